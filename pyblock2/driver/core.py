@@ -568,6 +568,7 @@ class DMRGDriver:
         min_mpo_mem=False,
         seq_type=None,
         compressed_mps_storage=False,
+        scheme_cache_dir=None,
     ):
         """
         Initialize :class:`DMRGDriver`.
@@ -619,6 +620,9 @@ class DMRGDriver:
             compressed_mps_storage : bool
                 Whether block-sparse tensor should be stored in compressed form to save storage (mainly for MPS).
                 Default is False.
+            scheme_cache_dir : None or str
+                If not None, the SU2 spin permutation schemes and NPDM schemes will be loaded from
+                (or saved to) this directory, which can be shared among jobs. Default is None.
         """
         if mpi is not None and mpi:
             self.mpi = True
@@ -635,6 +639,7 @@ class DMRGDriver:
         self.fp_codec_chunk = fp_codec_chunk
         self.min_mpo_mem = min_mpo_mem
         self.compressed_mps_storage = compressed_mps_storage
+        self.scheme_cache_dir = scheme_cache_dir
         self.symm_type = symm_type
         self.clean_scratch = clean_scratch
         bw = self.bw
@@ -1982,6 +1987,48 @@ class DMRGDriver:
         super_self = self
         import numpy as np
 
+        if SymmetryTypes.SU2 not in self.symm_type:
+            # no spin recoupling, native implementation
+            # c/C add and d/D subtract the lz given by orb_sym
+            if SymmetryTypes.SZ in self.symm_type:
+                lz_ops = {
+                    "": np.identity(4),  # identity
+                    "c": np.array(
+                        [[0, 0, 0, 0], [1, 0, 0, 0], [0, 0, 0, 0], [0, 0, 1, 0]]
+                    ),  # alpha+
+                    "d": np.array(
+                        [[0, 1, 0, 0], [0, 0, 0, 0], [0, 0, 0, 1], [0, 0, 0, 0]]
+                    ),  # alpha
+                    "C": np.array(
+                        [[0, 0, 0, 0], [0, 0, 0, 0], [1, 0, 0, 0], [0, -1, 0, 0]]
+                    ),  # beta+
+                    "D": np.array(
+                        [[0, 0, 1, 0], [0, 0, 0, -1], [0, 0, 0, 0], [0, 0, 0, 0]]
+                    ),  # beta
+                }
+            else:
+                lz_ops = {
+                    "": np.identity(2),  # identity
+                    "C": np.array([[0, 0], [1, 0]]),  # +
+                    "D": np.array([[0, 1], [0, 0]]),  # -
+                }
+            site_basis, site_ops = [], []
+            for m in range(self.n_sites):
+                lz = self.orb_sym[m]
+                if SymmetryTypes.SZ in self.symm_type:
+                    basis = [
+                        (self.bw.SX(0, 0, 0), 1),
+                        (self.bw.SX(1, 1, lz), 1),
+                        (self.bw.SX(1, -1, lz), 1),
+                        (self.bw.SX(2, 0, 2 * lz), 1),
+                    ]  # [0ab2]
+                else:
+                    basis = [(self.bw.SX(0, 0), 1), (self.bw.SX(1, lz), 1)]  # [0a]
+                site_basis.append(basis)
+                site_ops.append(lz_ops)
+            return self.get_custom_hamiltonian(site_basis, site_ops)
+
+        # SU2 mode, requires the SU2 recoupling rules
         class LZHamiltonian(GH):
             def __init__(self, vacuum, n_sites, orb_sym):
                 GH.__init__(self)
@@ -2003,25 +2050,11 @@ class DMRGDriver:
             def get_site_basis(self, m):
                 """Single site states."""
                 bz = super_self.bw.brs.StateInfo()
-                if SymmetryTypes.SU2 in super_self.symm_type:
-                    bz.allocate(3)
-                    bz.quanta[0] = super_self.bw.SX(0, 0, 0)
-                    bz.quanta[1] = super_self.bw.SX(1, 1, self.orb_sym[m])
-                    bz.quanta[2] = super_self.bw.SX(2, 0, 2 * self.orb_sym[m])
-                    bz.n_states[0] = bz.n_states[1] = bz.n_states[2] = 1
-                elif SymmetryTypes.SZ in super_self.symm_type:
-                    bz.allocate(4)
-                    bz.quanta[0] = super_self.bw.SX(0, 0, 0)
-                    bz.quanta[1] = super_self.bw.SX(1, 1, self.orb_sym[m])
-                    bz.quanta[2] = super_self.bw.SX(1, -1, self.orb_sym[m])
-                    bz.quanta[3] = super_self.bw.SX(2, 0, 2 * self.orb_sym[m])
-                    bz.n_states[0] = bz.n_states[1] = 1
-                    bz.n_states[2] = bz.n_states[3] = 1
-                else:
-                    bz.allocate(2)
-                    bz.quanta[0] = super_self.bw.SX(0, 0)
-                    bz.quanta[1] = super_self.bw.SX(1, self.orb_sym[m])
-                    bz.n_states[0] = bz.n_states[1] = 1
+                bz.allocate(3)
+                bz.quanta[0] = super_self.bw.SX(0, 0, 0)
+                bz.quanta[1] = super_self.bw.SX(1, 1, self.orb_sym[m])
+                bz.quanta[2] = super_self.bw.SX(2, 0, 2 * self.orb_sym[m])
+                bz.n_states[0] = bz.n_states[1] = bz.n_states[2] = 1
                 bz.sort_states()
                 return bz
 
@@ -2036,28 +2069,14 @@ class DMRGDriver:
                 max_n_even, max_s_even = max_n_odd ^ 1, max_s_odd ^ 1
                 for m in range(self.n_sites):
                     qs = {self.vacuum}
-                    if SymmetryTypes.SU2 in super_self.symm_type:
-                        for n in range(-max_n_odd, max_n_odd + 1, 2):
-                            for s in range(1, max_s_odd + 1, 2):
-                                for nz in range(-max_n_odd, max_n_odd + 1, 2):
-                                    qs.add(super_self.bw.SX(n, s, nz * self.orb_sym[m]))
-                        for n in range(-max_n_even, max_n_even + 1, 2):
-                            for s in range(0, max_s_even + 1, 2):
-                                for nz in range(-max_n_even, max_n_even + 1, 2):
-                                    qs.add(super_self.bw.SX(n, s, nz * self.orb_sym[m]))
-                    elif SymmetryTypes.SZ in super_self.symm_type:
-                        for n in range(-max_n_odd, max_n_odd + 1, 2):
-                            for s in range(-max_s_odd, max_s_odd + 1, 2):
-                                for nz in range(-max_n_odd, max_n_odd + 1, 2):
-                                    qs.add(super_self.bw.SX(n, s, nz * self.orb_sym[m]))
-                        for n in range(-max_n_even, max_n_even + 1, 2):
-                            for s in range(-max_s_even, max_s_even + 1, 2):
-                                for nz in range(-max_n_even, max_n_even + 1, 2):
-                                    qs.add(super_self.bw.SX(n, s, nz * self.orb_sym[m]))
-                    elif SymmetryTypes.SGF in super_self.symm_type:
-                        for n in range(-max_n, max_n + 1, 1):
-                            for nz in range(-max_n, max_n + 1, 1):
-                                qs.add(super_self.bw.SX(n, nz * self.orb_sym[m]))
+                    for n in range(-max_n_odd, max_n_odd + 1, 2):
+                        for s in range(1, max_s_odd + 1, 2):
+                            for nz in range(-max_n_odd, max_n_odd + 1, 2):
+                                qs.add(super_self.bw.SX(n, s, nz * self.orb_sym[m]))
+                    for n in range(-max_n_even, max_n_even + 1, 2):
+                        for s in range(0, max_s_even + 1, 2):
+                            for nz in range(-max_n_even, max_n_even + 1, 2):
+                                qs.add(super_self.bw.SX(n, s, nz * self.orb_sym[m]))
                     for q in sorted(qs):
                         mat = super_self.bw.brs.SparseMatrixInfo(i_alloc)
                         mat.initialize(self.basis[m], self.basis[m], q, q.is_fermion)
@@ -2065,174 +2084,64 @@ class DMRGDriver:
 
                 # prim ops
                 for m in range(self.n_sites):
-                    if SymmetryTypes.SU2 in super_self.symm_type:
-                        # ident
-                        mat = super_self.bw.bs.SparseMatrix(d_alloc)
-                        info = self.find_site_op_info(m, super_self.bw.SX(0, 0, 0))
-                        mat.allocate(info)
-                        mat[info.find_state(super_self.bw.SX(0, 0, 0, 0))] = np.array(
-                            [1.0]
-                        )
-                        mat[
-                            info.find_state(super_self.bw.SX(1, 1, 1, self.orb_sym[m]))
-                        ] = np.array([1.0])
-                        mat[
-                            info.find_state(
-                                super_self.bw.SX(2, 0, 0, 2 * self.orb_sym[m])
-                            )
-                        ] = np.array([1.0])
-                        self.site_norm_ops[m][""] = mat
-
-                        # C
-                        mat = super_self.bw.bs.SparseMatrix(d_alloc)
-                        info = self.find_site_op_info(
-                            m, super_self.bw.SX(1, 1, self.orb_sym[m])
-                        )
-                        mat.allocate(info)
-                        mat[info.find_state(super_self.bw.SX(0, 1, 0, 0))] = np.array(
-                            [1.0]
-                        )
-                        mat[
-                            info.find_state(super_self.bw.SX(1, 0, 1, self.orb_sym[m]))
-                        ] = np.array([-(2**0.5)])
-                        self.site_norm_ops[m]["C"] = mat
-
-                        # D
-                        mat = super_self.bw.bs.SparseMatrix(d_alloc)
-                        info = self.find_site_op_info(
-                            m, super_self.bw.SX(-1, 1, -self.orb_sym[m])
-                        )
-                        mat.allocate(info)
-                        mat[
-                            info.find_state(super_self.bw.SX(1, 0, 1, self.orb_sym[m]))
-                        ] = np.array([2**0.5])
-                        mat[
-                            info.find_state(
-                                super_self.bw.SX(2, 1, 0, 2 * self.orb_sym[m])
-                            )
-                        ] = np.array([1.0])
-                        self.site_norm_ops[m]["D"] = mat
-                    elif SymmetryTypes.SZ in super_self.symm_type:
-                        # ident
-                        mat = super_self.bw.bs.SparseMatrix(d_alloc)
-                        info = self.find_site_op_info(m, super_self.bw.SX(0, 0, 0))
-                        mat.allocate(info)
-                        mat[info.find_state(super_self.bw.SX(0, 0, 0))] = np.array(
-                            [1.0]
-                        )
-                        mat[
-                            info.find_state(super_self.bw.SX(1, 1, self.orb_sym[m]))
-                        ] = np.array([1.0])
-                        mat[
-                            info.find_state(super_self.bw.SX(1, -1, self.orb_sym[m]))
-                        ] = np.array([1.0])
-                        mat[
-                            info.find_state(super_self.bw.SX(2, 0, 2 * self.orb_sym[m]))
-                        ] = np.array([1.0])
-                        self.site_norm_ops[m][""] = mat
-
-                        # c
-                        mat = super_self.bw.bs.SparseMatrix(d_alloc)
-                        info = self.find_site_op_info(
-                            m, super_self.bw.SX(1, 1, self.orb_sym[m])
-                        )
-                        mat.allocate(info)
-                        mat[info.find_state(super_self.bw.SX(0, 0, 0))] = np.array(
-                            [1.0]
-                        )
-                        mat[
-                            info.find_state(super_self.bw.SX(1, -1, self.orb_sym[m]))
-                        ] = np.array([1.0])
-                        self.site_norm_ops[m]["c"] = mat
-
-                        # d
-                        mat = super_self.bw.bs.SparseMatrix(d_alloc)
-                        info = self.find_site_op_info(
-                            m, super_self.bw.SX(-1, -1, -self.orb_sym[m])
-                        )
-                        mat.allocate(info)
-                        mat[
-                            info.find_state(super_self.bw.SX(1, 1, self.orb_sym[m]))
-                        ] = np.array([1.0])
-                        mat[
-                            info.find_state(super_self.bw.SX(2, 0, 2 * self.orb_sym[m]))
-                        ] = np.array([1.0])
-                        self.site_norm_ops[m]["d"] = mat
-
-                        # C
-                        mat = super_self.bw.bs.SparseMatrix(d_alloc)
-                        info = self.find_site_op_info(
-                            m, super_self.bw.SX(1, -1, self.orb_sym[m])
-                        )
-                        mat.allocate(info)
-                        mat[info.find_state(super_self.bw.SX(0, 0, 0))] = np.array(
-                            [1.0]
-                        )
-                        mat[
-                            info.find_state(super_self.bw.SX(1, 1, self.orb_sym[m]))
-                        ] = np.array([-1.0])
-                        self.site_norm_ops[m]["C"] = mat
-
-                        # D
-                        mat = super_self.bw.bs.SparseMatrix(d_alloc)
-                        info = self.find_site_op_info(
-                            m, super_self.bw.SX(-1, 1, -self.orb_sym[m])
-                        )
-                        mat.allocate(info)
-                        mat[
-                            info.find_state(super_self.bw.SX(1, -1, self.orb_sym[m]))
-                        ] = np.array([1.0])
-                        mat[
-                            info.find_state(super_self.bw.SX(2, 0, 2 * self.orb_sym[m]))
-                        ] = np.array([-1.0])
-                        self.site_norm_ops[m]["D"] = mat
-                    elif SymmetryTypes.SGF in super_self.symm_type:
-                        # ident
-                        mat = super_self.bw.bs.SparseMatrix(d_alloc)
-                        info = self.find_site_op_info(m, super_self.bw.SX(0, 0))
-                        mat.allocate(info)
-                        mat[info.find_state(super_self.bw.SX(0, 0))] = np.array([1.0])
-                        mat[info.find_state(super_self.bw.SX(1, self.orb_sym[m]))] = (
-                            np.array([1.0])
+                    # ident
+                    mat = super_self.bw.bs.SparseMatrix(d_alloc)
+                    info = self.find_site_op_info(m, super_self.bw.SX(0, 0, 0))
+                    mat.allocate(info)
+                    mat[info.find_state(super_self.bw.SX(0, 0, 0, 0))] = np.array(
+                        [1.0]
+                    )
+                    mat[
+                        info.find_state(super_self.bw.SX(1, 1, 1, self.orb_sym[m]))
+                    ] = np.array([1.0])
+                    mat[
+                        info.find_state(
+                            super_self.bw.SX(2, 0, 0, 2 * self.orb_sym[m])
                         )
-                        self.site_norm_ops[m][""] = mat
+                    ] = np.array([1.0])
+                    self.site_norm_ops[m][""] = mat
 
-                        # C
-                        mat = super_self.bw.bs.SparseMatrix(d_alloc)
-                        info = self.find_site_op_info(
-                            m, super_self.bw.SX(1, self.orb_sym[m])
-                        )
-                        mat.allocate(info)
-                        mat[info.find_state(super_self.bw.SX(0, 0))] = np.array([1.0])
-                        self.site_norm_ops[m]["C"] = mat
+                    # C
+                    mat = super_self.bw.bs.SparseMatrix(d_alloc)
+                    info = self.find_site_op_info(
+                        m, super_self.bw.SX(1, 1, self.orb_sym[m])
+                    )
+                    mat.allocate(info)
+                    mat[info.find_state(super_self.bw.SX(0, 1, 0, 0))] = np.array(
+                        [1.0]
+                    )
+                    mat[
+                        info.find_state(super_self.bw.SX(1, 0, 1, self.orb_sym[m]))
+                    ] = np.array([-(2**0.5)])
+                    self.site_norm_ops[m]["C"] = mat
 
-                        # D
-                        mat = super_self.bw.bs.SparseMatrix(d_alloc)
-                        info = self.find_site_op_info(
-                            m, super_self.bw.SX(-1, -self.orb_sym[m])
-                        )
-                        mat.allocate(info)
-                        mat[info.find_state(super_self.bw.SX(1, self.orb_sym[m]))] = (
-                            np.array([1.0])
+                    # D
+                    mat = super_self.bw.bs.SparseMatrix(d_alloc)
+                    info = self.find_site_op_info(
+                        m, super_self.bw.SX(-1, 1, -self.orb_sym[m])
+                    )
+                    mat.allocate(info)
+                    mat[
+                        info.find_state(super_self.bw.SX(1, 0, 1, self.orb_sym[m]))
+                    ] = np.array([2**0.5])
+                    mat[
+                        info.find_state(
+                            super_self.bw.SX(2, 1, 0, 2 * self.orb_sym[m])
                         )
-                        self.site_norm_ops[m]["D"] = mat
+                    ] = np.array([1.0])
+                    self.site_norm_ops[m]["D"] = mat
 
             def get_site_string_op(self, m, expr):
                 """Construct longer site operators from primitive ones."""
                 d_alloc = super_self.bw.b.DoubleVectorAllocator()
                 if expr in self.site_norm_ops[m]:
                     return self.site_norm_ops[m][expr]
-                if SymmetryTypes.SU2 in super_self.symm_type:
-                    l = super_self.bw.b.SpinRecoupling.get_level(expr, 0)
-                    a = self.get_site_string_op(m, expr[l.left_idx : l.mid_idx - 1])
-                    b = self.get_site_string_op(m, expr[l.mid_idx : l.right_idx - 1])
-                    idq = super_self.bw.b.SpinPermRecoupling.get_target_twos(expr)
-                    jdq = a.info.delta_quantum + b.info.delta_quantum
-                    dq = super_self.bw.SX(jdq.values[0], idq, idq, jdq.values[3])
-                else:
-                    a = self.get_site_string_op(m, expr[:1])
-                    b = self.get_site_string_op(m, expr[1:])
-                    dq = a.info.delta_quantum + b.info.delta_quantum
+                l = super_self.bw.b.SpinRecoupling.get_level(expr, 0)
+                a = self.get_site_string_op(m, expr[l.left_idx : l.mid_idx - 1])
+                b = self.get_site_string_op(m, expr[l.mid_idx : l.right_idx - 1])
+                idq = super_self.bw.b.SpinPermRecoupling.get_target_twos(expr)
+                jdq = a.info.delta_quantum + b.info.delta_quantum
+                dq = super_self.bw.SX(jdq.values[0], idq, idq, jdq.values[3])
                 r = super_self.bw.bs.SparseMatrix(d_alloc)
                 r.allocate(self.find_site_op_info(m, dq))
                 self.opf.product(0, a, b, r)
@@ -2240,123 +2149,68 @@ class DMRGDriver:
                 return r
 
             def init_string_quanta(self, exprs, term_l, left_vacuum):
-                if SymmetryTypes.SU2 in super_self.symm_type:
-                    rr = super_self.bw.VectorVectorSX()
-                    for ix, expr in enumerate(exprs):
-                        r = super_self.bw.VectorSX(
-                            [super_self.bw.SX(0, 0, 0)] * (term_l[ix] + 1)
-                        )
-                        gr = super_self.bw.b.SpinPermRecoupling.get_target_twos(expr)
-                        r[-1] = super_self.bw.SX(
-                            expr.count("C") - expr.count("D"), gr, 0
+                rr = super_self.bw.VectorVectorSX()
+                for ix, expr in enumerate(exprs):
+                    r = super_self.bw.VectorSX(
+                        [super_self.bw.SX(0, 0, 0)] * (term_l[ix] + 1)
+                    )
+                    gr = super_self.bw.b.SpinPermRecoupling.get_target_twos(expr)
+                    r[-1] = super_self.bw.SX(
+                        expr.count("C") - expr.count("D"), gr, 0
+                    )
+                    lacc, nacc = 0, 0
+                    while True:  # (.+(.+(.+.)0)0)0
+                        l = super_self.bw.b.SpinRecoupling.get_level(expr, 0)
+                        if l.right_idx == -1:
+                            break
+                        exprl, exprr = (
+                            expr[0 : l.mid_idx - 1],
+                            expr[l.mid_idx : l.right_idx - 1],
                         )
-                        lacc, nacc = 0, 0
-                        while True:  # (.+(.+(.+.)0)0)0
-                            l = super_self.bw.b.SpinRecoupling.get_level(expr, 0)
-                            if l.right_idx == -1:
-                                break
-                            exprl, exprr = (
-                                expr[0 : l.mid_idx - 1],
-                                expr[l.mid_idx : l.right_idx - 1],
-                            )
-                            lacc += exprl.count("C") + exprl.count("D")
-                            nacc += exprl.count("C") - exprl.count("D")
-                            r[lacc] = super_self.bw.SX(
-                                nacc,
-                                super_self.bw.b.SpinPermRecoupling.get_target_twos(
-                                    exprr
-                                ),
-                                0,
-                            )
-                            expr = exprr
-                        rr.append(r)
-                    return rr
-                elif SymmetryTypes.SZ in super_self.symm_type:
-                    qs = {
-                        "": super_self.bw.SX(0, 0, 0),
-                        "c": super_self.bw.SX(1, 1, 0),
-                        "d": super_self.bw.SX(-1, -1, 0),
-                        "C": super_self.bw.SX(1, -1, 0),
-                        "D": super_self.bw.SX(-1, 1, 0),
-                    }
-                else:
-                    qs = {
-                        "": super_self.bw.SX(0, 0),
-                        "C": super_self.bw.SX(1, 0),
-                        "D": super_self.bw.SX(-1, 0),
-                    }
-                from itertools import accumulate
-
-                return super_self.bw.VectorVectorSX(
-                    [
-                        super_self.bw.VectorSX(
-                            list(
-                                accumulate(
-                                    [qs[""]] + [qs[x] for x in expr], lambda x, y: x + y
-                                )
-                            )
+                        lacc += exprl.count("C") + exprl.count("D")
+                        nacc += exprl.count("C") - exprl.count("D")
+                        r[lacc] = super_self.bw.SX(
+                            nacc,
+                            super_self.bw.b.SpinPermRecoupling.get_target_twos(
+                                exprr
+                            ),
+                            0,
                         )
-                        for expr in exprs
-                    ]
-                )
+                        expr = exprr
+                    rr.append(r)
+                return rr
 
             def get_string_quanta(self, ref, expr, idxs, k):
                 """Quantum number for string operators (orbital dependent part)."""
                 l, r = ref[k], ref[-1] - ref[k]
-                iv = (
-                    1
-                    + (SymmetryTypes.SZ in super_self.symm_type)
-                    + 2 * (SymmetryTypes.SU2 in super_self.symm_type)
-                )
                 j = 0
                 for ixx, ex in enumerate(expr):
-                    if ex not in "cdCD":
+                    if ex not in "CD":
                         continue
                     ipg = self.orb_sym[idxs[j]]
                     if j < k:
-                        l.values[iv] += ipg if ex in "cC" else -ipg
+                        l.values[3] += ipg if ex == "C" else -ipg
                     else:
-                        r.values[iv] += ipg if ex in "cC" else -ipg
+                        r.values[3] += ipg if ex == "C" else -ipg
                     j += 1
                 return l, r
 
             def get_string_quantum(self, expr, idxs):
                 """Total quantum number for a string operator."""
-                if SymmetryTypes.SU2 in super_self.symm_type:
-                    idq = super_self.bw.b.SpinPermRecoupling.get_target_twos(expr)
-                    qs = lambda ix: {
-                        "": super_self.bw.SX(0, 0, 0),
-                        "C": super_self.bw.SX(1, 1, self.orb_sym[ix]),
-                        "D": super_self.bw.SX(-1, 1, -self.orb_sym[ix]),
-                    }
-                    r = qs(0)[""]
-                    j = 0
-                    for ixx, ex in enumerate(expr):
-                        if ex in "CD":
-                            r = r + qs(idxs[j])[ex]
-                            j += 1
-                    r.values[1] = r.values[2] = idq
-                    return r
-                elif SymmetryTypes.SZ in super_self.symm_type:
-                    qs = lambda ix: {
-                        "": super_self.bw.SX(0, 0, 0),
-                        "c": super_self.bw.SX(1, 1, self.orb_sym[ix]),
-                        "d": super_self.bw.SX(-1, -1, -self.orb_sym[ix]),
-                        "C": super_self.bw.SX(1, -1, self.orb_sym[ix]),
-                        "D": super_self.bw.SX(-1, 1, -self.orb_sym[ix]),
-                    }
-                else:
-                    qs = lambda ix: {
-                        "": super_self.bw.SX(0, 0),
-                        "C": super_self.bw.SX(1, self.orb_sym[ix]),
-                        "D": super_self.bw.SX(-1, -self.orb_sym[ix]),
-                    }
-                from functools import reduce
-
-                return reduce(
-                    lambda a, b: a + b,
-                    [qs(0)[""]] + [qs(ix)[ex] for ex, ix in zip(expr, idxs)],
-                )
+                idq = super_self.bw.b.SpinPermRecoupling.get_target_twos(expr)
+                qs = lambda ix: {
+                    "": super_self.bw.SX(0, 0, 0),
+                    "C": super_self.bw.SX(1, 1, self.orb_sym[ix]),
+                    "D": super_self.bw.SX(-1, 1, -self.orb_sym[ix]),
+                }
+                r = qs(0)[""]
+                j = 0
+                for ixx, ex in enumerate(expr):
+                    if ex in "CD":
+                        r = r + qs(idxs[j])[ex]
+                        j += 1
+                r.values[1] = r.values[2] = idq
+                return r
 
             def deallocate(self):
                 """Release memory."""
@@ -2407,13 +2261,13 @@ class DMRGDriver:
                 List of spin symmetries for site operators. Default is None.
 
         Returns:
-            ghamil : CustomHamiltonian
+            ghamil : GeneralCustomHamiltonian or CustomHamiltonian
                 The Hamiltonian object, implicitly required for MPO and MPS construction.
+                Without SU2 symmetry, this is the native ``GeneralCustomHamiltonian``.
         """
         GH = self.bw.bs.GeneralHamiltonian
         super_self = self
         import numpy as np
-        from itertools import accumulate
 
         no_dep = (
             spin_dependent_ops == ""
@@ -2424,8 +2278,23 @@ class DMRGDriver:
         if (
             SymmetryTypes.SZ in super_self.symm_type
             or SymmetryTypes.SAny in super_self.symm_type
-        ):
+        ) and SymmetryTypes.SU2 not in super_self.symm_type:
+
+            # native implementation, no Python callbacks during MPO construction
+            return self.bw.bs.GeneralCustomHamiltonian(
+                self.vacuum,
+                self.n_sites,
+                self.orb_sym,
+                site_basis,
+                site_ops,
+                orb_dependent_ops,
+                spin_dependent_ops,
+                spin_sym,
+            )
 
+        elif SymmetryTypes.SAny in super_self.symm_type:
+
+            # spin-adapted (SAny | SU2) mode, requires the SU2 recoupling rules
             class CustomHamiltonian(GH):
                 def __init__(self, vacuum, n_sites, orb_sym, spin_sym=None):
                     GH.__init__(self)
@@ -2467,41 +2336,19 @@ class DMRGDriver:
                     i_alloc = super_self.bw.b.IntVectorAllocator()
                     d_alloc = super_self.bw.b.DoubleVectorAllocator()
                     # site op infos
-                    if (
-                        SymmetryTypes.SZ in super_self.symm_type
-                        and SymmetryTypes.SAny not in super_self.symm_type
-                    ):
-                        max_n, max_s = 10, 10
-                        max_n_odd, max_s_odd = max_n | 1, max_s | 1
-                        max_n_even, max_s_even = max_n_odd ^ 1, max_s_odd ^ 1
-                        for m in range(self.n_sites):
-                            qs = {self.vacuum}
-                            for n in range(-max_n_odd, max_n_odd + 1, 2):
-                                for s in range(-max_s_odd, max_s_odd + 1, 2):
-                                    qs.add(super_self.bw.SX(n, s, self.orb_sym[m]))
-                            for n in range(-max_n_even, max_n_even + 1, 2):
-                                for s in range(-max_s_even, max_s_even + 1, 2):
-                                    qs.add(super_self.bw.SX(n, s, 0))
-                            for q in sorted(qs):
-                                mat = super_self.bw.brs.SparseMatrixInfo(i_alloc)
-                                mat.initialize(
-                                    self.basis[m], self.basis[m], q, q.is_fermion
-                                )
-                                self.site_op_infos[m].append((q, mat))
-                    else:
-                        for m in range(self.n_sites):
-                            qs = {self.vacuum}
-                            for q, _ in site_basis[m]:
-                                for k, _ in site_basis[m]:
-                                    new_q = q - k
-                                    for iq in range(new_q.count):
-                                        qs.add(new_q[iq])
-                            for q in sorted(qs):
-                                mat = super_self.bw.brs.SparseMatrixInfo(i_alloc)
-                                mat.initialize(
-                                    self.basis[m], self.basis[m], q, q.is_fermion
-                                )
-                                self.site_op_infos[m].append((q, mat))
+                    for m in range(self.n_sites):
+                        qs = {self.vacuum}
+                        for q, _ in site_basis[m]:
+                            for k, _ in site_basis[m]:
+                                new_q = q - k
+                                for iq in range(new_q.count):
+                                    qs.add(new_q[iq])
+                        for q in sorted(qs):
+                            mat = super_self.bw.brs.SparseMatrixInfo(i_alloc)
+                            mat.initialize(
+                                self.basis[m], self.basis[m], q, q.is_fermion
+                            )
+                            self.site_op_infos[m].append((q, mat))
 
                     assert len(site_ops) == self.n_sites
 
@@ -2570,77 +2417,37 @@ class DMRGDriver:
                     d_alloc = super_self.bw.b.DoubleVectorAllocator()
                     if expr in self.site_norm_ops[m]:
                         return self.site_norm_ops[m][expr]
-                    if SymmetryTypes.SU2 in super_self.symm_type:
-                        l = super_self.bw.b.SpinRecoupling.get_level(expr, 0)
-                        a = self.get_site_string_op(m, expr[l.left_idx : l.mid_idx - 1])
-                        b = self.get_site_string_op(
-                            m, expr[l.mid_idx : l.right_idx - 1]
-                        )
-                        dq = self.get_su2_string_quantum(
-                            expr, [m] * (l.left_cnt + l.right_cnt)
-                        )
-                        r = super_self.bw.bs.SparseMatrix(d_alloc)
-                        r.allocate(self.find_site_op_info(m, dq))
-                        self.opf.product(0, a, b, r)
-                        self.site_norm_ops[m][expr] = r
-                    else:
-                        r = self.site_norm_ops[m][expr[0]]
-                        for p in expr[1:]:
-                            xp = self.site_norm_ops[m][p]
-                            q = r.info.delta_quantum + xp.info.delta_quantum
-                            mat = super_self.bw.bs.SparseMatrix(d_alloc)
-                            dq = self.find_site_op_info(m, q)
-                            assert dq is not None
-                            mat.allocate(dq)
-                            self.opf.product(0, r, xp, mat)
-                            r = mat
-                        self.site_norm_ops[m][expr] = r
+                    l = super_self.bw.b.SpinRecoupling.get_level(expr, 0)
+                    a = self.get_site_string_op(m, expr[l.left_idx : l.mid_idx - 1])
+                    b = self.get_site_string_op(m, expr[l.mid_idx : l.right_idx - 1])
+                    dq = self.get_su2_string_quantum(
+                        expr, [m] * (l.left_cnt + l.right_cnt)
+                    )
+                    r = super_self.bw.bs.SparseMatrix(d_alloc)
+                    r.allocate(self.find_site_op_info(m, dq))
+                    self.opf.product(0, a, b, r)
+                    self.site_norm_ops[m][expr] = r
                     return r
 
                 def init_string_quanta(self, exprs, term_l, left_vacuum):
                     """Quantum number for string operators (orbital independent part)."""
-                    if SymmetryTypes.SU2 in super_self.symm_type:
-                        rr = super_self.bw.VectorVectorSX()
-                        for ix, expr in enumerate(exprs):
-                            r = super_self.bw.VectorSX([self.vacuum] * (term_l[ix] + 1))
-                            r[-1] = self.get_su2_string_quantum(expr, [])
-                            lacc = 0
-                            while True:  # (.+(.+(.+.)0)0)0
-                                l = super_self.bw.b.SpinRecoupling.get_level(expr, 0)
-                                if l.right_idx == -1:
-                                    break
-                                exprr = expr[l.mid_idx : l.right_idx - 1]
-                                lacc += l.left_cnt
-                                r[lacc] = (
-                                    r[-1] - self.get_su2_string_quantum(exprr, [])
-                                )[0]
-                                expr = exprr
-                            rr.append(r)
-                        return rr
-                    else:
-                        qs = {}
-                        for norm_ops in self.site_norm_ops:
-                            for k, v in norm_ops.items():
-                                if k not in qs:
-                                    # must copy to prevent changing v.info.dq
-                                    qs[k] = v.info.delta_quantum[0]
-                                    if k in orb_dependent_ops:
-                                        qs[k].pg = 0
-                                    if k in spin_dependent_ops:
-                                        qs[k].twos = 0
-                        return super_self.bw.VectorVectorSX(
-                            [
-                                super_self.bw.VectorSX(
-                                    list(
-                                        accumulate(
-                                            [qs[""]] + [qs[x] for x in expr],
-                                            lambda x, y: x + y,
-                                        )
-                                    )
-                                )
-                                for expr in exprs
-                            ]
-                        )
+                    rr = super_self.bw.VectorVectorSX()
+                    for ix, expr in enumerate(exprs):
+                        r = super_self.bw.VectorSX([self.vacuum] * (term_l[ix] + 1))
+                        r[-1] = self.get_su2_string_quantum(expr, [])
+                        lacc = 0
+                        while True:  # (.+(.+(.+.)0)0)0
+                            l = super_self.bw.b.SpinRecoupling.get_level(expr, 0)
+                            if l.right_idx == -1:
+                                break
+                            exprr = expr[l.mid_idx : l.right_idx - 1]
+                            lacc += l.left_cnt
+                            r[lacc] = (
+                                r[-1] - self.get_su2_string_quantum(exprr, [])
+                            )[0]
+                            expr = exprr
+                        rr.append(r)
+                    return rr
 
                 def get_string_quanta(self, ref, expr, idxs, k):
                     """Quantum number for string operators (orbital dependent part)."""
@@ -2704,19 +2511,7 @@ class DMRGDriver:
 
                 def get_string_quantum(self, expr, idxs):
                     """Total quantum number for a string operator."""
-                    if SymmetryTypes.SU2 in super_self.symm_type:
-                        return self.get_su2_string_quantum(expr, idxs)
-                    else:
-                        qs = lambda ix: {
-                            k: v.info.delta_quantum
-                            for k, v in self.site_norm_ops[ix].items()
-                        }
-                        from functools import reduce
-
-                        return reduce(
-                            lambda a, b: a + b,
-                            [qs(0)[""]] + [qs(ix)[ex] for ex, ix in zip(expr, idxs)],
-                        )
+                    return self.get_su2_string_quantum(expr, idxs)
 
                 def deallocate(self):
                     """Release memory."""
@@ -4227,12 +4022,14 @@ class DMRGDriver:
                 ``ndim = 4`` unpacked two-electron integral.
             method : str
                 The algorithm name for orbital reordering.
-                Can be "gaopt" or "fiedler" (default).
+                Can be "gaopt", "sa" (simulated annealing seeded from fiedler) or "fiedler" (default).
             kwargs : dict
-                Only have effect when ``method == "gaopt"``.
+                Only have effect when ``method == "gaopt"`` or ``method == "sa"``.
                 Custom options for the genetic orbital ordering algorithm.
                 Possible keys are ``n_tasks``, ``n_generations``, ``n_configs``,
-                ``n_elite``, ``clone_rate``, and ``mutate_rate``.
+                ``n_elite``, ``clone_rate``, ``mutate_rate``, ``target_cost``, and ``iprint``.
+                For simulated annealing, possible keys are ``n_steps``, ``seed``,
+                ``target_cost``, and ``iprint``.
 
         Returns:
             idx : np.ndarray[int]
@@ -4269,6 +4066,10 @@ class DMRGDriver:
                 idx = tuple(idx)
                 idxs.append(idx)
             idx = sorted(list(set(idxs)))[0]
+        elif method == "sa":
+            opts = dict(n_steps=1000000, seed=1234)
+            opts.update(kwargs)
+            idx = bw.b.OrbitalOrdering.sa_opt(len(h1e), kmat, idx, **opts)
 
         return np.array(idx, dtype=int)
 
@@ -4396,6 +4197,7 @@ class DMRGDriver:
         fused_contraction_multiplication=False,
         fused_contraction_rotation=False,
         lowmem_numerical_transform=False,
+        subspace_expansion=0.0,
     ):
         """
         Perform the ground state and/or excited state Density Matrix
@@ -4529,6 +4331,10 @@ class DMRGDriver:
             lowmem_numerical_transform : bool
                 If True, numerical transform will be done with copying to save peak memory.
                 Defult is False.
+            subspace_expansion : float
+                Only for one-site sweeps with density matrix decomposition. Number of
+                complementary states added to the bond in each step, as a fraction of the
+                bond dimension. Zero means no expansion. Default is 0.0.
 
         Returns:
             energy : float|complex or list[float|complex]
@@ -4654,6 +4460,7 @@ class DMRGDriver:
         dmrg.store_seq_data = store_seq_data
         dmrg.iprint = iprint
         dmrg.cutoff = cutoff
+        dmrg.subspace_expansion = subspace_expansion
         dmrg.trunc_type = dmrg.trunc_type | bw.b.TruncationTypes.RealDensityMatrix
         if kernel is not None:
             # need to keep Python derived class in memory (stored in self)
@@ -5559,11 +5366,18 @@ class DMRGDriver:
                 op_str = "(C+D)0"
                 for _ in range(pdm_type - 1):
                     op_str = su2_coupling % op_str
-            perm = bw.b.SpinPermScheme.initialize_su2(
-                pdm_type * 2, op_str, True,
-                mask=bw.b.VectorUInt16() if mask is None else bw.b.VectorUInt16(mask),
-                max_n_sites=ket.n_sites,
-            )
+            if self.scheme_cache_dir is not None:
+                perm = bw.b.SpinPermScheme(
+                    op_str, True, True, True, False,
+                    bw.b.VectorUInt16() if mask is None else bw.b.VectorUInt16(mask),
+                    ket.n_sites, self.scheme_cache_dir,
+                )
+            else:
+                perm = bw.b.SpinPermScheme.initialize_su2(
+                    pdm_type * 2, op_str, True,
+                    mask=bw.b.VectorUInt16() if mask is None else bw.b.VectorUInt16(mask),
+                    max_n_sites=ket.n_sites,
+                )
             perms = bw.b.VectorSpinPermScheme([perm])
         elif SymmetryTypes.SZ in bw.symm_type:
             if npdm_expr is not None and isinstance(npdm_expr, str):
@@ -5742,7 +5556,10 @@ class DMRGDriver:
 
             self.align_mps_center(mbra, mket, max_bond_dim=max_bond_dim)
 
-            scheme = bw.b.NPDMScheme(perms)
+            if self.scheme_cache_dir is not None:
+                scheme = bw.b.NPDMScheme(perms, self.scheme_cache_dir)
+            else:
+                scheme = bw.b.NPDMScheme(perms)
             opdq = (mbra.info.target - mket.info.target)[0]
             if SymmetryTypes.SU2 in bw.symm_type:
                 opdq.twos = opdq.twos_low = bw.b.SpinPermRecoupling.get_target_twos(
@@ -5825,7 +5642,10 @@ class DMRGDriver:
             if iprint >= 1 and simulated_parallel != 0:
                 print("simulated parallel accumulate files...")
 
-            scheme = bw.b.NPDMScheme(perms)
+            if self.scheme_cache_dir is not None:
+                scheme = bw.b.NPDMScheme(perms, self.scheme_cache_dir)
+            else:
+                scheme = bw.b.NPDMScheme(perms)
             pmpo = bw.bs.GeneralNPDMMPO(
                 self.ghamil, scheme, NPDMAlgorithmTypes.SymbolFree in algo_type
             )
@@ -5873,12 +5693,13 @@ class DMRGDriver:
 
         npdms = list(expect.get_npdm())
 
+        # zero-copy views of the npdm tensors
+        for ip in range(len(npdms)):
+            npdms[ip] = np.asarray(npdms[ip])
+
         if SymmetryTypes.SU2 in bw.symm_type:
             for ip in range(len(npdms)):
-                npdms[ip] *= np.array(np.sqrt(2.0)) ** (scheme.n_max_ops // 2)
-        else:
-            for ip in range(len(npdms)):
-                npdms[ip] = np.asarray(npdms[ip])
+                npdms[ip] *= np.sqrt(2.0) ** (scheme.n_max_ops // 2)
 
         if self.reorder_idx is not None:
             rev_idx = np.argsort(self.reorder_idx)
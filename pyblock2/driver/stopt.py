@@ -49,10 +49,13 @@ class SPDMRG:
     """
 
     def __init__(self, su2, scratch='./nodex', fcidump=None, orb_idx=None,
-                 mps_tags=[], verbose=0, use_threading=True, n_steps=20, ratio=0.5):
+                 mps_tags=[], verbose=0, use_threading=True, n_steps=20, ratio=0.5,
+                 batch_size=0, seed=0):
         """
         Memory is in bytes.
         verbose = 0 (quiet), 2 (per sweep), 3 (per iteration)
+        batch_size > 0: use batched sampler with reproducible random streams
+            (independent of number of threads and MPI procs)
         """
         self.fcidump = None 
         self.hamil = None
@@ -61,6 +64,8 @@ class SPDMRG:
         self.mpo_orig = None
         self.use_threading = use_threading
         self.n_steps = n_steps
+        self.batch_size = batch_size
+        self.seed = seed
         self.bdims = [0, 0]
         self.su2 = su2
         self.orb_idx = orb_idx
@@ -204,7 +209,10 @@ class SPDMRG:
             n_samp_per_rank = max_samp - mrank * max_samp_per_rank
         else:
             n_samp_per_rank = max_samp_per_rank
-        if self.use_threading:
+        if self.use_threading and self.batch_size > 0:
+            H00, H00_2 = self.SPDMRG.batched_sampling(n_samp_per_rank, 0, self.fcidump,
+                seed=self.seed, sample_start=mrank * max_samp_per_rank, batch=self.batch_size)[:2]
+        elif self.use_threading:
             H00, H00_2 = self.SPDMRG.parallel_sampling(n_samp_per_rank, 0, self.fcidump)
         else:
             for num_samp in range(n_samp_per_rank):
@@ -241,7 +249,12 @@ class SPDMRG:
                 else:
                     n_sub_samp = n_samp_per_rank // self.n_steps
                 tx = time.perf_counter()
-                results = self.SPDMRG.parallel_sampling(n_sub_samp, 1, self.fcidump)
+                if self.batch_size > 0:
+                    results = self.SPDMRG.batched_sampling(n_sub_samp, 1, self.fcidump,
+                        seed=self.seed + 1, sample_start=mrank * max_samp_per_rank + current_max_samp,
+                        batch=self.batch_size)[:4]
+                else:
+                    results = self.SPDMRG.parallel_sampling(n_sub_samp, 1, self.fcidump)
                 sub_results = [ra + rb * n_sub_samp for ra, rb in zip(sub_results,results)]
                 current_max_samp += n_sub_samp
                 fcms = np.float64(current_max_samp)
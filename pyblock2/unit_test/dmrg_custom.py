@@ -0,0 +1,101 @@
+import pytest
+import numpy as np
+from pyblock2.driver.core import DMRGDriver, SymmetryTypes
+
+pytestmark = pytest.mark.filterwarnings("ignore::DeprecationWarning")
+
+
+@pytest.fixture(scope="module")
+def symm_type(pytestconfig):
+    return pytestconfig.getoption("symm")
+
+
+@pytest.fixture(scope="module", params=["SZ", "SGF"])
+def spin_type(request):
+    return request.param
+
+
+def get_lz_integrals(lz):
+    """Random real integrals conserving the total lz."""
+    n = len(lz)
+    np.random.seed(384666)
+    h1e = np.random.random((n, n)) - 0.5
+    h1e = h1e + h1e.T
+    g2e = np.random.random((n, n, n, n)) * 0.1
+    g2e = g2e + g2e.transpose(1, 0, 2, 3)
+    g2e = g2e + g2e.transpose(0, 1, 3, 2)
+    g2e = g2e + g2e.transpose(2, 3, 0, 1)
+    h1e[lz[:, None] != lz[None, :]] = 0
+    dlz = (
+        lz[:, None, None, None]
+        - lz[None, :, None, None]
+        + lz[None, None, :, None]
+        - lz[None, None, None, :]
+    )
+    g2e[dlz != 0] = 0
+    return h1e, g2e
+
+
+class TestCustomHamiltonian:
+    def test_lz(self, tmp_path, spin_type, symm_type):
+        if symm_type != "sany":
+            pytest.skip("LZ symmetry requires the SAny build")
+
+        lz = np.array([-2, -1, 0, 0, 1, 2])
+        n_sites, n_elec = len(lz), 6
+        h1e, g2e = get_lz_integrals(lz)
+
+        assert np.linalg.norm(g2e - g2e.transpose(2, 3, 0, 1)) < 1e-12
+        assert np.linalg.norm(g2e - g2e.transpose(1, 0, 3, 2)) < 1e-12
+
+        bond_dims = [100] * 8
+        noises = [1e-5] * 4 + [0]
+        thrds = [1e-12] * 8
+
+        # reference without LZ symmetry
+        symm = SymmetryTypes.SAnySZ if spin_type == "SZ" else SymmetryTypes.SAnySGF
+        driver = DMRGDriver(
+            scratch=str(tmp_path / "nodex"), symm_type=symm, n_threads=4
+        )
+        if spin_type == "SZ":
+            driver.initialize_system(n_sites=n_sites, n_elec=n_elec, spin=0)
+        else:
+            driver.initialize_system(n_sites=n_sites * 2, n_elec=n_elec, spin=0)
+        mpo = driver.get_qc_mpo(h1e=h1e, g2e=g2e, iprint=0)
+        ket = driver.get_random_mps(tag="REF", bond_dim=100, nroots=1)
+        e_ref = driver.dmrg(
+            mpo, ket, n_sweeps=20, bond_dims=bond_dims, noises=noises,
+            thrds=thrds, iprint=0,
+        )
+        driver.finalize()
+
+        # LZ symmetry using the native custom Hamiltonian
+        symm = (
+            SymmetryTypes.SAnySZLZ if spin_type == "SZ" else SymmetryTypes.SAnySGFLZ
+        )
+        driver = DMRGDriver(
+            scratch=str(tmp_path / "nodex"), symm_type=symm, n_threads=4
+        )
+        energies = {}
+        for k in range(-2, 3):
+            if spin_type == "SZ":
+                driver.initialize_system(
+                    n_sites=n_sites, n_elec=n_elec, spin=0, orb_sym=lz, pg_irrep=k
+                )
+            else:
+                driver.initialize_system(
+                    n_sites=n_sites * 2, n_elec=n_elec, spin=0,
+                    orb_sym=np.repeat(lz, 2), pg_irrep=k,
+                )
+            assert isinstance(driver.ghamil, driver.bw.bs.GeneralCustomHamiltonian)
+            mpo = driver.get_qc_mpo(h1e=h1e, g2e=g2e, iprint=0)
+            ket = driver.get_random_mps(tag="KET%d" % (k + 2), bond_dim=100, nroots=1)
+            energies[k] = driver.dmrg(
+                mpo, ket, n_sweeps=20, bond_dims=bond_dims, noises=noises,
+                thrds=thrds, iprint=0,
+            )
+        driver.finalize()
+
+        # the ground state lies in one of the lz sectors
+        assert abs(min(energies.values()) - e_ref) < 1e-8
+        assert max(energies.values()) - min(energies.values()) > 1e-4
@@ -168,6 +168,7 @@ setup(
     scripts=[
         "pyblock2/driver/block2main",
         "pyblock2/driver/gaopt",
+        "pyblock2/driver/schemecache",
         "pyblock2/driver/readwfn.py",
         "pyblock2/driver/writewfn.py",
         "block2",
@@ -30,6 +30,7 @@
 #include <array>
 #include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <unordered_map>
 #include <vector>
 
@@ -71,10 +72,28 @@ struct CSFSpace<S, FL, typename S::is_su2_t> {
     FP sparse_cutoff = 1E-14;
     FP sparse_max_nonzero_ratio = 0.25;
     CSFSpace(int n_orbs, int n_max_elec, bool is_right,
-             const vector<uint8_t> &orb_sym = vector<uint8_t>())
+             const vector<uint8_t> &orb_sym = vector<uint8_t>(),
+             const string &cache_filename = "")
         : n_orbs(n_orbs), is_right(is_right), n_max_elec(n_max_elec) {
         assert((int)orb_sym.size() == n_orbs || orb_sym.size() == 0);
         combinatorics = make_shared<Combinatorics>(n_orbs);
+        if (cache_filename != "" && Parsing::file_exists(cache_filename) &&
+            load_data(cache_filename, orb_sym))
+            return;
+        bool has_sym = false;
+        for (auto x : orb_sym)
+            has_sym = has_sym || x != 0;
+        basis = has_sym ? tensor_product_basis(orb_sym) : combinatorial_basis();
+        if (n_orbs != 0) {
+            build_tables();
+            cg = make_shared<CG<S>>((n_max_unpaired + 1) * 2);
+        }
+        if (cache_filename != "")
+            save_data(cache_filename, orb_sym);
+    }
+    // basis from repeated tensor product of site bases
+    shared_ptr<StateInfo<S>>
+    tensor_product_basis(const vector<uint8_t> &orb_sym) const {
         vector<shared_ptr<StateInfo<S>>> site_basis(n_orbs);
         S vacuum, target(S::invalid);
         for (int m = 0; m < n_orbs; m++) {
@@ -110,36 +129,77 @@ struct CSFSpace<S, FL, typename S::is_su2_t> {
                     x->n_states[q] = 0;
             x->collect();
         }
-        basis = x;
-        if (n_orbs == 0)
-            return;
+        return x;
+    }
+    // basis from counting CSFs directly (no point group symmetry)
+    // number of CSFs = C(n_orbs, n_double) * C(n_orbs - n_double, n_unpaired)
+    //   * (number of spin couplings of n_unpaired electrons to twos)
+    shared_ptr<StateInfo<S>> combinatorial_basis() const {
+        const uint64_t max_n_states = numeric_limits<ubond_t>::max();
+        auto mul_sat = [](uint64_t a, uint64_t b) -> uint64_t {
+            return a != 0 && b > numeric_limits<uint64_t>::max() / a
+                       ? numeric_limits<uint64_t>::max()
+                       : a * b;
+        };
+        map<S, uint64_t> mp;
+        for (int nd = 0; nd <= n_orbs; nd++)
+            for (int j = 0; j <= n_orbs - nd; j++) {
+                const int n = nd + nd + j;
+                if (is_right ? n > n_max_elec : n < n_orbs * 2 - n_max_elec)
+                    continue;
+                const uint64_t ncfg =
+                    mul_sat(combinatorics->combination(n_orbs, nd),
+                            combinatorics->combination(n_orbs - nd, j));
+                for (int twos = j & 1; twos <= j; twos += 2) {
+                    if (!is_right && twos > n_max_elec)
+                        continue;
+                    const int k = (j - twos) >> 1;
+                    const uint64_t nspin =
+                        combinatorics->combination(j, k) -
+                        (k == 0 ? 0 : combinatorics->combination(j, k - 1));
+                    uint64_t &x = mp[S(n, twos, 0)];
+                    x = min(x + mul_sat(ncfg, nspin), max_n_states);
+                }
+            }
+        shared_ptr<StateInfo<S>> x = make_shared<StateInfo<S>>();
+        x->allocate((int)mp.size());
+        int iq = 0;
+        for (auto &r : mp)
+            x->quanta[iq] = r.first, x->n_states[iq++] = (ubond_t)r.second;
+        x->collect();
+        return x;
+    }
+    // [012] config and [+-] pattern tables for the basis
+    void build_tables() {
+        int ntg = threading->activate_global();
         qs.resize(basis->n);
         qs_idxs.resize(basis->n + 1, 0);
+        n_max_unpaired = 0;
         for (int i = 0; i < basis->n; i++) {
             qs[i] = basis->quanta[i];
-            qs_idxs[i + 1] =
-                qs_idxs[i] +
-                ((min(qs[i].n(), n_max_elec) - qs[i].twos()) >> 1) + 1;
+            const int nj = ((min(qs[i].n(), n_max_elec) - qs[i].twos()) >> 1);
+            qs_idxs[i + 1] = qs_idxs[i] + nj + 1;
+            n_max_unpaired = max(n_max_unpaired, qs[i].twos() + nj * 2);
         }
         n_unpaired.resize(qs_idxs.back());
         n_unpaired_idxs.resize(qs_idxs.back() + 1, 0);
         n_unpaired_shapes.resize(qs_idxs.back());
-        n_max_unpaired = 0;
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
         for (int i = 0; i < basis->n; i++) {
             int ij = qs_idxs[i];
             int n_elec = qs[i].n(), two_s = qs[i].twos();
             for (int j = two_s; j <= min(qs[i].n(), n_max_elec); j += 2, ij++) {
-                n_max_unpaired = max(n_max_unpaired, j);
                 n_unpaired[ij] = j;
                 n_unpaired_shapes[ij] = make_pair(
                     combinatorics->combination(n_orbs, (n_elec - j) >> 1),
                     combinatorics->combination(n_orbs - ((n_elec - j) >> 1),
                                                j));
                 n_unpaired_idxs[ij + 1] =
-                    n_unpaired_idxs[ij] +
                     n_unpaired_shapes[ij].first * n_unpaired_shapes[ij].second;
             }
         }
+        for (int ij = 0; ij < qs_idxs.back(); ij++)
+            n_unpaired_idxs[ij + 1] += n_unpaired_idxs[ij];
         csf_idxs.resize(n_max_unpaired + 2);
         csf_idxs[0] = 0;
         for (int i = 0; i <= n_max_unpaired; i++)
@@ -171,10 +231,13 @@ struct CSFSpace<S, FL, typename S::is_su2_t> {
         }
         csfs.resize(csf_sub_idxs.back());
         csfs[0] = 0;
+        // patterns with i unpaired electrons only depend on those with i - 1
+        // and different twos are written to disjoint ranges
         for (int i = 1, cl = 0, pcl; i <= n_max_unpaired; i++) {
             pcl = cl;
             cl += ((i & 7) == 1);
             const LL cidx = csf_idxs[i], pidx = csf_idxs[i - 1];
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
             for (int j = 0; j <= i; j++) {
                 LL shift = 0, xshift;
                 if (j > 0) {
@@ -217,25 +280,191 @@ struct CSFSpace<S, FL, typename S::is_su2_t> {
             }
         }
         csf_offsets.resize(qs_idxs.back() + 1, 0);
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
         for (int i = 0; i < basis->n; i++) {
             int ij = qs_idxs[i];
-            int n_elec = qs[i].n(), two_s = qs[i].twos();
+            int two_s = qs[i].twos();
             for (int j = two_s; j <= min(qs[i].n(), n_max_elec); j += 2, ij++) {
                 int cl = max((j >> 3) + !!(j & 7), 1);
                 csf_offsets[ij + 1] =
-                    csf_offsets[ij] +
                     (n_unpaired_idxs[ij + 1] - n_unpaired_idxs[ij]) *
-                        (csf_sub_idxs[csf_idxs[j] + two_s + 1] -
-                         csf_sub_idxs[csf_idxs[j] + two_s]) /
-                        cl;
+                    (csf_sub_idxs[csf_idxs[j] + two_s + 1] -
+                     csf_sub_idxs[csf_idxs[j] + two_s]) /
+                    cl;
             }
-            // cout << i << " " << qs[i] << " " << basis->n_states[i] << " "
-            //      << csf_offsets[qs_idxs[i + 1]] << " "
-            //      << csf_offsets[qs_idxs[i]] << endl;
+        }
+        for (int ij = 0; ij < qs_idxs.back(); ij++)
+            csf_offsets[ij + 1] += csf_offsets[ij];
+        for (int i = 0; i < basis->n; i++)
             assert(basis->n_states[i] ==
                    csf_offsets[qs_idxs[i + 1]] - csf_offsets[qs_idxs[i]]);
+        threading->activate_normal();
+    }
+    // cache file format, bumped when the layout below changes
+    static const uint32_t cache_version = 1;
+    static const char *cache_magic() { return "CSFS"; }
+    // number of bytes from the current position to the end of the stream
+    static LL remaining_bytes(istream &ifs) {
+        const streampos cur = ifs.tellg();
+        if (cur == streampos(-1))
+            return -1;
+        ifs.seekg(0, ios::end);
+        const streampos end = ifs.tellg();
+        ifs.seekg(cur);
+        return (LL)(end - cur);
+    }
+    template <typename T>
+    static void save_vector(ostream &ofs, const vector<T> &v) {
+        size_t n = v.size();
+        ofs.write((char *)&n, sizeof(n));
+        ofs.write((char *)v.data(), sizeof(T) * n);
+    }
+    // the stream fails if the size exceeds the data left in the stream
+    template <typename T> static void load_vector(istream &ifs, vector<T> &v) {
+        size_t n = 0;
+        ifs.read((char *)&n, sizeof(n));
+        const LL rem = ifs.fail() ? 0 : remaining_bytes(ifs);
+        if (ifs.fail() || (rem != -1 && n > (size_t)rem / sizeof(T))) {
+            ifs.setstate(ios::failbit);
+            return;
+        }
+        v.resize(n);
+        ifs.read((char *)v.data(), sizeof(T) * n);
+    }
+    // the stream fails if the basis size exceeds the data left in the stream
+    static shared_ptr<StateInfo<S>> load_basis(istream &ifs) {
+        const streampos cur = ifs.tellg();
+        const LL rem = remaining_bytes(ifs);
+        shared_ptr<StateInfo<S>> b = make_shared<StateInfo<S>>();
+        ifs.read((char *)&b->n_states_total, sizeof(b->n_states_total));
+        ifs.read((char *)&b->n, sizeof(b->n));
+        if (ifs.fail() || b->n < 0 ||
+            (rem != -1 && (LL)sizeof(uint32_t) * _SI_MEM_SIZE(b->n) > rem)) {
+            ifs.setstate(ios::failbit);
+            return nullptr;
         }
+        ifs.seekg(cur);
+        b->load_data(ifs);
+        return ifs.fail() ? nullptr : b;
+    }
+    // header of cache file is used to check the format and the orbital space
+    void save_data(ostream &ofs, const vector<uint8_t> &orb_sym) const {
+        const uint32_t version = cache_version;
+        ofs.write(cache_magic(), 4);
+        ofs.write((char *)&version, sizeof(version));
+        ofs.write((char *)&n_orbs, sizeof(n_orbs));
+        ofs.write((char *)&n_max_elec, sizeof(n_max_elec));
+        ofs.write((char *)&is_right, sizeof(is_right));
+        save_vector(ofs, orb_sym);
+        basis->save_data(ofs);
+        if (n_orbs == 0)
+            return;
+        ofs.write((char *)&n_max_unpaired, sizeof(n_max_unpaired));
+        save_vector(ofs, qs);
+        save_vector(ofs, qs_idxs);
+        save_vector(ofs, n_unpaired);
+        save_vector(ofs, n_unpaired_idxs);
+        save_vector(ofs, n_unpaired_shapes);
+        save_vector(ofs, csfs);
+        save_vector(ofs, csf_idxs);
+        save_vector(ofs, csf_sub_idxs);
+        save_vector(ofs, csf_offsets);
+    }
+    // return false if the cache has another format, does not match the
+    // orbital space, or has inconsistent table sizes
+    // this object is only changed when true is returned
+    bool load_data(istream &ifs, const vector<uint8_t> &orb_sym) {
+        char xmagic[4] = {0, 0, 0, 0};
+        uint32_t xversion = 0;
+        int xn_orbs = -1, xn_max_elec = -1;
+        bool xis_right = !is_right;
+        vector<uint8_t> xorb_sym;
+        ifs.read(xmagic, 4);
+        ifs.read((char *)&xversion, sizeof(xversion));
+        if (ifs.fail() || memcmp(xmagic, cache_magic(), 4) != 0 ||
+            xversion != cache_version)
+            return false;
+        ifs.read((char *)&xn_orbs, sizeof(xn_orbs));
+        ifs.read((char *)&xn_max_elec, sizeof(xn_max_elec));
+        ifs.read((char *)&xis_right, sizeof(xis_right));
+        if (ifs.fail() || xn_orbs != n_orbs || xn_max_elec != n_max_elec ||
+            xis_right != is_right)
+            return false;
+        load_vector(ifs, xorb_sym);
+        if (ifs.fail() || xorb_sym != orb_sym)
+            return false;
+        shared_ptr<StateInfo<S>> xbasis = load_basis(ifs);
+        if (xbasis == nullptr)
+            return false;
+        if (n_orbs == 0) {
+            basis = xbasis;
+            return true;
+        }
+        int xn_max_unpaired = -1;
+        vector<S> xqs;
+        vector<int> xqs_idxs, xn_unpaired;
+        vector<LL> xn_unpaired_idxs, xcsf_idxs, xcsf_sub_idxs, xcsf_offsets;
+        vector<pair<LL, LL>> xn_unpaired_shapes;
+        vector<uint8_t> xcsfs;
+        ifs.read((char *)&xn_max_unpaired, sizeof(xn_max_unpaired));
+        load_vector(ifs, xqs);
+        load_vector(ifs, xqs_idxs);
+        load_vector(ifs, xn_unpaired);
+        load_vector(ifs, xn_unpaired_idxs);
+        load_vector(ifs, xn_unpaired_shapes);
+        load_vector(ifs, xcsfs);
+        load_vector(ifs, xcsf_idxs);
+        load_vector(ifs, xcsf_sub_idxs);
+        load_vector(ifs, xcsf_offsets);
+        if (ifs.fail() || xn_max_unpaired < 0 || xn_max_unpaired > n_orbs)
+            return false;
+        const size_t nu = xn_unpaired.size();
+        if (xqs.size() != (size_t)xbasis->n ||
+            xqs_idxs.size() != xqs.size() + 1 || xqs_idxs[0] != 0 ||
+            xqs_idxs.back() != (int)nu || xn_unpaired_idxs.size() != nu + 1 ||
+            xn_unpaired_shapes.size() != nu || xcsf_offsets.size() != nu + 1 ||
+            xcsf_idxs.size() != (size_t)xn_max_unpaired + 2 ||
+            xcsf_sub_idxs.size() != (size_t)xcsf_idxs.back() + 1 ||
+            xcsfs.size() != (size_t)xcsf_sub_idxs.back())
+            return false;
+        for (int i = 0; i < xbasis->n; i++)
+            if (xqs[i] != xbasis->quanta[i] || xqs_idxs[i + 1] < xqs_idxs[i] ||
+                (LL)xbasis->n_states[i] != xcsf_offsets[xqs_idxs[i + 1]] -
+                                               xcsf_offsets[xqs_idxs[i]])
+                return false;
+        basis = xbasis;
+        n_max_unpaired = xn_max_unpaired;
+        qs = move(xqs), qs_idxs = move(xqs_idxs);
+        n_unpaired = move(xn_unpaired);
+        n_unpaired_idxs = move(xn_unpaired_idxs);
+        n_unpaired_shapes = move(xn_unpaired_shapes);
+        csfs = move(xcsfs), csf_idxs = move(xcsf_idxs);
+        csf_sub_idxs = move(xcsf_sub_idxs), csf_offsets = move(xcsf_offsets);
         cg = make_shared<CG<S>>((n_max_unpaired + 1) * 2);
+        return true;
+    }
+    void save_data(const string &filename,
+                   const vector<uint8_t> &orb_sym) const {
+        if (Parsing::link_exists(filename))
+            Parsing::remove_file(filename);
+        ofstream ofs(filename.c_str(), ios::binary);
+        if (!ofs.good())
+            throw runtime_error("CSFSpace::save_data on '" + filename +
+                                "' failed.");
+        save_data(ofs, orb_sym);
+        if (!ofs.good())
+            throw runtime_error("CSFSpace::save_data on '" + filename +
+                                "' failed.");
+        ofs.close();
+    }
+    bool load_data(const string &filename, const vector<uint8_t> &orb_sym) {
+        ifstream ifs(filename.c_str(), ios::binary);
+        if (!ifs.good())
+            throw runtime_error("CSFSpace::load_data on '" + filename +
+                                "' failed.");
+        bool r = load_data(ifs, orb_sym);
+        ifs.close();
+        return r;
     }
     LL n_configs() const { return n_unpaired_idxs.back(); }
     LL n_csfs() const { return csf_offsets.back(); }
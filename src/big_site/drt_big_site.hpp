@@ -22,6 +22,7 @@
 
 #include "../core/allocator.hpp"
 #include "../core/clebsch_gordan.hpp"
+#include "../core/iterative_matrix_functions.hpp"
 #include "../core/state_info.hpp"
 #include "../core/threading.hpp"
 #include "../dmrg/general_hamiltonian.hpp"
@@ -1079,6 +1080,24 @@ struct HDRTScheme {
     }
 };
 
+// Segment-value tables of an operator HDRT on the CSF DRT
+// hm[k][dbra][jh - kjis[k]] : allowed ((site op dq, ket step), (hdrt step,
+// site matrix element)) at site k for bra step dbra and HDRT row jh
+template <typename FL> struct DRTSegmentTable {
+    typedef pair<pair<int16_t, int16_t>, pair<int16_t, FL>> segment_t;
+    vector<vector<vector<vector<segment_t>>>> hm;
+    vector<vector<size_t>> max_d;
+    vector<int> kjis;
+};
+
+// Per-thread double buffers of partial (HDRT, ket) walks
+template <typename FL> struct DRTWalkBuffer {
+    typedef long long LL;
+    array<vector<int>, 2> jh, jket;
+    array<vector<LL>, 2> ph, pket;
+    array<vector<FL>, 2> hv;
+};
+
 template <typename S, typename FL> struct DRTBigSiteBase : BigSite<S, FL> {
     typedef integral_constant<ElemOpTypes, ElemT<S>::value> T;
     typedef typename GMatrix<FL>::FP FP;
@@ -1428,6 +1447,130 @@ template <typename S, typename FL> struct DRTBigSiteBase : BigSite<S, FL> {
         }
         threading->activate_normal();
     }
+    shared_ptr<DRTSegmentTable<FL>> build_segment_table(
+        const shared_ptr<HDRT<S>> &hdrt,
+        const vector<vector<ElemMat<S, FL>>> &site_matrices) const {
+        shared_ptr<DRTSegmentTable<FL>> seg =
+            make_shared<DRTSegmentTable<FL>>();
+        auto &hm = seg->hm;
+        auto &max_d = seg->max_d;
+        auto &kjis = seg->kjis;
+        hm.resize(drt->n_sites);
+        max_d.resize(drt->n_sites, vector<size_t>(4, 0));
+        kjis.resize(drt->n_sites);
+        for (int k = drt->n_sites - 1, ji = 0, jj; k >= 0; k--, ji = jj) {
+            for (jj = ji; hdrt->qs[jj][0] == k + 1;)
+                jj++;
+            kjis[k] = ji;
+            hm[k].resize(4);
+            for (int dbra = 0; dbra < 4; dbra++) {
+                hm[k][dbra].resize(jj - ji);
+                for (int jk = ji; jk < jj; jk++) {
+                    for (int d = 0; d < hdrt->nd; d++)
+                        if (hdrt->jds[jk * hdrt->nd + d] != 0)
+                            for (size_t md = 0;
+                                 md < site_matrices[k][d].data.size(); md++)
+                                if (site_matrices[k][d].indices[md].first ==
+                                    dbra)
+                                    hm[k][dbra][jk - ji].push_back(make_pair(
+                                        make_pair(site_matrices[k][d].dq,
+                                                  site_matrices[k][d]
+                                                      .indices[md]
+                                                      .second),
+                                        make_pair(
+                                            d, site_matrices[k][d].data[md])));
+                    max_d[k][dbra] =
+                        max(max_d[k][dbra], hm[k][dbra][jk - ji].size());
+                }
+            }
+        }
+        return seg;
+    }
+    // SU2 and fermion factor for exchange:
+    //   ket x op -> op x ket when is_right
+    FL exchange_factor(S opdq, S qbra, S qket) const {
+        if (T::value == ElemOpTypes::SU2 && is_right)
+            return (FL)(1 - ((opdq.twos() & qket.twos() & 1) << 1)) *
+                   (FL)ElemMat<S, FL>::cg().phase(opdq.twos(), qket.twos(),
+                                                  qbra.twos());
+        return (FL)1.0;
+    }
+    // Walk all (HDRT, ket) paths connected to the bra CSF ibra
+    // returns the buffer index holding the final ket indices (pket),
+    // integral indices (ph) and segment value products (hv)
+    int walk_operator(const shared_ptr<HDRT<S>> &hdrt,
+                      const DRTSegmentTable<FL> &seg, int imb, int imk, FL xf,
+                      LL ibra, DRTWalkBuffer<FL> &buf) const {
+        const auto &hm = seg.hm;
+        const auto &max_d = seg.max_d;
+        const auto &kjis = seg.kjis;
+        int pi = 0, pj = pi ^ 1, jbra = imb;
+        array<vector<int>, 2> &xjh = buf.jh, &xjk = buf.jket;
+        array<vector<LL>, 2> &xph = buf.ph, &xpk = buf.pket;
+        array<vector<FL>, 2> &xhv = buf.hv;
+        xjh[pi].clear(), xph[pi].clear(), xjk[pi].clear();
+        xpk[pi].clear(), xhv[pi].clear();
+        for (int i = 0; i < hdrt->n_init_qs; i++) {
+            xjh[pi].push_back(i), xjk[pi].push_back(imk);
+            xph[pi].push_back(
+                i != 0 ? xph[pi].back() +
+                             hdrt->xs[(i - 1) * (hdrt->nd + 1) + hdrt->nd]
+                       : 0);
+            xpk[pi].push_back(0), xhv[pi].push_back(xf);
+        }
+        LL pbra = ibra;
+        for (int k = drt->n_sites - 1; k >= 0; k--, pi ^= 1, pj ^= 1) {
+            const int16_t dbra =
+                (int16_t)(upper_bound(drt->xs[jbra].begin(),
+                                      drt->xs[jbra].end(), pbra) -
+                          1 - drt->xs[jbra].begin());
+            pbra -= drt->xs[jbra][dbra];
+            const int jbv = drt->jds[jbra][dbra];
+            const size_t hsz = xhv[pi].size() * max_d[k][dbra];
+            xjh[pj].reserve(hsz), xjh[pj].clear();
+            xph[pj].reserve(hsz), xph[pj].clear();
+            xjk[pj].reserve(hsz), xjk[pj].clear();
+            xpk[pj].reserve(hsz), xpk[pj].clear();
+            xhv[pj].reserve(hsz), xhv[pj].clear();
+            for (size_t j = 0; j < xjh[pi].size(); j++)
+                for (const auto &md : hm[k][dbra][xjh[pi][j] - kjis[k]]) {
+                    const int16_t d = md.second.first;
+                    const int jhv = hdrt->jds[xjh[pi][j] * hdrt->nd + d];
+                    const int16_t dket = md.first.second;
+                    const int jkv = drt->jds[xjk[pi][j]][dket];
+                    if (jkv == 0)
+                        continue;
+                    const int16_t bfq = drt->abc[jbra][1];
+                    const int16_t kfq = drt->abc[xjk[pi][j]][1];
+                    const int16_t biq = drt->abc[jbv][1];
+                    const int16_t kiq = drt->abc[jkv][1];
+                    const int16_t mdq = md.first.first;
+                    const int16_t mfq = hdrt->qs[xjh[pi][j]][2];
+                    const int16_t miq = hdrt->qs[jhv][2];
+                    const FL f =
+                        T::value == ElemOpTypes::SU2
+                            ? (*factors)[bfq * factor_strides[0] +
+                                         (biq - bfq + 1) * factor_strides[1] +
+                                         kfq * factor_strides[2] +
+                                         (kiq - kfq + 1) * factor_strides[3] +
+                                         mfq * factor_strides[4] +
+                                         miq * factor_strides[5] +
+                                         mdq * factor_strides[6]]
+                            : (FL)(1 - (((kiq & 1) & (mdq & 1)) << 1));
+                    if (abs(f) < (FP)1E-14)
+                        continue;
+                    xjk[pj].push_back(jkv);
+                    xjh[pj].push_back(jhv);
+                    xpk[pj].push_back(drt->xs[xjk[pi][j]][dket] + xpk[pi][j]);
+                    xph[pj].push_back(
+                        hdrt->xs[xjh[pi][j] * (hdrt->nd + 1) + d] +
+                        xph[pi][j]);
+                    xhv[pj].push_back(f * xhv[pi][j] * md.second.second);
+                }
+            jbra = jbv;
+        }
+        return pi;
+    }
     void build_operator_matrices(
         const shared_ptr<HDRT<S>> &hdrt,
         const vector<vector<ElemMat<S, FL>>> &site_matrices,
@@ -1436,12 +1579,11 @@ template <typename S, typename FL> struct DRTBigSiteBase : BigSite<S, FL> {
         if (mats.size() == 0)
             return;
         assert(ints.size() == mats.size());
+        // segment tables do not depend on the bra/ket quanta
+        shared_ptr<DRTSegmentTable<FL>> seg =
+            build_segment_table(hdrt, site_matrices);
         int ntg = threading->activate_global();
-        vector<vector<vector<int>>> jh(ntg, vector<vector<int>>(2));
-        vector<vector<vector<int>>> jket(ntg, vector<vector<int>>(2));
-        vector<vector<vector<LL>>> ph(ntg, vector<vector<LL>>(2));
-        vector<vector<vector<LL>>> pket(ntg, vector<vector<LL>>(2));
-        vector<vector<vector<FL>>> hv(ntg, vector<vector<FL>>(2));
+        vector<DRTWalkBuffer<FL>> bufs(ntg);
         map<S, vector<size_t>> dq_mats;
         for (size_t it = 0; it < mats.size(); it++)
             dq_mats[mats[it]->info->delta_quantum].push_back(it);
@@ -1451,57 +1593,10 @@ template <typename S, typename FL> struct DRTBigSiteBase : BigSite<S, FL> {
                 S opdq = rep_mat->info->delta_quantum;
                 S qbra = rep_mat->info->quanta[im].get_bra(opdq);
                 S qket = rep_mat->info->quanta[im].get_ket();
-                // SU2 and fermion factor for exchange:
-                //   ket x op -> op x ket when is_right
-                FL xf = (FL)1.0;
-                if (T::value == ElemOpTypes::SU2 && is_right)
-                    xf = (FL)(1 - ((opdq.twos() & qket.twos() & 1) << 1)) *
-                         (FL)ElemMat<S, FL>::cg().phase(
-                             opdq.twos(), qket.twos(), qbra.twos());
+                const FL xf = exchange_factor(opdq, qbra, qket);
                 int imb = drt->q_index(qbra), imk = drt->q_index(qket);
                 assert(rep_mat->info->n_states_bra[im] == drt->xs[imb].back());
                 assert(rep_mat->info->n_states_ket[im] == drt->xs[imk].back());
-                vector<vector<vector<
-                    vector<pair<pair<int16_t, int16_t>, pair<int16_t, FL>>>>>>
-                    hm(drt->n_sites,
-                       vector<vector<vector<
-                           pair<pair<int16_t, int16_t>, pair<int16_t, FL>>>>>(
-                           4));
-                vector<vector<size_t>> max_d(drt->n_sites,
-                                             vector<size_t>(4, 0));
-                vector<int> kjis(drt->n_sites);
-                for (int k = drt->n_sites - 1, ji = 0, jj; k >= 0;
-                     k--, ji = jj) {
-                    for (jj = ji; hdrt->qs[jj][0] == k + 1;)
-                        jj++;
-                    kjis[k] = ji;
-                    for (int dbra = 0; dbra < 4; dbra++) {
-                        hm[k][dbra].resize(jj - ji);
-                        for (int jk = ji; jk < jj; jk++) {
-                            for (int d = 0; d < hdrt->nd; d++)
-                                if (hdrt->jds[jk * hdrt->nd + d] != 0)
-                                    for (size_t md = 0;
-                                         md <
-                                         (int)site_matrices[k][d].data.size();
-                                         md++)
-                                        if (site_matrices[k][d]
-                                                .indices[md]
-                                                .first == dbra)
-                                            hm[k][dbra][jk - ji].push_back(
-                                                make_pair(
-                                                    make_pair(
-                                                        site_matrices[k][d].dq,
-                                                        site_matrices[k][d]
-                                                            .indices[md]
-                                                            .second),
-                                                    make_pair(
-                                                        d, site_matrices[k][d]
-                                                               .data[md])));
-                            max_d[k][dbra] = max(max_d[k][dbra],
-                                                 hm[k][dbra][jk - ji].size());
-                        }
-                    }
-                }
                 vector<vector<vector<MKL_INT>>> col_idxs(
                     dqm.second.size(),
                     vector<vector<MKL_INT>>(drt->xs[imb].back()));
@@ -1516,80 +1611,11 @@ template <typename S, typename FL> struct DRTBigSiteBase : BigSite<S, FL> {
 #endif
                 {
                     const int tid = threading->get_thread_id();
-                    int pi = 0, pj = pi ^ 1, jbra = imb;
-                    vector<vector<int>> &xjh = jh[tid], &xjk = jket[tid];
-                    vector<vector<LL>> &xph = ph[tid], &xpk = pket[tid];
-                    vector<vector<FL>> &xhv = hv[tid];
-                    xjh[pi].clear(), xph[pi].clear(), xjk[pi].clear();
-                    xpk[pi].clear(), xhv[pi].clear();
-                    for (int i = 0; i < hdrt->n_init_qs; i++) {
-                        xjh[pi].push_back(i), xjk[pi].push_back(imk);
-                        xph[pi].push_back(
-                            i != 0 ? xph[pi].back() +
-                                         hdrt->xs[(i - 1) * (hdrt->nd + 1) +
-                                                  hdrt->nd]
-                                   : 0);
-                        xpk[pi].push_back(0), xhv[pi].push_back(xf);
-                    }
-                    LL pbra = ibra;
-                    for (int k = drt->n_sites - 1; k >= 0;
-                         k--, pi ^= 1, pj ^= 1) {
-                        const int16_t dbra =
-                            (int16_t)(upper_bound(drt->xs[jbra].begin(),
-                                                  drt->xs[jbra].end(), pbra) -
-                                      1 - drt->xs[jbra].begin());
-                        pbra -= drt->xs[jbra][dbra];
-                        const int jbv = drt->jds[jbra][dbra];
-                        const size_t hsz = xhv[pi].size() * max_d[k][dbra];
-                        xjh[pj].reserve(hsz), xjh[pj].clear();
-                        xph[pj].reserve(hsz), xph[pj].clear();
-                        xjk[pj].reserve(hsz), xjk[pj].clear();
-                        xpk[pj].reserve(hsz), xpk[pj].clear();
-                        xhv[pj].reserve(hsz), xhv[pj].clear();
-                        for (size_t j = 0; j < xjh[pi].size(); j++)
-                            for (const auto &md :
-                                 hm[k][dbra][xjh[pi][j] - kjis[k]]) {
-                                const int16_t d = md.second.first;
-                                const int jhv =
-                                    hdrt->jds[xjh[pi][j] * hdrt->nd + d];
-                                const int16_t dket = md.first.second;
-                                const int jkv = drt->jds[xjk[pi][j]][dket];
-                                if (jkv == 0)
-                                    continue;
-                                const int16_t bfq = drt->abc[jbra][1];
-                                const int16_t kfq = drt->abc[xjk[pi][j]][1];
-                                const int16_t biq = drt->abc[jbv][1];
-                                const int16_t kiq = drt->abc[jkv][1];
-                                const int16_t mdq = md.first.first;
-                                const int16_t mfq = hdrt->qs[xjh[pi][j]][2];
-                                const int16_t miq = hdrt->qs[jhv][2];
-                                const FL f =
-                                    T::value == ElemOpTypes::SU2
-                                        ? (*factors)[bfq * factor_strides[0] +
-                                                     (biq - bfq + 1) *
-                                                         factor_strides[1] +
-                                                     kfq * factor_strides[2] +
-                                                     (kiq - kfq + 1) *
-                                                         factor_strides[3] +
-                                                     mfq * factor_strides[4] +
-                                                     miq * factor_strides[5] +
-                                                     mdq * factor_strides[6]]
-                                        : (FL)(1 -
-                                               (((kiq & 1) & (mdq & 1)) << 1));
-                                if (abs(f) < (FP)1E-14)
-                                    continue;
-                                xjk[pj].push_back(jkv);
-                                xjh[pj].push_back(jhv);
-                                xpk[pj].push_back(drt->xs[xjk[pi][j]][dket] +
-                                                  xpk[pi][j]);
-                                xph[pj].push_back(
-                                    hdrt->xs[xjh[pi][j] * (hdrt->nd + 1) + d] +
-                                    xph[pi][j]);
-                                xhv[pj].push_back(f * xhv[pi][j] *
-                                                  md.second.second);
-                            }
-                        jbra = jbv;
-                    }
+                    DRTWalkBuffer<FL> &buf = bufs[tid];
+                    const int pi =
+                        walk_operator(hdrt, *seg, imb, imk, xf, ibra, buf);
+                    array<vector<LL>, 2> &xph = buf.ph, &xpk = buf.pket;
+                    array<vector<FL>, 2> &xhv = buf.hv;
                     vector<LL> idxs;
                     idxs.reserve(xhv[pi].size());
                     for (LL i = 0; i < (LL)xhv[pi].size(); i++)
@@ -1633,6 +1659,68 @@ template <typename S, typename FL> struct DRTBigSiteBase : BigSite<S, FL> {
         }
         threading->activate_normal();
     }
+    // Direct (matrix-free) operator application on the (qbra, qket) block
+    //   bra += scale * op * ket
+    // threaded over bra CSFs, each thread owns its bra rows
+    void apply_operator(const shared_ptr<HDRT<S>> &hdrt,
+                        const DRTSegmentTable<FL> &seg, const vector<FL> &ints,
+                        S opdq, S qbra, S qket, const FL *ket, FL *bra,
+                        FL scale = (FL)1.0) const {
+        const FL xf = exchange_factor(opdq, qbra, qket) * scale;
+        const int imb = drt->q_index(qbra), imk = drt->q_index(qket);
+        const FL *pints = ints.data();
+        int ntg = threading->activate_global();
+        vector<DRTWalkBuffer<FL>> bufs(ntg);
+#ifdef _MSC_VER
+#pragma omp parallel for schedule(dynamic, 16) num_threads(ntg)
+        for (int ibra = 0; ibra < (int)drt->xs[imb].back(); ibra++)
+#else
+#pragma omp parallel for schedule(dynamic, 16) num_threads(ntg)
+        for (LL ibra = 0; ibra < drt->xs[imb].back(); ibra++)
+#endif
+        {
+            DRTWalkBuffer<FL> &buf = bufs[threading->get_thread_id()];
+            const int pi = walk_operator(hdrt, seg, imb, imk, xf, ibra, buf);
+            const LL *xph = buf.ph[pi].data(), *xpk = buf.pket[pi].data();
+            const FL *xhv = buf.hv[pi].data();
+            const size_t nw = buf.hv[pi].size();
+            FL r = 0;
+#pragma omp simd reduction(+ : r)
+            for (size_t j = 0; j < nw; j++)
+                r += xhv[j] * pints[xph[j]] * ket[xpk[j]];
+            bra[ibra] += r;
+        }
+        threading->activate_normal();
+    }
+    // Diagonal elements of a (delta quantum zero) operator in the q block
+    void operator_diagonal(const shared_ptr<HDRT<S>> &hdrt,
+                           const DRTSegmentTable<FL> &seg,
+                           const vector<FL> &ints, S q, FL *diag) const {
+        const int imq = drt->q_index(q);
+        const FL *pints = ints.data();
+        int ntg = threading->activate_global();
+        vector<DRTWalkBuffer<FL>> bufs(ntg);
+#ifdef _MSC_VER
+#pragma omp parallel for schedule(dynamic, 16) num_threads(ntg)
+        for (int ibra = 0; ibra < (int)drt->xs[imq].back(); ibra++)
+#else
+#pragma omp parallel for schedule(dynamic, 16) num_threads(ntg)
+        for (LL ibra = 0; ibra < drt->xs[imq].back(); ibra++)
+#endif
+        {
+            DRTWalkBuffer<FL> &buf = bufs[threading->get_thread_id()];
+            const int pi = walk_operator(hdrt, seg, imq, imq, (FL)1.0, ibra,
+                                         buf);
+            const LL *xph = buf.ph[pi].data(), *xpk = buf.pket[pi].data();
+            const FL *xhv = buf.hv[pi].data();
+            FL r = 0;
+            for (size_t j = 0; j < buf.hv[pi].size(); j++)
+                if (xpk[j] == ibra)
+                    r += xhv[j] * pints[xph[j]];
+            diag[ibra] = r;
+        }
+        threading->activate_normal();
+    }
     vector<shared_ptr<GTensor<FL>>>
     build_npdm(const string &expr, const FL *bra_ci, const FL *ket_ci) const {
         int16_t op_twos = HDRT<S, T::value>::get_target_twos(expr);
@@ -1769,6 +1857,14 @@ template <typename S, typename FL> struct DRTBigSiteBase : BigSite<S, FL> {
         OpNames op_name, int8_t iq, const set<S> &iqs,
         const vector<uint16_t> &idxs,
         const vector<shared_ptr<CSRSparseMatrix<S, FL>>> &mats) const {}
+    // HDRT and sorted integrals of a complementary operator
+    // (only required by the direct operator application)
+    virtual shared_ptr<HDRT<S>>
+    build_operator_hdrt(OpNames op_name, int8_t iq, const set<S> &iqs,
+                        const vector<uint16_t> &idxs,
+                        vector<shared_ptr<vector<FL>>> &ints) const {
+        throw runtime_error("Not implemented!");
+    }
     virtual void build_complementary_site_ops(
         OpNames op_name, int8_t iq, const set<S> &iqs,
         const vector<uint16_t> &idxs,
@@ -2196,6 +2292,15 @@ struct DRTBigSite<S, FL, typename S::is_su2_t> : DRTBigSiteBase<S, FL> {
         const vector<shared_ptr<CSRSparseMatrix<S, FL>>> &mats) const override {
         if (mats.size() == 0)
             return;
+        vector<shared_ptr<vector<FL>>> ints;
+        shared_ptr<HDRT<S>> hdrt =
+            build_operator_hdrt(op_name, iq, iqs, idxs, ints);
+        build_operator_matrices(hdrt, get_site_matrices(hdrt), ints, mats);
+    }
+    shared_ptr<HDRT<S>>
+    build_operator_hdrt(OpNames op_name, int8_t iq, const set<S> &iqs,
+                        const vector<uint16_t> &idxs,
+                        vector<shared_ptr<vector<FL>>> &ints) const override {
         const map<OpNames, vector<int16_t>> op_map =
             map<OpNames, vector<int16_t>>{{OpNames::H, vector<int16_t>{2, 4}},
                                           {OpNames::R, vector<int16_t>{1, 3}},
@@ -2406,10 +2511,10 @@ struct DRTBigSite<S, FL, typename S::is_su2_t> : DRTBigSiteBase<S, FL> {
         print_hdrt_infos(iqs, std_exprs, hdrt);
         shared_ptr<HDRTScheme<S, FL>> hdrt_scheme =
             make_shared<HDRTScheme<S, FL>>(hdrt, schemes);
-        vector<shared_ptr<vector<FL>>> ints(gfds.size());
+        ints.resize(gfds.size());
         for (size_t i = 0; i < gfds.size(); i++)
             ints[i] = hdrt_scheme->sort_integral(gfds[i]);
-        build_operator_matrices(hdrt, get_site_matrices(hdrt), ints, mats);
+        return hdrt;
     }
 };
 
@@ -2644,6 +2749,15 @@ struct DRTBigSite<S, FL, typename S::is_sz_t> : DRTBigSiteBase<S, FL> {
         const vector<shared_ptr<CSRSparseMatrix<S, FL>>> &mats) const override {
         if (mats.size() == 0)
             return;
+        vector<shared_ptr<vector<FL>>> ints;
+        shared_ptr<HDRT<S>> hdrt =
+            build_operator_hdrt(op_name, iq, iqs, idxs, ints);
+        build_operator_matrices(hdrt, get_site_matrices(hdrt), ints, mats);
+    }
+    shared_ptr<HDRT<S>>
+    build_operator_hdrt(OpNames op_name, int8_t iq, const set<S> &iqs,
+                        const vector<uint16_t> &idxs,
+                        vector<shared_ptr<vector<FL>>> &ints) const override {
         const map<OpNames, vector<int16_t>> op_map =
             map<OpNames, vector<int16_t>>{{OpNames::H, vector<int16_t>{2, 4}},
                                           {OpNames::R, vector<int16_t>{1, 3}},
@@ -2897,10 +3011,87 @@ struct DRTBigSite<S, FL, typename S::is_sz_t> : DRTBigSiteBase<S, FL> {
         print_hdrt_infos(iqs, std_exprs, hdrt);
         shared_ptr<HDRTScheme<S, FL>> hdrt_scheme =
             make_shared<HDRTScheme<S, FL>>(hdrt, schemes);
-        vector<shared_ptr<vector<FL>>> ints(gfds.size());
+        ints.resize(gfds.size());
         for (size_t i = 0; i < gfds.size(); i++)
             ints[i] = hdrt_scheme->sort_integral(gfds[i]);
-        build_operator_matrices(hdrt, get_site_matrices(hdrt), ints, mats);
+        return hdrt;
+    }
+};
+
+// Stand-alone direct CAS-CI on the DRT using the matrix-free GUGA sigma
+// (no explicit Hamiltonian matrix), for checking DMRG energies
+template <typename S, typename FL> struct DRTDirectCI {
+    typedef typename GMatrix<FL>::FP FP;
+    typedef long long LL;
+    shared_ptr<DRTBigSite<S, FL>> site;
+    shared_ptr<HDRT<S>> hdrt;
+    shared_ptr<DRTSegmentTable<FL>> seg;
+    shared_ptr<vector<FL>> ints;
+    S target;
+    int iprint;
+    DRTDirectCI(const shared_ptr<FCIDUMP<FL>> &fcidump, S target,
+                const vector<typename S::pg_t> &orb_sym, int iprint = 0)
+        : target(target), iprint(iprint) {
+        site = make_shared<DRTBigSite<S, FL>>(vector<S>{target}, false,
+                                              fcidump->n_sites(), orb_sym,
+                                              fcidump, iprint);
+        vector<shared_ptr<vector<FL>>> xints;
+        hdrt = site->build_operator_hdrt(OpNames::H, 0, set<S>{S(0, 0, 0)},
+                                         vector<uint16_t>(), xints);
+        assert(xints.size() == 1);
+        ints = xints[0];
+        seg = site->build_segment_table(hdrt, site->get_site_matrices(hdrt));
+    }
+    virtual ~DRTDirectCI() = default;
+    LL size() const { return site->drt->size(); }
+    // s += H c (without the constant energy)
+    void sigma(const FL *c, FL *s) const {
+        site->apply_operator(hdrt, *seg, *ints, S(0, 0, 0), target, target, c,
+                             s);
+    }
+    vector<FL> diagonal() const {
+        vector<FL> diag(size());
+        site->operator_diagonal(hdrt, *seg, *ints, target, diag.data());
+        return diag;
+    }
+    // lowest nroots total energies; cis are the CSF coefficients
+    vector<FP> solve(int nroots, vector<vector<FL>> &cis,
+                     FP conv_thrd = (FP)1E-10, int max_iter = 5000) const {
+        const LL n = size();
+        if ((LL)(MKL_INT)n != n)
+            throw runtime_error(
+                "CSF space size exceeds MKL_INT. Rebuild with -DUSE_MKL64=ON.");
+        nroots = (int)min((LL)nroots, n);
+        vector<FL> diag = diagonal();
+        GDiagonalMatrix<FL> aa(diag.data(), (MKL_INT)n);
+        vector<LL> idx(n);
+        for (LL i = 0; i < n; i++)
+            idx[i] = i;
+        partial_sort(idx.begin(), idx.begin() + nroots, idx.end(),
+                     [&diag](LL i, LL j) {
+                         return xreal<FL>(diag[i]) < xreal<FL>(diag[j]);
+                     });
+        cis.assign(nroots, vector<FL>(n, (FL)0.0));
+        vector<GMatrix<FL>> vs;
+        for (int ir = 0; ir < nroots; ir++) {
+            cis[ir][idx[ir]] = (FL)1.0;
+            vs.push_back(GMatrix<FL>(cis[ir].data(), (MKL_INT)n, 1));
+        }
+        const auto op = [this](const GMatrix<FL> &b, const GMatrix<FL> &c) {
+            sigma(b.data, c.data);
+        };
+        int ndav = 0;
+        vector<FP> eners = IterativeMatrixFunctions<FL>::davidson(
+            op, aa, vs, (FP)0.0, DavidsonTypes::Normal, ndav, iprint >= 2,
+            (shared_ptr<ParallelCommunicator<S>>)nullptr, conv_thrd, (FP)0.0,
+            max_iter);
+        for (auto &e : eners)
+            e += xreal<FL>((FL)site->fcidump->const_e);
+        if (iprint >= 1)
+            cout << "DRT Direct CI :: NCSF = " << n << " NDAV = " << ndav
+                 << " E[0] = " << fixed << setprecision(12) << eners[0]
+                 << endl;
+        return eners;
     }
 };
 
@@ -602,6 +602,7 @@ struct SCIFockBigSite<S, FL, typename S::is_sz_t> : public BigSite<S, FL> {
             assert(det.nAlphaEl >= 0 && det.EffDetLen > 0);
             fragIndexMap.insert({det, i});
         }
+        SCIFockDeterminant::packWords(fSpace, fragSpaceWords);
         if (nOrbThis > std::numeric_limits<uint16_t>::max()) {
             throw std::runtime_error("nOrbThis too big for intT");
         }
@@ -771,6 +772,8 @@ struct SCIFockBigSite<S, FL, typename S::is_sz_t> : public BigSite<S, FL> {
         fragSpace; //!< Dummy fragment space. CAS stuff is first
                    //!< fragment; CI is second fragment
     std::unordered_map<SCIFockDeterminant, size_t> fragIndexMap;
+    std::vector<long long>
+        fragSpaceWords; //!< fragSpace bit strings in word-major order
 
     // Routines for filling the physical operator matrices
     /** Fill Identity */
@@ -874,6 +877,8 @@ struct SCIFockBigSite<S, FL, typename S::is_sz_t> : public BigSite<S, FL> {
         const auto qnPairs = getQNpairsH(mat, {0, 0, 0});
         const auto qnSiz = qnPairs.size();
         sci_detail::DenseMat<TripletVec> allOpCoeffs(ompThreads, 1);
+        std::vector<std::vector<int>> ketIdxs(ompThreads);
+        std::vector<std::vector<uint16_t>> ketDists(ompThreads);
         size_t nonZeros = 0;
         sci_detail::COOSparseMat<FL> smat;
         for (int itQN = 0; itQN < qnSiz; ++itQN) {
@@ -891,13 +896,20 @@ struct SCIFockBigSite<S, FL, typename S::is_sz_t> : public BigSite<S, FL> {
                 offsets[braQN].second; // openMP cant handle auto [...] -.-
             const auto sizBra = o2Bra - o1Bra;
 #ifdef _SCI_USE_OMP_ON
-#pragma omp parallel for collapse(2) default(shared) schedule(dynamic)
+#pragma omp parallel for default(shared) schedule(dynamic)
 #endif
             for (int ii = 0; ii < sizBra; ++ii) {
-                for (int jj = 0; jj < sizKet; ++jj) {
-                    const auto iThread = getThreadID();
-                    const auto iD = o1Bra + ii;
-                    const auto &bra = fragSpace[iD];
+                const auto iThread = getThreadID();
+                const auto iD = o1Bra + ii;
+                const auto &bra = fragSpace[iD];
+                // only jD <= iD and at most double excitations
+                const int nKet =
+                    iD < o1Ket
+                        ? 0
+                        : (int)std::min((size_t)sizKet, iD - o1Ket + 1);
+                screenKets(bra, o1Ket, nKet, 4, ketDists[iThread],
+                           ketIdxs[iThread]);
+                for (const int jj : ketIdxs[iThread]) {
                     const auto jD = o1Ket + jj;
                     if (iD == jD) { // Diagonal
                         allOpCoeffs(iThread, 0)
@@ -1052,6 +1064,8 @@ struct SCIFockBigSite<S, FL, typename S::is_sz_t> : public BigSite<S, FL> {
         const auto qnPairs = getQNpairsQ(
             refMat, deltaQN); // all entries should generate the same pairs!
         sci_detail::DenseMat<TripletVec> allOpCoeffs(ompThreads, entrySize);
+        std::vector<std::vector<int>> ketIdxs(ompThreads);
+        std::vector<std::vector<uint16_t>> ketDists(ompThreads);
         const auto qnSiz = qnPairs.size();
         std::vector<size_t> nonZeros(entrySize, 0);
         sci_detail::COOSparseMat<FL> smat;
@@ -1072,13 +1086,16 @@ struct SCIFockBigSite<S, FL, typename S::is_sz_t> : public BigSite<S, FL> {
             // TODO: How does this perform for small sizes? Some qnblocks have
             // just 1 state (sizBra=sizKet=1)
 #ifdef _SCI_USE_OMP_ON
-#pragma omp parallel for collapse(2) default(shared) schedule(dynamic)
+#pragma omp parallel for default(shared) schedule(dynamic)
 #endif
             for (int ii = 0; ii < sizBra; ++ii) {
-                for (int jj = 0; jj < sizKet; ++jj) {
-                    const auto iThread = getThreadID();
-                    const auto iD = o1Bra + ii;
-                    const auto &bra = fragSpace[iD];
+                const auto iThread = getThreadID();
+                const auto iD = o1Bra + ii;
+                const auto &bra = fragSpace[iD];
+                // at most single excitations
+                screenKets(bra, o1Ket, sizKet, 2, ketDists[iThread],
+                           ketIdxs[iThread]);
+                for (const int jj : ketIdxs[iThread]) {
                     const auto jD = o1Ket + jj;
                     if (iD == jD) { // Diagonal
                         auto closed = bra.getClosed();
@@ -1672,6 +1689,22 @@ struct SCIFockBigSite<S, FL, typename S::is_sz_t> : public BigSite<S, FL> {
                           : getQNpairs(mat, deltaQN);
     };
 
+    /** Indices jj in [0, nKet) of the determinants fragSpace[o1Ket + jj]
+     * that differ from bra in at most maxDiff spin orbitals. */
+    void screenKets(const SCIFockDeterminant &bra, std::size_t o1Ket,
+                    int nKet, int maxDiff, std::vector<uint16_t> &dist,
+                    std::vector<int> &ketIdx) const {
+        ketIdx.clear();
+        if (nKet <= 0)
+            return;
+        dist.resize(nKet);
+        sci_detail::bitDistances(bra.repr.data(), bra.EffDetLen,
+                                 fragSpaceWords.data() + o1Ket, nDet, nKet,
+                                 dist.data());
+        for (int jj = 0; jj < nKet; ++jj)
+            if (dist[jj] <= maxDiff)
+                ketIdx.push_back(jj);
+    }
     int getThreadID() const {
 #ifdef _OPENMP
         return omp_get_thread_num();
@@ -2226,6 +2259,8 @@ struct SCIFockBigSite<S, FL, typename S::is_sz_t> : public BigSite<S, FL> {
         auto &refMat = entries.at(0).mat;
         const int entrySize = (int)entries.size();
         sci_detail::DenseMat<TripletVec> allOpCoeffs(ompThreads, entrySize);
+        std::vector<std::vector<int>> ketIdxs(ompThreads);
+        std::vector<std::vector<uint16_t>> ketDists(ompThreads);
         const auto qnPairs = getQNpairsP(
             refMat, deltaQN); // all entries should generate the same pairs!
         const auto qnSiz = qnPairs.size();
@@ -2246,13 +2281,16 @@ struct SCIFockBigSite<S, FL, typename S::is_sz_t> : public BigSite<S, FL> {
                 offsets[braQN].second; // openMP cant handle auto [...] -.-
             const auto sizBra = o2Bra - o1Bra;
 #ifdef _SCI_USE_OMP_ON
-#pragma omp parallel for collapse(2) default(shared) schedule(dynamic)
+#pragma omp parallel for default(shared) schedule(dynamic)
 #endif
             for (int ii = 0; ii < sizBra; ++ii) {
-                for (int jj = 0; jj < sizKet; ++jj) {
-                    const auto iThread = getThreadID();
-                    const auto iD = o1Bra + ii;
-                    const auto &bra = fragSpace[iD];
+                const auto iThread = getThreadID();
+                const auto iD = o1Bra + ii;
+                const auto &bra = fragSpace[iD];
+                // ket and bra differ by exactly two orbitals
+                screenKets(bra, o1Ket, sizKet, 2, ketDists[iThread],
+                           ketIdxs[iThread]);
+                for (const int jj : ketIdxs[iThread]) {
                     const auto jD = o1Ket + jj;
                     const auto &ket = fragSpace[jD];
                     assert(Dagger ? bra.nEl() == ket.nEl() + 2
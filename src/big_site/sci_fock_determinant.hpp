@@ -41,6 +41,12 @@
 #include "sci_fcidump.hpp"
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
+#if (defined(__GNUC__) || defined(__clang__)) &&                              \
+    (defined(__x86_64__) || defined(__i386__))
+#define _SCI_X86_SIMD
+#include <immintrin.h>
+#endif
 
 namespace block2 {
 
@@ -56,10 +62,14 @@ static_assert(fragmentDetLen % 2 == 0 && fragmentDetLen > 0,
               "fragmentDetLen must be even!");
 
 inline int BitCount(long long x) {
+#ifdef __GNUC__
+    return __builtin_popcountll((unsigned long long)x);
+#else
     x = (x & 0x5555555555555555ULL) + ((x >> 1) & 0x5555555555555555ULL);
     x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
     x = (x & 0x0F0F0F0F0F0F0F0FULL) + ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL);
     return (x * 0x0101010101010101ULL) >> 56;
+#endif
 
     // unsigned int u2=u>>32, u1=u;
 
@@ -90,6 +100,106 @@ inline int ffsl(long long x) {
 #endif
 }
 
+/** Instruction sets for bitDistances. */
+enum struct SIMDLevel : uint8_t { Scalar = 0, AVX2 = 1, AVX512 = 2 };
+
+/** Best instruction set for bitDistances supported by the running CPU. */
+inline SIMDLevel supportedSIMDLevel() {
+#ifdef _SCI_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512vpopcntdq"))
+        return SIMDLevel::AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return SIMDLevel::AVX2;
+#endif
+    return SIMDLevel::Scalar;
+}
+
+/** Instruction set used by bitDistances. Detected once at runtime, and can
+ * be lowered (but not raised above supportedSIMDLevel()). */
+inline SIMDLevel &bitDistancesLevel() {
+    static SIMDLevel level = supportedSIMDLevel();
+    return level;
+}
+
+inline void bitDistancesScalar(const long long *bra, int nWords,
+                               const long long *kets, size_t stride, int k,
+                               int nKets, uint16_t *dist) {
+    for (; k < nKets; k++) {
+        int d = 0;
+        for (int w = 0; w < nWords; w++)
+            d += BitCount(bra[w] ^ kets[w * stride + k]);
+        dist[k] = (uint16_t)d;
+    }
+}
+
+#ifdef _SCI_X86_SIMD
+// popcount by nibble lookup and horizontal byte sums
+__attribute__((target("avx2"))) inline int
+bitDistancesAVX2(const long long *bra, int nWords, const long long *kets,
+                 size_t stride, int nKets, uint16_t *dist) {
+    const __m256i lut =
+        _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1,
+                         1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f), zero = _mm256_setzero_si256();
+    int k = 0;
+    for (; k + 4 <= nKets; k += 4) {
+        __m256i acc = zero;
+        for (int w = 0; w < nWords; w++) {
+            const __m256i x = _mm256_xor_si256(
+                _mm256_set1_epi64x(bra[w]),
+                _mm256_loadu_si256((const __m256i *)(kets + w * stride + k)));
+            const __m256i cnt = _mm256_add_epi8(
+                _mm256_shuffle_epi8(lut, _mm256_and_si256(x, low)),
+                _mm256_shuffle_epi8(
+                    lut, _mm256_and_si256(_mm256_srli_epi16(x, 4), low)));
+            acc = _mm256_add_epi64(acc, _mm256_sad_epu8(cnt, zero));
+        }
+        long long r[4];
+        _mm256_storeu_si256((__m256i *)r, acc);
+        for (int i = 0; i < 4; i++)
+            dist[k + i] = (uint16_t)r[i];
+    }
+    return k;
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq"))) inline int
+bitDistancesAVX512(const long long *bra, int nWords, const long long *kets,
+                   size_t stride, int nKets, uint16_t *dist) {
+    int k = 0;
+    for (; k + 8 <= nKets; k += 8) {
+        __m512i acc = _mm512_setzero_si512();
+        for (int w = 0; w < nWords; w++) {
+            const __m512i x = _mm512_xor_si512(
+                _mm512_set1_epi64(bra[w]),
+                _mm512_loadu_si512((const void *)(kets + w * stride + k)));
+            acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(x));
+        }
+        _mm_storeu_si128((__m128i *)(dist + k), _mm512_cvtepi64_epi16(acc));
+    }
+    return k;
+}
+#endif
+
+/** Number of differing bits between the bit string bra and each of the nKets
+ * bit strings in kets, which are stored word-major: word w of string k is
+ * kets[w * stride + k]. Uses AVX-512 (VPOPCNTDQ) or AVX2 when the CPU
+ * supports them (see bitDistancesLevel), otherwise a scalar popcount. */
+inline void bitDistances(const long long *bra, int nWords,
+                         const long long *kets, size_t stride, int nKets,
+                         uint16_t *dist) {
+    int k = 0;
+#ifdef _SCI_X86_SIMD
+    const SIMDLevel level = bitDistancesLevel();
+    if (level == SIMDLevel::AVX512)
+        k = bitDistancesAVX512(bra, nWords, kets, stride, nKets, dist);
+    else if (level == SIMDLevel::AVX2)
+        k = bitDistancesAVX2(bra, nWords, kets, stride, nKets, dist);
+#endif
+    bitDistancesScalar(bra, nWords, kets, stride, k, nKets, dist);
+}
+
 } // namespace sci_detail
 
 /** Essentially a slightly modified and slimmed version of Determinant to
@@ -350,18 +460,32 @@ struct SCIFockDeterminant {
         // TODO Short instead of int should be enough
         const auto nelec = nEl();
         std::vector<int> closed(nelec);
+        const int cindex = fillClosed(closed.data());
+        assert(cindex == nelec);
+        return closed;
+    }
+    /** Writes the occupied orbitals (in increasing order) to closed, which
+     * must hold at least Noccupied() entries. Returns the number written. */
+    int fillClosed(int *closed) const {
         int cindex = 0;
-        for (int i = 0; i < norbs; ++i) {
-            if (getocc(i)) {
-                assert(cindex < closed.size());
-                closed[cindex++] = i;
-                if (cindex >= nelec) {
-                    break;
-                }
+        for (int I = 0; I < EffDetLen; I++) {
+            unsigned long long reprBit = repr[I];
+            while (reprBit != 0) {
+                closed[cindex++] = I * 64 + sci_detail::ffsl(reprBit) - 1;
+                reprBit &= reprBit - 1;
             }
         }
-        assert(cindex == nelec);
-        return closed;
+        return cindex;
+    }
+    /** Appends the bit strings of dets to words in word-major order (word w
+     * of dets[k] is words[w * dets.size() + k]), for bitDistances. */
+    static void packWords(const std::vector<SCIFockDeterminant> &dets,
+                          std::vector<long long> &words) {
+        const int nWords = dets.size() == 0 ? 0 : dets[0].EffDetLen;
+        words.resize(nWords * dets.size());
+        for (int w = 0; w < nWords; w++)
+            for (size_t k = 0; k < dets.size(); k++)
+                words[w * dets.size() + k] = dets[k].repr[w];
     }
     double Energy(const SCIFCIDUMPOneInt &I1, const SCIFCIDUMPTwoInt &I2,
                   const std::vector<int> &closed) const {
@@ -438,7 +438,8 @@ struct DMRGBigSiteAQCC : DMRGBigSite<S, FL, FLS> {
 
     tuple<FPLS, int, size_t, double> two_dot_eigs_and_perturb(
         const bool forward, const int i, const FPS davidson_conv_thrd,
-        const FPS noise, shared_ptr<SparseMatrixGroup<S, FLS>> &pket) override {
+        const FPS noise, shared_ptr<SparseMatrixGroup<S, FLS>> &pket,
+        shared_ptr<SparseMatrix<S, FLS>> &pdm) override {
         tuple<FPLS, int, size_t, double> pdi;
         _t.get_time();
         shared_ptr<EffectiveHamiltonian<S, FL>> d_eff1, d_eff2, d_eff3, d_eff4;
@@ -28,12 +28,14 @@
 #include "dmrg/general_hamiltonian.hpp"
 #include "dmrg/general_mpo.hpp"
 #include "dmrg/general_npdm.hpp"
+#include "dmrg/memory_planner.hpp"
 #include "dmrg/moving_environment.hpp"
 #include "dmrg/mpo.hpp"
 #include "dmrg/mpo_fusing.hpp"
 #include "dmrg/mpo_simplification.hpp"
 #include "dmrg/mps.hpp"
 #include "dmrg/mps_unfused.hpp"
+#include "dmrg/npdm_shard.hpp"
 #include "dmrg/orbital_ordering.hpp"
 #include "dmrg/parallel_mpo.hpp"
 #include "dmrg/parallel_mps.hpp"
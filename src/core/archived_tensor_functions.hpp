@@ -176,7 +176,8 @@ struct ArchivedTensorFunctions : TensorFunctions<S, FL> {
      * @param vdqs Vector of quantum number of each vmat (for lookup).
      * @param vmats Vector of output "vectors" (perurbed wavefunctions).
      * @param vidx If -1, there is only one perurbed wavefunction for each
-     * target quantum number (used in NoiseTypes::ReducedPerturbative).
+     * target quantum number (used in NoiseTypes::ReducedPerturbative), and
+     * target quantum numbers not in vdqs are skipped.
      * Otherwise, one vmat is created for each tensor product (used in
      * NoiseTypes::Perturbative), and vidx is used as an incremental index in
      * vmats.
@@ -236,6 +237,9 @@ struct ArchivedTensorFunctions : TensorFunctions<S, FL> {
                     S vdq = pks[k];
                     int iv = (int)(lower_bound(vdqs.begin(), vdqs.end(), vdq) -
                                    vdqs.begin());
+                    if (vidx == -1 &&
+                        (iv == (int)vdqs.size() || vdqs[iv] != vdq))
+                        continue;
                     shared_ptr<SparseMatrix<S, FL>> vmat =
                         vidx == -1 ? (*vmats)[iv] : (*vmats)[vidx++];
                     cmat->info->cinfo = cinfos[ij][k];
@@ -267,6 +271,9 @@ struct ArchivedTensorFunctions : TensorFunctions<S, FL> {
                     S vdq = pks[k];
                     int iv = (int)(lower_bound(vdqs.begin(), vdqs.end(), vdq) -
                                    vdqs.begin());
+                    if (vidx == -1 &&
+                        (iv == (int)vdqs.size() || vdqs[iv] != vdq))
+                        continue;
                     shared_ptr<SparseMatrix<S, FL>> vmat =
                         vidx == -1 ? (*vmats)[iv] : (*vmats)[vidx++];
                     cmat->info->cinfo = cinfos[ij][k];
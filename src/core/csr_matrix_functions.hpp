@@ -616,22 +616,207 @@ template <typename FL> struct GCSRMatrixFunctions {
         for (MKL_INT it = conja + conjb - 1; it >= 0; it--)
             tmps[it].deallocate();
     }
+    // Fraction of nonzeros of a CSR operand above which it is converted to
+    // the dense form and multiplied by GEMM. Negative value means that
+    // the crossover is measured once at first use (opt-in)
+    // With MKL the default is 1 (only fully dense operands use GEMM),
+    // so that MKL sparse routines are used as before
+    static FP &dense_crossover_density() {
+#ifdef _HAS_INTEL_MKL
+        static FP density = 1.0;
+#else
+        static FP density = 0.15;
+#endif
+        return density;
+    }
+    static FP get_dense_crossover_density() {
+        if (dense_crossover_density() >= 0)
+            return min(dense_crossover_density(), (FP)1.0);
+        static const FP measured = measure_dense_crossover_density();
+        return measured;
+    }
+    // Find the lowest density at which GEMM on the dense form is faster
+    // than the sparse kernel, for a (m x k) CSR times (k x n) dense product
+    static FP measure_dense_crossover_density(MKL_INT m = 160, MKL_INT k = 160,
+                                              MKL_INT n = 160,
+                                              int n_repeat = 5) {
+        shared_ptr<VectorAllocator<FP>> d_alloc =
+            make_shared<VectorAllocator<FP>>();
+        const FP densities[] = {0.02, 0.05, 0.1, 0.15, 0.2,
+                                0.3,  0.4,  0.5, 0.7};
+        GMatrix<FL> ad(nullptr, m, k), bd(nullptr, k, n), cd(nullptr, m, n);
+        GMatrix<FL> td(nullptr, m, k);
+        ad.allocate(d_alloc), bd.allocate(d_alloc), cd.allocate(d_alloc);
+        td.allocate(d_alloc);
+        for (MKL_INT i = 0; i < bd.size(); i++)
+            bd.data[i] = (FP)1.0 / (FP)(1 + i % 97);
+        FP r = 1.0;
+        Timer t;
+        for (FP density : densities) {
+            // deterministic pattern, so that the global random state is kept
+            ad.clear();
+            for (MKL_INT i = 0; i < m; i++)
+                for (MKL_INT j = 0; j < k; j++)
+                    if ((i * 37 + j * 101) % 997 < (MKL_INT)(density * 997))
+                        ad(i, j) = (FP)1.0 / (FP)(1 + i + j);
+            GCSRMatrix<FL> as;
+            as.from_dense(ad);
+            double tsp = 0, tde = 0;
+            for (int it = 0; it < n_repeat; it++) {
+                t.get_time();
+                sparse_multiply(as, 0, bd, 0, cd, 1.0, 0.0);
+                tsp += t.get_time();
+                as.to_dense(td);
+                GMatrixFunctions<FL>::multiply(td, 0, bd, 0, cd, 1.0, 0.0);
+                tde += t.get_time();
+            }
+            as.deallocate();
+            if (tde < tsp) {
+                r = density;
+                break;
+            }
+        }
+        td.deallocate(d_alloc);
+        cd.deallocate(d_alloc), bd.deallocate(d_alloc), ad.deallocate(d_alloc);
+        return r;
+    }
+    // c = cfactor * c + scale * op(a) * op(b)
+    // native kernel with CSR b, where a and b are not transposed
+    // parallel over (blocks of) rows of c
+    static void dense_csr_kernel(const GMatrix<FL> &a, const GCSRMatrix<FL> &b,
+                                 bool conjb, const GMatrix<FL> &c, FL scale,
+                                 FL cfactor) {
+        assert(a.m == c.m && a.n == b.m && b.n == c.n);
+        const MKL_INT bm = b.m;
+        const int ntk = (size_t)c.m * b.nnz >= ((size_t)1 << 16)
+                            ? max(threading->n_threads_mkl, 1)
+                            : 1;
+#pragma omp parallel for schedule(static) num_threads(ntk)
+        for (MKL_INT i = 0; i < c.m; i++) {
+            FL *cr = c.data + (size_t)i * c.n;
+            if (cfactor == (FL)0.0)
+                memset(cr, 0, sizeof(FL) * c.n);
+            else if (cfactor != (FL)1.0)
+                for (MKL_INT j = 0; j < c.n; j++)
+                    cr[j] *= cfactor;
+            for (MKL_INT k = 0; k < bm; k++) {
+                const FL factor = scale * a.data[(size_t)i * a.n + k];
+                if (factor == (FL)0.0)
+                    continue;
+                const MKL_INT jp = b.rows[k],
+                              jr = k == bm - 1 ? b.nnz : b.rows[k + 1];
+                if (!conjb) {
+#pragma omp simd
+                    for (MKL_INT j = jp; j < jr; j++)
+                        cr[b.cols[j]] += factor * b.data[j];
+                } else {
+#pragma omp simd
+                    for (MKL_INT j = jp; j < jr; j++)
+                        cr[b.cols[j]] += factor * xconj<FL>(b.data[j]);
+                }
+            }
+        }
+    }
+    // c = cfactor * c + scale * op(a) * op(b)
+    // native kernel with CSR a, where a and b are not transposed
+    // parallel over (blocks of) rows of c
+    static void csr_dense_kernel(const GCSRMatrix<FL> &a, bool conja,
+                                 const GMatrix<FL> &b, const GMatrix<FL> &c,
+                                 FL scale, FL cfactor) {
+        assert(a.m == c.m && a.n == b.m && b.n == c.n);
+        const MKL_INT am = a.m, bn = b.n;
+        const int ntk = (size_t)a.nnz * bn >= ((size_t)1 << 16)
+                            ? max(threading->n_threads_mkl, 1)
+                            : 1;
+#pragma omp parallel for schedule(static) num_threads(ntk)
+        for (MKL_INT i = 0; i < am; i++) {
+            FL *cr = c.data + (size_t)i * c.n;
+            if (cfactor == (FL)0.0)
+                memset(cr, 0, sizeof(FL) * c.n);
+            else if (cfactor != (FL)1.0)
+                for (MKL_INT j = 0; j < c.n; j++)
+                    cr[j] *= cfactor;
+            const MKL_INT jp = a.rows[i],
+                          jr = i == am - 1 ? a.nnz : a.rows[i + 1];
+            for (MKL_INT j = jp; j < jr; j++) {
+                const FL factor =
+                    scale * (conja ? xconj<FL>(a.data[j]) : a.data[j]);
+                const FL *br = b.data + (size_t)a.cols[j] * b.n;
+#pragma omp simd
+                for (MKL_INT l = 0; l < bn; l++)
+                    cr[l] += factor * br[l];
+            }
+        }
+    }
+    // op(a) as a dense matrix without transpose or conjugation
+    static GMatrix<FL> dense_op(const GMatrix<FL> &a, uint8_t conja,
+                                const shared_ptr<VectorAllocator<FP>> &d_alloc) {
+        GMatrix<FL> at(nullptr, (conja & 1) ? a.n : a.m,
+                       (conja & 1) ? a.m : a.n);
+        at.allocate(d_alloc);
+        if (conja == 3)
+            GMatrixFunctions<FL>::iadd(at, a, 1.0, true, 0.0);
+        else if (conja == 1)
+            GMatrixFunctions<FL>::transpose(at, a, 1.0, 0.0);
+        else {
+            GMatrixFunctions<FL>::copy(at, a);
+            GMatrixFunctions<FL>::conjugate(at);
+        }
+        return at;
+    }
+    // op(a) as a CSR matrix without transpose (conjugation is not resolved)
+    static GCSRMatrix<FL>
+    csr_transpose_op(const GCSRMatrix<FL> &a, uint8_t conja,
+                     const shared_ptr<VectorAllocator<FP>> &d_alloc) {
+        assert(conja & 1);
+        // transpose always gives the conjugate transpose
+        GCSRMatrix<FL> at = a.transpose(d_alloc);
+        if (conja == 1)
+            GMatrixFunctions<FL>::conjugate(GMatrix<FL>(at.data, at.nnz, 1));
+        return at;
+    }
     static void multiply(const GMatrix<FL> &a, uint8_t conja,
                          const GCSRMatrix<FL> &b, uint8_t conjb,
                          const GMatrix<FL> &c, FL scale, FL cfactor) {
-        if (b.nnz == b.size())
+        if (b.nnz == b.size() && !(conjb == 2 && (conja & 2)))
             return GMatrixFunctions<FL>::multiply(a, conja, b.dense_ref(),
                                                   conjb, c, scale, cfactor);
+        if ((FP)b.nnz >= get_dense_crossover_density() * (FP)b.size()) {
+            shared_ptr<VectorAllocator<FP>> d_alloc =
+                make_shared<VectorAllocator<FP>>();
+            GMatrix<FL> bd(nullptr, b.m, b.n);
+            bd.allocate(d_alloc);
+            b.to_dense(bd);
+            // GEMM cannot take conjugate (no transpose) for both a and b
+            if (conjb == 2 && (conja & 2))
+                GMatrixFunctions<FL>::conjugate(bd), conjb = 0;
+            GMatrixFunctions<FL>::multiply(a, conja, bd, conjb, c, scale,
+                                           cfactor);
+            bd.deallocate(d_alloc);
+            return;
+        }
+        sparse_multiply(a, conja, b, conjb, c, scale, cfactor);
+    }
+    static void sparse_multiply(const GMatrix<FL> &a, uint8_t conja,
+                                const GCSRMatrix<FL> &b, uint8_t conjb,
+                                const GMatrix<FL> &c, FL scale, FL cfactor) {
 #ifdef _HAS_INTEL_MKL
         struct matrix_descr mt;
         mt.type = SPARSE_MATRIX_TYPE_GENERAL;
         assert(((conja & 1) ? a.n : a.m) == c.m);
         assert(((conjb & 1) ? b.m : b.n) == c.n);
         assert(((conja & 1) ? a.m : a.n) == ((conjb & 1) ? b.n : b.m));
+        // conjugate transpose of b has no matching MKL sparse operation
+        if (conjb == 3) {
+            shared_ptr<VectorAllocator<FP>> d_alloc =
+                make_shared<VectorAllocator<FP>>();
+            GCSRMatrix<FL> bt = b.transpose(d_alloc);
+            sparse_multiply(a, conja, bt, 0, c, scale, cfactor);
+            bt.deallocate();
+            return;
+        }
         shared_ptr<sparse_matrix_t> spb =
             MKLSparseAllocator<FL>::to_mkl_sparse_matrix(b);
-        // TODO: CSR conj not resolved
-        assert(conjb != 3);
         if (!conja) {
             sparse_status_t st = mkl_sparse_x_mm<FL>(
                 conjb == 2 ? SPARSE_OPERATION_CONJUGATE_TRANSPOSE
@@ -664,58 +849,49 @@ template <typename FL> struct GCSRMatrixFunctions {
             at.deallocate(d_alloc);
         }
 #else
-        const MKL_INT am = conja ? a.n : a.m, an = conja ? a.m : a.n;
-        const MKL_INT bm = conjb ? b.n : b.m, bn = conjb ? b.m : b.n;
+        const MKL_INT am = (conja & 1) ? a.n : a.m,
+                      an = (conja & 1) ? a.m : a.n;
+        const MKL_INT bm = (conjb & 1) ? b.n : b.m,
+                      bn = (conjb & 1) ? b.m : b.n;
         assert(am == c.m && bn == c.n && an == bm);
-        if (cfactor != (FL)1.0)
-            GMatrixFunctions<FL>::iscale(c, cfactor);
-        if (!conja && !conjb) {
-            for (MKL_INT ib = 0; ib < b.m; ib++) {
-                const MKL_INT jbp = b.rows[ib], jbr = b.rows[ib + 1];
-                for (MKL_INT jb = jbp; jb < jbr; jb++) {
-                    const FL factor = scale * b.data[jb];
-                    xaxpy<FL>(&a.m, &factor, &a(0, ib), &a.n, &c(0, b.cols[jb]),
-                              &c.n);
-                }
-            }
-        } else if (conja && !conjb) {
-            const MKL_INT inc = 1;
-            for (MKL_INT ib = 0; ib < b.m; ib++) {
-                const MKL_INT jbp = b.rows[ib], jbr = b.rows[ib + 1];
-                for (MKL_INT jb = jbp; jb < jbr; jb++) {
-                    const FL factor = scale * b.data[jb];
-                    xaxpy<FL>(&a.n, &factor, &a(ib, 0), &inc, &c(0, b.cols[jb]),
-                              &c.n);
-                }
-            }
-        } else if (!conja && conjb) {
-            for (MKL_INT ib = 0; ib < b.m; ib++) {
-                const MKL_INT jbp = b.rows[ib], jbr = b.rows[ib + 1];
-                for (MKL_INT jb = jbp; jb < jbr; jb++) {
-                    const FL factor = scale * b.data[jb];
-                    xaxpy<FL>(&a.m, &factor, &a(0, b.cols[jb]), &a.n, &c(0, ib),
-                              &c.n);
-                }
-            }
-        } else {
-            const MKL_INT inc = 1;
-            for (MKL_INT ib = 0; ib < b.m; ib++) {
-                const MKL_INT jbp = b.rows[ib], jbr = b.rows[ib + 1];
-                for (MKL_INT jb = jbp; jb < jbr; jb++) {
-                    const FL factor = scale * b.data[jb];
-                    xaxpy<FL>(&a.n, &factor, &a(b.cols[jb], 0), &inc, &c(0, ib),
-                              &c.n);
-                }
-            }
-        }
+        shared_ptr<VectorAllocator<FP>> d_alloc =
+            make_shared<VectorAllocator<FP>>();
+        GMatrix<FL> at = conja ? dense_op(a, conja, d_alloc) : a;
+        if (conjb & 1) {
+            GCSRMatrix<FL> bt = csr_transpose_op(b, conjb, d_alloc);
+            dense_csr_kernel(at, bt, false, c, scale, cfactor);
+            bt.deallocate();
+        } else
+            dense_csr_kernel(at, b, conjb == 2, c, scale, cfactor);
+        if (conja)
+            at.deallocate(d_alloc);
 #endif
     }
     static void multiply(const GCSRMatrix<FL> &a, uint8_t conja,
                          const GMatrix<FL> &b, uint8_t conjb,
                          const GMatrix<FL> &c, FL scale, FL cfactor) {
-        if (a.nnz == a.size())
+        if (a.nnz == a.size() && !(conjb == 2 && (conja & 2)))
             return GMatrixFunctions<FL>::multiply(a.dense_ref(), conja, b,
                                                   conjb, c, scale, cfactor);
+        if ((FP)a.nnz >= get_dense_crossover_density() * (FP)a.size()) {
+            shared_ptr<VectorAllocator<FP>> d_alloc =
+                make_shared<VectorAllocator<FP>>();
+            GMatrix<FL> ad(nullptr, a.m, a.n);
+            ad.allocate(d_alloc);
+            a.to_dense(ad);
+            // GEMM cannot take conjugate (no transpose) for both a and b
+            if (conjb == 2 && (conja & 2))
+                GMatrixFunctions<FL>::conjugate(ad), conja ^= 2;
+            GMatrixFunctions<FL>::multiply(ad, conja, b, conjb, c, scale,
+                                           cfactor);
+            ad.deallocate(d_alloc);
+            return;
+        }
+        sparse_multiply(a, conja, b, conjb, c, scale, cfactor);
+    }
+    static void sparse_multiply(const GCSRMatrix<FL> &a, uint8_t conja,
+                                const GMatrix<FL> &b, uint8_t conjb,
+                                const GMatrix<FL> &c, FL scale, FL cfactor) {
 #ifdef _HAS_INTEL_MKL
         const struct matrix_descr mt {
             SPARSE_MATRIX_TYPE_GENERAL, SPARSE_FILL_MODE_LOWER,
@@ -752,49 +928,22 @@ template <typename FL> struct GCSRMatrixFunctions {
             bt.deallocate(d_alloc);
         }
 #else
-        const MKL_INT am = conja ? a.n : a.m, an = conja ? a.m : a.n;
-        const MKL_INT bm = conjb ? b.n : b.m, bn = conjb ? b.m : b.n;
-        const MKL_INT inc = 1;
+        const MKL_INT am = (conja & 1) ? a.n : a.m,
+                      an = (conja & 1) ? a.m : a.n;
+        const MKL_INT bm = (conjb & 1) ? b.n : b.m,
+                      bn = (conjb & 1) ? b.m : b.n;
         assert(am == c.m && bn == c.n && an == bm);
-        if (cfactor != (FL)1.0)
-            GMatrixFunctions<FL>::iscale(c, cfactor);
-        if (!conja && !conjb) {
-            for (MKL_INT ia = 0; ia < a.m; ia++) {
-                const MKL_INT jap = a.rows[ia], jar = a.rows[ia + 1];
-                for (MKL_INT ja = jap; ja < jar; ja++) {
-                    const FL factor = scale * a.data[ja];
-                    xaxpy<FL>(&b.n, &factor, &b(a.cols[ja], 0), &inc, &c(ia, 0),
-                              &inc);
-                }
-            }
-        } else if (conja && !conjb) {
-            for (MKL_INT ia = 0; ia < a.m; ia++) {
-                const MKL_INT jap = a.rows[ia], jar = a.rows[ia + 1];
-                for (MKL_INT ja = jap; ja < jar; ja++) {
-                    const FL factor = scale * a.data[ja];
-                    xaxpy<FL>(&b.n, &factor, &b(ia, 0), &inc, &c(a.cols[ja], 0),
-                              &inc);
-                }
-            }
-        } else if (!conja && conjb) {
-            for (MKL_INT ia = 0; ia < a.m; ia++) {
-                const MKL_INT jap = a.rows[ia], jar = a.rows[ia + 1];
-                for (MKL_INT ja = jap; ja < jar; ja++) {
-                    const FL factor = scale * a.data[ja];
-                    xaxpy<FL>(&b.m, &factor, &b(0, a.cols[ja]), &b.n, &c(ia, 0),
-                              &inc);
-                }
-            }
-        } else {
-            for (MKL_INT ia = 0; ia < a.m; ia++) {
-                const MKL_INT jap = a.rows[ia], jar = a.rows[ia + 1];
-                for (MKL_INT ja = jap; ja < jar; ja++) {
-                    const FL factor = scale * a.data[ja];
-                    xaxpy<FL>(&b.m, &factor, &b(0, ia), &b.n, &c(a.cols[ja], 0),
-                              &inc);
-                }
-            }
-        }
+        shared_ptr<VectorAllocator<FP>> d_alloc =
+            make_shared<VectorAllocator<FP>>();
+        GMatrix<FL> bt = conjb ? dense_op(b, conjb, d_alloc) : b;
+        if (conja & 1) {
+            GCSRMatrix<FL> at = csr_transpose_op(a, conja, d_alloc);
+            csr_dense_kernel(at, false, bt, c, scale, cfactor);
+            at.deallocate();
+        } else
+            csr_dense_kernel(a, conja == 2, bt, c, scale, cfactor);
+        if (conjb)
+            bt.deallocate(d_alloc);
 #endif
     }
     // c = bra * a * ket(.T) for tensor product multiplication
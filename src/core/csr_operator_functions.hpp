@@ -45,6 +45,7 @@ struct CSROperatorFunctions : OperatorFunctions<S, FL> {
         shared_ptr<OperatorFunctions<S, FL>> opf =
             make_shared<CSROperatorFunctions<S, FL>>(this->cg);
         opf->seq = this->seq->copy();
+        opf->plan_cache = this->plan_cache;
         return opf;
     }
     // a += b * scale
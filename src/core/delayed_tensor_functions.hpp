@@ -168,6 +168,9 @@ struct DelayedTensorFunctions : TensorFunctions<S, FL> {
                     S vdq = pks[k];
                     int iv = (int)(lower_bound(vdqs.begin(), vdqs.end(), vdq) -
                                    vdqs.begin());
+                    if (vidx == -1 &&
+                        (iv == (int)vdqs.size() || vdqs[iv] != vdq))
+                        continue;
                     shared_ptr<SparseMatrix<S, FL>> vmat =
                         vidx == -1 ? (*vmats)[iv] : (*vmats)[vidx++];
                     cmat->info->cinfo = cinfos[ij][k];
@@ -205,6 +208,9 @@ struct DelayedTensorFunctions : TensorFunctions<S, FL> {
                     S vdq = pks[k];
                     int iv = (int)(lower_bound(vdqs.begin(), vdqs.end(), vdq) -
                                    vdqs.begin());
+                    if (vidx == -1 &&
+                        (iv == (int)vdqs.size() || vdqs[iv] != vdq))
+                        continue;
                     shared_ptr<SparseMatrix<S, FL>> vmat =
                         vidx == -1 ? (*vmats)[iv] : (*vmats)[vidx++];
                     cmat->info->cinfo = cinfos[ij][k];
@@ -137,6 +137,9 @@ template <typename S, typename FL> struct Hamiltonian {
     virtual ~Hamiltonian() = default;
     virtual int get_n_orbs_left() const { return 0; }
     virtual int get_n_orbs_right() const { return 0; }
+    // Whether the quanta/string callbacks can be called concurrently
+    // (false when they are overridden in Python and need the GIL)
+    virtual bool is_thread_safe() const { return true; }
     // Fill the map with sparse matrix representation of site operators
     // The keys in map should be already set by filter_site_ops
     virtual void get_site_ops(
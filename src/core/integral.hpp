@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include "complex_matrix_functions.hpp"
 #include "threading.hpp"
 #include "utils.hpp"
 #include <array>
@@ -81,6 +82,49 @@ inline void fd_read_line(array<uint16_t, 4> &idx, complex<FL> &d,
         assert(false);
 }
 
+// Orbital rotation x -> u^H x u on one index pair of two-electron integrals,
+// done as GEMMs on n x n slabs or on blocks of slabs
+template <typename FL> struct PairRotation {
+    MKL_INT n;
+    // u and its conjugate transpose
+    vector<FL> u, ut;
+    PairRotation(MKL_INT n, const vector<FL> &rot_mat)
+        : n(n), u(rot_mat), ut((size_t)n * n) {
+        for (MKL_INT i = 0; i < n; i++)
+            for (MKL_INT j = 0; j < n; j++)
+                ut[(size_t)j * n + i] = xconj(rot_mat[(size_t)i * n + j]);
+    }
+    // rows [r0, r1) of u^H a u for one slab a (n x n)
+    // c may be a; au is n x n scratch
+    void slab(const FL *a, FL *au, FL *c, MKL_INT r0, MKL_INT r1) const {
+        GMatrixFunctions<FL>::multiply(GMatrix<FL>((FL *)a, n, n), 0,
+                                       GMatrix<FL>((FL *)u.data(), n, n), 0,
+                                       GMatrix<FL>(au, n, n), 1.0, 0.0);
+        GMatrixFunctions<FL>::multiply(
+            GMatrix<FL>((FL *)ut.data() + (size_t)r0 * n, r1 - r0, n), 0,
+            GMatrix<FL>(au, n, n), 0, GMatrix<FL>(c, r1 - r0, n), 1.0, 0.0);
+    }
+    // b slabs stored as x[(i * n + j) * b + t] are transformed in place
+    // only rows i >= r0 are computed, stored as x[((i - r0) * n + j) * b + t]
+    // y is (n - r0) * n * b scratch
+    void block(FL *x, FL *y, MKL_INT b, MKL_INT r0) const {
+        GMatrixFunctions<FL>::multiply(
+            GMatrix<FL>((FL *)ut.data() + (size_t)r0 * n, n - r0, n), 0,
+            GMatrix<FL>(x, n, n * b), 0, GMatrix<FL>(y, n - r0, n * b), 1.0,
+            0.0);
+        for (MKL_INT i = 0; i < n - r0; i++)
+            GMatrixFunctions<FL>::multiply(
+                GMatrix<FL>((FL *)u.data(), n, n), 1,
+                GMatrix<FL>(y + (size_t)i * n * b, n, b), 0,
+                GMatrix<FL>(x + (size_t)i * n * b, n, b), 1.0, 0.0);
+    }
+    // number of slabs per block for the given scratch memory per thread
+    MKL_INT block_size(size_t max_memory, int ntg, size_t ncols) const {
+        size_t b = max_memory / ((size_t)ntg * 2 * n * n * sizeof(FL));
+        return (MKL_INT)max((size_t)1, min(min(b, (size_t)64), ncols));
+    }
+};
+
 // Symmetric/general 2D array for storage of one-electron integrals
 template <typename FL> struct TInt {
     // Number of orbitals
@@ -182,84 +226,36 @@ template <typename FL> struct V1Int {
                         (*this)(i, j, k, l) =
                             other(ord[i], ord[j], ord[k], ord[l]);
     }
-    void rotate(const V1Int &other, const vector<FL> &rot_mat) {
+    // rotation with scratch memory bounded by max_memory (except n x n
+    // work per thread), the result is transformed in place
+    void rotate(const V1Int &other, const vector<FL> &rot_mat,
+                size_t max_memory = (size_t)1 << 30) {
         assert(n == other.n);
-        vector<FL> tmp(size());
-#ifdef _MSC_VER
-        assert((size_t)n * n * n * n <= (size_t)numeric_limits<int>::max());
-#endif
+        const size_t n2 = (size_t)n * n;
+        const PairRotation<FL> rot((MKL_INT)n, rot_mat);
         int ntg = threading->activate_global();
+        const MKL_INT b = rot.block_size(max_memory, ntg, n2);
+        const int nblock = (int)((n2 + b - 1) / b);
 #pragma omp parallel num_threads(ntg)
         {
-#ifdef _MSC_VER
+            vector<FL> x(n2 * b), y(n2 * b);
+            // (k, l) of every (i, j)
 #pragma omp for schedule(dynamic)
-            for (int ijkl = 0; ijkl < (int)(n * n * n * n); ijkl++) {
-                int i = ijkl / (n * n * n), j = (ijkl / (n * n)) % n,
-                    k = (ijkl / n) % n, l = ijkl % n;
-#else
-#pragma omp for schedule(dynamic) collapse(4)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++)
-                    for (int k = 0; k < n; k++)
-                        for (int l = 0; l < n; l++) {
-#endif
-                FL x = 0;
-                for (int q = 0; q < (int)n; q++)
-                    x += other(i, j, k, q) * rot_mat[q * n + l];
-                tmp[(((size_t)i * n + j) * n + k) * n + l] = x;
-            }
-#ifdef _MSC_VER
+            for (int ij = 0; ij < (int)n2; ij++)
+                rot.slab(other.data + ij * n2, x.data(), data + ij * n2, 0,
+                         (MKL_INT)n);
+            // (i, j) of every (k, l)
 #pragma omp for schedule(dynamic)
-            for (int ijkl = 0; ijkl < (int)(n * n * n * n); ijkl++) {
-                int i = ijkl / (n * n * n), j = (ijkl / (n * n)) % n,
-                    k = (ijkl / n) % n, l = ijkl % n;
-#else
-#pragma omp for schedule(dynamic) collapse(4)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++)
-                    for (int k = 0; k < n; k++)
-                        for (int l = 0; l < n; l++) {
-#endif
-                FL x = 0;
-                for (int q = 0; q < (int)n; q++)
-                    x += tmp[(((size_t)i * n + j) * n + q) * n + l] *
-                         xconj(rot_mat[q * n + k]);
-                (*this)(i, j, k, l) = x;
-            }
-#ifdef _MSC_VER
-#pragma omp for schedule(dynamic)
-            for (int ijkl = 0; ijkl < (int)(n * n * n * n); ijkl++) {
-                int i = ijkl / (n * n * n), j = (ijkl / (n * n)) % n,
-                    k = (ijkl / n) % n, l = ijkl % n;
-#else
-#pragma omp for schedule(dynamic) collapse(4)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++)
-                    for (int k = 0; k < n; k++)
-                        for (int l = 0; l < n; l++) {
-#endif
-                FL x = 0;
-                for (int q = 0; q < (int)n; q++)
-                    x += (*this)(i, q, k, l) * rot_mat[q * n + j];
-                tmp[(((size_t)i * n + j) * n + k) * n + l] = x;
-            }
-#ifdef _MSC_VER
-#pragma omp for schedule(dynamic)
-            for (int ijkl = 0; ijkl < (int)(n * n * n * n); ijkl++) {
-                int i = ijkl / (n * n * n), j = (ijkl / (n * n)) % n,
-                    k = (ijkl / n) % n, l = ijkl % n;
-#else
-#pragma omp for schedule(dynamic) collapse(4)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++)
-                    for (int k = 0; k < n; k++)
-                        for (int l = 0; l < n; l++) {
-#endif
-                FL x = 0;
-                for (int q = 0; q < (int)n; q++)
-                    x += tmp[(((size_t)q * n + j) * n + k) * n + l] *
-                         xconj(rot_mat[q * n + i]);
-                (*this)(i, j, k, l) = x;
+            for (int ib = 0; ib < nblock; ib++) {
+                const size_t kl0 = (size_t)ib * b;
+                const MKL_INT nb = (MKL_INT)min((size_t)b, n2 - kl0);
+                for (size_t ij = 0; ij < n2; ij++)
+                    memcpy(x.data() + ij * nb, data + ij * n2 + kl0,
+                           sizeof(FL) * nb);
+                rot.block(x.data(), y.data(), nb, 0);
+                for (size_t ij = 0; ij < n2; ij++)
+                    memcpy(data + ij * n2 + kl0, x.data() + ij * nb,
+                           sizeof(FL) * nb);
             }
         }
     }
@@ -308,87 +304,50 @@ template <typename FL> struct V4Int {
                         (*this)(i, j, k, l) =
                             other(ord[i], ord[j], ord[k], ord[l]);
     }
-    void rotate(const V4Int &other, const vector<FL> &rot_mat) {
+    // rotation with scratch memory bounded by max_memory (except n x n
+    // work per thread), the result is transformed in place
+    void rotate(const V4Int &other, const vector<FL> &rot_mat,
+                size_t max_memory = (size_t)1 << 30) {
         assert(n == other.n);
-        vector<FL> tmp((size_t)n * n * n * n), tmp2((size_t)n * n * n * n);
-#ifdef _MSC_VER
-        assert((size_t)n * n * n * n <= (size_t)numeric_limits<int>::max());
-#endif
+        const size_t n2 = (size_t)n * n;
+        const PairRotation<FL> rot((MKL_INT)n, rot_mat);
         int ntg = threading->activate_global();
+        const MKL_INT b = rot.block_size(max_memory, ntg, m);
+        const int nblock = (int)((m + b - 1) / b);
 #pragma omp parallel num_threads(ntg)
         {
-#ifdef _MSC_VER
-#pragma omp for schedule(dynamic)
-            for (int ijkl = 0; ijkl < (int)(n * n * n * n); ijkl++) {
-                int i = ijkl / (n * n * n), j = (ijkl / (n * n)) % n,
-                    k = (ijkl / n) % n, l = ijkl % n;
-#else
-#pragma omp for schedule(dynamic) collapse(4)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++)
-                    for (int k = 0; k < n; k++)
-                        for (int l = 0; l < n; l++) {
-#endif
-                FL x = 0;
-                for (int q = 0; q < (int)n; q++)
-                    x += other(i, j, k, q) * rot_mat[q * n + l];
-                tmp[(((size_t)i * n + j) * n + k) * n + l] = x;
-            }
-#ifdef _MSC_VER
+            vector<FL> x(n2 * b), y(n2 * b);
+            // (k, l) of every packed (i, j)
 #pragma omp for schedule(dynamic)
-            for (int ijkl = 0; ijkl < (int)(n * n * n * n); ijkl++) {
-                int i = ijkl / (n * n * n), j = (ijkl / (n * n)) % n,
-                    k = (ijkl / n) % n, l = ijkl % n;
-#else
-#pragma omp for schedule(dynamic) collapse(4)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++)
-                    for (int k = 0; k < n; k++)
-                        for (int l = 0; l < n; l++) {
-#endif
-                FL x = 0;
-                for (int q = 0; q < (int)n; q++)
-                    x += tmp[(((size_t)i * n + j) * n + q) * n + l] *
-                         xconj(rot_mat[q * n + k]);
-                tmp2[(((size_t)i * n + j) * n + k) * n + l] = x;
-            }
-#ifdef _MSC_VER
-#pragma omp for schedule(dynamic)
-            for (int ijkl = 0; ijkl < (int)(n * n * n * n); ijkl++) {
-                int i = ijkl / (n * n * n), j = (ijkl / (n * n)) % n,
-                    k = (ijkl / n) % n, l = ijkl % n;
-#else
-#pragma omp for schedule(dynamic) collapse(4)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++)
-                    for (int k = 0; k < n; k++)
-                        for (int l = 0; l < n; l++) {
-#endif
-                FL x = 0;
-                for (int q = 0; q < (int)n; q++)
-                    x += tmp2[(((size_t)i * n + q) * n + k) * n + l] *
-                         rot_mat[q * n + j];
-                tmp[(((size_t)i * n + j) * n + k) * n + l] = x;
+            for (int ij = 0; ij < (int)m; ij++) {
+                const FL *pd = other.data + (size_t)ij * m;
+                for (uint32_t k = 0, kl = 0; k < n; k++)
+                    for (uint32_t l = 0; l <= k; l++, kl++)
+                        y[k * n + l] = y[l * n + k] = pd[kl];
+                rot.slab(y.data(), x.data(), y.data(), 0, (MKL_INT)n);
+                FL *pr = data + (size_t)ij * m;
+                for (uint32_t k = 0, kl = 0; k < n; k++)
+                    for (uint32_t l = 0; l <= k; l++, kl++)
+                        pr[kl] = y[k * n + l];
             }
-#ifdef _MSC_VER
+            // (i, j) of every packed (k, l)
 #pragma omp for schedule(dynamic)
-            for (int ijkl = 0; ijkl < (int)(n * n * n * n); ijkl++) {
-                int i = ijkl / (n * n * n), j = (ijkl / (n * n)) % n,
-                    k = (ijkl / n) % n, l = ijkl % n;
-#else
-#pragma omp for schedule(dynamic) collapse(4)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++)
-                    for (int k = 0; k < n; k++)
-                        for (int l = 0; l < n; l++) {
-                            if (j > i || l > k)
-                                continue;
-#endif
-                FL x = 0;
-                for (int q = 0; q < (int)n; q++)
-                    x += tmp[(((size_t)q * n + j) * n + k) * n + l] *
-                         xconj(rot_mat[q * n + i]);
-                (*this)(i, j, k, l) = x;
+            for (int ib = 0; ib < nblock; ib++) {
+                const size_t kl0 = (size_t)ib * b;
+                const MKL_INT nb = (MKL_INT)min((size_t)b, m - kl0);
+                for (uint32_t i = 0, ij = 0; i < n; i++)
+                    for (uint32_t j = 0; j <= i; j++, ij++) {
+                        memcpy(x.data() + ((size_t)i * n + j) * nb,
+                               data + (size_t)ij * m + kl0, sizeof(FL) * nb);
+                        memcpy(x.data() + ((size_t)j * n + i) * nb,
+                               data + (size_t)ij * m + kl0, sizeof(FL) * nb);
+                    }
+                rot.block(x.data(), y.data(), nb, 0);
+                for (uint32_t i = 0, ij = 0; i < n; i++)
+                    for (uint32_t j = 0; j <= i; j++, ij++)
+                        memcpy(data + (size_t)ij * m + kl0,
+                               x.data() + ((size_t)i * n + j) * nb,
+                               sizeof(FL) * nb);
             }
         }
     }
@@ -438,88 +397,83 @@ template <typename FL> struct V8Int {
                             (*this)(i, j, k, l) =
                                 other(ord[i], ord[j], ord[k], ord[l]);
     }
-    void rotate(const V8Int &other, const vector<FL> &rot_mat) {
+    // rotation with scratch memory bounded by max_memory (except n x n
+    // work per thread). The half-transformed integrals (all (i, j) by a
+    // range of (k, l)) are kept in blocks of whole k rows.
+    void rotate(const V8Int &other, const vector<FL> &rot_mat,
+                size_t max_memory = (size_t)1 << 30) {
         assert(n == other.n);
-        vector<FL> tmp((size_t)n * n * n * n), tmp2((size_t)n * n * n * n);
-#ifdef _MSC_VER
-        assert((size_t)n * n * n * n <= (size_t)numeric_limits<int>::max());
-#endif
+        const size_t n2 = (size_t)n * n;
+        const PairRotation<FL> rot((MKL_INT)n, rot_mat);
         int ntg = threading->activate_global();
+        const MKL_INT b = rot.block_size(max_memory / 4, ntg, m);
+        const size_t scratch = (size_t)ntg * 2 * n2 * b * sizeof(FL);
+        const size_t max_cols =
+            max_memory > scratch
+                ? max((size_t)1, (max_memory - scratch) / sizeof(FL) / m)
+                : (size_t)1;
+        vector<uint32_t> kl_k(m);
+        for (uint32_t k = 0, kl = 0; k < n; k++)
+            for (uint32_t l = 0; l <= k; l++, kl++)
+                kl_k[kl] = k;
+        vector<FL> h;
+        for (uint32_t k0 = 0, k1; k0 < n; k0 = k1) {
+            // k rows [k0, k1), at least one row
+            for (k1 = k0 + 1; k1 < n && ((size_t)(k1 + 1) * (k1 + 2) >> 1) -
+                                                ((size_t)k0 * (k0 + 1) >> 1) <=
+                                            max_cols;
+                 k1++)
+                ;
+            const size_t kl0 = (size_t)k0 * (k0 + 1) >> 1;
+            const size_t nkl = ((size_t)k1 * (k1 + 1) >> 1) - kl0;
+            const int nblock = (int)((nkl + b - 1) / b);
+            h.resize((size_t)m * nkl);
 #pragma omp parallel num_threads(ntg)
-        {
-#ifdef _MSC_VER
-#pragma omp for schedule(dynamic)
-            for (int ijkl = 0; ijkl < (int)(n * n * n * n); ijkl++) {
-                int i = ijkl / (n * n * n), j = (ijkl / (n * n)) % n,
-                    k = (ijkl / n) % n, l = ijkl % n;
-#else
-#pragma omp for schedule(dynamic) collapse(4)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++)
-                    for (int k = 0; k < n; k++)
-                        for (int l = 0; l < n; l++) {
-#endif
-                FL x = 0;
-                for (int q = 0; q < (int)n; q++)
-                    x += other(i, j, k, q) * rot_mat[q * n + l];
-                tmp[(((size_t)i * n + j) * n + k) * n + l] = x;
-            }
-#ifdef _MSC_VER
-#pragma omp for schedule(dynamic)
-            for (int ijkl = 0; ijkl < (int)(n * n * n * n); ijkl++) {
-                int i = ijkl / (n * n * n), j = (ijkl / (n * n)) % n,
-                    k = (ijkl / n) % n, l = ijkl % n;
-#else
-#pragma omp for schedule(dynamic) collapse(4)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++)
-                    for (int k = 0; k < n; k++)
-                        for (int l = 0; l < n; l++) {
-#endif
-                FL x = 0;
-                for (int q = 0; q < (int)n; q++)
-                    x += tmp[(((size_t)i * n + j) * n + q) * n + l] *
-                         xconj(rot_mat[q * n + k]);
-                tmp2[(((size_t)i * n + j) * n + k) * n + l] = x;
-            }
-#ifdef _MSC_VER
+            {
+                vector<FL> x(n2 * b), y(n2 * b);
+                // (k, l) in this block of every packed (i, j)
 #pragma omp for schedule(dynamic)
-            for (int ijkl = 0; ijkl < (int)(n * n * n * n); ijkl++) {
-                int i = ijkl / (n * n * n), j = (ijkl / (n * n)) % n,
-                    k = (ijkl / n) % n, l = ijkl % n;
-#else
-#pragma omp for schedule(dynamic) collapse(4)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++)
-                    for (int k = 0; k < n; k++)
-                        for (int l = 0; l < n; l++) {
-#endif
-                FL x = 0;
-                for (int q = 0; q < (int)n; q++)
-                    x += tmp2[(((size_t)i * n + q) * n + k) * n + l] *
-                         rot_mat[q * n + j];
-                tmp[(((size_t)i * n + j) * n + k) * n + l] = x;
-            }
-#ifdef _MSC_VER
+                for (int ij = 0; ij < (int)m; ij++) {
+                    for (uint32_t k = 0, kl = 0; k < n; k++)
+                        for (uint32_t l = 0; l <= k; l++, kl++)
+                            y[k * n + l] = y[l * n + k] =
+                                other.data[find_index((uint32_t)ij, kl)];
+                    rot.slab(y.data(), x.data(), y.data(), (MKL_INT)k0,
+                             (MKL_INT)k1);
+                    FL *ph = h.data() + (size_t)ij * nkl;
+                    for (uint32_t k = k0, kl = 0; k < k1; k++)
+                        for (uint32_t l = 0; l <= k; l++, kl++)
+                            ph[kl] = y[(k - k0) * n + l];
+                }
+                // (i, j) of every packed (k, l) in this block
+                // only (i, j) >= (k, l) is stored, so rows i < k are skipped
 #pragma omp for schedule(dynamic)
-            for (int ijkl = 0; ijkl < (int)(n * n * n * n); ijkl++) {
-                int i = ijkl / (n * n * n), j = (ijkl / (n * n)) % n,
-                    k = (ijkl / n) % n, l = ijkl % n;
-#else
-#pragma omp for schedule(dynamic) collapse(4)
-            for (int i = 0; i < n; i++)
-                for (int j = 0; j < n; j++)
-                    for (int k = 0; k < n; k++)
-                        for (int l = 0; l < n; l++) {
-                            if (j > i || l > k ||
-                                (k * (k + 1) >> 1) + l > (i * (i + 1) >> 1) + j)
-                                continue;
-#endif
-                FL x = 0;
-                for (int q = 0; q < (int)n; q++)
-                    x += tmp[(((size_t)q * n + j) * n + k) * n + l] *
-                         xconj(rot_mat[q * n + i]);
-                (*this)(i, j, k, l) = x;
+                for (int ib = 0; ib < nblock; ib++) {
+                    const size_t klb = (size_t)ib * b;
+                    const MKL_INT nb = (MKL_INT)min((size_t)b, nkl - klb);
+                    const uint32_t r0 = kl_k[kl0 + klb];
+                    for (uint32_t i = 0, ij = 0; i < n; i++)
+                        for (uint32_t j = 0; j <= i; j++, ij++) {
+                            memcpy(x.data() + ((size_t)i * n + j) * nb,
+                                   h.data() + (size_t)ij * nkl + klb,
+                                   sizeof(FL) * nb);
+                            memcpy(x.data() + ((size_t)j * n + i) * nb,
+                                   h.data() + (size_t)ij * nkl + klb,
+                                   sizeof(FL) * nb);
+                        }
+                    rot.block(x.data(), y.data(), nb, (MKL_INT)r0);
+                    for (uint32_t i = r0; i < n; i++)
+                        for (uint32_t j = 0; j <= i; j++) {
+                            const size_t ij = find_index(i, j);
+                            const FL *px =
+                                x.data() + ((size_t)(i - r0) * n + j) * nb;
+                            for (MKL_INT t = 0; t < nb; t++)
+                                if (ij >= kl0 + klb + t)
+                                    data[find_index((uint32_t)ij,
+                                                    (uint32_t)(kl0 + klb +
+                                                               t))] = px[t];
+                        }
+                }
             }
         }
     }
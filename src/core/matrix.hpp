@@ -391,8 +391,8 @@ template <typename FL, typename IX = MKL_INT> struct GTensor {
             i = i * shape[k++] + ix;
         return data->at(i);
     }
-    // write array in numpy format
-    void write_array(ostream &ofs) const {
+    // write numpy header only, returning the number of bytes written
+    size_t write_header(ostream &ofs) const {
         const string magic = "\x93NUMPY";
         const char ver_major = 1, ver_minor = 0;
         const size_t pre_len = sizeof(char) * magic.length() +
@@ -418,12 +418,9 @@ template <typename FL, typename IX = MKL_INT> struct GTensor {
         else
             throw runtime_error("GTensor::write_array: unsupported data type");
         ss << ", 'fortran_order': False, 'shape': (";
-        size_t arr_len = 1;
-        for (int i = 0; i < (int)shape.size(); i++) {
+        for (int i = 0; i < (int)shape.size(); i++)
             ss << shape[i]
                << (i == (int)shape.size() - 1 ? (i == 0 ? ",)" : ")") : ", ");
-            arr_len *= shape[i];
-        }
         ss << ", }\n";
         string header = ss.str();
         if (((pre_len + header.length()) & 0x3F) != 0)
@@ -438,6 +435,14 @@ template <typename FL, typename IX = MKL_INT> struct GTensor {
             ofs.write((char *)&header_len, sizeof(header_len));
         }
         ofs.write((char *)header.c_str(), sizeof(char) * header.length());
+        return pre_len + header.length();
+    }
+    // write array in numpy format
+    void write_array(ostream &ofs) const {
+        write_header(ofs);
+        size_t arr_len = 1;
+        for (IX sh : shape)
+            arr_len = arr_len * (size_t)sh;
         ofs.write((char *)&(*data)[0], sizeof(FL) * arr_len);
     }
     // read array in numpy format
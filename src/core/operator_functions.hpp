@@ -42,6 +42,7 @@ enum struct NoiseTypes : uint16_t {
     Collected = 32,
     LowMem = 64,
     MidMem = 128,
+    Batched = 256,
     ReducedPerturbative = 4 | 8,
     PerturbativeUnscaled = 4 | 16,
     ReducedPerturbativeUnscaled = 4 | 8 | 16,
@@ -52,7 +53,11 @@ enum struct NoiseTypes : uint16_t {
     ReducedPerturbativeLowMem = 4 | 8 | 64,
     ReducedPerturbativeUnscaledLowMem = 4 | 8 | 16 | 64,
     ReducedPerturbativeCollectedLowMem = 4 | 8 | 32 | 64,
-    ReducedPerturbativeUnscaledCollectedLowMem = 4 | 8 | 16 | 32 | 64
+    ReducedPerturbativeUnscaledCollectedLowMem = 4 | 8 | 16 | 32 | 64,
+    ReducedPerturbativeBatched = 4 | 8 | 256,
+    ReducedPerturbativeUnscaledBatched = 4 | 8 | 16 | 256,
+    ReducedPerturbativeCollectedBatched = 4 | 8 | 32 | 256,
+    ReducedPerturbativeUnscaledCollectedBatched = 4 | 8 | 16 | 32 | 256
 };
 
 enum struct TraceTypes : uint8_t { None = 0, Left = 1, Right = 2 };
@@ -65,11 +70,26 @@ inline NoiseTypes operator|(NoiseTypes a, NoiseTypes b) {
     return NoiseTypes((uint16_t)a | (uint16_t)b);
 }
 
+// Embedding of an old renormalized basis into a new one
+// for each quantum sector, the new index of every old state (-1 if the
+// state is not kept) and the phase t such that |new> = t |old>
+template <typename S, typename FL> struct StateEmbedding {
+    map<S, vector<pair<int, FL>>> sectors;
+    size_t n_kept = 0, n_old = 0;
+    // nullptr if the sector is not present
+    const vector<pair<int, FL>> *find(S q) const {
+        auto it = sectors.find(q);
+        return it == sectors.end() ? nullptr : &it->second;
+    }
+};
+
 // SparseMatrix operations
 template <typename S, typename FL> struct OperatorFunctions {
     typedef typename GMatrix<FL>::FP FP;
     shared_ptr<CG<S>> cg;
     shared_ptr<BatchGEMMSeq<FL>> seq = nullptr;
+    // compiled contraction plans (disabled when nullptr)
+    shared_ptr<ConnectionPlanCache<S>> plan_cache = nullptr;
     OperatorFunctions(const shared_ptr<CG<S>> &cg) : cg(cg) {
         seq = make_shared<BatchGEMMSeq<FL>>(0, threading->seq_type);
     }
@@ -81,6 +101,7 @@ template <typename S, typename FL> struct OperatorFunctions {
         shared_ptr<OperatorFunctions> opf =
             make_shared<OperatorFunctions>(this->cg);
         opf->seq = this->seq->copy();
+        opf->plan_cache = this->plan_cache;
         return opf;
     }
     virtual void
@@ -208,6 +229,216 @@ template <typename S, typename FL> struct OperatorFunctions {
         if (seq->mode & SeqTypes::Simple)
             seq->simple_perform();
     }
+    // c = rot_bra x a x rot_ket, where c_old is the same operator rotated
+    // by the old bases and bra_emb/ket_emb embed the old bases into the
+    // bases of rot_bra/rot_ket. Blocks between kept states are copied from
+    // c_old (with phases), only rows/columns of new states are rotated
+    // the scale and factors must be the same as those used for c_old
+    virtual void tensor_rotate_incremental(
+        const shared_ptr<SparseMatrix<S, FL>> &a,
+        const shared_ptr<SparseMatrix<S, FL>> &c_old,
+        const shared_ptr<SparseMatrix<S, FL>> &c,
+        const shared_ptr<SparseMatrix<S, FL>> &rot_bra,
+        const shared_ptr<SparseMatrix<S, FL>> &rot_ket, bool trans,
+        const StateEmbedding<S, FL> &bra_emb,
+        const StateEmbedding<S, FL> &ket_emb, FL scale = 1.0) const {
+        assert(a->get_type() == SparseMatrixTypes::Normal &&
+               c->get_type() == SparseMatrixTypes::Normal &&
+               c_old->get_type() == SparseMatrixTypes::Normal &&
+               rot_bra->get_type() == SparseMatrixTypes::Normal &&
+               rot_ket->get_type() == SparseMatrixTypes::Normal);
+        scale =
+            scale * a->factor * xconj<FL>(rot_bra->factor) * rot_ket->factor;
+        assert(c->factor == (FP)1.0);
+        if (abs(scale) < TINY)
+            return;
+        S adq = a->info->delta_quantum, cdq = c->info->delta_quantum;
+        assert(adq == cdq && a->info->n >= c->info->n);
+        const uint8_t conj_bra = (uint8_t)!trans | 2, conj_ket = trans;
+        // selected states of a rotation block
+        // (columns for left rotation, rows for right rotation)
+        auto gather = [trans](const GMatrix<FL> &r, const vector<int> &idx,
+                              vector<FL> &buf) -> GMatrix<FL> {
+            const MKL_INT k = (MKL_INT)idx.size();
+            buf.resize((size_t)r.m * r.n);
+            if (!trans) {
+                for (MKL_INT i = 0; i < r.m; i++)
+                    for (MKL_INT j = 0; j < k; j++)
+                        buf[(size_t)i * k + j] = r(i, idx[j]);
+                return GMatrix<FL>(buf.data(), r.m, k);
+            } else {
+                for (MKL_INT j = 0; j < k; j++)
+                    memcpy(buf.data() + (size_t)j * r.n,
+                           r.data + (size_t)idx[j] * r.n, sizeof(FL) * r.n);
+                return GMatrix<FL>(buf.data(), k, r.n);
+            }
+        };
+        vector<FL> wb, wk, wc;
+        for (int ic = 0, ia = 0; ic < c->info->n; ia++, ic++) {
+            while (a->info->quanta[ia] != c->info->quanta[ic])
+                ia++;
+            S cq = c->info->quanta[ic].get_bra(cdq);
+            S cqprime = c->info->quanta[ic].get_ket();
+            int ibra = rot_bra->info->find_state(cq);
+            int iket = rot_ket->info->find_state(cqprime);
+            GMatrix<FL> ma = (*a)[ia], mc = (*c)[ic];
+            GMatrix<FL> mb = (*rot_bra)[ibra], mk = (*rot_ket)[iket];
+            int io = c_old->info->find_state(c->info->quanta[ic]);
+            const vector<pair<int, FL>> *eb = bra_emb.find(cq),
+                                        *ek = ket_emb.find(cqprime);
+            if (io == -1 || eb == nullptr || ek == nullptr ||
+                (*c_old)[io].m != (MKL_INT)eb->size() ||
+                (*c_old)[io].n != (MKL_INT)ek->size()) {
+                GMatrixFunctions<FL>::rotate(ma, mc, mb, conj_bra, mk,
+                                             conj_ket, scale);
+                continue;
+            }
+            GMatrix<FL> mo = (*c_old)[io];
+            // old index and phase of each new state
+            vector<int> bold(mc.m, -1), kold(mc.n, -1);
+            vector<FL> bph(mc.m), kph(mc.n);
+            for (int x = 0; x < (int)eb->size(); x++)
+                if ((*eb)[x].first != -1) {
+                    bold[(*eb)[x].first] = x;
+                    bph[(*eb)[x].first] = (*eb)[x].second;
+                }
+            for (int y = 0; y < (int)ek->size(); y++)
+                if ((*ek)[y].first != -1) {
+                    kold[(*ek)[y].first] = y;
+                    kph[(*ek)[y].first] = (*ek)[y].second;
+                }
+            vector<int> bnew, knew, kkept;
+            for (MKL_INT p = 0; p < mc.m; p++)
+                if (bold[p] == -1)
+                    bnew.push_back((int)p);
+            for (MKL_INT q = 0; q < mc.n; q++)
+                (kold[q] == -1 ? knew : kkept).push_back((int)q);
+            // kept x kept
+            for (MKL_INT p = 0; p < mc.m; p++)
+                if (bold[p] != -1)
+                    for (int q : kkept)
+                        mc(p, q) += xconj<FL>(bph[p]) * kph[q] *
+                                    mo(bold[p], kold[q]);
+            // all x new
+            if (mc.m != 0 && knew.size() != 0) {
+                GMatrix<FL> xk = gather(mk, knew, wk);
+                wc.assign((size_t)mc.m * knew.size(), 0);
+                GMatrix<FL> xc(wc.data(), mc.m, (MKL_INT)knew.size());
+                GMatrixFunctions<FL>::rotate(ma, xc, mb, conj_bra, xk,
+                                             conj_ket, scale);
+                for (MKL_INT p = 0; p < mc.m; p++)
+                    for (MKL_INT j = 0; j < xc.n; j++)
+                        mc(p, knew[j]) += xc(p, j);
+            }
+            // new x kept
+            if (bnew.size() != 0 && kkept.size() != 0) {
+                GMatrix<FL> xb = gather(mb, bnew, wb);
+                GMatrix<FL> xk = gather(mk, kkept, wk);
+                wc.assign(bnew.size() * kkept.size(), 0);
+                GMatrix<FL> xc(wc.data(), (MKL_INT)bnew.size(),
+                               (MKL_INT)kkept.size());
+                GMatrixFunctions<FL>::rotate(ma, xc, xb, conj_bra, xk,
+                                             conj_ket, scale);
+                for (MKL_INT i = 0; i < xc.m; i++)
+                    for (MKL_INT j = 0; j < xc.n; j++)
+                        mc(bnew[i], kkept[j]) += xc(i, j);
+            }
+        }
+    }
+    // c = rot_bra x [ sum_k conj_k(a_k x b_k) * f_k ] x rot_ket
+    // abinfo is the info of the (unrotated) enlarged operator
+    // the enlarged operator is never stored: each of its blocks is
+    // accumulated in a scratch buffer and rotated immediately
+    // only blocks surviving the rotation are formed
+    virtual void tensor_product_rotate(
+        const vector<tuple<uint8_t, shared_ptr<SparseMatrix<S, FL>>,
+                           shared_ptr<SparseMatrix<S, FL>>, FL>> &terms,
+        const shared_ptr<SparseMatrixInfo<S>> &abinfo,
+        const shared_ptr<SparseMatrix<S, FL>> &c,
+        const shared_ptr<SparseMatrix<S, FL>> &rot_bra,
+        const shared_ptr<SparseMatrix<S, FL>> &rot_ket, bool trans,
+        FL scale = 1.0) const {
+        assert(c->get_type() == SparseMatrixTypes::Normal &&
+               rot_bra->get_type() == SparseMatrixTypes::Normal &&
+               rot_ket->get_type() == SparseMatrixTypes::Normal);
+        scale = scale * xconj<FL>(rot_bra->factor) * rot_ket->factor;
+        assert(c->factor == (FP)1.0);
+        if (abs(scale) < TINY || terms.size() == 0)
+            return;
+        S cdq = c->info->delta_quantum;
+        assert(abinfo->delta_quantum == cdq && abinfo->n >= c->info->n);
+        assert(abinfo->cinfo != nullptr);
+        shared_ptr<typename SparseMatrixInfo<S>::ConnectionInfo> cinfo =
+            abinfo->cinfo;
+        // connections (term, index in cinfo) grouped by enlarged block
+        vector<vector<pair<int, int>>> conns(abinfo->n);
+        vector<FL> tscales(terms.size());
+        for (int k = 0; k < (int)terms.size(); k++) {
+            const uint8_t conj = get<0>(terms[k]);
+            const shared_ptr<SparseMatrix<S, FL>> &a = get<1>(terms[k]);
+            const shared_ptr<SparseMatrix<S, FL>> &b = get<2>(terms[k]);
+            assert(a->get_type() == SparseMatrixTypes::Normal &&
+                   b->get_type() == SparseMatrixTypes::Normal);
+            tscales[k] = get<3>(terms[k]) * a->factor * b->factor;
+            if (abs(tscales[k]) < TINY)
+                continue;
+            S adq = a->info->delta_quantum, bdq = b->info->delta_quantum;
+            S abdq =
+                cdq.combine((conj & 1) ? -adq : adq, (conj & 2) ? bdq : -bdq);
+            int ik =
+                (int)(lower_bound(cinfo->quanta + cinfo->n[conj],
+                                  cinfo->quanta + cinfo->n[conj + 1], abdq) -
+                      cinfo->quanta);
+            assert(ik < cinfo->n[conj + 1]);
+            int ixa = cinfo->idx[ik];
+            int ixb = ik == cinfo->n[4] - 1 ? cinfo->nc : cinfo->idx[ik + 1];
+            for (int il = ixa; il < ixb; il++)
+                conns[cinfo->ic[il]].push_back(make_pair(k, il));
+        }
+        size_t max_size = 0;
+        for (int ic = 0, ix = 0; ic < c->info->n; ix++, ic++) {
+            while (abinfo->quanta[ix] != c->info->quanta[ic])
+                ix++;
+            if (conns[ix].size() != 0)
+                max_size = max(max_size, (size_t)abinfo->n_states_bra[ix] *
+                                             abinfo->n_states_ket[ix]);
+        }
+        if (max_size == 0)
+            return;
+        shared_ptr<VectorAllocator<FP>> d_alloc =
+            make_shared<VectorAllocator<FP>>();
+        GMatrix<FL> scratch(nullptr, (MKL_INT)max_size, 1);
+        scratch.allocate(d_alloc);
+        for (int ic = 0, ix = 0; ic < c->info->n; ix++, ic++) {
+            while (abinfo->quanta[ix] != c->info->quanta[ic])
+                ix++;
+            if (conns[ix].size() == 0)
+                continue;
+            GMatrix<FL> work(scratch.data, (MKL_INT)abinfo->n_states_bra[ix],
+                             (MKL_INT)abinfo->n_states_ket[ix]);
+            work.clear();
+            for (const auto &kl : conns[ix]) {
+                const uint8_t conj = get<0>(terms[kl.first]);
+                const shared_ptr<SparseMatrix<S, FL>> &a =
+                    get<1>(terms[kl.first]);
+                const shared_ptr<SparseMatrix<S, FL>> &b =
+                    get<2>(terms[kl.first]);
+                GMatrixFunctions<FL>::tensor_product(
+                    (*a)[cinfo->ia[kl.second]], conj & 1,
+                    (*b)[cinfo->ib[kl.second]], (conj & 2) >> 1, work,
+                    tscales[kl.first] * (FP)cinfo->factor[kl.second],
+                    cinfo->stride[kl.second]);
+            }
+            S cq = c->info->quanta[ic].get_bra(cdq);
+            S cqprime = c->info->quanta[ic].get_ket();
+            int ibra = rot_bra->info->find_state(cq);
+            int iket = rot_ket->info->find_state(cqprime);
+            GMatrixFunctions<FL>::rotate(work, (*c)[ic], (*rot_bra)[ibra],
+                                         (int)!trans | 2, (*rot_ket)[iket],
+                                         trans, scale);
+        }
+        scratch.deallocate(d_alloc);
+    }
     virtual void
     tensor_product_diagonal(uint8_t conj,
                             const shared_ptr<SparseMatrix<S, FL>> &a,
@@ -617,6 +617,51 @@ template <typename S> struct MPICommunicator : ParallelCommunicator<S> {
         }
         tcomm += _t.get_time();
     }
+    // single MPI_Reduce_scatter when all slices fit in one chunk
+    // otherwise one chunked reduce per owner
+    template <typename FL, typename FP>
+    void reduce_scatter_sum_impl(FL *data, const vector<size_t> &displs,
+                                 MPI_Datatype dtype) {
+        const size_t mult = sizeof(FL) / sizeof(FP);
+        vector<int> counts(size);
+        bool single = true;
+        for (int i = 0; i < size; i++) {
+            const size_t len = (displs[i + 1] - displs[i]) * mult;
+            single = single && len <= chunk_size;
+            counts[i] = (int)min(len, chunk_size);
+        }
+        if (!single) {
+            for (int i = 0; i < size; i++)
+                reduce_sum(data + displs[i], displs[i + 1] - displs[i], i);
+            return;
+        }
+        _t.get_time();
+        int ierr = MPI_Reduce_scatter(MPI_IN_PLACE, (FP *)(data + displs[0]),
+                                      counts.data(), dtype, MPI_SUM, comm);
+        assert(ierr == 0);
+        // MPI_IN_PLACE leaves the owned slice at the start of the buffer
+        memmove(data + displs[rank], data + displs[0],
+                sizeof(FP) * counts[rank]);
+        tcomm += _t.get_time();
+    }
+    void reduce_scatter_sum(double *data,
+                            const vector<size_t> &displs) override {
+        reduce_scatter_sum_impl<double, double>(data, displs, MPI_DOUBLE);
+    }
+    void reduce_scatter_sum(complex<double> *data,
+                            const vector<size_t> &displs) override {
+        reduce_scatter_sum_impl<complex<double>, double>(data, displs,
+                                                         MPI_DOUBLE);
+    }
+    void reduce_scatter_sum(float *data,
+                            const vector<size_t> &displs) override {
+        reduce_scatter_sum_impl<float, float>(data, displs, MPI_FLOAT);
+    }
+    void reduce_scatter_sum(complex<float> *data,
+                            const vector<size_t> &displs) override {
+        reduce_scatter_sum_impl<complex<float>, float>(data, displs,
+                                                       MPI_FLOAT);
+    }
     void ireduce_sum(double *data, size_t len, int owner) override {
         _t.get_time();
         for (size_t offset = 0; offset < len; offset += chunk_size) {
@@ -298,6 +298,26 @@ template <typename S> struct ParallelCommunicator {
     virtual void reduce_sum(uint64_t *data, size_t len, int owner) {
         assert(size == 1);
     }
+    // sum over ranks of slice [displs[i], displs[i + 1]) is left on rank i
+    // other slices of data are undefined after the call
+    virtual void reduce_scatter_sum(double *data, const vector<size_t> &displs) {
+        for (int i = 0; i < size; i++)
+            reduce_sum(data + displs[i], displs[i + 1] - displs[i], i);
+    }
+    virtual void reduce_scatter_sum(complex<double> *data,
+                                    const vector<size_t> &displs) {
+        for (int i = 0; i < size; i++)
+            reduce_sum(data + displs[i], displs[i + 1] - displs[i], i);
+    }
+    virtual void reduce_scatter_sum(float *data, const vector<size_t> &displs) {
+        for (int i = 0; i < size; i++)
+            reduce_sum(data + displs[i], displs[i + 1] - displs[i], i);
+    }
+    virtual void reduce_scatter_sum(complex<float> *data,
+                                    const vector<size_t> &displs) {
+        for (int i = 0; i < size; i++)
+            reduce_sum(data + displs[i], displs[i + 1] - displs[i], i);
+    }
     // do not raise assertion error if not implemented
     // mainly for no communication parallel execution in serial
     virtual void reduce_sum_optional(double *data, size_t len, int owner) {}
@@ -1368,17 +1368,8 @@ struct ParallelTensorFunctions : TensorFunctions<S, FL> {
             vector<shared_ptr<SparseMatrix<S, FL>>> mats(exprs->data.size());
             for (size_t i = 0; i < exprs->data.size(); i++) {
                 shared_ptr<OpExpr<S>> op = abs_value(ab->lmat->data[i]);
-                if (!delayed(
-                        dynamic_pointer_cast<OpElement<S, FL>>(op)->name)) {
-                    if (!frame_<FP>()->use_main_stack) {
-                        // skip cached part
-                        if (ab->ops.at(op)->alloc != nullptr)
-                            continue;
-                        ab->ops.at(op)->alloc =
-                            make_shared<VectorAllocator<FP>>();
-                    }
+                if (!delayed(dynamic_pointer_cast<OpElement<S, FL>>(op)->name))
                     mats[i] = ab->ops.at(op);
-                }
             }
             vector<shared_ptr<OpExpr<S>>> local_exprs;
             auto f =
@@ -1386,12 +1377,6 @@ struct ParallelTensorFunctions : TensorFunctions<S, FL> {
                     local_exprs = exprs;
                 };
             rule->distributed_apply(f, ab->lmat->data, exprs->data, mats);
-            if (frame_<FP>()->use_main_stack)
-                for (size_t i = 0; i < local_exprs.size(); i++)
-                    if (local_exprs[i] != nullptr) {
-                        assert(mats[i]->data == nullptr);
-                        mats[i]->allocate(mats[i]->info);
-                    }
             for (size_t i = 0; i < ab->lmat->data.size(); i++)
                 if (ab->lmat->data[i]->get_type() != OpTypes::Zero) {
                     auto pa = abs_value(ab->lmat->data[i]);
@@ -1422,14 +1407,9 @@ struct ParallelTensorFunctions : TensorFunctions<S, FL> {
                                (no_repeat && !this->rule->repeat(pa)));
                     if (req) {
                         assert(local_exprs[i] != nullptr);
-                        if (!frame_<FP>()->use_main_stack)
-                            mats[i]->allocate(mats[i]->info);
-                        tf->tensor_product(local_exprs[i], a->ops, b->ops,
-                                           mats[i]);
-                        tf->opf->tensor_rotate(mats[i], c->ops.at(pa), mpst_bra,
-                                               mpst_ket, false);
-                        if (!frame_<FP>()->use_main_stack)
-                            mats[i]->deallocate();
+                        tf->tensor_product_rotate(
+                            local_exprs[i], a->ops, b->ops, mats[i],
+                            c->ops.at(pa), mpst_bra, mpst_ket, false);
                     }
                 }
             };
@@ -1458,17 +1438,8 @@ struct ParallelTensorFunctions : TensorFunctions<S, FL> {
             vector<shared_ptr<SparseMatrix<S, FL>>> mats(exprs->data.size());
             for (size_t i = 0; i < exprs->data.size(); i++) {
                 shared_ptr<OpExpr<S>> op = abs_value(ab->rmat->data[i]);
-                if (!delayed(
-                        dynamic_pointer_cast<OpElement<S, FL>>(op)->name)) {
-                    if (!frame_<FP>()->use_main_stack) {
-                        // skip cached part
-                        if (ab->ops.at(op)->alloc != nullptr)
-                            continue;
-                        ab->ops.at(op)->alloc =
-                            make_shared<VectorAllocator<FP>>();
-                    }
+                if (!delayed(dynamic_pointer_cast<OpElement<S, FL>>(op)->name))
                     mats[i] = ab->ops.at(op);
-                }
             }
             vector<shared_ptr<OpExpr<S>>> local_exprs;
             auto f =
@@ -1476,12 +1447,6 @@ struct ParallelTensorFunctions : TensorFunctions<S, FL> {
                     local_exprs = exprs;
                 };
             rule->distributed_apply(f, ab->rmat->data, exprs->data, mats);
-            if (frame_<FP>()->use_main_stack)
-                for (size_t i = 0; i < local_exprs.size(); i++)
-                    if (local_exprs[i] != nullptr) {
-                        assert(mats[i]->data == nullptr);
-                        mats[i]->allocate(mats[i]->info);
-                    }
             for (size_t i = 0; i < ab->rmat->data.size(); i++)
                 if (ab->rmat->data[i]->get_type() != OpTypes::Zero) {
                     auto pa = abs_value(ab->rmat->data[i]);
@@ -1512,14 +1477,9 @@ struct ParallelTensorFunctions : TensorFunctions<S, FL> {
                                (no_repeat && !this->rule->repeat(pa)));
                     if (req) {
                         assert(local_exprs[i] != nullptr);
-                        if (!frame_<FP>()->use_main_stack)
-                            mats[i]->allocate(mats[i]->info);
-                        tf->tensor_product(local_exprs[i], b->ops, a->ops,
-                                           mats[i]);
-                        tf->opf->tensor_rotate(mats[i], c->ops.at(pa), mpst_bra,
-                                               mpst_ket, true);
-                        if (!frame_<FP>()->use_main_stack)
-                            mats[i]->deallocate();
+                        tf->tensor_product_rotate(
+                            local_exprs[i], b->ops, a->ops, mats[i],
+                            c->ops.at(pa), mpst_bra, mpst_ket, true);
                     }
                 }
             };
@@ -26,9 +26,11 @@
 #include "matrix_functions.hpp"
 #include "state_info.hpp"
 #include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <string>
 #include <tuple>
 #include <type_traits>
@@ -43,6 +45,15 @@ namespace block2 {
 
 template <typename, typename = void> struct SparseMatrixInfo;
 
+// Compiled contraction plan: a compact copy of the non-zero-block indices,
+// CG factors and strides of a ConnectionInfo
+struct ConnectionPlan {
+    int n[5], nc;
+    vector<uint32_t> data;
+};
+
+template <typename S> struct ConnectionPlanCache;
+
 // Quantum label information for block-sparse matrix
 template <typename S>
 struct SparseMatrixInfo<
@@ -58,6 +69,16 @@ struct SparseMatrixInfo<
     bool is_wavefunction;
     // Number of non-zero blocks
     int n;
+    // Optional hash index for find_state, kept outside the stack memory
+    // (so that it is never saved with or restored from a stack frame)
+    // nullptr when n <= quanta_index_threshold() or when not yet built
+    shared_ptr<vector<int>> qindex = nullptr;
+    // Number of blocks above which the hash index is built
+    // A negative value disables the index
+    static int &quanta_index_threshold() {
+        static int threshold = 32;
+        return threshold;
+    }
     static bool cmp_op_info(const pair<S, shared_ptr<SparseMatrixInfo>> &p,
                             S q) {
         return p.first < q;
@@ -164,11 +185,19 @@ struct SparseMatrixInfo<
             const vector<pair<S, shared_ptr<SparseMatrixInfo<S>>>> &binfos,
             const shared_ptr<SparseMatrixInfo<S>> &cinfo,
             const shared_ptr<SparseMatrixInfo<S>> &vinfo,
-            const shared_ptr<CG<S>> &cg) {
+            const shared_ptr<CG<S>> &cg,
+            const shared_ptr<ConnectionPlanCache<S>> &plans = nullptr) {
             if (ainfos.size() == 0 || binfos.size() == 0) {
                 n[4] = nc = 0;
                 return;
             }
+            vector<uint32_t> key;
+            if (plans != nullptr) {
+                key = plans->wfn_key(cdq, vdq, opdq, subdq, ainfos, binfos,
+                                     cinfo, vinfo);
+                if (plans->load(key, *this))
+                    return;
+            }
             vector<uint32_t> vidx(subdq.size());
             vector<uint64_t> viv;
             vector<uint32_t> via, vib, vic;
@@ -286,6 +315,8 @@ struct SparseMatrixInfo<
             memcpy(ia, via.data(), nc * sizeof(uint32_t));
             memcpy(ib, vib.data(), nc * sizeof(uint32_t));
             memcpy(ic, vic.data(), nc * sizeof(uint32_t));
+            if (plans != nullptr)
+                plans->store(key, *this);
         }
         // Compute non-zero-block indices for 'tensor_product'
         void initialize_tp(
@@ -298,11 +329,19 @@ struct SparseMatrixInfo<
             const vector<pair<S, shared_ptr<SparseMatrixInfo<S>>>> &ainfos,
             const vector<pair<S, shared_ptr<SparseMatrixInfo<S>>>> &binfos,
             const shared_ptr<SparseMatrixInfo<S>> &cinfo,
-            const shared_ptr<CG<S>> &cg) {
+            const shared_ptr<CG<S>> &cg,
+            const shared_ptr<ConnectionPlanCache<S>> &plans = nullptr) {
             if (ainfos.size() == 0 || binfos.size() == 0) {
                 n[4] = nc = 0;
                 return;
             }
+            vector<uint32_t> key;
+            if (plans != nullptr) {
+                key = plans->tp_key(cdq, subdq, bra, ket, bra_a, bra_b, ket_a,
+                                    ket_b, ainfos, binfos, cinfo);
+                if (plans->load(key, *this))
+                    return;
+            }
             vector<uint32_t> vidx(subdq.size());
             vector<uint64_t> vstride;
             vector<uint32_t> via, vib, vic;
@@ -416,6 +455,39 @@ struct SparseMatrixInfo<
             memcpy(ia, via.data(), nc * sizeof(uint32_t));
             memcpy(ib, vib.data(), nc * sizeof(uint32_t));
             memcpy(ic, vic.data(), nc * sizeof(uint32_t));
+            if (plans != nullptr)
+                plans->store(key, *this);
+        }
+        size_t get_total_memory() const {
+            return n[4] * (sizeof(S) >> 2) + n[4] + (size_t)nc * 7;
+        }
+        void set_pointers(uint32_t *ptr) {
+            quanta = (S *)ptr;
+            idx = ptr + n[4] * (sizeof(S) >> 2);
+            stride = (uint64_t *)(idx + n[4]);
+            factor = (double *)((uint32_t *)stride + nc * 2);
+            ia = (uint32_t *)((uint32_t *)stride + nc * 4), ib = ia + nc,
+            ic = ib + nc;
+        }
+        ConnectionPlan to_plan() const {
+            ConnectionPlan plan;
+            memcpy(plan.n, n, sizeof(n));
+            plan.nc = nc;
+            if (n[4] != 0 || nc != 0)
+                plan.data = vector<uint32_t>((uint32_t *)quanta,
+                                             (uint32_t *)quanta +
+                                                 get_total_memory());
+            return plan;
+        }
+        void from_plan(const ConnectionPlan &plan) {
+            memcpy(n, plan.n, sizeof(n));
+            nc = plan.nc;
+            if (n[4] == 0 && nc == 0)
+                return;
+            assert(plan.data.size() == get_total_memory());
+            uint32_t *ptr = ialloc->allocate(plan.data.size());
+            memcpy(ptr, plan.data.data(), plan.data.size() * sizeof(uint32_t));
+            set_pointers(ptr);
         }
         void reallocate(bool clean) {
             size_t length = n[4] * (sizeof(S) >> 2) + n[4] + nc * 7;
@@ -496,6 +568,7 @@ struct SparseMatrixInfo<
         memcpy(other.quanta, quanta,
                (n * (sizeof(S) >> 2) + n + _DBL_MEM_SIZE(n)) *
                    sizeof(uint32_t));
+        other.build_index();
     }
     void load_data(const string &filename) {
         ifstream ifs(filename.c_str(), ios::binary);
@@ -530,6 +603,10 @@ struct SparseMatrixInfo<
         n_states_bra = (ubond_t *)(ptr + n * (sizeof(S) >> 2));
         n_states_ket = (ubond_t *)(ptr + n * (sizeof(S) >> 2)) + n;
         n_states_total = ptr + n * (sizeof(S) >> 2) + _DBL_MEM_SIZE(n);
+        // the index is not written to files, but rebuilt from quanta
+        // (in both modes, as the stack data may have changed since saving)
+        qindex = nullptr;
+        build_index();
         cinfo = nullptr;
     }
     void save_data(const string &filename) const {
@@ -652,6 +729,7 @@ struct SparseMatrixInfo<
                 n_states_total[i + 1] =
                     n_states_total[i] +
                     (uint32_t)n_states_bra[i] * n_states_ket[i];
+            build_index();
         }
     }
     // Generate SparseMatrixInfo for density matrix
@@ -706,6 +784,7 @@ struct SparseMatrixInfo<
                 n_states_total[i + 1] =
                     n_states_total[i] +
                     (uint32_t)n_states_bra[i] * n_states_ket[i];
+            build_index();
         }
     }
     // Generate SparseMatrixInfo from bra and ket StateInfo and
@@ -744,6 +823,7 @@ struct SparseMatrixInfo<
                 n_states_total[i + 1] =
                     n_states_total[i] +
                     (uint32_t)n_states_bra[i] * n_states_ket[i];
+            build_index();
         }
     }
     // Extract row or column StateInfo from SparseMatrixInfo
@@ -772,12 +852,28 @@ struct SparseMatrixInfo<
         return info;
     }
     int find_state(S q, int start = 0) const {
+        // a probe that does not terminate within the table (-2)
+        // falls back to binary search
+        if (qindex != nullptr &&
+            qindex->size() == QuantaIndex<S>::capacity(n)) {
+            const int p = QuantaIndex<S>::find(qindex->data(), qindex->size(),
+                                               quanta, q);
+            if (p >= start || p == -1)
+                return p;
+        }
         auto p = lower_bound(quanta + start, quanta + n, q);
         if (p == quanta + n || *p != q)
             return -1;
         else
             return (int)(p - quanta);
     }
+    // O(1) lookup using an index built from this SparseMatrixInfo
+    int find_state(S q, const QuantaIndex<S> &idx) const {
+        return idx.find(quanta, q);
+    }
+    QuantaIndex<S> build_quanta_index() const {
+        return QuantaIndex<S>(quanta, n);
+    }
     void sort_states() {
         vector<int> idx(n);
         vector<S> q(quanta, quanta + n);
@@ -796,7 +892,24 @@ struct SparseMatrixInfo<
                 n_states_total[i] + (uint32_t)n_states_bra[i] * n_states_ket[i];
             assert(n_states_total[i + 1] >= n_states_total[i]);
         }
+        build_index();
+    }
+    // Fill the find_state hash index from current quanta
+    // (if n > quanta_index_threshold())
+    // Must be called again if quanta are changed afterwards
+    // The table is refilled in place, so shallow copies sharing the
+    // quanta array also share the updated index
+    void build_index() {
+        if (quanta_index_threshold() < 0 || n <= quanta_index_threshold()) {
+            qindex = nullptr;
+            return;
+        }
+        const size_t cap = QuantaIndex<S>::capacity(n);
+        if (qindex == nullptr || qindex->size() != cap)
+            qindex = make_shared<vector<int>>(cap);
+        QuantaIndex<S>::fill(qindex->data(), cap, quanta, n);
     }
+    bool has_index() const { return qindex != nullptr; }
     uint32_t get_total_memory() const {
         if (n == 0)
             return 0;
@@ -820,6 +933,7 @@ struct SparseMatrixInfo<
         n_states_total =
             ptr + length * (sizeof(S) >> 2) + _DBL_MEM_SIZE(length);
         n = length;
+        qindex = nullptr;
     }
     void deallocate() {
         assert(n != -1);
@@ -831,6 +945,7 @@ struct SparseMatrixInfo<
         n_states_bra = nullptr;
         n_states_ket = nullptr;
         n_states_total = nullptr;
+        qindex = nullptr;
         n = -1;
     }
     void reallocate(int length) {
@@ -852,6 +967,7 @@ struct SparseMatrixInfo<
         n_states_total =
             ptr + length * (sizeof(S) >> 2) + _DBL_MEM_SIZE(length);
         n = length;
+        qindex = nullptr;
     }
     friend ostream &operator<<(ostream &os, const SparseMatrixInfo<S> &c) {
         os << "DQ=" << c.delta_quantum << " N=" << c.n
@@ -864,6 +980,256 @@ struct SparseMatrixInfo<
     }
 };
 
+// Cache of compiled contraction plans for ConnectionInfo, keyed by the
+// quantum number structure of the contraction (not the block data)
+// For fixed site, MPO and bond basis the plans can be reused across Davidson
+// iterations and sweeps, skipping the CG recoupling in
+// initialize_wfn / initialize_tp
+template <typename S> struct ConnectionPlanCache {
+    typedef vector<pair<S, shared_ptr<SparseMatrixInfo<S>>>> OpInfos;
+    unordered_map<size_t, vector<pair<vector<uint32_t>, ConnectionPlan>>>
+        plans;
+    size_t n_hits = 0, n_misses = 0, n_plans = 0;
+    // memory used by keys and plans (in uint32_t)
+    size_t total_size = 0;
+    // no more plans are stored when total_size exceeds this (in uint32_t)
+    size_t max_size = (size_t)1 << 28;
+    ConnectionPlanCache() {}
+    virtual ~ConnectionPlanCache() = default;
+    template <typename T> static void append(vector<uint32_t> &key, T x) {
+        static_assert(sizeof(T) % sizeof(uint32_t) == 0, "");
+        const uint32_t *p = (const uint32_t *)&x;
+        key.insert(key.end(), p, p + sizeof(T) / sizeof(uint32_t));
+    }
+    static void append_quanta(vector<uint32_t> &key, const S *quanta, int n) {
+        key.push_back((uint32_t)n);
+        const uint32_t *p = (const uint32_t *)quanta;
+        key.insert(key.end(), p, p + n * (sizeof(S) >> 2));
+    }
+    static void append_state_info(vector<uint32_t> &key,
+                                  const StateInfo<S> &info) {
+        append_quanta(key, info.quanta, info.n);
+        for (int i = 0; i < info.n; i++)
+            key.push_back((uint32_t)info.n_states[i]);
+    }
+    static void append_op_infos(vector<uint32_t> &key, const OpInfos &infos) {
+        key.push_back((uint32_t)infos.size());
+        for (auto &p : infos) {
+            append(key, p.first);
+            key.push_back((uint32_t)p.second->is_fermion);
+            append_quanta(key, p.second->quanta, p.second->n);
+        }
+    }
+    static void append_subdq(vector<uint32_t> &key,
+                             const vector<pair<uint8_t, S>> &subdq) {
+        key.push_back((uint32_t)subdq.size());
+        for (auto &p : subdq)
+            key.push_back((uint32_t)p.first), append(key, p.second);
+    }
+    // initialize_wfn only depends on the quanta of the infos
+    static vector<uint32_t>
+    wfn_key(S cdq, S vdq, S opdq, const vector<pair<uint8_t, S>> &subdq,
+            const OpInfos &ainfos, const OpInfos &binfos,
+            const shared_ptr<SparseMatrixInfo<S>> &cinfo,
+            const shared_ptr<SparseMatrixInfo<S>> &vinfo) {
+        vector<uint32_t> key;
+        key.push_back(0);
+        append(key, cdq), append(key, vdq), append(key, opdq);
+        append_subdq(key, subdq);
+        append_op_infos(key, ainfos), append_op_infos(key, binfos);
+        append_quanta(key, cinfo->quanta, cinfo->n);
+        append_quanta(key, vinfo->quanta, vinfo->n);
+        return key;
+    }
+    // initialize_tp strides also depend on the bond dimensions
+    static vector<uint32_t>
+    tp_key(S cdq, const vector<pair<uint8_t, S>> &subdq,
+           const StateInfo<S> &bra, const StateInfo<S> &ket,
+           const StateInfo<S> &bra_a, const StateInfo<S> &bra_b,
+           const StateInfo<S> &ket_a, const StateInfo<S> &ket_b,
+           const OpInfos &ainfos, const OpInfos &binfos,
+           const shared_ptr<SparseMatrixInfo<S>> &cinfo) {
+        vector<uint32_t> key;
+        key.push_back(1);
+        append(key, cdq);
+        append_subdq(key, subdq);
+        append_state_info(key, bra), append_state_info(key, ket);
+        append_state_info(key, bra_a), append_state_info(key, bra_b);
+        append_state_info(key, ket_a), append_state_info(key, ket_b);
+        append_op_infos(key, ainfos), append_op_infos(key, binfos);
+        append_quanta(key, cinfo->quanta, cinfo->n);
+        for (int i = 0; i < cinfo->n; i++)
+            key.push_back((uint32_t)cinfo->n_states_ket[i]);
+        return key;
+    }
+    static size_t hash_key(const vector<uint32_t> &key) {
+        size_t h = (size_t)key.size();
+        for (auto &x : key)
+            h ^= (size_t)x + 0x9E3779B9 + (h << 6) + (h >> 2);
+        return h;
+    }
+    // restore a plan into cinfo; returns false if no plan is found
+    bool load(const vector<uint32_t> &key,
+              typename SparseMatrixInfo<S>::ConnectionInfo &cinfo) {
+        const size_t h = hash_key(key);
+        bool found = false;
+#pragma omp critical(connection_plan_cache)
+        {
+            auto it = plans.find(h);
+            if (it != plans.end())
+                for (auto &p : it->second)
+                    if (p.first == key) {
+                        cinfo.from_plan(p.second);
+                        found = true;
+                        break;
+                    }
+            found ? n_hits++ : n_misses++;
+        }
+        return found;
+    }
+    void store(const vector<uint32_t> &key,
+               const typename SparseMatrixInfo<S>::ConnectionInfo &cinfo) {
+        const size_t h = hash_key(key);
+#pragma omp critical(connection_plan_cache)
+        {
+            if (total_size < max_size) {
+                ConnectionPlan plan = cinfo.to_plan();
+                total_size += key.size() + plan.data.size();
+                plans[h].push_back(make_pair(key, plan));
+                n_plans++;
+            }
+        }
+    }
+    void clear() {
+        plans.clear();
+        n_hits = n_misses = n_plans = total_size = 0;
+    }
+    double hit_rate() const {
+        return n_hits + n_misses == 0
+                   ? 0.0
+                   : (double)n_hits / (double)(n_hits + n_misses);
+    }
+    string to_str() const {
+        stringstream ss;
+        ss << "Plans = " << n_plans << " ("
+           << Parsing::to_size_string(total_size * sizeof(uint32_t))
+           << ") | Hits = " << n_hits << " | Misses = " << n_misses
+           << " | Hit rate = " << fixed << setprecision(2)
+           << hit_rate() * 100 << "%";
+        return ss.str();
+    }
+    // plan file format, bumped when the layout below changes
+    static const uint32_t file_version = 1;
+    static const char *file_magic() { return "CPLC"; }
+    // checks the sizes and connection offsets of a plan
+    // (block indices are only known to the infos the plan is used with)
+    static bool is_valid_plan(const ConnectionPlan &plan) {
+        if (plan.nc < 0)
+            return false;
+        for (int i = 0; i < 5; i++)
+            if (plan.n[i] < (i == 0 ? 0 : plan.n[i - 1]))
+                return false;
+        const size_t n4 = (size_t)plan.n[4];
+        if (n4 == 0 && plan.nc == 0)
+            return plan.data.size() == 0;
+        if (plan.data.size() != n4 * (sizeof(S) >> 2) + n4 + (size_t)plan.nc * 7)
+            return false;
+        const uint32_t *idx = plan.data.data() + n4 * (sizeof(S) >> 2);
+        for (size_t k = 0; k < n4; k++)
+            if (idx[k] > (uint32_t)plan.nc || (k != 0 && idx[k] < idx[k - 1]))
+                return false;
+        return true;
+    }
+    void save_data(const string &filename) const {
+        ofstream ofs(filename.c_str(), ios::binary);
+        if (!ofs.good())
+            throw runtime_error("ConnectionPlanCache::save_data on '" +
+                                filename + "' failed.");
+        const uint32_t version = file_version, s_size = (uint32_t)sizeof(S);
+        ofs.write(file_magic(), 4);
+        ofs.write((char *)&version, sizeof(version));
+        ofs.write((char *)&s_size, sizeof(s_size));
+        size_t np = 0;
+        for (auto &r : plans)
+            np += r.second.size();
+        ofs.write((char *)&np, sizeof(np));
+        for (auto &r : plans)
+            for (auto &p : r.second) {
+                size_t lk = p.first.size(), lp = p.second.data.size();
+                ofs.write((char *)&lk, sizeof(lk));
+                ofs.write((char *)p.first.data(), sizeof(uint32_t) * lk);
+                ofs.write((char *)p.second.n, sizeof(p.second.n));
+                ofs.write((char *)&p.second.nc, sizeof(p.second.nc));
+                ofs.write((char *)&lp, sizeof(lp));
+                ofs.write((char *)p.second.data.data(), sizeof(uint32_t) * lp);
+            }
+        if (!ofs.good())
+            throw runtime_error("ConnectionPlanCache::save_data on '" +
+                                filename + "' failed.");
+        ofs.close();
+    }
+    // plans in the file are added to the existing plans
+    // the whole file is checked before any plan is added
+    void load_data(const string &filename) {
+        ifstream ifs(filename.c_str(), ios::binary);
+        if (!ifs.good())
+            throw runtime_error("ConnectionPlanCache::load_data on '" +
+                                filename + "' failed.");
+        ifs.seekg(0, ios::end);
+        const size_t file_size = (size_t)ifs.tellg();
+        ifs.seekg(0, ios::beg);
+        char magic[4] = {0, 0, 0, 0};
+        uint32_t version = 0, s_size = 0;
+        ifs.read(magic, 4);
+        ifs.read((char *)&version, sizeof(version));
+        ifs.read((char *)&s_size, sizeof(s_size));
+        if (ifs.fail() || memcmp(magic, file_magic(), 4) != 0 ||
+            version != file_version || s_size != (uint32_t)sizeof(S))
+            throw runtime_error("ConnectionPlanCache::load_data on '" +
+                                filename +
+                                "' failed: not a plan file of this version "
+                                "and symmetry.");
+        // number of uint32_t left in the file
+        const auto remaining = [&ifs, file_size]() -> size_t {
+            const size_t cur = (size_t)ifs.tellg();
+            return cur > file_size ? 0 : (file_size - cur) / sizeof(uint32_t);
+        };
+        const auto check = [&ifs, &filename](bool ok) {
+            if (!ok || ifs.fail())
+                throw runtime_error("ConnectionPlanCache::load_data on '" +
+                                    filename + "' failed: corrupted plan.");
+        };
+        size_t np = 0;
+        ifs.read((char *)&np, sizeof(np));
+        check(true);
+        vector<pair<vector<uint32_t>, ConnectionPlan>> xplans;
+        for (size_t i = 0; i < np; i++) {
+            size_t lk = 0, lp = 0;
+            vector<uint32_t> key;
+            ConnectionPlan plan;
+            ifs.read((char *)&lk, sizeof(lk));
+            check(lk != 0 && lk <= remaining());
+            key.resize(lk);
+            ifs.read((char *)key.data(), sizeof(uint32_t) * lk);
+            check(key[0] == 0 || key[0] == 1);
+            ifs.read((char *)plan.n, sizeof(plan.n));
+            ifs.read((char *)&plan.nc, sizeof(plan.nc));
+            ifs.read((char *)&lp, sizeof(lp));
+            check(lp <= remaining());
+            plan.data.resize(lp);
+            ifs.read((char *)plan.data.data(), sizeof(uint32_t) * lp);
+            check(is_valid_plan(plan));
+            xplans.push_back(make_pair(move(key), move(plan)));
+        }
+        ifs.close();
+        for (auto &p : xplans) {
+            total_size += p.first.size() + p.second.data.size();
+            plans[hash_key(p.first)].push_back(move(p));
+            n_plans++;
+        }
+    }
+};
+
 enum struct SparseMatrixTypes : uint8_t {
     Normal = 0,
     CSR = 1,
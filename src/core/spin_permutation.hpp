@@ -25,8 +25,10 @@
 #include "clebsch_gordan.hpp"
 #include "matrix_functions.hpp"
 #include "threading.hpp"
+#include "utils.hpp"
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
@@ -1184,6 +1186,126 @@ struct SpinPermPattern {
     }
 };
 
+// Binary I/O and on-disk cache files for spin permutation schemes
+struct SpinPermIO {
+    // increase when the layout of any cached scheme changes
+    static uint32_t cache_version() { return 1; }
+    template <typename T> static void write(ostream &ofs, const T &x) {
+        ofs.write((char *)&x, sizeof(x));
+    }
+    static void write(ostream &ofs, const string &x) {
+        write(ofs, (size_t)x.length());
+        ofs.write(x.data(), x.length());
+    }
+    template <typename A, typename B>
+    static void write(ostream &ofs, const pair<A, B> &x) {
+        write(ofs, x.first), write(ofs, x.second);
+    }
+    template <typename T> static void write(ostream &ofs, const vector<T> &x) {
+        write(ofs, (size_t)x.size());
+        for (auto &xx : x)
+            write(ofs, xx);
+    }
+    template <typename K, typename V>
+    static void write(ostream &ofs, const map<K, V> &x) {
+        write(ofs, (size_t)x.size());
+        for (auto &xx : x)
+            write(ofs, xx.first), write(ofs, xx.second);
+    }
+    template <typename T> static void read(istream &ifs, T &x) {
+        ifs.read((char *)&x, sizeof(x));
+    }
+    static void read(istream &ifs, string &x) {
+        size_t n = 0;
+        read(ifs, n);
+        x.resize(n);
+        ifs.read(&x[0], n);
+    }
+    template <typename A, typename B>
+    static void read(istream &ifs, pair<A, B> &x) {
+        read(ifs, x.first), read(ifs, x.second);
+    }
+    template <typename T> static void read(istream &ifs, vector<T> &x) {
+        size_t n = 0;
+        read(ifs, n);
+        x.resize(n);
+        for (auto &xx : x)
+            read(ifs, xx);
+    }
+    template <typename K, typename V>
+    static void read(istream &ifs, map<K, V> &x) {
+        size_t n = 0;
+        read(ifs, n);
+        x.clear();
+        for (size_t i = 0; i < n; i++) {
+            K k;
+            read(ifs, k);
+            read(ifs, x[k]);
+        }
+    }
+    static string cache_filename(const string &cache_dir, const string &prefix,
+                                 const string &key) {
+        stringstream ss;
+        ss << cache_dir << "/" << prefix << "-" << hex
+           << std::hash<string>{}(key) << ".bin";
+        return ss.str();
+    }
+    // cache file: version, key, payload size, payload
+    // the whole file is read at once and the payload is returned in ss
+    static bool read_cache(const string &filename, const string &key,
+                           stringstream &ss) {
+        if (!Parsing::file_exists(filename))
+            return false;
+        ifstream ifs(filename.c_str(), ios::binary);
+        if (!ifs.good())
+            return false;
+        stringstream fss;
+        fss << ifs.rdbuf();
+        ifs.close();
+        uint32_t version = 0;
+        string xkey;
+        size_t psize = 0;
+        read(fss, version);
+        if (!fss.good() || version != cache_version())
+            return false;
+        read(fss, xkey);
+        if (!fss.good() || xkey != key)
+            return false;
+        read(fss, psize);
+        if (!fss.good() || psize != fss.str().length() - (size_t)fss.tellg())
+            return false;
+        ss.str(fss.str().substr((size_t)fss.tellg()));
+        return true;
+    }
+    // written to a temporary file first so that concurrent jobs
+    // never read a partially written cache
+    static void write_cache(const string &filename, const string &key,
+                            const string &payload) {
+        const string cache_dir = Parsing::get_pathname(filename);
+        if (cache_dir != "" && !Parsing::path_exists(cache_dir))
+            Parsing::mkdir(cache_dir);
+        const string tmp_filename =
+            filename + ".tmp." +
+            to_string(chrono::high_resolution_clock::now()
+                          .time_since_epoch()
+                          .count());
+        ofstream ofs(tmp_filename.c_str(), ios::binary);
+        if (!ofs.good())
+            throw runtime_error("SpinPermIO::write_cache on '" + tmp_filename +
+                                "' failed.");
+        write(ofs, cache_version());
+        write(ofs, key);
+        write(ofs, (size_t)payload.length());
+        ofs.write(payload.data(), payload.length());
+        if (!ofs.good())
+            throw runtime_error("SpinPermIO::write_cache on '" + tmp_filename +
+                                "' failed.");
+        ofs.close();
+        if (!Parsing::rename_file(tmp_filename, filename))
+            Parsing::remove_file(tmp_filename);
+    }
+};
+
 // generate appropriate spin recoupling formulae after reordering
 struct SpinPermScheme {
     vector<vector<uint16_t>> index_patterns;
@@ -1195,7 +1317,18 @@ struct SpinPermScheme {
     SpinPermScheme(string spin_str, bool su2 = true, bool is_fermion = true,
                    bool is_npdm = false, bool is_drt = false,
                    const vector<uint16_t> &mask = vector<uint16_t>(),
-                   int max_n_sites = 0) {
+                   int max_n_sites = 0, const string &cache_dir = "") {
+        string key, filename;
+        if (cache_dir != "") {
+            key = cache_key(spin_str, su2, is_fermion, is_npdm, is_drt, mask,
+                            max_n_sites);
+            filename = SpinPermIO::cache_filename(cache_dir, "spin-perm", key);
+            stringstream ss;
+            if (SpinPermIO::read_cache(filename, key, ss)) {
+                load_data(ss);
+                return;
+            }
+        }
         int nn = SpinPermRecoupling::count_cds(spin_str);
         SpinPermScheme r =
             su2 ? SpinPermScheme::initialize_su2(nn, spin_str, is_npdm, is_drt,
@@ -1207,6 +1340,35 @@ struct SpinPermScheme {
         data = r.data;
         is_su2 = r.is_su2;
         left_vacuum = r.left_vacuum;
+        if (cache_dir != "") {
+            stringstream ss;
+            save_data(ss);
+            SpinPermIO::write_cache(filename, key, ss.str());
+        }
+    }
+    static string cache_key(const string &spin_str, bool su2, bool is_fermion,
+                            bool is_npdm, bool is_drt,
+                            const vector<uint16_t> &mask, int max_n_sites) {
+        stringstream ss;
+        ss << spin_str << "|" << su2 << is_fermion << is_npdm << is_drt << "|";
+        for (auto &m : mask)
+            ss << m << ",";
+        ss << "|" << max_n_sites;
+        return ss.str();
+    }
+    void save_data(ostream &ofs) const {
+        SpinPermIO::write(ofs, index_patterns);
+        SpinPermIO::write(ofs, data);
+        SpinPermIO::write(ofs, mask);
+        SpinPermIO::write(ofs, is_su2);
+        SpinPermIO::write(ofs, left_vacuum);
+    }
+    void load_data(istream &ifs) {
+        SpinPermIO::read(ifs, index_patterns);
+        SpinPermIO::read(ifs, data);
+        SpinPermIO::read(ifs, mask);
+        SpinPermIO::read(ifs, is_su2);
+        SpinPermIO::read(ifs, left_vacuum);
     }
     static SpinPermScheme
     initialize_sz(int nn, const string &spin_str, bool is_fermion = true,
@@ -1860,6 +2022,55 @@ struct NPDMScheme {
                 n_max_ops = max(n_max_ops, (int)perm->index_patterns[i].size());
         initialize();
     }
+    // the cache is keyed by the content of perms
+    NPDMScheme(const vector<shared_ptr<SpinPermScheme>> &perms,
+               const string &cache_dir)
+        : perms(perms) {
+        n_max_ops = 0;
+        for (auto perm : perms)
+            for (int i = 0; i < (int)perm->index_patterns.size(); i++)
+                n_max_ops = max(n_max_ops, (int)perm->index_patterns[i].size());
+        stringstream kss;
+        for (auto perm : perms)
+            perm->save_data(kss);
+        const string key = kss.str();
+        const string filename =
+            SpinPermIO::cache_filename(cache_dir, "npdm-scheme", key);
+        stringstream ss;
+        if (SpinPermIO::read_cache(filename, key, ss))
+            load_data(ss);
+        else {
+            initialize();
+            save_data(ss);
+            SpinPermIO::write_cache(filename, key, ss.str());
+        }
+    }
+    void save_data(ostream &ofs) const {
+        SpinPermIO::write(ofs, left_terms);
+        SpinPermIO::write(ofs, right_terms);
+        SpinPermIO::write(ofs, left_blocking);
+        SpinPermIO::write(ofs, right_blocking);
+        SpinPermIO::write(ofs, middle_perm_patterns);
+        SpinPermIO::write(ofs, middle_terms);
+        SpinPermIO::write(ofs, middle_blocking);
+        SpinPermIO::write(ofs, last_right_terms);
+        SpinPermIO::write(ofs, last_right_blocking);
+        SpinPermIO::write(ofs, last_middle_blocking);
+        SpinPermIO::write(ofs, local_terms);
+    }
+    void load_data(istream &ifs) {
+        SpinPermIO::read(ifs, left_terms);
+        SpinPermIO::read(ifs, right_terms);
+        SpinPermIO::read(ifs, left_blocking);
+        SpinPermIO::read(ifs, right_blocking);
+        SpinPermIO::read(ifs, middle_perm_patterns);
+        SpinPermIO::read(ifs, middle_terms);
+        SpinPermIO::read(ifs, middle_blocking);
+        SpinPermIO::read(ifs, last_right_terms);
+        SpinPermIO::read(ifs, last_right_blocking);
+        SpinPermIO::read(ifs, last_middle_blocking);
+        SpinPermIO::read(ifs, local_terms);
+    }
     void initialize() {
         set<string> locals;
         map<vector<uint16_t>, map<string, int>> left_patterns, right_patterns;
@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include "threading.hpp"
 #include <cstdint>
 #include <fstream>
 #include <iostream>
@@ -27,6 +28,7 @@
 #include <map>
 #include <set>
 #include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 using namespace std;
@@ -52,6 +54,65 @@ typedef int32_t total_bond_t;
 #endif
 #endif
 
+// Open-addressing hash index from quantum numbers to their position in an
+// array of quanta (linear probing, power-of-two capacity)
+// The table stores positions only, so the quanta array must outlive it
+template <typename S> struct QuantaIndex {
+    vector<int> table;
+    int n = 0;
+    QuantaIndex() {}
+    QuantaIndex(const S *quanta, int n) { build(quanta, n); }
+    static size_t hash(S q) {
+        uint64_t h = (uint64_t)q.hash() * 0x9E3779B97F4A7C15ULL;
+        return (size_t)(h ^ (h >> 31));
+    }
+    // number of table slots for n quanta (load factor <= 0.5)
+    static size_t capacity(int n) {
+        size_t cap = 4;
+        while (cap < (size_t)n * 2)
+            cap <<= 1;
+        return cap;
+    }
+    // For duplicated quanta, the first position is kept
+    static void fill(int *table, size_t cap, const S *quanta, int n) {
+        const size_t mask = cap - 1;
+        for (size_t h = 0; h < cap; h++)
+            table[h] = -1;
+        for (int i = 0; i < n; i++) {
+            size_t h = hash(quanta[i]) & mask;
+            while (table[h] != -1 && quanta[table[h]] != quanta[i])
+                h = (h + 1) & mask;
+            if (table[h] == -1)
+                table[h] = i;
+        }
+    }
+    // Returns -1 if not found, or -2 if the probe visits all cap slots
+    // without a match or an empty slot (which can only happen for a table
+    // not filled from the given quanta), so the caller can fall back
+    static int find(const int *table, size_t cap, const S *quanta, S q) {
+        const size_t mask = cap - 1;
+        size_t h = hash(q) & mask;
+        for (size_t k = 0; k < cap; k++, h = (h + 1) & mask)
+            if (table[h] == -1 || quanta[table[h]] == q)
+                return table[h];
+        return -2;
+    }
+    void build(const S *quanta, int n) {
+        table.resize(capacity(n));
+        fill(table.data(), table.size(), quanta, n);
+        this->n = n;
+    }
+    int find(const S *quanta, S q) const {
+        if (table.size() == 0)
+            return -1;
+        const int p = find(table.data(), table.size(), quanta, q);
+        if (p != -2)
+            return p;
+        const S *pq = std::find(quanta, quanta + n, q);
+        return pq == quanta + n ? -1 : (int)(pq - quanta);
+    }
+};
+
 template <typename, typename = void> struct StateInfo;
 
 // A collection of quantum symmetry labels and their quantity
@@ -66,6 +127,9 @@ struct StateInfo<S,
     ubond_t *n_states;
     int n;
     total_bond_t n_states_total;
+    // Number of (a, b) pairs above which tensor_product uses the
+    // hashed and thread-parallel path
+    static const size_t hashed_product_threshold = 1 << 14;
     struct ConnectionInfo {
         vector<uint32_t> acc_n_states;
         vector<pair<uint32_t, uint32_t>> ij_indices;
@@ -202,6 +266,13 @@ struct StateInfo<S,
         else
             return (int)(p - quanta);
     }
+    // O(1) lookup using an index built from this StateInfo
+    int find_state(S q, const QuantaIndex<S> &idx) const {
+        return idx.find(quanta, q);
+    }
+    QuantaIndex<S> build_quanta_index() const {
+        return QuantaIndex<S>(quanta, n);
+    }
     void reduce_n_states(int m) {
         bool can_reduce = true;
         while (can_reduce && n_states_total > m) {
@@ -234,6 +305,41 @@ struct StateInfo<S,
         c.allocate(cref.n);
         memcpy(c.quanta, cref.quanta, c.n * sizeof(S));
         memset(c.n_states, 0, c.n * sizeof(ubond_t));
+        if ((size_t)a.n * b.n > hashed_product_threshold) {
+            const uint64_t mx = (uint64_t)numeric_limits<ubond_t>::max();
+            const QuantaIndex<S> cidx = c.build_quanta_index();
+            vector<uint64_t> cn(c.n, 0);
+            // inside a parallel region of the caller, run serially and
+            // keep the thread settings of the caller
+            const bool para = !threading->in_parallel();
+            int ntg = para ? threading->activate_global() : 1;
+#pragma omp parallel num_threads(ntg)
+            {
+                vector<uint64_t> xn(c.n, 0);
+#pragma omp for schedule(dynamic)
+                for (int i = 0; i < a.n; i++)
+                    for (int j = 0; j < b.n; j++) {
+                        S qc = a.quanta[i] + b.quanta[j];
+                        uint64_t nprod = min(
+                            (uint64_t)a.n_states[i] * (uint64_t)b.n_states[j],
+                            mx);
+                        for (int k = 0; k < qc.count(); k++) {
+                            int ic = c.find_state(qc[k], cidx);
+                            if (ic != -1)
+                                xn[ic] = min(xn[ic] + nprod, mx);
+                        }
+                    }
+#pragma omp critical(state_info_tensor_product)
+                for (int ic = 0; ic < c.n; ic++)
+                    cn[ic] = min(cn[ic] + xn[ic], mx);
+            }
+            if (para)
+                threading->activate_normal();
+            for (int ic = 0; ic < c.n; ic++)
+                c.n_states[ic] = (ubond_t)cn[ic];
+            c.collect();
+            return c;
+        }
         for (int i = 0; i < a.n; i++)
             for (int j = 0; j < b.n; j++) {
                 S qc = a.quanta[i] + b.quanta[j];
@@ -255,6 +361,8 @@ struct StateInfo<S,
     // Resulting state that larger than target will be removed
     static StateInfo tensor_product(const StateInfo &a, const StateInfo &b,
                                     S target) {
+        if ((size_t)a.n * b.n > hashed_product_threshold)
+            return hashed_tensor_product(a, b, target);
         int nc = 0;
         for (int i = 0; i < a.n; i++)
             for (int j = 0; j < b.n; j++)
@@ -277,6 +385,47 @@ struct StateInfo<S,
         c.collect(target);
         return c;
     }
+    // Same as tensor_product(a, b, target), but duplicated quanta are merged
+    // in per-thread hash tables, so that only distinct quanta are sorted
+    static StateInfo hashed_tensor_product(const StateInfo &a,
+                                           const StateInfo &b, S target) {
+        const uint64_t mx = (uint64_t)numeric_limits<ubond_t>::max();
+        unordered_map<S, uint64_t> mp;
+        // inside a parallel region of the caller, run serially and keep
+        // the thread settings of the caller
+        const bool para = !threading->in_parallel();
+        int ntg = para ? threading->activate_global() : 1;
+#pragma omp parallel num_threads(ntg)
+        {
+            unordered_map<S, uint64_t> xmp;
+#pragma omp for schedule(dynamic)
+            for (int i = 0; i < a.n; i++)
+                for (int j = 0; j < b.n; j++) {
+                    S qc = a.quanta[i] + b.quanta[j];
+                    uint64_t nprod = min(
+                        (uint64_t)a.n_states[i] * (uint64_t)b.n_states[j], mx);
+                    for (int k = 0; k < qc.count(); k++)
+                        if (nprod != 0 && !(target < qc[k])) {
+                            uint64_t &x = xmp[qc[k]];
+                            x = min(x + nprod, mx);
+                        }
+                }
+#pragma omp critical(state_info_tensor_product)
+            for (auto &r : xmp) {
+                uint64_t &x = mp[r.first];
+                x = min(x + r.second, mx);
+            }
+        }
+        if (para)
+            threading->activate_normal();
+        StateInfo c;
+        c.allocate((int)mp.size());
+        int ic = 0;
+        for (auto &r : mp)
+            c.quanta[ic] = r.first, c.n_states[ic++] = (ubond_t)r.second;
+        c.sort_states();
+        return c;
+    }
     // Connection info for tensor product c of StateInfo a and b
     // For determining stride in tensor product of two SparseMatrix
     static shared_ptr<typename StateInfo::ConnectionInfo>
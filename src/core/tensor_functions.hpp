@@ -355,6 +355,7 @@ template <typename S, typename FL> struct TensorFunctions {
             });
     }
     // vmat = expr[L part | R part] x cmat (for perturbative noise)
+    // when vidx == -1, target quanta not in vdqs are skipped
     virtual void tensor_product_partial_multiply(
         const shared_ptr<OpExpr<S>> &expr, const shared_ptr<OpExpr<S>> &xexpr,
         const shared_ptr<OperatorTensor<S, FL>> &lopt,
@@ -451,7 +452,9 @@ template <typename S, typename FL> struct TensorFunctions {
                     S vdq = pks[k];
                     int iv = (int)(lower_bound(vdqs.begin(), vdqs.end(), vdq) -
                                    vdqs.begin());
-                    if (tvidx >= 0 && tvidx != iv)
+                    if ((tvidx >= 0 && tvidx != iv) ||
+                        (vidx == -1 &&
+                         (iv == (int)vdqs.size() || vdqs[iv] != vdq)))
                         continue;
                     shared_ptr<SparseMatrix<S, FL>> vmat =
                         vidx == -1 ? (*vmats)[iv] : (*vmats)[vidx++];
@@ -481,7 +484,9 @@ template <typename S, typename FL> struct TensorFunctions {
                     S vdq = pks[k];
                     int iv = (int)(lower_bound(vdqs.begin(), vdqs.end(), vdq) -
                                    vdqs.begin());
-                    if (tvidx >= 0 && tvidx != iv)
+                    if ((tvidx >= 0 && tvidx != iv) ||
+                        (vidx == -1 &&
+                         (iv == (int)vdqs.size() || vdqs[iv] != vdq)))
                         continue;
                     shared_ptr<SparseMatrix<S, FL>> vmat =
                         vidx == -1 ? (*vmats)[iv] : (*vmats)[vidx++];
@@ -562,7 +567,9 @@ template <typename S, typename FL> struct TensorFunctions {
                     int iv =
                         (int)(lower_bound(vdqs.begin(), vdqs.end(), pks[k]) -
                               vdqs.begin());
-                    skip = skip && (tvidx >= 0 && tvidx != iv);
+                    skip = skip && ((tvidx >= 0 && tvidx != iv) ||
+                                    (vidx == -1 && (iv == (int)vdqs.size() ||
+                                                    vdqs[iv] != pks[k])));
                 }
                 if ((dleft || dright) && !skip) {
                     assert(!frame_<FP>()->use_main_stack);
@@ -599,7 +606,9 @@ template <typename S, typename FL> struct TensorFunctions {
                     S vdq = pks[k];
                     int iv = (int)(lower_bound(vdqs.begin(), vdqs.end(), vdq) -
                                    vdqs.begin());
-                    if (tvidx >= 0 && tvidx != iv)
+                    if ((tvidx >= 0 && tvidx != iv) ||
+                        (vidx == -1 &&
+                         (iv == (int)vdqs.size() || vdqs[iv] != vdq)))
                         continue;
                     shared_ptr<SparseMatrix<S, FL>> vmat =
                         vidx == -1 ? (*vmats)[iv] : (*vmats)[vidx++];
@@ -649,7 +658,9 @@ template <typename S, typename FL> struct TensorFunctions {
                     int iv =
                         (int)(lower_bound(vdqs.begin(), vdqs.end(), pks[k]) -
                               vdqs.begin());
-                    skip = skip && (tvidx >= 0 && tvidx != iv);
+                    skip = skip && ((tvidx >= 0 && tvidx != iv) ||
+                                    (vidx == -1 && (iv == (int)vdqs.size() ||
+                                                    vdqs[iv] != pks[k])));
                 }
                 if ((dleft || dright) && !skip) {
                     assert(!frame_<FP>()->use_main_stack);
@@ -687,7 +698,9 @@ template <typename S, typename FL> struct TensorFunctions {
                     S vdq = pks[k];
                     int iv = (int)(lower_bound(vdqs.begin(), vdqs.end(), vdq) -
                                    vdqs.begin());
-                    if (tvidx >= 0 && tvidx != iv)
+                    if ((tvidx >= 0 && tvidx != iv) ||
+                        (vidx == -1 &&
+                         (iv == (int)vdqs.size() || vdqs[iv] != vdq)))
                         continue;
                     shared_ptr<SparseMatrix<S, FL>> vmat =
                         vidx == -1 ? (*vmats)[iv] : (*vmats)[vidx++];
@@ -948,10 +961,14 @@ template <typename S, typename FL> struct TensorFunctions {
         ifs.close();
         return p;
     }
+    // when ranges is not empty, npdm[i] only holds the flat index range
+    // [ranges[i].first, ranges[i].second) and other elements are skipped
     template <typename FLX, typename GT>
     void npdm_sort(const shared_ptr<NPDMScheme> &scheme, const vector<GT> &npdm,
                    const string &filename, int n_sites, int center,
-                   bool compressed, int r_step, int r_init) const {
+                   bool compressed, int r_step, int r_init,
+                   const vector<pair<uint64_t, uint64_t>> &ranges =
+                       vector<pair<uint64_t, uint64_t>>()) const {
         shared_ptr<NPDMCounter> counter =
             make_shared<NPDMCounter>(scheme->n_max_ops, n_sites);
         shared_ptr<GTensor<FL, uint64_t>> p =
@@ -1054,11 +1071,25 @@ template <typename S, typename FL> struct TensorFunctions {
                         }
                         // sorting
                         const uint64_t ip = mshape_presum[is_last][i][jj];
+                        if (ranges.size() == 0) {
+                            for (uint64_t il = 0; il < lcnt; il++)
+                                for (uint64_t ir = 0; ir < rcnt; ir++)
+                                    (*npdm[r.first]
+                                          ->data)[lixx[il] + rixx[ir]] +=
+                                        (FLX)prr.first *
+                                        (FLX)(*p->data)[ip + il * rcnt + ir];
+                            continue;
+                        }
+                        const uint64_t rlo = ranges[r.first].first,
+                                       rhi = ranges[r.first].second;
                         for (uint64_t il = 0; il < lcnt; il++)
-                            for (uint64_t ir = 0; ir < rcnt; ir++)
-                                (*npdm[r.first]->data)[lixx[il] + rixx[ir]] +=
-                                    (FLX)prr.first *
-                                    (FLX)(*p->data)[ip + il * rcnt + ir];
+                            for (uint64_t ir = 0; ir < rcnt; ir++) {
+                                const uint64_t ix = lixx[il] + rixx[ir];
+                                if (ix >= rlo && ix < rhi)
+                                    (*npdm[r.first]->data)[ix - rlo] +=
+                                        (FLX)prr.first *
+                                        (FLX)(*p->data)[ip + il * rcnt + ir];
+                            }
                     }
                 }
             }
@@ -2203,6 +2234,134 @@ template <typename S, typename FL> struct TensorFunctions {
             break;
         }
     }
+    // expand expr into a list of (conj, lmat, rmat, factor) tensor products
+    // summed intermediates are allocated in heap and appended to tmps
+    // return false if any operand is not a normal (dense) sparse matrix
+    bool tensor_product_terms(
+        const shared_ptr<OpExpr<S>> &expr,
+        const unordered_map<shared_ptr<OpExpr<S>>,
+                            shared_ptr<SparseMatrix<S, FL>>> &lop,
+        const unordered_map<shared_ptr<OpExpr<S>>,
+                            shared_ptr<SparseMatrix<S, FL>>> &rop,
+        vector<tuple<uint8_t, shared_ptr<SparseMatrix<S, FL>>,
+                     shared_ptr<SparseMatrix<S, FL>>, FL>> &terms,
+        vector<shared_ptr<SparseMatrix<S, FL>>> &tmps) const {
+        shared_ptr<SparseMatrix<S, FL>> lmat, rmat;
+        uint8_t conj = 0;
+        FL factor = 1.0;
+        switch (expr->get_type()) {
+        case OpTypes::Elem: {
+            shared_ptr<OpElement<S, FL>> op =
+                dynamic_pointer_cast<OpElement<S, FL>>(expr);
+            assert((rop.count(op) != 0) ^ (lop.count(op) != 0));
+            lmat = lop.count(op) != 0 ? lop.at(op)
+                                      : lop.at(make_shared<OpExpr<S>>());
+            rmat = rop.count(op) != 0 ? rop.at(op)
+                                      : rop.at(make_shared<OpExpr<S>>());
+            factor = op->factor;
+        } break;
+        case OpTypes::Prod: {
+            shared_ptr<OpProduct<S, FL>> op =
+                dynamic_pointer_cast<OpProduct<S, FL>>(expr);
+            assert(op->b != nullptr);
+            assert(lop.count(op->a) != 0 && rop.count(op->b) != 0);
+            lmat = lop.at(op->a), rmat = rop.at(op->b);
+            conj = op->conj, factor = op->factor;
+        } break;
+        case OpTypes::SumProd: {
+            shared_ptr<OpSumProd<S, FL>> op =
+                dynamic_pointer_cast<OpSumProd<S, FL>>(expr);
+            assert((op->a == nullptr) ^ (op->b == nullptr));
+            assert(op->ops.size() != 0);
+            shared_ptr<SparseMatrix<S, FL>> tmp;
+            const auto &xop = op->b == nullptr ? rop : lop;
+            if (op->c != nullptr && xop.count(op->c))
+                tmp = xop.at(op->c);
+            else {
+                shared_ptr<OpExpr<S>> opx =
+                    abs_value((shared_ptr<OpExpr<S>>)op->ops[0]);
+                assert(xop.count(opx) != 0);
+                if (xop.at(opx)->get_type() != SparseMatrixTypes::Normal)
+                    return false;
+                tmp = make_shared<SparseMatrix<S, FL>>(
+                    make_shared<VectorAllocator<FP>>());
+                tmp->allocate(xop.at(opx)->info);
+                tmps.push_back(tmp);
+                for (size_t i = 0; i < op->ops.size(); i++)
+                    opf->iadd(
+                        tmp,
+                        xop.at(abs_value((shared_ptr<OpExpr<S>>)op->ops[i])),
+                        op->ops[i]->factor, op->conjs[i]);
+            }
+            lmat = op->b == nullptr ? lop.at(op->a) : tmp;
+            rmat = op->b == nullptr ? tmp : rop.at(op->b);
+            conj = op->conj, factor = op->factor;
+        } break;
+        case OpTypes::Sum: {
+            shared_ptr<OpSum<S, FL>> op =
+                dynamic_pointer_cast<OpSum<S, FL>>(expr);
+            for (auto &x : op->strings)
+                if (x->get_type() == OpTypes::Prod && x->b == nullptr) {
+                    if (!tensor_product_terms(x->get_op(), lop, rop, terms,
+                                              tmps))
+                        return false;
+                } else if (!tensor_product_terms(x, lop, rop, terms, tmps))
+                    return false;
+            return true;
+        }
+        case OpTypes::Zero:
+            return true;
+        default:
+            assert(false);
+            return false;
+        }
+        if (lmat->get_type() != SparseMatrixTypes::Normal ||
+            rmat->get_type() != SparseMatrixTypes::Normal)
+            return false;
+        terms.push_back(make_tuple(conj, lmat, rmat, factor));
+        return true;
+    }
+    // c = mpst_bra x eval(expr) x mpst_ket
+    // mat provides the info of eval(expr). When mat has no data, eval(expr)
+    // is formed block by block in scratch and never stored in full
+    // (falls back to a temporary copy of eval(expr) for sparse operands,
+    // SeqTypes::Simple and SeqTypes::Auto)
+    void tensor_product_rotate(
+        const shared_ptr<OpExpr<S>> &expr,
+        const unordered_map<shared_ptr<OpExpr<S>>,
+                            shared_ptr<SparseMatrix<S, FL>>> &lop,
+        const unordered_map<shared_ptr<OpExpr<S>>,
+                            shared_ptr<SparseMatrix<S, FL>>> &rop,
+        const shared_ptr<SparseMatrix<S, FL>> &mat,
+        const shared_ptr<SparseMatrix<S, FL>> &c,
+        const shared_ptr<SparseMatrix<S, FL>> &mpst_bra,
+        const shared_ptr<SparseMatrix<S, FL>> &mpst_ket, bool trans) const {
+        if (mat->data != nullptr) {
+            // already contracted
+            opf->tensor_rotate(mat, c, mpst_bra, mpst_ket, trans);
+            return;
+        }
+        vector<tuple<uint8_t, shared_ptr<SparseMatrix<S, FL>>,
+                     shared_ptr<SparseMatrix<S, FL>>, FL>>
+            terms;
+        vector<shared_ptr<SparseMatrix<S, FL>>> tmps;
+        if (!(opf->seq->mode & SeqTypes::Simple) &&
+            opf->seq->mode != SeqTypes::Auto &&
+            tensor_product_terms(expr, lop, rop, terms, tmps))
+            opf->tensor_product_rotate(terms, mat->info, c, mpst_bra, mpst_ket,
+                                       trans);
+        else {
+            shared_ptr<SparseMatrix<S, FL>> tmat =
+                make_shared<SparseMatrix<S, FL>>(
+                    make_shared<VectorAllocator<FP>>());
+            tmat->allocate(mat->info);
+            tensor_product(expr, lop, rop, tmat);
+            opf->tensor_rotate(tmat, c, mpst_bra, mpst_ket, trans);
+            tmat->deallocate();
+        }
+        for (auto &tmp : tmps)
+            tmp->deallocate();
+    }
     // mat = eval(expr)
     virtual void tensor_product_stacked(
         const shared_ptr<OpExpr<S>> &expr, const shared_ptr<OpExpr<S>> &xexpr,
@@ -2318,6 +2477,67 @@ template <typename S, typename FL> struct TensorFunctions {
         if (opf->seq->mode == SeqTypes::Auto)
             opf->seq->auto_perform();
     }
+    // c = mpst_bra x a x mpst_ket, reusing c_old rotated by old bases
+    // operators not present (or not dense) in c_old are fully rotated
+    virtual void
+    left_rotate_incremental(const shared_ptr<OperatorTensor<S, FL>> &a,
+                            const shared_ptr<SparseMatrix<S, FL>> &mpst_bra,
+                            const shared_ptr<SparseMatrix<S, FL>> &mpst_ket,
+                            shared_ptr<OperatorTensor<S, FL>> &c,
+                            const shared_ptr<OperatorTensor<S, FL>> &c_old,
+                            const StateEmbedding<S, FL> &bra_emb,
+                            const StateEmbedding<S, FL> &ket_emb) const {
+        rotate_incremental(a, a->lmat, mpst_bra, mpst_ket, c, c_old, bra_emb,
+                           ket_emb, false);
+    }
+    // c = mpst_bra x a x mpst_ket, reusing c_old rotated by old bases
+    virtual void
+    right_rotate_incremental(const shared_ptr<OperatorTensor<S, FL>> &a,
+                             const shared_ptr<SparseMatrix<S, FL>> &mpst_bra,
+                             const shared_ptr<SparseMatrix<S, FL>> &mpst_ket,
+                             shared_ptr<OperatorTensor<S, FL>> &c,
+                             const shared_ptr<OperatorTensor<S, FL>> &c_old,
+                             const StateEmbedding<S, FL> &bra_emb,
+                             const StateEmbedding<S, FL> &ket_emb) const {
+        rotate_incremental(a, a->rmat, mpst_bra, mpst_ket, c, c_old, bra_emb,
+                           ket_emb, true);
+    }
+    void rotate_incremental(const shared_ptr<OperatorTensor<S, FL>> &a,
+                            const shared_ptr<Symbolic<S>> &mat,
+                            const shared_ptr<SparseMatrix<S, FL>> &mpst_bra,
+                            const shared_ptr<SparseMatrix<S, FL>> &mpst_ket,
+                            shared_ptr<OperatorTensor<S, FL>> &c,
+                            const shared_ptr<OperatorTensor<S, FL>> &c_old,
+                            const StateEmbedding<S, FL> &bra_emb,
+                            const StateEmbedding<S, FL> &ket_emb,
+                            bool trans) const {
+        for (auto &p : c->ops)
+            c->ops.at(p.first)->allocate(c->ops.at(p.first)->info);
+        parallel_for(
+            mat->data.size(),
+            [&a, &mat, &c, &c_old, &mpst_bra, &mpst_ket, &bra_emb, &ket_emb,
+             trans](const shared_ptr<TensorFunctions> &tf, size_t i) {
+                if (mat->data[i]->get_type() != OpTypes::Zero) {
+                    auto pa = abs_value(mat->data[i]);
+                    const shared_ptr<SparseMatrix<S, FL>> &xa = a->ops.at(pa);
+                    const shared_ptr<SparseMatrix<S, FL>> &xc = c->ops.at(pa);
+                    auto it = c_old->ops.find(pa);
+                    if (it != c_old->ops.end() &&
+                        it->second->get_type() == SparseMatrixTypes::Normal &&
+                        it->second->data != nullptr &&
+                        xa->get_type() == SparseMatrixTypes::Normal &&
+                        xc->get_type() == SparseMatrixTypes::Normal)
+                        tf->opf->tensor_rotate_incremental(
+                            xa, it->second, xc, mpst_bra, mpst_ket, trans,
+                            bra_emb, ket_emb);
+                    else
+                        tf->opf->tensor_rotate(xa, xc, mpst_bra, mpst_ket,
+                                               trans);
+                }
+            });
+        if (opf->seq->mode == SeqTypes::Auto)
+            opf->seq->auto_perform();
+    }
     virtual void intermediates(const shared_ptr<Symbolic<S>> &names,
                                const shared_ptr<Symbolic<S>> &exprs,
                                const shared_ptr<OperatorTensor<S, FL>> &a,
@@ -2964,12 +3184,13 @@ template <typename S, typename FL> struct TensorFunctions {
                          shared_ptr<OperatorTensor<S, FL>> &c,
                          const shared_ptr<Symbolic<S>> &cexprs = nullptr,
                          OpNamesSet delayed = OpNamesSet()) const {
-        if (frame_<FP>()->use_main_stack)
+        // blocked operators in ab are only formed when a is empty
+        // they are kept in dynamic memory, since the rotation matrices
+        // are loaded in the main stack before ab is formed
+        if (a == nullptr && frame_<FP>()->use_main_stack)
             for (auto &p : ab->ops) {
-                shared_ptr<OpElement<S, FL>> op =
-                    dynamic_pointer_cast<OpElement<S, FL>>(p.first);
-                if (a == nullptr || !delayed(op->name))
-                    ab->ops.at(op)->allocate(ab->ops.at(op)->info);
+                ab->ops.at(p.first)->alloc = make_shared<VectorAllocator<FP>>();
+                ab->ops.at(p.first)->allocate(ab->ops.at(p.first)->info);
             }
         if (a == nullptr) {
             left_assign(b, ab);
@@ -2983,7 +3204,7 @@ template <typename S, typename FL> struct TensorFunctions {
             shared_ptr<Symbolic<S>> exprs =
                 cexprs == nullptr ? a->lmat * b->lmat : cexprs;
             assert(exprs->data.size() == ab->lmat->data.size());
-            // because of deallocation of the ab, we cannot use auto
+            // blocks of ab are rotated as soon as formed, we cannot use auto
             assert(opf->seq->mode != SeqTypes::Auto);
             parallel_for(
                 exprs->data.size(),
@@ -2995,22 +3216,10 @@ template <typename S, typename FL> struct TensorFunctions {
                     shared_ptr<OpExpr<S>> op = abs_value(ab->lmat->data[i]);
                     shared_ptr<OpExpr<S>> expr =
                         exprs->data[i] * ((FP)1.0 / cop->factor);
-                    if (!delayed(cop->name)) {
-                        if (!frame_<FP>()->use_main_stack) {
-                            // skip cached part
-                            if (ab->ops.at(op)->alloc != nullptr)
-                                return;
-                            ab->ops.at(op)->alloc =
-                                make_shared<VectorAllocator<FP>>();
-                            ab->ops.at(op)->allocate(ab->ops.at(op)->info);
-                        }
-                        tf->tensor_product(expr, a->ops, b->ops,
-                                           ab->ops.at(op));
-                        tf->opf->tensor_rotate(ab->ops.at(op), c->ops.at(op),
-                                               mpst_bra, mpst_ket, false);
-                        if (!frame_<FP>()->use_main_stack)
-                            ab->ops.at(op)->deallocate();
-                    }
+                    if (!delayed(cop->name))
+                        tf->tensor_product_rotate(expr, a->ops, b->ops,
+                                                  ab->ops.at(op), c->ops.at(op),
+                                                  mpst_bra, mpst_ket, false);
                 });
         }
     }
@@ -3026,12 +3235,13 @@ template <typename S, typename FL> struct TensorFunctions {
                           shared_ptr<OperatorTensor<S, FL>> &c,
                           const shared_ptr<Symbolic<S>> &cexprs = nullptr,
                           OpNamesSet delayed = OpNamesSet()) const {
-        if (frame_<FP>()->use_main_stack)
+        // blocked operators in ab are only formed when a is empty
+        // they are kept in dynamic memory, since the rotation matrices
+        // are loaded in the main stack before ab is formed
+        if (a == nullptr && frame_<FP>()->use_main_stack)
             for (auto &p : ab->ops) {
-                shared_ptr<OpElement<S, FL>> op =
-                    dynamic_pointer_cast<OpElement<S, FL>>(p.first);
-                if (a == nullptr || !delayed(op->name))
-                    ab->ops.at(op)->allocate(ab->ops.at(op)->info);
+                ab->ops.at(p.first)->alloc = make_shared<VectorAllocator<FP>>();
+                ab->ops.at(p.first)->allocate(ab->ops.at(p.first)->info);
             }
         if (a == nullptr) {
             right_assign(b, ab);
@@ -3045,7 +3255,7 @@ template <typename S, typename FL> struct TensorFunctions {
             shared_ptr<Symbolic<S>> exprs =
                 cexprs == nullptr ? b->rmat * a->rmat : cexprs;
             assert(exprs->data.size() == ab->rmat->data.size());
-            // because of deallocation of the ab, we cannot use auto
+            // blocks of ab are rotated as soon as formed, we cannot use auto
             assert(opf->seq->mode != SeqTypes::Auto);
             parallel_for(
                 exprs->data.size(),
@@ -3057,22 +3267,10 @@ template <typename S, typename FL> struct TensorFunctions {
                     shared_ptr<OpExpr<S>> op = abs_value(ab->rmat->data[i]);
                     shared_ptr<OpExpr<S>> expr =
                         exprs->data[i] * ((FP)1.0 / cop->factor);
-                    if (!delayed(cop->name)) {
-                        if (!frame_<FP>()->use_main_stack) {
-                            // skip cached part
-                            if (ab->ops.at(op)->alloc != nullptr)
-                                return;
-                            ab->ops.at(op)->alloc =
-                                make_shared<VectorAllocator<FP>>();
-                            ab->ops.at(op)->allocate(ab->ops.at(op)->info);
-                        }
-                        tf->tensor_product(expr, b->ops, a->ops,
-                                           ab->ops.at(op));
-                        tf->opf->tensor_rotate(ab->ops.at(op), c->ops.at(op),
-                                               mpst_bra, mpst_ket, true);
-                        if (!frame_<FP>()->use_main_stack)
-                            ab->ops.at(op)->deallocate();
-                    }
+                    if (!delayed(cop->name))
+                        tf->tensor_product_rotate(expr, b->ops, a->ops,
+                                                  ab->ops.at(op), c->ops.at(op),
+                                                  mpst_bra, mpst_ket, true);
                 });
         }
     }
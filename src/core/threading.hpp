@@ -271,6 +271,14 @@ struct Threading {
         return omp_get_thread_num();
 #else
         return 0;
+#endif
+    }
+    /** Whether called from inside an active openMP parallel region. */
+    bool in_parallel() const {
+#ifdef _OPENMP
+        return omp_in_parallel() != 0;
+#else
+        return false;
 #endif
     }
     /** Set number of threads for a general task.
@@ -222,6 +222,35 @@ struct RandomMT {
     }
 };
 
+// Counter-based random number generator
+// the i-th number of a stream only depends on (seed, stream, i)
+// so that results can be reproduced independent of thread partitioning
+struct RandomCB {
+    uint64_t key, counter;
+    RandomCB(uint64_t seed = 0, uint64_t stream = 0)
+        : key(mix(mix(seed) + stream)), counter(0) {}
+    // splitmix64 finalizer
+    static uint64_t mix(uint64_t z) {
+        z += 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+    // jump to the i-th number of the stream
+    void seek(uint64_t i) { counter = i; }
+    uint64_t rand_uint64() { return mix(key ^ mix(counter++)); }
+    // return a double in [a, b)
+    double rand_double(double a = 0, double b = 1) {
+        assert(b > a);
+        return a + (b - a) * ((double)(rand_uint64() >> 11) *
+                              (1.0 / 9007199254740992.0));
+    }
+    template <typename FL> void fill(FL *data, size_t n, FL a = 0, FL b = 1) {
+        for (size_t i = 0; i < n; i++)
+            data[i] = (FL)rand_double(a, b);
+    }
+};
+
 // Random number generator
 struct Random {
     static mt19937 &rng() {
@@ -162,6 +162,177 @@ struct TRIE {
                 rpop[k] += pop[itg][k];
         return rpop;
     }
+    // Breadth-first (level-synchronous) traverse of trie for overlap with MPS
+    // pinfos[d + 1][j] : shape of partial contraction ending with digit j
+    // blocks[d][j] : MPS blocks connected to digit j at site d
+    // All nodes at the same depth sharing the last digit have the same shape,
+    // so their partial contractions are stored as rows of one dense matrix
+    // and each MPS block is applied to (at most batch) rows by one GEMM.
+    // Nodes with norm of partial contraction < cutoff are not expanded.
+    // If ref is given, nodes with more than max_rank holes or particles
+    // relative to ref are not expanded.
+    template <typename S>
+    void evaluate_level_sync(
+        const vector<vector<shared_ptr<SparseMatrixInfo<S>>>> &pinfos,
+        const vector<vector<vector<pair<pair<S, S>, shared_ptr<GTensor<FL>>>>>>
+            &blocks,
+        FP cutoff, int max_rank, const vector<uint8_t> &ref, int batch) {
+        assert(batch > 0 && (int)blocks.size() == n_sites);
+        bool has_dets = dets.size() != 0;
+        // create all children of a node (when dets are not given)
+        auto expand_node = [this](IT cur, int nj) {
+            for (int jj = 0; jj < nj; jj++)
+                if (data[cur][jj] == 0) {
+                    assert(data.size() <= (size_t)numeric_limits<IT>::max());
+                    data[cur][jj] = (IT)data.size();
+                    data.push_back(array<IT, L>());
+                    if (enable_look_up)
+                        invs.resize(data.size()), invs.back() = cur;
+                }
+        };
+        if (!has_dets) {
+            if (enable_look_up)
+                invs.resize(data.size());
+            expand_node(0, (int)blocks[0].size());
+        }
+        // frontier: nodes, (holes, particles), partial contractions
+        // grouped by last digit
+        vector<vector<IT>> fnodes(1, vector<IT>{0}), nnodes;
+        vector<vector<array<int, 2>>> franks(1, vector<array<int, 2>>(1)),
+            nranks;
+        vector<vector<FL>> fmats(1), nmats;
+        vector<shared_ptr<SparseMatrixInfo<S>>> finfos(1, pinfos[0][0]);
+        fmats[0].resize(pinfos[0][0]->get_total_memory(), (FL)(FP)1.0);
+        int ntg = threading->activate_global();
+        vector<vector<FL>> scratch(ntg);
+        // (group, digit, row start, row end, output row start)
+        vector<array<size_t, 5>> tasks;
+        vector<vector<size_t>> rows;
+        vector<uint8_t> keep;
+        for (int d = 0; d < n_sites; d++) {
+            check_signal_()();
+            const int nj = (int)blocks[d].size(), ng = (int)fnodes.size();
+            nnodes.resize(nj), nranks.resize(nj), nmats.resize(nj);
+            rows.resize((size_t)ng * nj);
+            tasks.clear();
+            // determine the connected (parent row, digit) pairs
+            for (int j = 0; j < nj; j++) {
+                nnodes[j].clear(), nranks[j].clear();
+                const size_t tmj = pinfos[d + 1][j]->get_total_memory();
+                for (int g = 0; g < ng; g++) {
+                    vector<size_t> &r = rows[(size_t)g * nj + j];
+                    r.clear();
+                    if (tmj == 0)
+                        continue;
+                    for (size_t ir = 0; ir < fnodes[g].size(); ir++) {
+                        const IT cur = fnodes[g][ir];
+                        if (data[cur][j] == 0)
+                            continue;
+                        if (ref.size() != 0 && (franks[g][ir][0] > max_rank ||
+                                                franks[g][ir][1] > max_rank))
+                            continue;
+                        array<int, 2> rk = franks[g][ir];
+                        if (ref.size() != 0) {
+                            rk[0] += __builtin_popcount(ref[d] & ~j);
+                            rk[1] += __builtin_popcount(j & ~ref[d]);
+                        }
+                        r.push_back(ir);
+                        nnodes[j].push_back(data[cur][j]);
+                        nranks[j].push_back(rk);
+                    }
+                    for (size_t ir = 0; ir < r.size(); ir += batch)
+                        tasks.push_back(array<size_t, 5>{
+                            (size_t)g, (size_t)j, ir,
+                            min(r.size(), ir + (size_t)batch),
+                            nnodes[j].size() - r.size() + ir});
+                }
+                nmats[j].assign(tmj * nnodes[j].size(), (FL)0.0);
+            }
+            // batched contraction
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+            for (size_t it = 0; it < tasks.size(); it++) {
+                const int tid = threading->get_thread_id();
+                const size_t g = tasks[it][0], j = tasks[it][1];
+                const vector<size_t> &r = rows[g * nj + j];
+                const size_t ir0 = tasks[it][2], ir1 = tasks[it][3];
+                const shared_ptr<SparseMatrixInfo<S>> &pinfo = finfos[g];
+                const shared_ptr<SparseMatrixInfo<S>> &cinfo = pinfos[d + 1][j];
+                const MKL_INT tmg = (MKL_INT)pinfo->get_total_memory();
+                const MKL_INT tmj = (MKL_INT)cinfo->get_total_memory();
+                const MKL_INT nr = (MKL_INT)(ir1 - ir0);
+                const FL *pa = fmats[g].data() + r[ir0] * tmg;
+                // gather parent rows if they are not contiguous
+                if (r[ir1 - 1] - r[ir0] + 1 != (size_t)nr) {
+                    vector<FL> &sc = scratch[tid];
+                    sc.resize((size_t)nr * tmg);
+                    for (size_t ir = ir0; ir < ir1; ir++)
+                        memcpy(sc.data() + (ir - ir0) * tmg,
+                               fmats[g].data() + r[ir] * tmg, sizeof(FL) * tmg);
+                    pa = sc.data();
+                }
+                FL *pc = nmats[j].data() + tasks[it][4] * tmj;
+                const FL one = 1.0;
+                for (auto &m : blocks[d][j]) {
+                    int ib = pinfo->find_state(m.first.first);
+                    int ik = cinfo->find_state(m.first.second);
+                    if (ib == -1 || ik == -1)
+                        continue;
+                    assert(m.second->shape[1] == 1);
+                    MKL_INT kb = (MKL_INT)m.second->shape[0];
+                    MKL_INT nk = (MKL_INT)m.second->shape[2];
+                    assert(kb == pinfo->n_states_ket[ib] &&
+                           nk == cinfo->n_states_ket[ik]);
+                    xgemm<FL>("n", "n", &nk, &nr, &kb, &one,
+                              m.second->data->data(), &nk,
+                              pa + pinfo->n_states_total[ib], &tmg, &one,
+                              pc + cinfo->n_states_total[ik], &tmj);
+                }
+            }
+            // screen and compress the new frontier
+            for (int j = 0; j < nj; j++) {
+                const size_t tmj = pinfos[d + 1][j]->get_total_memory();
+                const size_t nr = nnodes[j].size();
+                keep.resize(nr);
+#pragma omp parallel for schedule(static) num_threads(ntg)
+                for (size_t ir = 0; ir < nr; ir++)
+                    keep[ir] = cutoff == 0 ||
+                               GMatrixFunctions<FL>::norm(GMatrix<FL>(
+                                   nmats[j].data() + ir * tmj, 1,
+                                   (MKL_INT)tmj)) >= cutoff;
+                size_t nk = 0;
+                for (size_t ir = 0; ir < nr; ir++)
+                    if (keep[ir]) {
+                        if (nk != ir) {
+                            nnodes[j][nk] = nnodes[j][ir];
+                            nranks[j][nk] = nranks[j][ir];
+                            memmove(nmats[j].data() + nk * tmj,
+                                    nmats[j].data() + ir * tmj,
+                                    sizeof(FL) * tmj);
+                        }
+                        nk++;
+                    }
+                nnodes[j].resize(nk), nranks[j].resize(nk);
+                nmats[j].resize(nk * tmj);
+                if (d == n_sites - 1) {
+                    assert(nk == 0 || tmj == 1);
+                    for (size_t ir = 0; ir < nk; ir++)
+                        if (!has_dets) {
+                            dets.push_back(nnodes[j][ir]);
+                            vals.push_back(nmats[j][ir]);
+                        } else
+                            vals[lower_bound(dets.begin(), dets.end(),
+                                             nnodes[j][ir]) -
+                                 dets.begin()] = nmats[j][ir];
+                } else if (!has_dets)
+                    for (size_t ir = 0; ir < nk; ir++)
+                        expand_node(nnodes[j][ir], (int)blocks[d + 1].size());
+            }
+            fnodes.swap(nnodes), franks.swap(nranks), fmats.swap(nmats);
+            finfos = pinfos[d + 1];
+        }
+        threading->activate_normal();
+        sort_dets();
+    }
 };
 
 template <typename, typename, typename = void> struct DeterminantTRIE;
@@ -318,8 +489,10 @@ struct DeterminantTRIE<S, FL, typename S::is_sz_t>
         return r;
     }
     // set the value for each determinant to the overlap between mps
+    // batch > 0 : use breadth-first traverse with at most batch nodes per GEMM
     void evaluate(const shared_ptr<UnfusedMPS<S, FL>> &mps, FP cutoff = 0,
-                  int max_rank = -1, const vector<uint8_t> &ref = {}) {
+                  int max_rank = -1, const vector<uint8_t> &ref = {},
+                  int batch = 0) {
         assert(ref.size() == n_sites || ref.size() == 0);
         if (max_rank < 0)
             max_rank = mps->info->target.n();
@@ -364,6 +537,18 @@ struct DeterminantTRIE<S, FL, typename S::is_sz_t>
                                              false);
             }
         }
+        if (batch > 0) {
+            vector<vector<vector<pair<pair<S, S>, shared_ptr<GTensor<FL>>>>>>
+                blocks(n_sites);
+            for (int d = 0; d < n_sites; d++) {
+                blocks[d].resize(pinfos[d + 1].size());
+                for (int j = 0; j < (int)blocks[d].size(); j++)
+                    blocks[d][j] = mps->tensors[d]->data[j];
+            }
+            this->evaluate_level_sync(pinfos, blocks, cutoff, max_rank, ref,
+                                      batch);
+            return;
+        }
         if (!has_dets) {
             for (uint8_t j = 0; j < (uint8_t)data[0].size(); j++)
                 if (data[0][j] == 0) {
@@ -699,8 +884,10 @@ struct DeterminantTRIE<S, FL, typename S::is_su2_t>
         return r;
     }
     // set the value for each CSF to the overlap between mps
+    // batch > 0 : use breadth-first traverse with at most batch nodes per GEMM
     void evaluate(const shared_ptr<UnfusedMPS<S, FL>> &mps, FP cutoff = 0,
-                  int max_rank = -1, const vector<uint8_t> &ref = {}) {
+                  int max_rank = -1, const vector<uint8_t> &ref = {},
+                  int batch = 0) {
         if (max_rank < 0)
             max_rank = mps->info->target.n();
         vals.resize(dets.size());
@@ -747,6 +934,27 @@ struct DeterminantTRIE<S, FL, typename S::is_su2_t>
                                              false);
             }
         }
+        if (batch > 0) {
+            vector<vector<vector<pair<pair<S, S>, shared_ptr<GTensor<FL>>>>>>
+                blocks(n_sites);
+            for (int d = 0; d < n_sites; d++) {
+                blocks[d].resize(pinfos[d + 1].size());
+                for (int j = 0; j < (int)blocks[d].size(); j++) {
+                    int jd = j >= 2 ? j - 1 : j;
+                    for (auto &m : mps->tensors[d]->data[jd]) {
+                        S bra = m.first.first, ket = m.first.second;
+                        if (jd == 1 &&
+                            !((j == 1 && ket.twos() > bra.twos()) ||
+                              (j == 2 && ket.twos() < bra.twos())))
+                            continue;
+                        blocks[d][j].push_back(m);
+                    }
+                }
+            }
+            this->evaluate_level_sync(pinfos, blocks, cutoff, max_rank,
+                                      vector<uint8_t>(), batch);
+            return;
+        }
         if (!has_dets) {
             for (uint8_t j = 0; j < (uint8_t)data[0].size(); j++)
                 if (data[0][j] == 0) {
@@ -1011,8 +1219,10 @@ struct DeterminantTRIE<S, FL, typename S::is_sg_t>
         return r;
     }
     // set the value for each CSF to the overlap between mps
+    // batch > 0 : use breadth-first traverse with at most batch nodes per GEMM
     void evaluate(const shared_ptr<UnfusedMPS<S, FL>> &mps, FP cutoff = 0,
-                  int max_rank = -1, const vector<uint8_t> &ref = {}) {
+                  int max_rank = -1, const vector<uint8_t> &ref = {},
+                  int batch = 0) {
         assert(ref.size() == n_sites || ref.size() == 0);
         if (max_rank < 0)
             max_rank = mps->info->target.n();
@@ -1056,6 +1266,18 @@ struct DeterminantTRIE<S, FL, typename S::is_sg_t>
                                              false);
             }
         }
+        if (batch > 0) {
+            vector<vector<vector<pair<pair<S, S>, shared_ptr<GTensor<FL>>>>>>
+                blocks(n_sites);
+            for (int d = 0; d < n_sites; d++) {
+                blocks[d].resize(pinfos[d + 1].size());
+                for (int j = 0; j < (int)blocks[d].size(); j++)
+                    blocks[d][j] = mps->tensors[d]->data[j];
+            }
+            this->evaluate_level_sync(pinfos, blocks, cutoff, max_rank, ref,
+                                      batch);
+            return;
+        }
         if (!has_dets) {
             for (uint8_t j = 0; j < (uint8_t)data[0].size(); j++)
                 if (data[0][j] == 0) {
@@ -1370,8 +1592,10 @@ struct DeterminantTRIE<S, FL, typename S::is_sany_t>
         return r;
     }
     // set the value for each DET to the overlap between mps
+    // batch > 0 : use breadth-first traverse with at most batch nodes per GEMM
     void evaluate(const shared_ptr<UnfusedMPS<S, FL>> &mps, FP cutoff = 0,
-                  int max_rank = -1, const vector<uint8_t> &ref = {}) {
+                  int max_rank = -1, const vector<uint8_t> &ref = {},
+                  int batch = 0) {
         assert(max_rank == -1);
         vals.resize(dets.size());
         memset(vals.data(), 0, sizeof(FL) * vals.size());
@@ -1428,6 +1652,39 @@ struct DeterminantTRIE<S, FL, typename S::is_sany_t>
                                              false);
             }
         }
+        if (batch > 0) {
+            vector<vector<vector<pair<pair<S, S>, shared_ptr<GTensor<FL>>>>>>
+                blocks(n_sites);
+            for (int d = 0; d < n_sites; d++) {
+                blocks[d].resize(pinfos[d + 1].size());
+                for (int j = 0; j < (int)blocks[d].size(); j++) {
+                    int jd = basis_iqs[d][j][0];
+                    for (auto &m : mps->tensors[d]->data[jd]) {
+                        S bra = m.first.first, ket = m.first.second;
+                        S jket = bra + mps->info->basis[d]->quanta[jd];
+                        if (basis_iqs[d][j][1] >= jket.count() ||
+                            jket[basis_iqs[d][j][1]] != ket)
+                            continue;
+                        // extract the slice for this basis state
+                        MKL_INT nl = m.second->shape[0];
+                        MKL_INT nr = m.second->shape[2];
+                        shared_ptr<GTensor<FL>> gt =
+                            make_shared<GTensor<FL>>(nl, 1, nr);
+                        for (MKL_INT il = 0; il < nl; il++)
+                            memcpy(gt->data->data() + il * nr,
+                                   m.second->data->data() +
+                                       (il * m.second->shape[1] +
+                                        basis_iqs[d][j][2]) *
+                                           nr,
+                                   sizeof(FL) * nr);
+                        blocks[d][j].push_back(make_pair(m.first, gt));
+                    }
+                }
+            }
+            this->evaluate_level_sync(pinfos, blocks, cutoff, max_rank,
+                                      vector<uint8_t>(), batch);
+            return;
+        }
         if (!has_dets) {
             for (uint8_t j = 0; j < (uint8_t)basis_iqs[0].size(); j++)
                 if (data[0][j] == 0) {
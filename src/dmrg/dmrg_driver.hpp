@@ -524,6 +524,62 @@ template <typename S, typename FL> struct DMRGDriver {
              int iprint = 0, FP cutoff = (FP)1E-24,
              bool fused_contraction_rotation = true, int max_bond_dim = -1,
              const vector<uint16_t> &mask = vector<uint16_t>()) const {
+        vector<shared_ptr<GTensor<FL>>> npdms =
+            npdm_expect(exprs, ket, bra, site_type, algo_type, iprint, cutoff,
+                        fused_contraction_rotation, max_bond_dim, mask)
+                ->get_npdm();
+        if (prule != nullptr)
+            prule->comm->barrier();
+        vector<FL> factors = npdm_factors(exprs);
+        for (size_t i = 0; i < exprs.size(); i++)
+            if (factors[i] != (FL)1.0)
+                for (size_t j = 0; j < npdms[i]->size(); j++)
+                    (*npdms[i]->data)[j] *= factors[i];
+        return npdms;
+    }
+    // same as get_npdm, but each rank of prule only keeps a slice of
+    // every NPDM tensor (see NPDMShard)
+    vector<shared_ptr<NPDMShard<S, FL>>>
+    get_npdm_shards(const vector<string> &exprs, shared_ptr<MPS<S, FL>> ket,
+                    shared_ptr<MPS<S, FL>> bra, int site_type = 0,
+                    ExpectationAlgorithmTypes algo_type =
+                        ExpectationAlgorithmTypes::SymbolFree |
+                        ExpectationAlgorithmTypes::Compressed,
+                    int iprint = 0, FP cutoff = (FP)1E-24,
+                    bool fused_contraction_rotation = true,
+                    int max_bond_dim = -1,
+                    const vector<uint16_t> &mask = vector<uint16_t>()) const {
+        vector<shared_ptr<NPDMShard<S, FL>>> npdms =
+            npdm_expect(exprs, ket, bra, site_type, algo_type, iprint, cutoff,
+                        fused_contraction_rotation, max_bond_dim, mask)
+                ->get_npdm_shards();
+        if (prule != nullptr)
+            prule->comm->barrier();
+        vector<FL> factors = npdm_factors(exprs);
+        for (size_t i = 0; i < exprs.size(); i++)
+            if (factors[i] != (FL)1.0)
+                for (size_t j = 0; j < npdms[i]->size(); j++)
+                    (*npdms[i]->data->data)[j] *= factors[i];
+        return npdms;
+    }
+    // normalization of SU2 NPDM elements
+    static vector<FL> npdm_factors(const vector<string> &exprs) {
+        vector<FL> factors(exprs.size(), (FL)1.0);
+        if (is_same<S, SU2>::value)
+            for (size_t i = 0; i < exprs.size(); i++) {
+                int n_cds = SpinPermRecoupling::count_cds(exprs[i]);
+                for (int j = 0; j < n_cds; j++)
+                    factors[i] *= (FL)sqrt(sqrt((FL)2.0));
+            }
+        return factors;
+    }
+    // sweep over the NPDM MPO, leaving the fragments on disk
+    shared_ptr<Expect<S, FL, FL, FL>>
+    npdm_expect(const vector<string> &exprs, shared_ptr<MPS<S, FL>> ket,
+                shared_ptr<MPS<S, FL>> bra, int site_type,
+                ExpectationAlgorithmTypes algo_type, int iprint, FP cutoff,
+                bool fused_contraction_rotation, int max_bond_dim,
+                const vector<uint16_t> &mask) const {
         if (prule != nullptr)
             prule->comm->barrier();
         shared_ptr<MPS<S, FL>> mket = ket->deep_copy("PDM-KET@TMP"), mbra;
@@ -647,22 +703,7 @@ template <typename S, typename FL> struct DMRGDriver {
         if (clean_scratch)
             pme->remove_partition_files();
 
-        vector<shared_ptr<GTensor<FL>>> npdms = dx->get_npdm();
-
-        if (prule != nullptr)
-            prule->comm->barrier();
-
-        if (is_same<S, SU2>::value)
-            for (size_t i = 0; i < exprs.size(); i++) {
-                int n_cds = SpinPermRecoupling::count_cds(exprs[i]);
-                FL factor = (FL)1.0;
-                for (int j = 0; j < n_cds; j++)
-                    factor *= (FL)sqrt(sqrt((FL)2.0));
-                for (size_t j = 0; j < npdms[i]->size(); j++)
-                    (*npdms[i]->data)[j] *= factor;
-            }
-
-        return npdms;
+        return dx;
     }
 };
 
@@ -211,7 +211,8 @@ struct EffectiveHamiltonian<S, FL, MPS<S, FL>> {
                     make_shared<typename SparseMatrixInfo<S>::ConnectionInfo>();
                 wfn_infos[i]->initialize_wfn(cdq, vdq, msl[i], msubsl[i],
                                              left_op_infos, right_op_infos,
-                                             ket->info, bra->info, tf->opf->cg);
+                                             ket->info, bra->info, tf->opf->cg,
+                                             tf->opf->plan_cache);
             }
         cmat->info->cinfo = nullptr;
         for (int i = 0; i < (int)msl.size(); i++)
@@ -249,19 +250,21 @@ struct EffectiveHamiltonian<S, FL, MPS<S, FL>> {
             tf->opf->seq->clear();
         }
     }
-    shared_ptr<SparseMatrixGroup<S, FL>>
-    perturbative_noise(bool trace_right, int iL, int iR, FuseTypes ftype,
-                       const shared_ptr<MPSInfo<S>> &mps_info,
-                       const NoiseTypes noise_type,
-                       const shared_ptr<ParallelRule<S>> &para_rule = nullptr) {
-        shared_ptr<VectorAllocator<uint32_t>> i_alloc =
-            make_shared<VectorAllocator<uint32_t>>();
-        shared_ptr<VectorAllocator<FP>> d_alloc =
-            make_shared<VectorAllocator<FP>>();
+    // target quanta, infos and connection infos of perturbed wavefunctions
+    void perturbative_noise_prepare(
+        bool trace_right, int iL, int iR, FuseTypes ftype,
+        const shared_ptr<MPSInfo<S>> &mps_info,
+        const shared_ptr<ParallelRule<S>> &para_rule,
+        const shared_ptr<VectorAllocator<uint32_t>> &i_alloc,
+        shared_ptr<OpExpr<S>> &pexpr, shared_ptr<OpExpr<S>> &xexpr,
+        vector<pair<uint8_t, S>> &psubsl, vector<S> &perturb_ket_labels,
+        vector<S> &all_perturb_ket_labels,
+        vector<shared_ptr<SparseMatrixInfo<S>>> &infos,
+        vector<vector<shared_ptr<typename SparseMatrixInfo<S>::ConnectionInfo>>>
+            &cinfos) {
         vector<S> msl = Partition<S, FL>::get_uniq_labels({hop_mat});
         assert(msl.size() == 1 && msl[0] == opdq);
-        shared_ptr<OpExpr<S>> pexpr = op->mat->data[0], xexpr = nullptr;
-        vector<pair<uint8_t, S>> psubsl;
+        pexpr = op->mat->data[0], xexpr = nullptr;
         if (op->stacked_mat == nullptr) {
             shared_ptr<Symbolic<S>> pmat = make_shared<SymbolicColumnVector<S>>(
                 1, vector<shared_ptr<OpExpr<S>>>{pexpr});
@@ -285,7 +288,6 @@ struct EffectiveHamiltonian<S, FL, MPS<S, FL>> {
             psubsl = Partition<S, FL>::get_stacked_uniq_sub_labels(
                 msl, msl, msl, qsubsl, xsubsl, true, trace_right, false)[0];
         }
-        vector<S> perturb_ket_labels, all_perturb_ket_labels;
         S ket_label = ket->info->delta_quantum;
         for (size_t j = 0; j < psubsl.size(); j++) {
             S pks = ket_label + psubsl[j].second;
@@ -321,7 +323,6 @@ struct EffectiveHamiltonian<S, FL, MPS<S, FL>> {
                               ? StateInfo<S>::tensor_product(
                                     mr, r, *mps_info->right_dims_fci[iR])
                               : r;
-        vector<shared_ptr<SparseMatrixInfo<S>>> infos;
         infos.reserve(perturb_ket_labels.size());
         for (size_t j = 0; j < perturb_ket_labels.size(); j++) {
             shared_ptr<SparseMatrixInfo<S>> info =
@@ -335,34 +336,8 @@ struct EffectiveHamiltonian<S, FL, MPS<S, FL>> {
             ll.deallocate();
         r.deallocate();
         l.deallocate();
-        // perturbed wavefunctions
-        shared_ptr<SparseMatrixGroup<S, FL>> perturb_ket =
-            make_shared<SparseMatrixGroup<S, FL>>(d_alloc);
-        assert(noise_type & NoiseTypes::Perturbative);
-        bool do_reduce = !(noise_type & NoiseTypes::Collected);
-        bool reduced = noise_type & NoiseTypes::Reduced;
-        bool low_mem = noise_type & NoiseTypes::LowMem;
-        bool mid_mem = noise_type & NoiseTypes::MidMem;
-        if ((low_mem && mid_mem) ||
-            (mid_mem && (tf->opf->seq->mode & SeqTypes::Tasked)))
-            throw runtime_error("Invalid NoiseTypes::MidMem.");
-        if (reduced)
-            perturb_ket->allocate(infos);
-        else {
-            vector<shared_ptr<SparseMatrixInfo<S>>> all_infos;
-            all_infos.reserve(all_perturb_ket_labels.size());
-            for (S q : all_perturb_ket_labels) {
-                size_t ib = lower_bound(perturb_ket_labels.begin(),
-                                        perturb_ket_labels.end(), q) -
-                            perturb_ket_labels.begin();
-                all_infos.push_back(infos[ib]);
-            }
-            perturb_ket->allocate(all_infos);
-        }
         // connection infos
         frame_<FP>()->activate(0);
-        vector<vector<shared_ptr<typename SparseMatrixInfo<S>::ConnectionInfo>>>
-            cinfos;
         cinfos.resize(psubsl.size());
         S idq = mps_info->vacuum;
         for (size_t j = 0; j < psubsl.size(); j++) {
@@ -382,10 +357,55 @@ struct EffectiveHamiltonian<S, FL, MPS<S, FL>> {
                                     opdq.combine(idq, -opdq))};
                 cinfos[j][k]->initialize_wfn(
                     ket_label, pks[k], psubsl[j].second, subdq, left_op_infos,
-                    right_op_infos, ket->info, infos[ib], tf->opf->cg);
+                    right_op_infos, ket->info, infos[ib], tf->opf->cg,
+                    tf->opf->plan_cache);
                 assert(cinfos[j][k]->n[4] == 1);
             }
         }
+    }
+    shared_ptr<SparseMatrixGroup<S, FL>>
+    perturbative_noise(bool trace_right, int iL, int iR, FuseTypes ftype,
+                       const shared_ptr<MPSInfo<S>> &mps_info,
+                       const NoiseTypes noise_type,
+                       const shared_ptr<ParallelRule<S>> &para_rule = nullptr) {
+        shared_ptr<VectorAllocator<uint32_t>> i_alloc =
+            make_shared<VectorAllocator<uint32_t>>();
+        shared_ptr<VectorAllocator<FP>> d_alloc =
+            make_shared<VectorAllocator<FP>>();
+        shared_ptr<OpExpr<S>> pexpr, xexpr;
+        vector<pair<uint8_t, S>> psubsl;
+        vector<S> perturb_ket_labels, all_perturb_ket_labels;
+        vector<shared_ptr<SparseMatrixInfo<S>>> infos;
+        vector<vector<shared_ptr<typename SparseMatrixInfo<S>::ConnectionInfo>>>
+            cinfos;
+        perturbative_noise_prepare(trace_right, iL, iR, ftype, mps_info,
+                                   para_rule, i_alloc, pexpr, xexpr, psubsl,
+                                   perturb_ket_labels, all_perturb_ket_labels,
+                                   infos, cinfos);
+        // perturbed wavefunctions
+        shared_ptr<SparseMatrixGroup<S, FL>> perturb_ket =
+            make_shared<SparseMatrixGroup<S, FL>>(d_alloc);
+        assert(noise_type & NoiseTypes::Perturbative);
+        bool do_reduce = !(noise_type & NoiseTypes::Collected);
+        bool reduced = noise_type & NoiseTypes::Reduced;
+        bool low_mem = noise_type & NoiseTypes::LowMem;
+        bool mid_mem = noise_type & NoiseTypes::MidMem;
+        if ((low_mem && mid_mem) ||
+            (mid_mem && (tf->opf->seq->mode & SeqTypes::Tasked)))
+            throw runtime_error("Invalid NoiseTypes::MidMem.");
+        if (reduced)
+            perturb_ket->allocate(infos);
+        else {
+            vector<shared_ptr<SparseMatrixInfo<S>>> all_infos;
+            all_infos.reserve(all_perturb_ket_labels.size());
+            for (S q : all_perturb_ket_labels) {
+                size_t ib = lower_bound(perturb_ket_labels.begin(),
+                                        perturb_ket_labels.end(), q) -
+                            perturb_ket_labels.begin();
+                all_infos.push_back(infos[ib]);
+            }
+            perturb_ket->allocate(all_infos);
+        }
         int vidx = reduced ? -1 : 0;
         // perform multiplication
         tf->tensor_product_partial_multiply(
@@ -421,6 +441,117 @@ struct EffectiveHamiltonian<S, FL, MPS<S, FL>> {
                 cinfos[j][k]->deallocate();
         return perturb_ket;
     }
+    // Add the reduced perturbative noise to the density matrix dm, without
+    // storing all perturbed wavefunctions at the same time.
+    // Target quanta are processed in batches of at most batch_size quanta
+    // (zero means no limit). One batch and its thread-local copies are
+    // restricted to the free memory of the current data frame.
+    // Returns the number of batches
+    int perturbative_noise_density_matrix(
+        bool trace_right, int iL, int iR, FuseTypes ftype,
+        const shared_ptr<MPSInfo<S>> &mps_info, const NoiseTypes noise_type,
+        const shared_ptr<SparseMatrix<S, FL>> &dm, FP noise,
+        int batch_size = 0,
+        const shared_ptr<ParallelRule<S>> &para_rule = nullptr) {
+        assert((noise_type & NoiseTypes::Perturbative) &&
+               (noise_type & NoiseTypes::Reduced));
+        shared_ptr<VectorAllocator<uint32_t>> i_alloc =
+            make_shared<VectorAllocator<uint32_t>>();
+        shared_ptr<VectorAllocator<FP>> d_alloc =
+            make_shared<VectorAllocator<FP>>();
+        shared_ptr<OpExpr<S>> pexpr, xexpr;
+        vector<pair<uint8_t, S>> psubsl;
+        vector<S> perturb_ket_labels, all_perturb_ket_labels;
+        vector<shared_ptr<SparseMatrixInfo<S>>> infos;
+        vector<vector<shared_ptr<typename SparseMatrixInfo<S>::ConnectionInfo>>>
+            cinfos;
+        perturbative_noise_prepare(trace_right, iL, iR, ftype, mps_info,
+                                   para_rule, i_alloc, pexpr, xexpr, psubsl,
+                                   perturb_ket_labels, all_perturb_ket_labels,
+                                   infos, cinfos);
+        bool do_reduce = !(noise_type & NoiseTypes::Collected);
+        bool unscaled = noise_type & NoiseTypes::Unscaled;
+        bool is_root =
+            para_rule == nullptr || !do_reduce || para_rule->is_root();
+        // the batch is allocated in the stack,
+        // and each extra thread has one copy in the heap
+        const int cpx_sz = sizeof(FL) / sizeof(FP);
+        const int ntop = max(threading->n_threads_op, 1);
+        double max_batch_mem =
+            (double)(dalloc_<FP>()->size - dalloc_<FP>()->used) /
+            (cpx_sz * ntop);
+        if (para_rule != nullptr)
+            para_rule->comm->allreduce_min(&max_batch_mem, 1);
+        shared_ptr<SparseMatrix<S, FL>> pdm =
+            make_shared<SparseMatrix<S, FL>>(d_alloc);
+        pdm->allocate(dm->info);
+        FP norm_sq = 0;
+        int n_batches = 0;
+        for (size_t ib = 0, jb; ib < infos.size(); ib = jb) {
+            // at least one target quantum in each batch
+            size_t batch_mem = infos[ib]->get_total_memory();
+            for (jb = ib + 1;
+                 jb < infos.size() &&
+                 (batch_size <= 0 || jb - ib < (size_t)batch_size) &&
+                 batch_mem + infos[jb]->get_total_memory() <= max_batch_mem;
+                 jb++)
+                batch_mem += infos[jb]->get_total_memory();
+            if (batch_mem == 0)
+                continue;
+            n_batches++;
+            vector<S> batch_labels(perturb_ket_labels.begin() + ib,
+                                   perturb_ket_labels.begin() + jb);
+            shared_ptr<SparseMatrixGroup<S, FL>> perturb_ket =
+                make_shared<SparseMatrixGroup<S, FL>>();
+            perturb_ket->allocate(vector<shared_ptr<SparseMatrixInfo<S>>>(
+                infos.begin() + ib, infos.begin() + jb));
+            int vidx = -1;
+            tf->tensor_product_partial_multiply(
+                pexpr, xexpr, op->lopt, op->ropt, trace_right, ket, psubsl,
+                cinfos, batch_labels, perturb_ket, vidx, -1, do_reduce);
+            if (tf->opf->seq->mode == SeqTypes::Auto) {
+                tf->opf->seq->auto_perform();
+                if (para_rule != nullptr && do_reduce)
+                    para_rule->comm->reduce_sum(perturb_ket,
+                                                para_rule->comm->root);
+            } else if (tf->opf->seq->mode & SeqTypes::Tasked) {
+                assert(perturb_ket->total_memory <=
+                       (size_t)numeric_limits<decltype(GMatrix<FL>::n)>::max());
+                tf->opf->seq->auto_perform(GMatrix<FL>(
+                    perturb_ket->data, (MKL_INT)perturb_ket->total_memory, 1));
+                if (para_rule != nullptr && do_reduce)
+                    para_rule->comm->reduce_sum(perturb_ket,
+                                                para_rule->comm->root);
+            }
+            // same normalization as MovingEnvironment::scale_perturbative_noise
+            // and, as in MovingEnvironment::density_matrix, the first
+            // perturbed wavefunction only contributes to the normalization
+            for (int j = 0; is_root && j < perturb_ket->n; j++) {
+                shared_ptr<SparseMatrix<S, FL>> pmat = (*perturb_ket)[j];
+                FP pnorm = pmat->norm();
+                if (unscaled)
+                    norm_sq += pnorm * pnorm;
+                else if (abs(pnorm) > TINY) {
+                    pmat->iscale(1 / pnorm);
+                    norm_sq += 1;
+                }
+                if (ib + j != 0)
+                    OperatorFunctions<S, FL>::trans_product(
+                        pmat, pdm, trace_right, 0.0, NoiseTypes::None);
+            }
+            perturb_ket->deallocate();
+        }
+        if (is_root && abs(norm_sq) > TINY)
+            GMatrixFunctions<FL>::iadd(
+                GMatrix<FL>(dm->data, (MKL_INT)dm->total_memory, 1),
+                GMatrix<FL>(pdm->data, (MKL_INT)pdm->total_memory, 1),
+                noise / norm_sq);
+        pdm->deallocate();
+        for (int j = (int)cinfos.size() - 1; j >= 0; j--)
+            for (int k = (int)cinfos[j].size() - 1; k >= 0; k--)
+                cinfos[j][k]->deallocate();
+        return n_batches;
+    }
     int get_mpo_bond_dimension() const {
         if (op->mat->data.size() == 0)
             return 0;
@@ -1391,7 +1522,7 @@ struct EffectiveHamiltonian<S, FL, MultiMPS<S, FL>> {
                     wfn_info->initialize_wfn(cdq, vdq, msl[i], msubsl[i],
                                              left_op_infos, right_op_infos,
                                              cmat->infos[ic], vmat->infos[iv],
-                                             tf->opf->cg);
+                                             tf->opf->cg, tf->opf->plan_cache);
                     wfn_infos[i][cvdq] = wfn_info;
                 }
         for (int i = 0; i < cmat->n; i++) {
@@ -1572,7 +1703,7 @@ struct EffectiveHamiltonian<S, FL, MultiMPS<S, FL>> {
                     cinfos[i][j][k]->initialize_wfn(
                         ket_label, pks[k], psubsl[j].second, subdq,
                         left_op_infos, right_op_infos, ket[0]->infos[i],
-                        infos[ib], tf->opf->cg);
+                        infos[ib], tf->opf->cg, tf->opf->plan_cache);
                     assert(cinfos[i][j][k]->n[4] == 1);
                 }
             }
@@ -31,6 +31,7 @@
 #include <functional>
 #include <iostream>
 #include <map>
+#include <set>
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
@@ -1527,4 +1528,272 @@ struct GeneralHamiltonian<S, FL, typename S::is_sany_t> : Hamiltonian<S, FL> {
     }
 };
 
+// General Hamiltonian for custom models (non-spin-adapted)
+// defined by tables of site basis, primitive site operator matrices
+// and quantum number rules, without any Python callbacks
+template <typename S, typename FL>
+struct GeneralCustomHamiltonian : GeneralHamiltonian<S, FL> {
+    typedef typename GMatrix<FL>::FP FP;
+    using Hamiltonian<S, FL>::vacuum;
+    using Hamiltonian<S, FL>::n_sites;
+    using Hamiltonian<S, FL>::basis;
+    using Hamiltonian<S, FL>::site_op_infos;
+    using Hamiltonian<S, FL>::orb_sym;
+    using Hamiltonian<S, FL>::find_site_op_info;
+    using Hamiltonian<S, FL>::opf;
+    using GeneralHamiltonian<S, FL>::site_norm_ops;
+    using GeneralHamiltonian<S, FL>::max_n;
+    using GeneralHamiltonian<S, FL>::max_s;
+    // Quantum numbers and number of states in the local Hilbert space
+    vector<vector<pair<S, int>>> site_basis;
+    // Primitive (single character) site operators: name -> (delta quantum,
+    // dense matrix in row-major order); delta quantum can be S(S::invalid),
+    // then it is determined from the non-zero blocks
+    vector<vector<pair<string, pair<S, vector<FL>>>>> site_ops;
+    // Operators having point group irrep given by orb_sym
+    string orb_dependent_ops;
+    // Operators having site-dependent spin given by spin_sym
+    string spin_dependent_ops;
+    vector<map<string, int>> spin_sym;
+    // Orbital independent delta quantum of primitive operators
+    map<string, S> prim_quanta;
+    GeneralCustomHamiltonian(
+        S vacuum, int n_sites, const vector<typename S::pg_t> &orb_sym,
+        const vector<vector<pair<S, int>>> &site_basis,
+        const vector<vector<pair<string, pair<S, vector<FL>>>>> &site_ops,
+        const string &orb_dependent_ops = "cdCD",
+        const string &spin_dependent_ops = "",
+        const vector<map<string, int>> &spin_sym = vector<map<string, int>>())
+        : GeneralHamiltonian<S, FL>(), site_basis(site_basis),
+          site_ops(site_ops), orb_dependent_ops(orb_dependent_ops),
+          spin_dependent_ops(spin_dependent_ops), spin_sym(spin_sym) {
+        if ((int)site_basis.size() != n_sites ||
+            (int)site_ops.size() != n_sites)
+            throw runtime_error("GeneralCustomHamiltonian: site_basis and "
+                                "site_ops must be given for all sites!");
+        this->vacuum = vacuum;
+        this->n_sites = (uint16_t)n_sites;
+        this->orb_sym = orb_sym;
+        opf = make_shared<OperatorFunctions<S, FL>>(make_shared<CG<S>>());
+        basis.resize(n_sites);
+        site_op_infos.resize(n_sites);
+        site_norm_ops.resize(n_sites);
+        for (uint16_t m = 0; m < n_sites; m++)
+            basis[m] = get_site_basis(m);
+        init_site_ops();
+    }
+    virtual ~GeneralCustomHamiltonian() = default;
+    shared_ptr<StateInfo<S>> get_site_basis(uint16_t m) const override {
+        shared_ptr<StateInfo<S>> b = make_shared<StateInfo<S>>();
+        b->allocate((int)site_basis[m].size());
+        for (int i = 0; i < (int)site_basis[m].size(); i++)
+            b->quanta[i] = site_basis[m][i].first,
+            b->n_states[i] = (ubond_t)site_basis[m][i].second;
+        b->sort_states();
+        return b;
+    }
+    // quanta of site operators: all (N, 2S) within the range
+    template <typename SS = S>
+    auto init_site_op_quanta(uint16_t m, set<S> &qs) const
+        -> decltype(typename SS::is_sz_t()) {
+        const int max_n_odd = max_n | 1, max_s_odd = max_s | 1;
+        const int max_n_even = max_n_odd ^ 1, max_s_even = max_s_odd ^ 1;
+        for (int n = -max_n_odd; n <= max_n_odd; n += 2)
+            for (int s = -max_s_odd; s <= max_s_odd; s += 2)
+                qs.insert(S(n, s, orb_sym[m]));
+        for (int n = -max_n_even; n <= max_n_even; n += 2)
+            for (int s = -max_s_even; s <= max_s_even; s += 2)
+                qs.insert(S(n, s, 0));
+    }
+    // quanta of site operators: all differences of site basis quanta
+    template <typename SS = S>
+    auto init_site_op_quanta(uint16_t m, set<S> &qs) const
+        -> decltype(typename SS::is_sany_t()) {
+        for (auto &p : site_basis[m])
+            for (auto &q : site_basis[m]) {
+                S dq = p.first - q.first;
+                for (int iq = 0; iq < dq.count(); iq++)
+                    qs.insert(dq[iq]);
+            }
+    }
+    // orbital dependent LZ part of operator quanta (additive, unlike pg)
+    template <typename SS = S>
+    static auto clear_lz(S &q) -> decltype(typename SS::is_sz_t()) {}
+    template <typename SS = S>
+    static auto clear_lz(S &q) -> decltype(typename SS::is_sany_t()) {
+        for (int8_t k = 0; k < S::ll; k++)
+            if (q.types[k] == SAnySymmTypes::LZ)
+                q.values[k] = 0;
+    }
+    template <typename SS = S>
+    auto add_lz(S &q, uint16_t m, char op) const
+        -> decltype(typename SS::is_sz_t()) {}
+    template <typename SS = S>
+    auto add_lz(S &q, uint16_t m, char op) const
+        -> decltype(typename SS::is_sany_t()) {
+        for (int8_t k = 0; k < S::ll; k++)
+            if (q.types[k] == SAnySymmTypes::LZ)
+                q.values[k] += site_norm_ops[m]
+                                   .at(string(1, op))
+                                   ->info->delta_quantum.values[k];
+    }
+    void init_site_ops() override {
+        shared_ptr<VectorAllocator<uint32_t>> i_alloc =
+            make_shared<VectorAllocator<uint32_t>>();
+        shared_ptr<VectorAllocator<FP>> d_alloc =
+            make_shared<VectorAllocator<FP>>();
+        // site operator infos
+        for (uint16_t m = 0; m < n_sites; m++) {
+            set<S> qs;
+            qs.insert(vacuum);
+            init_site_op_quanta(m, qs);
+            site_op_infos[m].clear();
+            for (auto &q : qs) {
+                shared_ptr<SparseMatrixInfo<S>> info =
+                    make_shared<SparseMatrixInfo<S>>(i_alloc);
+                info->initialize(*basis[m], *basis[m], q, q.is_fermion());
+                site_op_infos[m].push_back(make_pair(q, info));
+            }
+        }
+        // primitive site operators
+        for (uint16_t m = 0; m < n_sites; m++) {
+            const vector<pair<S, int>> &sb = site_basis[m];
+            vector<size_t> offs(sb.size() + 1, 0);
+            for (size_t i = 0; i < sb.size(); i++)
+                offs[i + 1] = offs[i] + sb[i].second;
+            const size_t pv = offs.back();
+            bool has_ident = false;
+            for (auto &op : site_ops[m]) {
+                const string &name = op.first;
+                const vector<FL> &mat = op.second.second;
+                has_ident = has_ident || name == "";
+                if (mat.size() != pv * pv)
+                    throw runtime_error(
+                        "GeneralCustomHamiltonian: wrong matrix size for "
+                        "operator '" +
+                        name + "' at site " + Parsing::to_string(m));
+                // non-zero blocks and compatible delta quanta
+                vector<pair<size_t, size_t>> blocks;
+                vector<S> dqs;
+                for (size_t i = 0; i < sb.size(); i++)
+                    for (size_t j = 0; j < sb.size(); j++) {
+                        FP norm = 0;
+                        for (size_t r = offs[i]; r < offs[i + 1]; r++)
+                            for (size_t c = offs[j]; c < offs[j + 1]; c++)
+                                norm += xreal(xconj(mat[r * pv + c]) *
+                                              mat[r * pv + c]);
+                        if (norm < (FP)1E-40)
+                            continue;
+                        S xdq = sb[i].first - sb[j].first;
+                        if (blocks.size() == 0)
+                            for (int iq = 0; iq < xdq.count(); iq++)
+                                dqs.push_back(xdq[iq]);
+                        else {
+                            vector<S> ndqs;
+                            for (auto &dq : dqs)
+                                for (int iq = 0; iq < xdq.count(); iq++)
+                                    if (dq == xdq[iq]) {
+                                        ndqs.push_back(dq);
+                                        break;
+                                    }
+                            dqs = ndqs;
+                        }
+                        blocks.push_back(make_pair(i, j));
+                    }
+                S dq = op.second.first;
+                if (dq == S(S::invalid)) {
+                    if (blocks.size() == 0)
+                        dq = vacuum;
+                    else if (dqs.size() == 0)
+                        throw runtime_error(
+                            "GeneralCustomHamiltonian: no delta quantum "
+                            "compatible with operator '" +
+                            name + "' at site " + Parsing::to_string(m));
+                    else
+                        dq = dqs[0];
+                }
+                shared_ptr<SparseMatrixInfo<S>> info = find_site_op_info(m, dq);
+                if (info == nullptr)
+                    throw runtime_error(
+                        "GeneralCustomHamiltonian: invalid delta quantum for "
+                        "operator '" +
+                        name + "' at site " + Parsing::to_string(m));
+                shared_ptr<SparseMatrix<S, FL>> xmat =
+                    make_shared<SparseMatrix<S, FL>>(d_alloc);
+                xmat->allocate(info);
+                for (auto &b : blocks) {
+                    GMatrix<FL> xm = (*xmat)[dq.combine(sb[b.first].first,
+                                                        sb[b.second].first)];
+                    for (size_t r = offs[b.first]; r < offs[b.first + 1]; r++)
+                        for (size_t c = offs[b.second]; c < offs[b.second + 1];
+                             c++)
+                            xm(r - offs[b.first], c - offs[b.second]) =
+                                mat[r * pv + c];
+                }
+                site_norm_ops[m][name] = xmat;
+            }
+            if (!has_ident)
+                throw runtime_error("GeneralCustomHamiltonian: identity "
+                                    "operator '' is required at site " +
+                                    Parsing::to_string(m));
+        }
+        // orbital (and spin) independent part of delta quanta
+        prim_quanta.clear();
+        for (uint16_t m = 0; m < n_sites; m++)
+            for (auto &op : site_ops[m])
+                if (!prim_quanta.count(op.first)) {
+                    S q = site_norm_ops[m].at(op.first)->info->delta_quantum;
+                    if (op.first.length() == 1 &&
+                        orb_dependent_ops.find(op.first[0]) != string::npos) {
+                        q.set_pg(0);
+                        clear_lz(q);
+                    }
+                    if (op.first.length() == 1 &&
+                        spin_dependent_ops.find(op.first[0]) != string::npos)
+                        q.set_twos(0);
+                    prim_quanta[op.first] = q;
+                }
+    }
+    vector<vector<S>> init_string_quanta(const vector<string> &exprs,
+                                         const vector<uint16_t> &term_l,
+                                         S left_vacuum) override {
+        vector<vector<S>> r(exprs.size());
+        for (size_t ix = 0; ix < exprs.size(); ix++) {
+            r[ix].resize(exprs[ix].length() + 1);
+            r[ix][0] = prim_quanta.at("");
+            for (size_t i = 0; i < exprs[ix].length(); i++)
+                r[ix][i + 1] =
+                    r[ix][i] + prim_quanta.at(string(1, exprs[ix][i]));
+        }
+        return r;
+    }
+    pair<S, S> get_string_quanta(const vector<S> &ref, const string &expr,
+                                 const uint16_t *idxs,
+                                 uint16_t k) const override {
+        S l = ref[k], r = ref.back() - l;
+        for (uint16_t j = 0; j < (uint16_t)expr.length(); j++) {
+            S &x = j < k ? l : r;
+            if (orb_dependent_ops.find(expr[j]) != string::npos) {
+                x.set_pg(S::pg_mul(x.pg(), orb_sym[idxs[j]]));
+                add_lz(x, idxs[j], expr[j]);
+            }
+            if (spin_dependent_ops.find(expr[j]) != string::npos)
+                x.set_twos(x.twos() +
+                           spin_sym[idxs[j]].at(string(1, expr[j])));
+        }
+        return make_pair(l, r);
+    }
+    S get_string_quantum(const string &expr,
+                         const uint16_t *idxs) const override {
+        S r = prim_quanta.at("");
+        for (uint16_t j = 0; j < (uint16_t)expr.length(); j++)
+            r = r + (idxs != nullptr
+                         ? site_norm_ops[idxs[j]]
+                               .at(string(1, expr[j]))
+                               ->info->delta_quantum
+                         : prim_quanta.at(string(1, expr[j])));
+        return r;
+    }
+};
+
 } // namespace block2
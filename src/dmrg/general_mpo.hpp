@@ -462,6 +462,31 @@ template <typename S, typename FL> struct GeneralMPO : MPO<S, FL> {
                                       part_values[delayed_term] * rsc_factor));
                     }
                 }
+                // quanta of the left and right parts of each term
+                // (independent of other terms, so computed in parallel
+                // unless the hamiltonian callbacks are not thread safe)
+                vector<pair<S, S>> pqs(fast_no_orb_dep_op ? 0 : cn);
+                if (!fast_no_orb_dep_op) {
+                    const bool para_pqs = hamil->is_thread_safe();
+                    int ntg = para_pqs ? threading->activate_global() : 1;
+#pragma omp parallel for schedule(static) num_threads(ntg) if (para_pqs)
+                    for (LL ic = 0; ic < cn; ic++) {
+                        const pair<int, LL> &pt =
+                            ic < cnr ? cur_terms[ip][ic]
+                                     : part_terms[ic + part_off];
+                        const int ix = pt.first, kmax = term_l[ix];
+                        const LL itt = pt.second * kmax;
+                        int k = term_i[ix][pt.second];
+                        for (; k < kmax && afd->indices[ix][itt + k] <= ii;
+                             k++)
+                            ;
+                        pqs[ic] = hamil->get_string_quanta(
+                            quanta_ref[ix], afd->exprs[ix],
+                            &afd->indices[ix][itt], k);
+                    }
+                    if (para_pqs)
+                        threading->activate_normal();
+                }
                 for (LL ic = 0; ic < cn; ic++) {
                     LL ix, it;
                     FL itv;
@@ -512,9 +537,7 @@ template <typename S, typename FL> struct GeneralMPO : MPO<S, FL> {
                                         ? make_pair(quanta_ref[ix][k],
                                                     quanta_ref[ix].back() -
                                                         quanta_ref[ix][k])
-                                        : hamil->get_string_quanta(
-                                              quanta_ref[ix], afd->exprs[ix],
-                                              &afd->indices[ix][itt], k);
+                                        : pqs[ic];
                     S qq = qh.combine(pq.first, -pq.second);
                     // possible error here due to unsymmetrized integral
                     assert(qq != S(S::invalid));
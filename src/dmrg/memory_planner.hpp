@@ -0,0 +1,434 @@
+
+/*
+ * block2: Efficient MPO implementation of quantum chemistry DMRG
+ * Copyright (C) 2020-2021 Huanchen Zhai <hczhai@caltech.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../core/allocator.hpp"
+#include "../core/operator_functions.hpp"
+#include "../core/sparse_matrix.hpp"
+#include "../core/state_info.hpp"
+#include "moving_environment.hpp"
+#include "mpo.hpp"
+#include "mps.hpp"
+#include "state_averaged.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+namespace block2 {
+
+// Memory-saving switches and predicted peak memory (in bytes) for one sweep
+struct MemoryPlan {
+    ubond_t bond_dim = 0;
+    int peak_site = -1;
+    // main stack (frame 0), second stack (frame 1) and dynamic memory
+    size_t main_peak = 0, second_peak = 0, heap_peak = 0;
+    // renormalized operators on disk
+    size_t disk_storage = 0;
+    // actual peak of the stacks after the sweep
+    size_t actual_main_peak = 0, actual_second_peak = 0;
+    // recommended fraction of the double stack for the main frame
+    double dmain_ratio = 0.7;
+    bool use_main_stack = true;
+    bool batched_noise = false;
+    bool fused_contraction_rotation = false;
+    bool fused_contraction_multiplication = false;
+    bool lowmem_numerical_transform = false;
+    bool minimal_disk_usage = false;
+    // whether the prediction fits the current stacks and budget
+    bool feasible = true;
+    string to_str() const {
+        stringstream ss;
+        ss << "M = " << (uint32_t)bond_dim
+           << " | Pmain = " << Parsing::to_size_string(main_peak)
+           << " | Pseco = " << Parsing::to_size_string(second_peak)
+           << " | Pheap = " << Parsing::to_size_string(heap_peak)
+           << " | Pdisk = " << Parsing::to_size_string(disk_storage)
+           << " | site = " << peak_site << " | ratio = " << fixed
+           << setprecision(2) << dmain_ratio << " |";
+        if (!use_main_stack)
+            ss << " heap-blocking";
+        if (batched_noise)
+            ss << " batched-noise";
+        if (fused_contraction_rotation)
+            ss << " fused-rot";
+        if (fused_contraction_multiplication)
+            ss << " fused-mult";
+        if (lowmem_numerical_transform)
+            ss << " lowmem-trans";
+        if (minimal_disk_usage)
+            ss << " min-disk";
+        if (!feasible)
+            ss << " INFEASIBLE";
+        return ss.str();
+    }
+};
+
+// Dry-run estimation of per-site peak memory of a DMRG sweep, from the
+// FCI quantum numbers in MPSInfo truncated to the bond dimension and the
+// operator quanta in MPO. Before each sweep, memory-saving switches are
+// turned on (never off) in order of increasing cost, until the prediction
+// fits the current data frame and the optional budgets.
+// The data frame cannot be re-partitioned during a sweep (renormalized
+// operators hold pointers into the stacks), so the frame split is only
+// recommended through MemoryPlan::dmain_ratio.
+template <typename S, typename FL, typename FLS> struct MemoryPlanner {
+    typedef typename GMatrix<FL>::FP FP;
+    // total memory budget in bytes (stacks + dynamic memory).
+    // Zero means the dynamic memory is not limited
+    size_t max_memory;
+    // disk budget in bytes for renormalized operators. Zero means no limit
+    size_t max_disk;
+    // fraction of each stack that the prediction is allowed to use
+    double safety = 0.9;
+    int iprint = 1;
+    vector<MemoryPlan> plans;
+    // fused_contraction_multiplication set by the user before planning
+    bool user_fused_multiplication = false;
+    // settings of the data frame, moving environment and noise type
+    // before the first apply, recovered by restore
+    bool saved = false;
+    bool saved_use_main_stack = true, saved_minimal_disk_usage = false;
+    bool saved_fused_rotation = false, saved_fused_multiplication = false;
+    bool saved_lowmem_transform = false, saved_cached_contraction = false;
+    NoiseTypes saved_noise_type = NoiseTypes::None;
+    MemoryPlanner(size_t max_memory = 0, size_t max_disk = 0)
+        : max_memory(max_memory), max_disk(max_disk) {}
+    virtual ~MemoryPlanner() = default;
+    // same truncation as MPSInfo::set_bond_dimension
+    static StateInfo<S> truncate_dims(const StateInfo<S> &fci, ubond_t m) {
+        StateInfo<S> r = fci.deep_copy();
+        if (r.n_states_total > m) {
+            total_bond_t new_total = 0;
+            for (int k = 0; k < r.n; k++) {
+                uint64_t new_n_states = (uint64_t)(
+                    ceil((double)r.n_states[k] * m / r.n_states_total) + 0.1);
+                r.n_states[k] =
+                    (ubond_t)min((uint64_t)new_n_states,
+                                 (uint64_t)numeric_limits<ubond_t>::max());
+                new_total += r.n_states[k];
+            }
+            r.n_states_total = new_total;
+        }
+        return r;
+    }
+    // number of elements of all operators in names, on bra/ket basis st
+    static size_t
+    operator_size(const shared_ptr<Symbolic<S>> &names, const StateInfo<S> &st,
+                  map<S, size_t> &mpsz,
+                  const shared_ptr<SparseMatrixInfo<S>> &mat_info) {
+        size_t sz = 0;
+        for (auto &xop : names->data) {
+            shared_ptr<OpElement<S, FL>> op =
+                dynamic_pointer_cast<OpElement<S, FL>>(xop);
+            if (op == nullptr)
+                continue;
+            if (!mpsz.count(op->q_label)) {
+                mat_info->initialize(st, st, op->q_label,
+                                     op->q_label.is_fermion());
+                mpsz[op->q_label] = mat_info->get_total_memory();
+                mat_info->deallocate();
+            }
+            sz += mpsz.at(op->q_label);
+        }
+        return sz;
+    }
+    static size_t n_unique_quanta(const shared_ptr<Symbolic<S>> &names) {
+        set<S> qs;
+        for (auto &xop : names->data) {
+            shared_ptr<OpElement<S, FL>> op =
+                dynamic_pointer_cast<OpElement<S, FL>>(xop);
+            if (op != nullptr)
+                qs.insert(op->q_label);
+        }
+        return qs.size();
+    }
+    // predicted peaks for the given switches (all sizes in bytes)
+    // davidson_max_size is the max Davidson deflation space
+    virtual void estimate(const shared_ptr<MovingEnvironment<S, FL, FLS>> &me,
+                          NoiseTypes noise_type, int davidson_max_size,
+                          MemoryPlan &plan) const {
+        const shared_ptr<MPO<S, FL>> &mpo = me->mpo;
+        const shared_ptr<MPSInfo<S>> &info = me->ket->info;
+        const int n_sites = me->n_sites, dot = me->dot;
+        const ubond_t m = plan.bond_dim;
+        int nroots = me->ket->get_type() == MPSTypes::MultiWfn
+                         ? dynamic_pointer_cast<MultiMPS<S, FLS>>(me->ket)
+                               ->nroots
+                         : 1;
+        const size_t szo = sizeof(FL), szw = sizeof(FLS);
+        const int ntop = max(threading->n_threads_op, 1);
+        shared_ptr<SparseMatrixInfo<S>> mat_info =
+            make_shared<SparseMatrixInfo<S>>(
+                make_shared<VectorAllocator<uint32_t>>());
+        vector<StateInfo<S>> ldims(n_sites + 1), rdims(n_sites + 1);
+        for (int i = 0; i <= n_sites; i++) {
+            ldims[i] = truncate_dims(*info->left_dims_fci[i], m);
+            rdims[i] = truncate_dims(*info->right_dims_fci[i], m);
+        }
+        // renormalized operators: left ops at bond i, right ops at bond i
+        vector<size_t> lenv(n_sites + 1, 0), renv(n_sites + 1, 0);
+        vector<size_t> lnq(n_sites, 0), rnq(n_sites, 0);
+        for (int i = 0; i < n_sites; i++) {
+            map<S, size_t> mpszl, mpszr;
+            mpo->load_left_operators(i);
+            lenv[i + 1] = operator_size(mpo->left_operator_names[i],
+                                        ldims[i + 1], mpszl, mat_info);
+            lnq[i] = n_unique_quanta(mpo->left_operator_names[i]);
+            mpo->unload_left_operators(i);
+            mpo->load_right_operators(i);
+            renv[i] = operator_size(mpo->right_operator_names[i], rdims[i],
+                                    mpszr, mat_info);
+            rnq[i] = n_unique_quanta(mpo->right_operator_names[i]);
+            mpo->unload_right_operators(i);
+        }
+        plan.disk_storage = 0;
+        for (int i = 0; i <= n_sites; i++)
+            plan.disk_storage += (lenv[i] + renv[i]) * szo;
+        if (plan.minimal_disk_usage)
+            plan.disk_storage /= 2;
+        size_t main_base = frame_<FP>()->dallocs[0]->used * sizeof(FP);
+        plan.main_peak = plan.second_peak = plan.heap_peak = 0;
+        for (int i = 0; i + dot <= n_sites; i++) {
+            const int iL = i, iR = i + dot - 1;
+            StateInfo<S> tl = StateInfo<S>::tensor_product(
+                ldims[iL], *info->basis[iL], *info->left_dims_fci[iL + 1]);
+            StateInfo<S> tr = StateInfo<S>::tensor_product(
+                *info->basis[iR], rdims[iR + 1], *info->right_dims_fci[iR]);
+            map<S, size_t> mpszl, mpszr;
+            mpo->load_left_operators(iL);
+            size_t lblk =
+                operator_size(mpo->left_operator_names[iL], tl, mpszl,
+                              mat_info) *
+                szo;
+            mpo->unload_left_operators(iL);
+            mpo->load_right_operators(iR);
+            size_t rblk =
+                operator_size(mpo->right_operator_names[iR], tr, mpszr,
+                              mat_info) *
+                szo;
+            mpo->unload_right_operators(iR);
+            // two-site: both sides blocked; one-site: only the fused side
+            size_t blk = dot == 2 ? lblk + rblk : max(lblk, rblk);
+            size_t wfn = 0, dm = 0;
+            if (dot == 2) {
+                mat_info->initialize(tl, tr, info->target, false, true);
+                wfn = mat_info->get_total_memory();
+                mat_info->deallocate();
+            } else {
+                mat_info->initialize(tl, rdims[iR + 1], info->target, false,
+                                     true);
+                wfn = mat_info->get_total_memory();
+                mat_info->deallocate();
+                mat_info->initialize(ldims[iL], tr, info->target, false, true);
+                wfn = max(wfn, (size_t)mat_info->get_total_memory());
+                mat_info->deallocate();
+            }
+            mat_info->initialize(tl, tl, info->vacuum, false);
+            dm = mat_info->get_total_memory();
+            mat_info->deallocate();
+            mat_info->initialize(tr, tr, info->vacuum, false);
+            dm = max(dm, (size_t)mat_info->get_total_memory());
+            mat_info->deallocate();
+            wfn *= nroots * szw, dm *= szw;
+            size_t noise = 0;
+            if (noise_type & NoiseTypes::Perturbative) {
+                size_t nq = max(iL == 0 ? 1 : lnq[iL - 1],
+                                iR + 1 >= n_sites ? 1 : rnq[iR + 1]);
+                noise = plan.batched_noise || (noise_type & NoiseTypes::LowMem)
+                            ? wfn * ntop + dm
+                            : wfn * nq + dm;
+            } else if (noise_type & NoiseTypes::DensityMatrix)
+                noise = dm;
+            // wavefunction, diagonal, Davidson vectors and sigma vectors
+            size_t dav = wfn * (2 + 2 * (davidson_max_size + nroots));
+            size_t eff_blk = plan.fused_contraction_multiplication ? 0 : blk;
+            size_t rot_blk =
+                plan.fused_contraction_rotation ? 0 : max(lblk, rblk);
+            size_t main_eff =
+                (plan.use_main_stack ? eff_blk : 0) + dav + max(noise, dm);
+            size_t main_rot = (plan.use_main_stack ? rot_blk : 0) + wfn + dm;
+            size_t main = main_base + max(main_eff, main_rot);
+            size_t heap = plan.use_main_stack ? 0 : max(eff_blk, rot_blk);
+            // environments of both sides and the new renormalized operators
+            size_t seco = (lenv[iL] + renv[iR + 1] +
+                           max(lenv[iL + 1], renv[iR])) *
+                          szo;
+            if (main + seco + heap >
+                plan.main_peak + plan.second_peak + plan.heap_peak)
+                plan.peak_site = i;
+            plan.main_peak = max(plan.main_peak, main);
+            plan.second_peak = max(plan.second_peak, seco);
+            plan.heap_peak = max(plan.heap_peak, heap);
+        }
+        plan.dmain_ratio =
+            plan.main_peak + plan.second_peak == 0
+                ? 0.7
+                : min(0.9, max(0.1, (double)plan.main_peak /
+                                        (plan.main_peak + plan.second_peak)));
+    }
+    bool fits(const MemoryPlan &plan) const {
+        const size_t main_cap = frame_<FP>()->dallocs[0]->size * sizeof(FP);
+        const size_t seco_cap = frame_<FP>()->dallocs[1]->size * sizeof(FP);
+        const size_t stack_total = frame_<FP>()->dsize * sizeof(FP);
+        return plan.main_peak <= main_cap * safety &&
+               plan.second_peak <= seco_cap * safety &&
+               (max_memory == 0 ||
+                stack_total + plan.heap_peak <= max_memory * safety) &&
+               (max_disk == 0 || plan.disk_storage <= max_disk);
+    }
+    // choose switches for the next sweep, starting from the current settings
+    virtual MemoryPlan plan_sweep(
+        const shared_ptr<MovingEnvironment<S, FL, FLS>> &me, ubond_t bond_dim,
+        NoiseTypes noise_type, int davidson_max_size) {
+        MemoryPlan plan;
+        const bool perturbative = noise_type & NoiseTypes::Perturbative;
+        if (plans.size() == 0)
+            user_fused_multiplication = me->fused_contraction_multiplication;
+        else
+            plan = plans.back();
+        plan.bond_dim = bond_dim;
+        plan.use_main_stack =
+            plan.use_main_stack && frame_<FP>()->use_main_stack;
+        plan.batched_noise =
+            plan.batched_noise || (noise_type & NoiseTypes::Batched);
+        plan.fused_contraction_rotation = plan.fused_contraction_rotation ||
+                                          me->fused_contraction_rotation;
+        // perturbative noise needs the blocked operators
+        plan.fused_contraction_multiplication =
+            perturbative ? user_fused_multiplication
+                         : plan.fused_contraction_multiplication ||
+                               me->fused_contraction_multiplication;
+        plan.lowmem_numerical_transform = plan.lowmem_numerical_transform ||
+                                          me->lowmem_numerical_transform;
+        plan.minimal_disk_usage =
+            plan.minimal_disk_usage || frame_<FP>()->minimal_disk_usage;
+        estimate(me, noise_type, davidson_max_size, plan);
+        // switches in order of increasing cost
+        vector<bool MemoryPlan::*> steps;
+        if (max_disk != 0 && plan.disk_storage > max_disk)
+            plan.minimal_disk_usage = true;
+        if (perturbative && (noise_type & NoiseTypes::Reduced) &&
+            me->dot == 2)
+            steps.push_back(&MemoryPlan::batched_noise);
+        steps.push_back(&MemoryPlan::fused_contraction_rotation);
+        if (me->mpo->schemer != nullptr)
+            steps.push_back(&MemoryPlan::lowmem_numerical_transform);
+        // fused multiplication forms delayed operators in dynamic memory
+        // and cannot be combined with delayed contraction or tasked gemm
+        if (!perturbative && me->delayed_contraction.empty() &&
+            me->mpo->tf->opf->seq->mode != SeqTypes::Tasked)
+            steps.push_back(&MemoryPlan::fused_contraction_multiplication);
+        for (auto step : steps) {
+            if (fits(plan))
+                break;
+            if (plan.*step)
+                continue;
+            plan.*step = true;
+            if (plan.fused_contraction_multiplication)
+                plan.use_main_stack = false;
+            estimate(me, noise_type, davidson_max_size, plan);
+        }
+        // blocked operators can be moved out of the main stack
+        // when the budget for dynamic memory allows
+        if (!fits(plan) && plan.use_main_stack) {
+            MemoryPlan xplan = plan;
+            xplan.use_main_stack = false;
+            estimate(me, noise_type, davidson_max_size, xplan);
+            if (fits(xplan))
+                plan = xplan;
+        }
+        plan.feasible = fits(plan);
+        plan.actual_main_peak = plan.actual_second_peak = 0;
+        plans.push_back(plan);
+        if (iprint >= 1)
+            cout << " Memory plan | " << plan.to_str() << endl;
+        return plan;
+    }
+    // set the switches in the moving environment and data frame
+    // and start recording the peak of the stacks for this sweep
+    virtual void apply(const MemoryPlan &plan,
+                       const shared_ptr<MovingEnvironment<S, FL, FLS>> &me,
+                       NoiseTypes &noise_type) {
+        if (!saved) {
+            saved_use_main_stack = frame_<FP>()->use_main_stack;
+            saved_minimal_disk_usage = frame_<FP>()->minimal_disk_usage;
+            saved_fused_rotation = me->fused_contraction_rotation;
+            saved_fused_multiplication = me->fused_contraction_multiplication;
+            saved_lowmem_transform = me->lowmem_numerical_transform;
+            saved_cached_contraction = me->cached_contraction;
+            saved_noise_type = noise_type;
+            saved = true;
+        }
+        if (plan.batched_noise && (noise_type & NoiseTypes::Perturbative))
+            noise_type = noise_type | NoiseTypes::Batched;
+        me->fused_contraction_rotation = plan.fused_contraction_rotation;
+        me->fused_contraction_multiplication =
+            plan.fused_contraction_multiplication;
+        me->lowmem_numerical_transform = plan.lowmem_numerical_transform;
+        // cached contraction is not compatible with fused rotation
+        if (plan.fused_contraction_rotation ||
+            plan.fused_contraction_multiplication)
+            me->cached_contraction = false;
+        frame_<FP>()->use_main_stack = plan.use_main_stack;
+        frame_<FP>()->minimal_disk_usage = plan.minimal_disk_usage;
+        frame_<FP>()->reset_peak_used_memory();
+    }
+    // recover all settings changed by apply
+    // (called after the last sweep, or when a sweep throws)
+    virtual void restore(const shared_ptr<MovingEnvironment<S, FL, FLS>> &me,
+                         NoiseTypes &noise_type) {
+        if (!saved)
+            return;
+        frame_<FP>()->use_main_stack = saved_use_main_stack;
+        frame_<FP>()->minimal_disk_usage = saved_minimal_disk_usage;
+        me->fused_contraction_rotation = saved_fused_rotation;
+        me->fused_contraction_multiplication = saved_fused_multiplication;
+        me->lowmem_numerical_transform = saved_lowmem_transform;
+        me->cached_contraction = saved_cached_contraction;
+        noise_type = saved_noise_type;
+        saved = false;
+    }
+    // record the actual peak of the stacks after one sweep
+    virtual void finish_sweep() {
+        if (plans.size() == 0)
+            return;
+        MemoryPlan &plan = plans.back();
+        plan.actual_main_peak = frame_<FP>()->peak_used_memory[0];
+        plan.actual_second_peak = frame_<FP>()->peak_used_memory[1];
+        if (iprint >= 1)
+            cout << " Memory plan | Pmain = "
+                 << Parsing::to_size_string(plan.main_peak) << " / "
+                 << Parsing::to_size_string(plan.actual_main_peak)
+                 << " (actual) | Pseco = "
+                 << Parsing::to_size_string(plan.second_peak) << " / "
+                 << Parsing::to_size_string(plan.actual_second_peak)
+                 << " (actual)" << endl;
+    }
+};
+
+} // namespace block2
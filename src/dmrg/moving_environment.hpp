@@ -145,6 +145,19 @@ struct ComplexMixture<S, complex<FP>, FP> : ComplexMixture<S, FP, FP> {
     }
 };
 
+// How the renormalized basis at one bond was last built
+// (used by MovingEnvironment::incremental_rotation)
+template <typename S, typename FL> struct RotationRecord {
+    // version of the basis and of the previous bond basis it was built from
+    // version 0 means that the bond has not been built in this environment
+    int version = 0, prev_version = 0;
+    // states of the previous bond (bra/ket) when the basis was built
+    vector<pair<S, int>> prev_bra_dims, prev_ket_dims;
+    // embedding of the basis of version emb_from into the current one
+    int emb_from = -1;
+    shared_ptr<StateEmbedding<S, FL>> bra_emb = nullptr, ket_emb = nullptr;
+};
+
 // A tensor network < bra | mpo | ket >
 template <typename S, typename FL, typename FLS> struct MovingEnvironment {
     typedef typename GMatrix<FL>::FP FP;
@@ -174,6 +187,10 @@ template <typename S, typename FL, typename FLS> struct MovingEnvironment {
     // whether contraction and rotation should be done within one-step, without
     // using large memory for blocking (only saving memory when no explicit
     // left/right_contact is invoked, which is the case for zero-dot expt)
+    // each blocked operator is formed one symmetry block at a time in
+    // scratch and rotated immediately, so it is never stored in full
+    // (SeqTypes::Simple and SeqTypes::Auto always use the dense fallback,
+    // which forms each blocked operator in full in dynamic memory)
     // fused_contraction_rotation = T conflicts with cached_contraction = T
     bool fused_contraction_rotation = false;
     // whether contraction and wavefunction multiplication should be done
@@ -190,6 +207,19 @@ template <typename S, typename FL, typename FLS> struct MovingEnvironment {
     int fuse_center;
     // Set this to false for non-propagate expectation
     bool save_environments = true;
+    // whether renormalized operators should be updated incrementally
+    // when the new rotation matrix keeps (up to phases) some states of
+    // the rotation matrix used for the previous environment at the same
+    // bond (e.g. after bond dimension increase or subspace expansion)
+    // only blocks involving new states are rotated. requires
+    // save_environments, and is not used with fused/stacked contraction
+    bool incremental_rotation = false;
+    // an old state is kept if its overlap with a new state is 1 - tol
+    FP incremental_rotation_tol = (FP)1E-10;
+    // numbers of kept states and all states in incremental rotations
+    size_t incr_kept_states = 0, incr_total_states = 0;
+    int rotation_version = 0;
+    vector<RotationRecord<S, FL>> left_rot_records, right_rot_records;
     MovingEnvironment(const shared_ptr<MPO<S, FL>> &mpo,
                       const shared_ptr<MPS<S, FLS>> &bra,
                       const shared_ptr<MPS<S, FLS>> &ket,
@@ -283,7 +313,8 @@ template <typename S, typename FL, typename FLS> struct MovingEnvironment {
         }
         Partition<S, FL>::init_left_op_infos_notrunc(
             i - 1, bra->info, ket->info, sl, subsl, envs[i - 1]->left_op_infos,
-            site_op_info, left_op_infos_notrunc, mpo->tf->opf->cg);
+            site_op_info, left_op_infos_notrunc, mpo->tf->opf->cg,
+            mpo->tf->opf->plan_cache);
         frame_<FP>()->activate(0);
         shared_ptr<OperatorTensor<S, FL>> new_left;
         if (cached_info.first == OpCachingTypes::Left &&
@@ -336,6 +367,26 @@ template <typename S, typename FL, typename FLS> struct MovingEnvironment {
         bra->load_tensor(i - 1);
         if (bra != ket)
             ket->load_tensor(i - 1);
+        shared_ptr<SparseMatrix<S, FL>> fbt =
+            ComplexMixture<S, FL, FLS>::forward(bra->tensors[i - 1]);
+        shared_ptr<SparseMatrix<S, FL>> fkt =
+            bra == ket
+                ? fbt
+                : ComplexMixture<S, FL, FLS>::forward(ket->tensors[i - 1]);
+        const bool incr = incremental_rotation_enabled();
+        shared_ptr<OperatorTensor<S, FL>> old_left = nullptr;
+        shared_ptr<StateEmbedding<S, FL>> bra_emb = nullptr, ket_emb = nullptr;
+        if (incr) {
+            update_rotation_record(
+                i, true, fbt, fkt, get_state_dims(*bra->info->left_dims[i - 1]),
+                get_state_dims(*ket->info->left_dims[i - 1]), bra_emb, ket_emb);
+            // the old environment is only read when some states are kept
+            if (bra_emb != nullptr && bra_emb->n_kept != 0 &&
+                ket_emb != nullptr &&
+                !(mpo->schemer != nullptr &&
+                  i - 1 == mpo->schemer->left_trans_site))
+                old_left = load_old_environment(i, true);
+        }
         frame_<FP>()->reset(1);
         Partition<S, FL>::init_left_op_infos(i - 1, bra->info, ket->info, sl,
                                              envs[i]->left_op_infos);
@@ -350,13 +401,10 @@ template <typename S, typename FL, typename FLS> struct MovingEnvironment {
             dynamic_pointer_cast<ArchivedTensorFunctions<S, FL>>(mpo->tf)
                 ->offset = 0;
         }
-        shared_ptr<SparseMatrix<S, FL>> fbt =
-            ComplexMixture<S, FL, FLS>::forward(bra->tensors[i - 1]);
-        shared_ptr<SparseMatrix<S, FL>> fkt =
-            bra == ket
-                ? fbt
-                : ComplexMixture<S, FL, FLS>::forward(ket->tensors[i - 1]);
-        if (!fused_contraction_rotation)
+        if (!fused_contraction_rotation && old_left != nullptr)
+            mpo->tf->left_rotate_incremental(new_left, fbt, fkt, envs[i]->left,
+                                             old_left, *bra_emb, *ket_emb);
+        else if (!fused_contraction_rotation)
             mpo->tf->left_rotate(new_left, fbt, fkt, envs[i]->left);
         else if (stacked_mpo != nullptr) {
             mpo->tf->left_contract_rotate_stacked(
@@ -368,7 +416,6 @@ template <typename S, typename FL, typename FLS> struct MovingEnvironment {
             mpo->unload_left_operators(i - 1);
             stacked_mpo->unload_tensor(i - 1);
             stacked_mpo->unload_left_operators(i - 1);
-            copied_left = nullptr;
         } else {
             mpo->tf->left_contract_rotate(copied_left, mpo->tensors[i - 1], fbt,
                                           fkt, new_left, envs[i]->left,
@@ -377,7 +424,6 @@ template <typename S, typename FL, typename FLS> struct MovingEnvironment {
                                               : nullptr);
             mpo->unload_tensor(i - 1);
             mpo->unload_left_operators(i - 1);
-            copied_left = nullptr;
         }
         size_t blocking_mem = new_left->get_total_memory() + copied_mem;
         size_t renormal_mem = envs[i]->left->get_total_memory();
@@ -420,12 +466,16 @@ template <typename S, typename FL, typename FLS> struct MovingEnvironment {
         if (bra != ket)
             ket->unload_tensor(i - 1);
         bra->unload_tensor(i - 1);
-        if (frame_<FP>()->use_main_stack)
+        if (frame_<FP>()->use_main_stack) {
             new_left->deallocate();
+            // the copied environment is below the rotation matrices
+            if (copied_left != nullptr && copied_left != cached_opt)
+                copied_left->deallocate();
+        }
         Partition<S, FL>::deallocate_op_infos_notrunc(left_op_infos_notrunc);
         if (save_environments) {
             frame_<FP>()->save_data(1, get_left_partition_filename(i));
-            if (save_partition_info) {
+            if (save_partition_info || incr) {
                 frame_<FP>()->activate(1);
                 envs[i]->save_data(true, get_left_partition_filename(i, true));
                 frame_<FP>()->activate(0);
@@ -502,7 +552,7 @@ template <typename S, typename FL, typename FLS> struct MovingEnvironment {
         Partition<S, FL>::init_right_op_infos_notrunc(
             i + dot, bra->info, ket->info, sl, subsl,
             envs[i + 1]->right_op_infos, site_op_info, right_op_infos_notrunc,
-            mpo->tf->opf->cg);
+            mpo->tf->opf->cg, mpo->tf->opf->plan_cache);
         frame_<FP>()->activate(0);
         shared_ptr<OperatorTensor<S, FL>> new_right;
         if (cached_info.first == OpCachingTypes::Right &&
@@ -555,6 +605,28 @@ template <typename S, typename FL, typename FLS> struct MovingEnvironment {
         bra->load_tensor(i + dot);
         if (bra != ket)
             ket->load_tensor(i + dot);
+        shared_ptr<SparseMatrix<S, FL>> fbt =
+            ComplexMixture<S, FL, FLS>::forward(bra->tensors[i + dot]);
+        shared_ptr<SparseMatrix<S, FL>> fkt =
+            bra == ket
+                ? fbt
+                : ComplexMixture<S, FL, FLS>::forward(ket->tensors[i + dot]);
+        const bool incr = incremental_rotation_enabled();
+        shared_ptr<OperatorTensor<S, FL>> old_right = nullptr;
+        shared_ptr<StateEmbedding<S, FL>> bra_emb = nullptr, ket_emb = nullptr;
+        if (incr) {
+            update_rotation_record(
+                i, false, fbt, fkt,
+                get_state_dims(*bra->info->right_dims[i + dot + 1]),
+                get_state_dims(*ket->info->right_dims[i + dot + 1]), bra_emb,
+                ket_emb);
+            // the old environment is only read when some states are kept
+            if (bra_emb != nullptr && bra_emb->n_kept != 0 &&
+                ket_emb != nullptr &&
+                !(mpo->schemer != nullptr &&
+                  i + dot == mpo->schemer->right_trans_site))
+                old_right = load_old_environment(i, false);
+        }
         frame_<FP>()->reset(1);
         Partition<S, FL>::init_right_op_infos(i + dot, bra->info, ket->info, sl,
                                               envs[i]->right_op_infos);
@@ -569,13 +641,11 @@ template <typename S, typename FL, typename FLS> struct MovingEnvironment {
             dynamic_pointer_cast<ArchivedTensorFunctions<S, FL>>(mpo->tf)
                 ->offset = 0;
         }
-        shared_ptr<SparseMatrix<S, FL>> fbt =
-            ComplexMixture<S, FL, FLS>::forward(bra->tensors[i + dot]);
-        shared_ptr<SparseMatrix<S, FL>> fkt =
-            bra == ket
-                ? fbt
-                : ComplexMixture<S, FL, FLS>::forward(ket->tensors[i + dot]);
-        if (!fused_contraction_rotation)
+        if (!fused_contraction_rotation && old_right != nullptr)
+            mpo->tf->right_rotate_incremental(new_right, fbt, fkt,
+                                              envs[i]->right, old_right,
+                                              *bra_emb, *ket_emb);
+        else if (!fused_contraction_rotation)
             mpo->tf->right_rotate(new_right, fbt, fkt, envs[i]->right);
         else if (stacked_mpo != nullptr) {
             mpo->tf->right_contract_rotate_stacked(
@@ -587,7 +657,6 @@ template <typename S, typename FL, typename FLS> struct MovingEnvironment {
             mpo->unload_right_operators(i + dot);
             stacked_mpo->unload_tensor(i + dot);
             stacked_mpo->unload_right_operators(i + dot);
-            copied_right = nullptr;
         } else {
             mpo->tf->right_contract_rotate(
                 copied_right, mpo->tensors[i + dot], fbt, fkt, new_right,
@@ -597,7 +666,6 @@ template <typename S, typename FL, typename FLS> struct MovingEnvironment {
                     : nullptr);
             mpo->unload_tensor(i + dot);
             mpo->unload_right_operators(i + dot);
-            copied_right = nullptr;
         }
         size_t blocking_mem = new_right->get_total_memory() + copied_mem;
         size_t renormal_mem = envs[i]->right->get_total_memory();
@@ -643,12 +711,16 @@ template <typename S, typename FL, typename FLS> struct MovingEnvironment {
         if (bra != ket)
             ket->unload_tensor(i + dot);
         bra->unload_tensor(i + dot);
-        if (frame_<FP>()->use_main_stack)
+        if (frame_<FP>()->use_main_stack) {
             new_right->deallocate();
+            // the copied environment is below the rotation matrices
+            if (copied_right != nullptr && copied_right != cached_opt)
+                copied_right->deallocate();
+        }
         Partition<S, FL>::deallocate_op_infos_notrunc(right_op_infos_notrunc);
         if (save_environments) {
             frame_<FP>()->save_data(1, get_right_partition_filename(i));
-            if (save_partition_info) {
+            if (save_partition_info || incr) {
                 frame_<FP>()->activate(1);
                 envs[i]->save_data(false,
                                    get_right_partition_filename(i, true));
@@ -851,7 +923,263 @@ template <typename S, typename FL, typename FLS> struct MovingEnvironment {
            << ".PART." << tag << ".NPDM.FRAG." << Parsing::to_string(i);
         return ss.str();
     }
+    // rotation matrix used for the environment at bond i
+    string get_rotation_filename(int i, bool left, bool ket) const {
+        stringstream ss;
+        ss << frame_<FP>()->save_dir << "/" << frame_<FP>()->prefix_distri
+           << ".PART.ROT." << (ket ? "KET." : "") << tag
+           << (left ? ".LEFT." : ".RIGHT.") << Parsing::to_string(i);
+        return ss.str();
+    }
+    bool incremental_rotation_enabled() const {
+        return incremental_rotation && save_environments &&
+               !fused_contraction_rotation && stacked_mpo == nullptr &&
+               para_rule == nullptr &&
+               mpo->tf->get_type() == TensorFunctionsTypes::Normal;
+    }
+    static vector<pair<S, int>> get_state_dims(const StateInfo<S> &info) {
+        vector<pair<S, int>> r(info.n);
+        for (int i = 0; i < info.n; i++)
+            r[i] = make_pair(info.quanta[i], (int)info.n_states[i]);
+        return r;
+    }
+    // Embedding of the states of old_rot into the states of new_rot
+    // the rows (enlarged basis) are matched through the embedding prev_emb
+    // of the previous bond basis (identity if nullptr). An old state is
+    // kept if its image has unit overlap (within tol) with a new state
+    static shared_ptr<StateEmbedding<S, FL>>
+    get_state_embedding(const shared_ptr<SparseMatrix<S, FL>> &old_rot,
+                        const shared_ptr<SparseMatrix<S, FL>> &new_rot,
+                        const vector<pair<S, int>> &old_prev,
+                        const vector<pair<S, int>> &new_prev,
+                        const StateInfo<S> &site,
+                        const shared_ptr<StateEmbedding<S, FL>> &prev_emb,
+                        bool left, FP tol) {
+        // offsets of (a, b) blocks in each enlarged sector
+        // a = prev, b = site for left; a = site, b = prev for right
+        auto layout = [&site, left](const vector<pair<S, int>> &prev,
+                                    map<S, size_t> &sz) {
+            map<S, map<pair<S, S>, size_t>> mp;
+            const int na = left ? (int)prev.size() : site.n;
+            const int nb = left ? site.n : (int)prev.size();
+            for (int ia = 0; ia < na; ia++)
+                for (int ib = 0; ib < nb; ib++) {
+                    S qa = left ? prev[ia].first : site.quanta[ia];
+                    S qb = left ? site.quanta[ib] : prev[ib].first;
+                    size_t n =
+                        left ? (size_t)prev[ia].second * site.n_states[ib]
+                             : (size_t)site.n_states[ia] * prev[ib].second;
+                    S qc = qa + qb;
+                    for (int k = 0; k < qc.count(); k++) {
+                        mp[qc[k]][make_pair(qa, qb)] = sz[qc[k]];
+                        sz[qc[k]] += n;
+                    }
+                }
+            return mp;
+        };
+        map<S, size_t> osz, nsz;
+        map<S, map<pair<S, S>, size_t>> olay = layout(old_prev, osz),
+                                        nlay = layout(new_prev, nsz);
+        map<S, int> oprev, nprev, nsite;
+        for (auto &p : old_prev)
+            oprev[p.first] = p.second;
+        for (auto &p : new_prev)
+            nprev[p.first] = p.second;
+        for (int k = 0; k < site.n; k++)
+            nsite[site.quanta[k]] = site.n_states[k];
+        shared_ptr<StateEmbedding<S, FL>> emb =
+            make_shared<StateEmbedding<S, FL>>();
+        vector<FL> v, o;
+        for (int io = 0; io < old_rot->info->n; io++) {
+            S q = old_rot->info->quanta[io];
+            GMatrix<FL> mo = (*old_rot)[io];
+            const MKL_INT ko = left ? mo.n : mo.m, neo = left ? mo.m : mo.n;
+            vector<pair<int, FL>> &sec = emb->sectors[q];
+            sec.assign(ko, make_pair(-1, (FL)0.0));
+            emb->n_old += ko;
+            int inw = new_rot->info->find_state(q);
+            if (inw == -1 || ko == 0 || !olay.count(q) || !nlay.count(q))
+                continue;
+            GMatrix<FL> mn = (*new_rot)[inw];
+            const MKL_INT kn = left ? mn.n : mn.m, nen = left ? mn.m : mn.n;
+            if (osz.at(q) != (size_t)neo || nsz.at(q) != (size_t)nen ||
+                kn == 0)
+                continue;
+            // old enlarged row -> (new enlarged row, phase)
+            vector<pair<MKL_INT, FL>> rmap(neo, make_pair(-1, (FL)0.0));
+            const map<pair<S, S>, size_t> &nblk = nlay.at(q);
+            for (auto &ob : olay.at(q)) {
+                auto nb = nblk.find(ob.first);
+                if (nb == nblk.end())
+                    continue;
+                S qp = left ? ob.first.first : ob.first.second;
+                S qs = left ? ob.first.second : ob.first.first;
+                const int npo = oprev.at(qp), npn = nprev.at(qp);
+                const int ns = nsite.at(qs);
+                const vector<pair<int, FL>> *pe =
+                    prev_emb == nullptr ? nullptr : prev_emb->find(qp);
+                if (prev_emb == nullptr ? npo != npn
+                                        : (pe == nullptr ||
+                                           (int)pe->size() != npo))
+                    continue;
+                for (int xp = 0; xp < npo; xp++) {
+                    const int yp = pe == nullptr ? xp : (*pe)[xp].first;
+                    const FL ph = pe == nullptr ? (FL)1.0 : (*pe)[xp].second;
+                    if (yp == -1)
+                        continue;
+                    for (int xs = 0; xs < ns; xs++) {
+                        size_t ro = ob.second + (left ? (size_t)xp * ns + xs
+                                                      : (size_t)xs * npo + xp);
+                        size_t rn = nb->second + (left ? (size_t)yp * ns + xs
+                                                       : (size_t)xs * npn + yp);
+                        rmap[ro] = make_pair((MKL_INT)rn, ph);
+                    }
+                }
+            }
+            // conjugated images of old states in the new enlarged basis
+            // |old row> = conj(phase) |new row>
+            v.assign((size_t)ko * nen, 0);
+            vector<bool> valid(ko, true);
+            for (MKL_INT x = 0; x < ko; x++) {
+                FP wlost = 0;
+                for (MKL_INT r = 0; r < neo; r++) {
+                    const FL xv = left ? mo(r, x) : mo(x, r);
+                    if (rmap[r].first == -1)
+                        wlost += abs(xv) * abs(xv);
+                    else
+                        v[(size_t)x * nen + rmap[r].first] =
+                            rmap[r].second * xconj<FL>(xv);
+                }
+                valid[x] = wlost <= tol;
+            }
+            // o[x, p] = <old x | new p> (= phase of new p if kept)
+            o.assign((size_t)ko * kn, 0);
+            GMatrix<FL> mv(v.data(), ko, nen), mov(o.data(), ko, kn);
+            if (left)
+                GMatrixFunctions<FL>::multiply(mv, false, mn, false, mov, 1.0,
+                                               0.0);
+            else
+                GMatrixFunctions<FL>::multiply(mv, false, mn, 1, mov, 1.0,
+                                               0.0);
+            vector<bool> used(kn, false);
+            for (MKL_INT x = 0; x < ko; x++) {
+                if (!valid[x])
+                    continue;
+                MKL_INT pm = 0;
+                for (MKL_INT p = 1; p < kn; p++)
+                    if (abs(mov(x, p)) > abs(mov(x, pm)))
+                        pm = p;
+                const FP ov = abs(mov(x, pm));
+                if (used[pm] || abs((FP)1.0 - ov) > tol)
+                    continue;
+                used[pm] = true;
+                sec[x] = make_pair((int)pm, mov(x, pm) / (FL)ov);
+                emb->n_kept++;
+            }
+        }
+        return emb;
+    }
+    // Heap copy of the operators of the previous environment at bond i
+    // must be invoked when frame 1 can be discarded
+    shared_ptr<OperatorTensor<S, FL>> load_old_environment(int i,
+                                                           bool left) const {
+        const string data_name = left ? get_left_partition_filename(i)
+                                      : get_right_partition_filename(i);
+        const string info_name = left ? get_left_partition_filename(i, true)
+                                      : get_right_partition_filename(i, true);
+        if (!Parsing::file_exists(data_name) ||
+            !Parsing::file_exists(info_name))
+            return nullptr;
+        frame_<FP>()->activate(1);
+        Partition<S, FL> part(nullptr, nullptr, nullptr);
+        part.load_data(left, info_name);
+        frame_<FP>()->load_data(1, data_name);
+        shared_ptr<OperatorTensor<S, FL>> old_op =
+            left ? part.left : part.right;
+        shared_ptr<OperatorTensor<S, FL>> r = nullptr;
+        if (old_op != nullptr) {
+            shared_ptr<VectorAllocator<uint32_t>> i_alloc =
+                make_shared<VectorAllocator<uint32_t>>();
+            shared_ptr<VectorAllocator<FP>> d_alloc =
+                make_shared<VectorAllocator<FP>>();
+            r = make_shared<OperatorTensor<S, FL>>();
+            for (auto &p : old_op->ops)
+                if (p.second->get_type() == SparseMatrixTypes::Normal &&
+                    p.second->data != nullptr) {
+                    shared_ptr<SparseMatrix<S, FL>> mat =
+                        p.second->deep_copy(d_alloc);
+                    mat->info = make_shared<SparseMatrixInfo<S>>(
+                        p.second->info->deep_copy(i_alloc));
+                    r->ops[p.first] = mat;
+                }
+        }
+        frame_<FP>()->activate(0);
+        return r;
+    }
+    // Find the embedding of the previous basis at bond i into the new
+    // basis of fbt/fkt, then record the new basis
+    void update_rotation_record(int i, bool left,
+                                const shared_ptr<SparseMatrix<S, FL>> &fbt,
+                                const shared_ptr<SparseMatrix<S, FL>> &fkt,
+                                const vector<pair<S, int>> &prev_bra_dims,
+                                const vector<pair<S, int>> &prev_ket_dims,
+                                shared_ptr<StateEmbedding<S, FL>> &bra_emb,
+                                shared_ptr<StateEmbedding<S, FL>> &ket_emb) {
+        vector<RotationRecord<S, FL>> &recs =
+            left ? left_rot_records : right_rot_records;
+        if (recs.size() != n_sites + 1)
+            recs.resize(n_sites + 1);
+        RotationRecord<S, FL> &rec = recs[i];
+        const RotationRecord<S, FL> &prec = recs[left ? i - 1 : i + 1];
+        const int im = left ? i - 1 : i + dot;
+        bra_emb = ket_emb = nullptr;
+        // the previous bond is either unchanged or embedded
+        bool valid = rec.version != 0;
+        shared_ptr<StateEmbedding<S, FL>> pbemb = nullptr, pkemb = nullptr;
+        if (valid && prec.version != rec.prev_version) {
+            valid = prec.emb_from == rec.prev_version;
+            pbemb = prec.bra_emb, pkemb = prec.ket_emb;
+        }
+        const string bra_name = get_rotation_filename(i, left, false);
+        const string ket_name = get_rotation_filename(i, left, true);
+        if (valid && Parsing::file_exists(bra_name) &&
+            (bra == ket || Parsing::file_exists(ket_name))) {
+            shared_ptr<VectorAllocator<uint32_t>> i_alloc =
+                make_shared<VectorAllocator<uint32_t>>();
+            shared_ptr<VectorAllocator<FP>> d_alloc =
+                make_shared<VectorAllocator<FP>>();
+            shared_ptr<SparseMatrix<S, FL>> old_rot =
+                make_shared<SparseMatrix<S, FL>>(d_alloc);
+            old_rot->load_data(bra_name, true, i_alloc);
+            bra_emb = get_state_embedding(
+                old_rot, fbt, rec.prev_bra_dims, prev_bra_dims,
+                *bra->info->basis[im], pbemb, left, incremental_rotation_tol);
+            if (bra == ket)
+                ket_emb = bra_emb;
+            else {
+                old_rot->load_data(ket_name, true, i_alloc);
+                ket_emb = get_state_embedding(
+                    old_rot, fkt, rec.prev_ket_dims, prev_ket_dims,
+                    *ket->info->basis[im], pkemb, left,
+                    incremental_rotation_tol);
+            }
+            incr_kept_states += bra_emb->n_kept;
+        }
+        for (int k = 0; k < fbt->info->n; k++)
+            incr_total_states +=
+                left ? fbt->info->n_states_ket[k] : fbt->info->n_states_bra[k];
+        rec.emb_from = bra_emb != nullptr ? rec.version : -1;
+        rec.bra_emb = bra_emb, rec.ket_emb = ket_emb;
+        rec.version = ++rotation_version;
+        rec.prev_version = prec.version;
+        rec.prev_bra_dims = prev_bra_dims, rec.prev_ket_dims = prev_ket_dims;
+        fbt->save_data(bra_name, true);
+        if (bra != ket)
+            fkt->save_data(ket_name, true);
+    }
     void shallow_copy_to(const shared_ptr<MovingEnvironment> &me) const {
+        me->left_rot_records.clear();
+        me->right_rot_records.clear();
         for (int i = 0; i < n_sites; i++) {
             me->envs[i] = make_shared<Partition<S, FL>>(*envs[i]);
             me->envs[i]->left_op_infos = envs[i]->left_op_infos;
@@ -1200,6 +1528,8 @@ template <typename S, typename FL, typename FLS> struct MovingEnvironment {
         this->iprint = iprint;
         envs.clear();
         envs.resize(n_sites);
+        left_rot_records.clear();
+        right_rot_records.clear();
         frame_<FPS>()->twrite = frame_<FPS>()->tread = frame_<FPS>()->tasync =
             0;
         frame_<FPS>()->fpwrite = frame_<FPS>()->fpread = 0;
@@ -1396,6 +1726,8 @@ template <typename S, typename FL, typename FLS> struct MovingEnvironment {
         // two-site to one-site transition
         if (dot == 1 && envs[0]->middle.size() == 2) {
             frame_<FP>()->reset_buffer(1);
+            left_rot_records.clear();
+            right_rot_records.clear();
             if (center == end_site - 2 &&
                 (ket->canonical_form[end_site - 1] == 'C' ||
                  ket->canonical_form[end_site - 1] == 'M')) {
@@ -1473,6 +1805,12 @@ template <typename S, typename FL, typename FLS> struct MovingEnvironment {
                 string right_data_name = get_right_partition_filename(i, info);
                 if (Parsing::file_exists(right_data_name))
                     Parsing::remove_file(right_data_name);
+                // rotation matrices for incremental rotation (info = ket)
+                for (int left = 0; left < 2; left++) {
+                    string rot_name = get_rotation_filename(i, left, info);
+                    if (Parsing::file_exists(rot_name))
+                        Parsing::remove_file(rot_name);
+                }
             }
     }
     // Move the center site by one
@@ -1740,7 +2078,8 @@ template <typename S, typename FL, typename FLS> struct MovingEnvironment {
             frame_<FP>()->load_data(1, get_left_partition_filename(iL));
         Partition<S, FL>::init_left_op_infos_notrunc(
             iL, bra->info, ket->info, lsl, lsubsl, envs[iL]->left_op_infos,
-            site_op_info, left_op_infos, mpo->tf->opf->cg);
+            site_op_info, left_op_infos, mpo->tf->opf->cg,
+            mpo->tf->opf->plan_cache);
         // left contract
         frame_<FP>()->activate(0);
         if (cached_info.first == OpCachingTypes::Left &&
@@ -1881,7 +2220,7 @@ template <typename S, typename FL, typename FLS> struct MovingEnvironment {
         Partition<S, FL>::init_right_op_infos_notrunc(
             iR, bra->info, ket->info, rsl, rsubsl,
             envs[iR - dot + 1]->right_op_infos, site_op_info, right_op_infos,
-            mpo->tf->opf->cg);
+            mpo->tf->opf->cg, mpo->tf->opf->plan_cache);
         // right contract
         frame_<FP>()->activate(0);
         if (cached_info.first == OpCachingTypes::Right &&
@@ -4167,6 +4506,19 @@ template <typename S, typename FL, typename FLS> struct MovingEnvironment {
         vector<pair<int, int>> ss;
         FPS error = truncate_density_matrix(
             dm, ss, k, cutoff, store_wfn_spectra, wfn_spectra, trunc_type);
+        split_diagonalized_density_matrix(dm, wfn, ss, trace_right, normalize,
+                                          left, right);
+        return error;
+    }
+    // Build rotation matrix and wavefunction from the kept eigenvectors
+    // of a diagonalized density matrix
+    // ss: pair<quantum index in dm, eigenvector index in dm> (sorted)
+    static void split_diagonalized_density_matrix(
+        const shared_ptr<SparseMatrix<S, FLS>> &dm,
+        const shared_ptr<SparseMatrix<S, FLS>> &wfn,
+        const vector<pair<int, int>> &ss, bool trace_right, bool normalize,
+        shared_ptr<SparseMatrix<S, FLS>> &left,
+        shared_ptr<SparseMatrix<S, FLS>> &right) {
         // ilr: row index in dm
         // im: number of states
         vector<int> ilr;
@@ -4249,6 +4601,148 @@ template <typename S, typename FL, typename FLS> struct MovingEnvironment {
                 left->normalize();
         }
         assert(iss == ss.size());
+    }
+    // Split density matrix with subspace expansion (for one-site algorithms)
+    // After truncating dm to k states, at most k_expand states are added
+    // from the orthogonal complement of the kept states, as the leading
+    // eigenvectors of the projected density matrix of perturbed wavefunctions
+    // New states can have quantum numbers not present in wfn
+    // min_orth_norm: a new state is dropped if the norm left after
+    // orthogonalizing it against the stored states is smaller than this
+    // (such a state is mostly numerical noise of the eigensolver)
+    static FPS split_density_matrix_expanded(
+        const shared_ptr<SparseMatrix<S, FLS>> &dm,
+        const shared_ptr<SparseMatrix<S, FLS>> &wfn,
+        const shared_ptr<SparseMatrixGroup<S, FLS>> &pkets, int k,
+        int k_expand, bool trace_right, bool normalize,
+        shared_ptr<SparseMatrix<S, FLS>> &left,
+        shared_ptr<SparseMatrix<S, FLS>> &right, FPS cutoff,
+        bool store_wfn_spectra, vector<FPS> &wfn_spectra,
+        TruncationTypes trunc_type = TruncationTypes::Physical,
+        FPS min_orth_norm = (FPS)0.5) {
+        vector<pair<int, int>> ss;
+        FPS error = truncate_density_matrix(
+            dm, ss, k, cutoff, store_wfn_spectra, wfn_spectra, trunc_type);
+        shared_ptr<VectorAllocator<uint32_t>> i_alloc =
+            make_shared<VectorAllocator<uint32_t>>();
+        shared_ptr<VectorAllocator<FPS>> d_alloc =
+            make_shared<VectorAllocator<FPS>>();
+        // density matrix info including quanta of perturbed wavefunctions
+        vector<shared_ptr<SparseMatrixInfo<S>>> winfos = pkets->infos;
+        winfos.push_back(wfn->info);
+        shared_ptr<SparseMatrixInfo<S>> xinfo =
+            make_shared<SparseMatrixInfo<S>>(i_alloc);
+        xinfo->initialize_dm(winfos, dm->info->delta_quantum, trace_right);
+        shared_ptr<SparseMatrix<S, FLS>> xdm =
+            make_shared<SparseMatrix<S, FLS>>(d_alloc);
+        shared_ptr<SparseMatrix<S, FLS>> pdm =
+            make_shared<SparseMatrix<S, FLS>>(d_alloc);
+        xdm->allocate(xinfo);
+        pdm->allocate(xinfo);
+        // xss: kept eigenvectors in xdm
+        vector<int> dm_to_xdm(dm->info->n);
+        for (int i = 0; i < dm->info->n; i++) {
+            dm_to_xdm[i] = xinfo->find_state(dm->info->quanta[i]);
+            assert(dm_to_xdm[i] != -1);
+            GMatrixFunctions<FLS>::copy((*xdm)[dm_to_xdm[i]], (*dm)[i]);
+        }
+        vector<pair<int, int>> xss;
+        xss.reserve(ss.size() + k_expand);
+        for (auto &x : ss)
+            xss.push_back(make_pair(dm_to_xdm[x.first], x.second));
+        for (int i = 0; i < pkets->n; i++)
+            OperatorFunctions<S, FLS>::trans_product(
+                (*pkets)[i], pdm, trace_right, 0.0, NoiseTypes::None);
+        FPS ptrace = 0;
+        for (int i = 0; i < xinfo->n; i++)
+            for (MKL_INT j = 0; j < (*pdm)[i].m; j++)
+                ptrace += xreal<FLS>((*pdm)[i](j, j));
+        // project out kept states and diagonalize
+        vector<vector<int>> kept(xinfo->n);
+        for (auto &x : xss)
+            kept[x.first].push_back(x.second);
+        vector<GDiagonalMatrix<FPS>> eigen_values(
+            xinfo->n, GDiagonalMatrix<FPS>(nullptr, 0));
+        for (int i = 0; i < xinfo->n; i++) {
+            const MKL_INT n = (*pdm)[i].m, m = (MKL_INT)kept[i].size();
+            GMatrix<FLS> p = (*pdm)[i];
+            if (m != 0) {
+                GMatrix<FLS> v(nullptr, m, n), q(nullptr, n, n),
+                    t(nullptr, n, n);
+                v.allocate(d_alloc), q.allocate(d_alloc), t.allocate(d_alloc);
+                for (MKL_INT j = 0; j < m; j++)
+                    GMatrixFunctions<FLS>::copy(
+                        GMatrix<FLS>(&v(j, 0), 1, n),
+                        GMatrix<FLS>(&(*xdm)[i](kept[i][j], 0), 1, n));
+                // q = 1 - conj(v^H v) is the projector onto the complement
+                GMatrixFunctions<FLS>::multiply(v, 3, v, 0, q, -1.0, 0.0);
+                GMatrixFunctions<FLS>::conjugate(q);
+                for (MKL_INT j = 0; j < n; j++)
+                    q(j, j) += (FLS)1.0;
+                GMatrixFunctions<FLS>::multiply(q, 0, p, 0, t, 1.0, 0.0);
+                GMatrixFunctions<FLS>::multiply(t, 0, q, 0, p, 1.0, 0.0);
+                t.deallocate(d_alloc), q.deallocate(d_alloc),
+                    v.deallocate(d_alloc);
+            }
+            eigen_values[i] = GDiagonalMatrix<FPS>(nullptr, n);
+            eigen_values[i].allocate(d_alloc);
+            GMatrixFunctions<FLS>::eigs(p, eigen_values[i]);
+        }
+        // eigenvalues are in ascending order
+        // only the n - m largest ones can be outside the kept space
+        vector<pair<int, int>> pss;
+        for (int i = 0; i < xinfo->n; i++)
+            for (int j = (int)kept[i].size(); j < eigen_values[i].n; j++)
+                if (abs(ptrace) > TINY &&
+                    eigen_values[i].data[j] / ptrace > cutoff)
+                    pss.push_back(make_pair(i, j));
+        sort(pss.begin(), pss.end(),
+             [&eigen_values](const pair<int, int> &a, const pair<int, int> &b) {
+                 return eigen_values[a.first].data[a.second] >
+                        eigen_values[b.first].data[b.second];
+             });
+        if ((int)pss.size() > k_expand)
+            pss.resize(max(k_expand, 0));
+        // store new states in the rows of discarded states
+        // they are orthogonalized again against all stored states, since
+        // eigenvectors of small eigenvalues can be numerically unreliable
+        vector<vector<uint8_t>> used(xinfo->n);
+        for (int i = 0; i < xinfo->n; i++) {
+            used[i].resize((*xdm)[i].m, 0);
+            for (int j : kept[i])
+                used[i][j] = 1;
+        }
+        vector<int> ifree(xinfo->n, 0);
+        for (auto &x : pss) {
+            const MKL_INT n = (*xdm)[x.first].n;
+            GMatrix<FLS> w(&(*pdm)[x.first](x.second, 0), 1, n);
+            for (int it = 0; it < 2; it++)
+                for (int j : kept[x.first]) {
+                    GMatrix<FLS> v(&(*xdm)[x.first](j, 0), 1, n);
+                    GMatrixFunctions<FLS>::iadd(
+                        w, v, -GMatrixFunctions<FLS>::complex_dot(v, w));
+                }
+            FPS w_norm = GMatrixFunctions<FLS>::norm(w);
+            if (w_norm < min_orth_norm)
+                continue;
+            GMatrixFunctions<FLS>::iscale(w, (FPS)1.0 / w_norm);
+            int &j = ifree[x.first];
+            while (used[x.first][j])
+                j++;
+            used[x.first][j] = 1;
+            kept[x.first].push_back(j);
+            GMatrixFunctions<FLS>::copy(
+                GMatrix<FLS>(&(*xdm)[x.first](j, 0), 1, n), w);
+            xss.push_back(make_pair(x.first, j));
+        }
+        sort(xss.begin(), xss.end());
+        split_diagonalized_density_matrix(xdm, wfn, xss, trace_right,
+                                          normalize, left, right);
+        for (int i = xinfo->n - 1; i >= 0; i--)
+            eigen_values[i].deallocate(d_alloc);
+        pdm->deallocate();
+        xdm->deallocate();
+        xinfo->deallocate();
         return error;
     }
     // Split density matrix to two MultiMPS tensors by solving eigenvalue
@@ -146,8 +146,12 @@ template <typename S, typename FL> struct MPO {
     vector<vector<size_t>> archive_marks;
     size_t archive_schemer_mark;
     string archive_filename = "";
+    //! Sites whose data stays in memory until unpinned. Used when several
+    //! MovingEnvironment sharing this MPO sweep in lockstep
+    vector<bool> pinned_sites;
     string tag = "H";
     mutable double tread = 0;  //!< IO Time cost for reading scratch files.
+    mutable size_t nread = 0;  //!< Number of site data reads from scratch.
     mutable double twrite = 0; //!< IO Time cost for writing scratch files.
     shared_ptr<Hamiltonian<S, FL>> hamil =
         nullptr;   //!< Optional field, to prevent early release of Hamiltonian
@@ -319,8 +323,37 @@ template <typename S, typename FL> struct MPO {
            << xtag[ixtag] << "." << Parsing::to_string(i);
         return ss.str();
     }
+    bool is_pinned(int i) const {
+        return i >= 0 && i < (int)pinned_sites.size() && pinned_sites[i];
+    }
+    // Load all data of site i once and keep it in memory,
+    // so that later load/unload calls on site i are no-ops
+    void pin_site(int i) {
+        assert(i >= 0 && i < n_sites);
+        if (is_pinned(i))
+            return;
+        load_tensor(i);
+        load_left_operators(i);
+        load_right_operators(i);
+        if (i < (int)middle_operator_names.size())
+            load_middle_operators(i);
+        if ((int)pinned_sites.size() < n_sites)
+            pinned_sites.resize(n_sites, false);
+        pinned_sites[i] = true;
+    }
+    void unpin_site(int i) {
+        if (!is_pinned(i))
+            return;
+        pinned_sites[i] = false;
+        if (i < (int)middle_operator_names.size())
+            unload_middle_operators(i);
+        unload_right_operators(i);
+        unload_left_operators(i);
+        unload_tensor(i);
+    }
     void load_tensor(int i, bool no_ops = false) {
-        if (archive_filename == "" && !frame_<FP>()->minimal_memory_usage)
+        if ((archive_filename == "" && !frame_<FP>()->minimal_memory_usage) ||
+            is_pinned(i))
             return;
         Timer _t;
         _t.get_time();
@@ -344,6 +377,8 @@ template <typename S, typename FL> struct MPO {
         ifs.close();
 #pragma omp atomic
         tread += _t.get_time();
+#pragma omp atomic
+        nread++;
     }
     void save_tensor(int i) {
         if (!frame_<FP>()->minimal_memory_usage)
@@ -366,7 +401,8 @@ template <typename S, typename FL> struct MPO {
     }
     void unload_tensor(int i) {
         assert(i < n_sites);
-        if (archive_filename != "" || frame_<FP>()->minimal_memory_usage)
+        if ((archive_filename != "" || frame_<FP>()->minimal_memory_usage) &&
+            !is_pinned(i))
             tensors[i] = nullptr;
     }
     void load_schemer() {
@@ -416,7 +452,8 @@ template <typename S, typename FL> struct MPO {
             schemer->unload_data();
     }
     void load_left_operators(int i) {
-        if (archive_filename == "" && !frame_<FP>()->minimal_memory_usage)
+        if ((archive_filename == "" && !frame_<FP>()->minimal_memory_usage) ||
+            is_pinned(i))
             return;
         Timer _t;
         _t.get_time();
@@ -451,6 +488,8 @@ template <typename S, typename FL> struct MPO {
         ifs.close();
 #pragma omp atomic
         tread += _t.get_time();
+#pragma omp atomic
+        nread++;
     }
     void save_left_operators(int i) {
         if (!frame_<FP>()->minimal_memory_usage)
@@ -481,7 +520,8 @@ template <typename S, typename FL> struct MPO {
         twrite += _t.get_time();
     }
     void unload_left_operators(int i) {
-        if (archive_filename != "" || frame_<FP>()->minimal_memory_usage) {
+        if ((archive_filename != "" || frame_<FP>()->minimal_memory_usage) &&
+            !is_pinned(i)) {
             assert(i < n_sites);
             left_operator_names[i] = nullptr;
             if (left_operator_exprs.size() != 0)
@@ -489,7 +529,8 @@ template <typename S, typename FL> struct MPO {
         }
     }
     void load_right_operators(int i) {
-        if (archive_filename == "" && !frame_<FP>()->minimal_memory_usage)
+        if ((archive_filename == "" && !frame_<FP>()->minimal_memory_usage) ||
+            is_pinned(i))
             return;
         Timer _t;
         _t.get_time();
@@ -524,6 +565,8 @@ template <typename S, typename FL> struct MPO {
         ifs.close();
 #pragma omp atomic
         tread += _t.get_time();
+#pragma omp atomic
+        nread++;
     }
     void save_right_operators(int i) {
         if (!frame_<FP>()->minimal_memory_usage)
@@ -554,7 +597,8 @@ template <typename S, typename FL> struct MPO {
         twrite += _t.get_time();
     }
     void unload_right_operators(int i) {
-        if (archive_filename != "" || frame_<FP>()->minimal_memory_usage) {
+        if ((archive_filename != "" || frame_<FP>()->minimal_memory_usage) &&
+            !is_pinned(i)) {
             assert(i < n_sites);
             right_operator_names[i] = nullptr;
             if (right_operator_exprs.size() != 0)
@@ -562,7 +606,8 @@ template <typename S, typename FL> struct MPO {
         }
     }
     void load_middle_operators(int i) {
-        if (archive_filename == "" && !frame_<FP>()->minimal_memory_usage)
+        if ((archive_filename == "" && !frame_<FP>()->minimal_memory_usage) ||
+            is_pinned(i))
             return;
         Timer _t;
         _t.get_time();
@@ -597,6 +642,8 @@ template <typename S, typename FL> struct MPO {
         ifs.close();
 #pragma omp atomic
         tread += _t.get_time();
+#pragma omp atomic
+        nread++;
     }
     void save_middle_operators(int i) {
         if (!frame_<FP>()->minimal_memory_usage)
@@ -627,7 +674,8 @@ template <typename S, typename FL> struct MPO {
         twrite += _t.get_time();
     }
     void unload_middle_operators(int i) {
-        if (archive_filename != "" || frame_<FP>()->minimal_memory_usage) {
+        if ((archive_filename != "" || frame_<FP>()->minimal_memory_usage) &&
+            !is_pinned(i)) {
             assert(i < n_sites);
             middle_operator_names[i] = nullptr;
             middle_operator_exprs[i] = nullptr;
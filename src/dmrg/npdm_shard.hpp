@@ -0,0 +1,158 @@
+
+/*
+ * block2: Efficient MPO implementation of quantum chemistry DMRG
+ * Copyright (C) 2020-2021 Huanchen Zhai <hczhai@caltech.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "../core/matrix.hpp"
+#include "../core/parallel_rule.hpp"
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+namespace block2 {
+
+// Slice of a dense NPDM tensor owned by one rank.
+// The flat (row-major) index space of the full tensor is split into
+// contiguous ranges of nearly equal length, one per rank of comm.
+template <typename S, typename FL> struct NPDMShard {
+    // shape of the full tensor
+    vector<MKL_INT> shape;
+    // owned flat index range is [offset, offset + data->size())
+    size_t offset = 0;
+    shared_ptr<GTensor<FL>> data;
+    // nullptr means the whole tensor is owned
+    shared_ptr<ParallelCommunicator<S>> comm;
+    NPDMShard(const vector<MKL_INT> &shape,
+              const shared_ptr<ParallelCommunicator<S>> &comm = nullptr)
+        : shape(shape), comm(comm) {
+        vector<size_t> dx = displs();
+        offset = dx[rank()];
+        data = make_shared<GTensor<FL>>(
+            vector<MKL_INT>{(MKL_INT)(dx[rank() + 1] - offset)});
+        data->clear();
+    }
+    int rank() const { return comm == nullptr ? 0 : comm->rank; }
+    int n_ranks() const { return comm == nullptr ? 1 : comm->size; }
+    size_t size() const { return data->size(); }
+    size_t total_size() const {
+        size_t x = 1;
+        for (MKL_INT sh : shape)
+            x = x * (size_t)sh;
+        return x;
+    }
+    bool is_partial() const { return size() != total_size(); }
+    // start of the owned range of each rank, with total size appended
+    static vector<size_t> partition(size_t total, int n_ranks) {
+        vector<size_t> r(n_ranks + 1);
+        for (int i = 0; i <= n_ranks; i++)
+            r[i] = total / n_ranks * i + min(total % n_ranks, (size_t)i);
+        return r;
+    }
+    vector<size_t> displs() const {
+        return partition(total_size(), n_ranks());
+    }
+    // sum a full dense tensor over ranks and keep the owned slice
+    // the content of full is destroyed
+    void reduce_scatter(const shared_ptr<GTensor<FL>> &full) {
+        assert(full->size() == total_size());
+        if (comm != nullptr && comm->size != 1)
+            comm->reduce_scatter_sum(full->data->data(), displs());
+        memcpy(data->data->data(), full->data->data() + offset,
+               sizeof(FL) * size());
+    }
+    // full tensor on every rank (for small tensors only)
+    shared_ptr<GTensor<FL>> gather() const {
+        shared_ptr<GTensor<FL>> r = make_shared<GTensor<FL>>(shape);
+        r->clear();
+        memcpy(r->data->data() + offset, data->data->data(),
+               sizeof(FL) * size());
+        if (comm != nullptr && comm->size != 1)
+            comm->allreduce_sum(r->data->data(), r->size());
+        return r;
+    }
+    // throw on all ranks if any rank failed (collective)
+    void check_all_ranks(bool failed, const string &msg) const {
+        if (comm != nullptr)
+            comm->allreduce_logical_or(failed);
+        if (failed)
+            throw runtime_error(msg);
+    }
+    // write the full tensor as one numpy file on a shared file system
+    // each rank writes its own slice at the corresponding file offset
+    // every rank reaches each collective step even if its own I/O fails,
+    // so that an error is reported on all ranks instead of a deadlock
+    void save(const string &filename) const {
+        const string msg = "NPDMShard::save on '" + filename + "' failed.";
+        GTensor<FL> hdr;
+        hdr.shape = shape;
+        stringstream ss;
+        const size_t hlen = hdr.write_header(ss);
+        bool failed = false;
+        if (rank() == 0) {
+            try {
+                ofstream ofs(filename.c_str(), ios::binary);
+                if (ofs.good())
+                    hdr.write_header(ofs);
+                failed = !ofs.good();
+                ofs.close();
+            } catch (...) {
+                failed = true;
+            }
+        }
+        check_all_ranks(failed, msg);
+        if (size() != 0) {
+            try {
+                fstream fs(filename.c_str(), ios::binary | ios::in | ios::out);
+                if (fs.good()) {
+                    fs.seekp(hlen + sizeof(FL) * offset);
+                    fs.write((char *)data->data->data(), sizeof(FL) * size());
+                }
+                failed = !fs.good();
+                fs.close();
+            } catch (...) {
+                failed = true;
+            }
+        }
+        check_all_ranks(failed, msg);
+    }
+    // write the owned slice as a one-dimensional numpy file per rank
+    // the file name is "<filename>.<rank>.npy"
+    void save_local(const string &filename) const {
+        string fn = filename + "." + Parsing::to_string(rank()) + ".npy";
+        ofstream ofs(fn.c_str(), ios::binary);
+        if (!ofs.good())
+            throw runtime_error("NPDMShard::save_local on '" + fn +
+                                "' failed.");
+        if (size() != 0)
+            data->write_array(ofs);
+        else
+            data->write_header(ofs);
+        if (!ofs.good())
+            throw runtime_error("NPDMShard::save_local on '" + fn +
+                                "' failed.");
+        ofs.close();
+    }
+};
+
+} // namespace block2
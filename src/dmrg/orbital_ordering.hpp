@@ -22,12 +22,14 @@
 
 #include "../core/integral.hpp"
 #include "../core/matrix_functions.hpp"
+#include "../core/threading.hpp"
 #include "../core/utils.hpp"
 #include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstdint>
 #include <cstring>
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -43,12 +45,23 @@ template <typename EvalOp> struct GAOptimization {
     int n_elite = 1;
     double clone_rate = 0.1;
     double mutate_rate = 0.1;
-    vector<double> cumu_probs, probs;
+    // wall time when the best cost first reaches target_cost (-1 if never)
+    double target_cost = 0.0, time_to_target = -1.0, t_start = 0.0;
+    int iprint = 0;
+    // optional cost change of swapping ord[a] and ord[b]
+    // if set, costs of cloned (and point mutated) configs are not recomputed
+    function<double(const uint16_t *, int, int)> swap_delta_op = nullptr;
+    vector<double> cumu_probs, probs, costs;
+    // costs known before evaluate (by incremental update)
+    vector<uint8_t> cost_known;
     vector<uint16_t> ords;
+    Timer timer;
     GAOptimization(uint16_t n_sites, const vector<uint16_t> &ford, EvalOp &evop,
                    int n_configs)
         : ford(ford), n_sites(n_sites), evop(evop), n_configs(n_configs) {
         probs.resize(n_configs);
+        costs.resize(n_configs);
+        cost_known.resize(n_configs, 0);
         cumu_probs.resize(n_configs);
         ords.resize(2 * n_sites * n_configs);
         for (n_bunit = 0; (1 << n_bunit) < (int)(sizeof(uint16_t) * 8);
@@ -63,10 +76,16 @@ template <typename EvalOp> struct GAOptimization {
         return r;
     }
     void evaluate(int ir) {
-        uint16_t irr = ir * n_sites * n_configs;
+        int irr = ir * n_sites * n_configs;
         double ssq_prob = 0, sum_prob = 0, min_prob = 1E99;
+        int ntg = threading->activate_global();
+#pragma omp parallel for schedule(static) num_threads(ntg)
+        for (int i = 0; i < n_configs; i++)
+            if (!cost_known[i])
+                costs[i] = evop(ords.data() + irr + i * n_sites);
+        threading->activate_normal();
         for (int i = 0; i < n_configs; i++) {
-            probs[i] = sqrt(abs(evop(ords.data() + irr + i * n_sites)));
+            probs[i] = sqrt(abs(costs[i]));
             sum_prob += probs[i];
             ssq_prob += probs[i] * probs[i];
             min_prob = min(min_prob, probs[i]);
@@ -86,12 +105,13 @@ template <typename EvalOp> struct GAOptimization {
         cumu_probs[n_configs - 1] = 1.0;
     }
     void initialize(int ir) {
-        uint16_t irr = ir * n_sites * n_configs;
+        int irr = ir * n_sites * n_configs;
         if (ford.size() != 0)
             memcpy(ords.data() + irr, ford.data(), n_sites * sizeof(uint16_t));
         vector<uint16_t> idx(n_sites);
         for (uint16_t i = 0; i < n_sites; i++)
             idx[i] = i;
+        memset(cost_known.data(), 0, n_configs * sizeof(uint8_t));
         for (int i = ford.size() != 0; i < n_configs; i++) {
             for (uint16_t j = 0; j < n_sites; j++)
                 swap(idx[j], idx[Random::rand_int(j, n_sites)]);
@@ -99,17 +119,20 @@ template <typename EvalOp> struct GAOptimization {
                    n_sites * sizeof(uint16_t));
         }
     }
-    void point_mutate(int ic) {
+    // cost is updated if known, and is the cost of config ic
+    void point_mutate(int ic, uint8_t &known, double &cost) {
         int itrial = Random::rand_int(1, 4);
         for (int i = 0; i < itrial; i++) {
             int ja = Random::rand_int(0, n_sites),
                 jb = Random::rand_int(0, n_sites);
+            if (known)
+                cost += swap_delta_op(ords.data() + ic, ja, jb);
             swap(ords[ic + ja], ords[ic + jb]);
         }
     }
     void global_mutate(int ic) {
         vector<uint16_t> tmp;
-        tmp.reserve(n_sites + 4);
+        tmp.resize(n_sites + 4);
         memcpy(tmp.data(), ords.data() + ic, n_sites * sizeof(uint16_t));
         for (int i = 0; i < 4; i++)
             tmp[n_sites + i] = Random::rand_int(0, n_sites);
@@ -124,7 +147,7 @@ template <typename EvalOp> struct GAOptimization {
     }
     void cross_over(int ia, int ib, int ic) {
         vector<uint16_t> tmp;
-        tmp.reserve(n_sites * 2 + n_bits);
+        tmp.resize(n_sites * 2 + n_bits);
         for (uint16_t i = 0; i < n_sites; i++)
             tmp[ords[ia + i]] = i, tmp[ords[ib + i] + n_sites] = i;
         for (uint16_t i = 0; i < n_bits; i++)
@@ -150,18 +173,24 @@ template <typename EvalOp> struct GAOptimization {
     }
     void optimize(int ip) {
         int ir = !ip;
-        uint16_t irr = ir * n_sites * n_configs;
-        uint16_t ipp = ip * n_sites * n_configs;
+        int irr = ir * n_sites * n_configs;
+        int ipp = ip * n_sites * n_configs;
         vector<uint16_t> idx(n_configs);
         for (int i = 0; i < n_configs; i++)
             idx[i] = i;
         sort(idx.begin(), idx.end(), [this](uint16_t i, uint16_t j) {
             return this->probs[i] > this->probs[j];
         });
-        for (int i = 0; i < n_elite; i++)
+        // costs of elites and clones are carried over with swap deltas
+        const bool incremental = swap_delta_op != nullptr;
+        vector<double> xcosts(n_configs, 0.0);
+        vector<uint8_t> xknown(n_configs, 0);
+        for (int i = 0; i < n_elite; i++) {
             memcpy(ords.data() + irr + i * n_sites,
                    ords.data() + ipp + idx[i] * n_sites,
                    n_sites * sizeof(uint16_t));
+            xcosts[i] = costs[idx[i]], xknown[i] = incremental;
+        }
         for (int i = n_elite; i < n_configs; i++) {
             if (Random::rand_double() < clone_rate) {
                 int j = (int)(lower_bound(cumu_probs.begin(), cumu_probs.end(),
@@ -170,6 +199,7 @@ template <typename EvalOp> struct GAOptimization {
                 memcpy(ords.data() + irr + i * n_sites,
                        ords.data() + ipp + j * n_sites,
                        n_sites * sizeof(uint16_t));
+                xcosts[i] = costs[j], xknown[i] = incremental;
             } else {
                 int ja = (int)(lower_bound(cumu_probs.begin(), cumu_probs.end(),
                                            Random::rand_double()) -
@@ -181,18 +211,37 @@ template <typename EvalOp> struct GAOptimization {
                            irr + i * n_sites);
             }
             if (Random::rand_double() < mutate_rate)
-                point_mutate(irr + i * n_sites);
+                point_mutate(irr + i * n_sites, xknown[i], xcosts[i]);
             if (Random::rand_double() < mutate_rate)
-                global_mutate(irr + i * n_sites);
+                global_mutate(irr + i * n_sites), xknown[i] = 0;
         }
+        costs = xcosts, cost_known = xknown;
         evaluate(ir);
     }
+    void check_target(int ig) {
+        double best = *min_element(costs.begin(), costs.end());
+        if (time_to_target < 0 && best <= target_cost) {
+            timer.get_time();
+            time_to_target = timer.current - t_start;
+            if (iprint)
+                cout << "GA target cost " << target_cost << " reached at gen "
+                     << ig << " T = " << fixed << setprecision(3)
+                     << time_to_target << endl;
+        }
+        if (iprint >= 2)
+            cout << "GA gen " << ig << " best cost = " << scientific
+                 << setprecision(8) << best << endl;
+    }
     vector<uint16_t> solve(int n_generations = 10000) {
+        timer.get_time();
+        t_start = timer.current;
         initialize(n_generations & 1);
         evaluate(n_generations & 1);
         for (int i = 0, ip = n_generations & 1; i < n_generations;
-             i++, ip = !ip)
+             i++, ip = !ip) {
             optimize(ip);
+            check_target(i);
+        }
         return find_best();
     }
 };
@@ -220,11 +269,134 @@ struct OrbitalOrdering {
                         rsum += kmat[ord[i] * n_sites + ord[j]];
         return r / rsum;
     }
+    // change of the (unnormalized) cost when swapping ord[a] and ord[b]
+    // O(n), kmat must be symmetric
+    static double swap_delta(uint16_t n_sites, const vector<double> &kmat,
+                             const vector<uint16_t> &ord, int a, int b) {
+        return swap_delta(n_sites, kmat.data(), ord.data(), a, b);
+    }
+    static double swap_delta(uint16_t n_sites, const double *kmat,
+                             const uint16_t *ord, int a, int b) {
+        const double *kx = kmat + ord[a] * n_sites;
+        const double *ky = kmat + ord[b] * n_sites;
+        double r = 0;
+        for (int k = 0; k < n_sites; k++)
+            if (k != a && k != b)
+                r += (double)((k - a) * (k - a) - (k - b) * (k - b)) *
+                     (ky[ord[k]] - kx[ord[k]]);
+        return r;
+    }
+    // change of the (unnormalized) cost when reversing ord[a:b + 1] (2-opt)
+    // O(n (b - a)), kmat must be symmetric
+    static double reverse_delta(uint16_t n_sites, const vector<double> &kmat,
+                                const vector<uint16_t> &ord, int a, int b) {
+        double r = 0;
+        for (int p = a; p <= b; p++) {
+            const double *kp = kmat.data() + ord[p] * n_sites;
+            const int q = a + b - p;
+            double rp = 0;
+            for (int k = 0; k < a; k++)
+                rp += (double)(2 * k - p - q) * kp[ord[k]];
+            for (int k = b + 1; k < n_sites; k++)
+                rp += (double)(2 * k - p - q) * kp[ord[k]];
+            r += (double)(p - q) * rp;
+        }
+        return r;
+    }
+    // simulated annealing with swap and 2-opt moves,
+    // followed by a greedy swap descent. Seeded from fiedler if ord is empty.
+    // The result is deterministic for a given seed (seed must be nonzero)
+    static vector<uint16_t>
+    sa_opt(uint16_t n_sites, const vector<double> &kmat,
+           const vector<uint16_t> &init_ord = vector<uint16_t>(),
+           int n_steps = 1000000, unsigned seed = 1234,
+           double target_cost = 0.0, int iprint = 0) {
+        assert(kmat.size() == n_sites * n_sites);
+        vector<uint16_t> ord =
+            init_ord.size() != 0 ? init_ord : fiedler(n_sites, kmat);
+        if (n_sites < 3)
+            return ord;
+        double rsum = 0;
+        for (uint16_t i = 0; i < n_sites; i++)
+            for (uint16_t j = i + 1; j < n_sites; j++)
+                rsum += kmat[i * n_sites + j];
+        Timer t;
+        t.get_time();
+        const double t_start = t.current;
+        double time_to_target = -1;
+        RandomMT rng(seed);
+        double cost = evaluate(n_sites, kmat, ord) * rsum;
+        vector<uint16_t> best_ord = ord;
+        double best_cost = cost;
+        auto check_target = [&]() {
+            if (time_to_target < 0 && best_cost <= target_cost * rsum) {
+                t.get_time();
+                time_to_target = t.current - t_start;
+                if (iprint)
+                    cout << "SA target cost " << target_cost << " reached T = "
+                         << fixed << setprecision(3) << time_to_target << endl;
+            }
+        };
+        check_target();
+        // initial temperature from the mean change of random swaps
+        double t0 = 0;
+        for (int i = 0; i < n_sites; i++) {
+            int a = rng.rand_int(0, n_sites), b = rng.rand_int(0, n_sites);
+            t0 += abs(swap_delta(n_sites, kmat, ord, a, b));
+        }
+        t0 = max(t0 / n_sites, 1E-12 * abs(cost));
+        const double t1 = t0 * 1E-4;
+        const double alpha = pow(t1 / t0, 1.0 / max(n_steps - 1, 1));
+        double temp = t0;
+        for (int i = 0; i < n_steps; i++, temp *= alpha) {
+            int a = rng.rand_int(0, n_sites), b = rng.rand_int(0, n_sites - 1);
+            b += b >= a;
+            if (a > b)
+                swap(a, b);
+            const bool two_opt = rng.rand_double() < 0.5;
+            const double delta =
+                two_opt ? reverse_delta(n_sites, kmat, ord, a, b)
+                        : swap_delta(n_sites, kmat, ord, a, b);
+            if (delta <= 0 || rng.rand_double() < exp(-delta / temp)) {
+                if (two_opt)
+                    reverse(ord.begin() + a, ord.begin() + b + 1);
+                else
+                    swap(ord[a], ord[b]);
+                cost += delta;
+                if (cost < best_cost) {
+                    best_cost = cost, best_ord = ord;
+                    check_target();
+                }
+            }
+        }
+        // greedy descent on the best ordering
+        ord = best_ord;
+        for (bool improved = true; improved;) {
+            improved = false;
+            for (int a = 0; a < n_sites; a++)
+                for (int b = a + 1; b < n_sites; b++) {
+                    const double delta = swap_delta(n_sites, kmat, ord, a, b);
+                    if (delta < -1E-12 * abs(best_cost)) {
+                        swap(ord[a], ord[b]);
+                        best_cost += delta, improved = true;
+                    }
+                }
+        }
+        check_target();
+        if (iprint) {
+            t.get_time();
+            cout << "SA final cost = " << scientific << setprecision(8)
+                 << best_cost / rsum << " T = " << fixed << setprecision(3)
+                 << t.current - t_start << endl;
+        }
+        return ord;
+    }
     static vector<uint16_t> ga_opt(uint16_t n_sites, const vector<double> &kmat,
                                    int n_generations = 10000,
                                    int n_configs = 54, int n_elite = 5,
                                    double clone_rate = 0.1,
-                                   double mutate_rate = 0.1) {
+                                   double mutate_rate = 0.1,
+                                   double target_cost = 0.0, int iprint = 0) {
         double rsum = 0;
         for (uint16_t i = 0; i < n_sites; i++)
             for (uint16_t j = i + 1; j < n_sites; j++)
@@ -238,9 +410,15 @@ struct OrbitalOrdering {
         };
         vector<uint16_t> ford = fiedler(n_sites, kmat);
         GAOptimization<decltype(eval_op)> ga(n_sites, ford, eval_op, n_configs);
+        ga.swap_delta_op = [n_sites, rsum, &kmat](const uint16_t *ord, int a,
+                                                  int b) {
+            return swap_delta(n_sites, kmat.data(), ord, a, b) / rsum;
+        };
         ga.n_elite = n_elite;
         ga.clone_rate = clone_rate;
         ga.mutate_rate = mutate_rate;
+        ga.target_cost = target_cost;
+        ga.iprint = iprint;
         return ga.solve(n_generations);
     }
     static vector<uint16_t> fiedler(uint16_t n_sites,
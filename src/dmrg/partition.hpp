@@ -609,7 +609,8 @@ template <typename S, typename FL> struct Partition {
             &prev_left_op_infos,
         const vector<pair<S, shared_ptr<SparseMatrixInfo<S>>>> &site_op_infos,
         vector<pair<S, shared_ptr<SparseMatrixInfo<S>>>> &left_op_infos_notrunc,
-        const shared_ptr<CG<S>> &cg) {
+        const shared_ptr<CG<S>> &cg,
+        const shared_ptr<ConnectionPlanCache<S>> &plan_cache = nullptr) {
         frame_<FP>()->activate(1);
         bra_info->load_left_dims(m);
         StateInfo<S> ibra_prev = *bra_info->left_dims[m], iket_prev = ibra_prev;
@@ -643,7 +644,8 @@ template <typename S, typename FL> struct Partition {
             cinfo->initialize_tp(
                 sl[i], subsl[i], ibra_notrunc, iket_notrunc, ibra_prev,
                 *bra_info->basis[m], iket_prev, *ket_info->basis[m], ibra_cinfo,
-                iket_cinfo, prev_left_op_infos, site_op_infos, lop_notrunc, cg);
+                iket_cinfo, prev_left_op_infos, site_op_infos, lop_notrunc, cg,
+                plan_cache);
             lop_notrunc->cinfo = cinfo;
         }
         frame_<FP>()->activate(1);
@@ -691,7 +693,8 @@ template <typename S, typename FL> struct Partition {
         const vector<pair<S, shared_ptr<SparseMatrixInfo<S>>>> &site_op_infos,
         vector<pair<S, shared_ptr<SparseMatrixInfo<S>>>>
             &right_op_infos_notrunc,
-        const shared_ptr<CG<S>> &cg) {
+        const shared_ptr<CG<S>> &cg,
+        const shared_ptr<ConnectionPlanCache<S>> &plan_cache = nullptr) {
         frame_<FP>()->activate(1);
         bra_info->load_right_dims(m + 1);
         StateInfo<S> ibra_prev = *bra_info->right_dims[m + 1],
@@ -726,7 +729,7 @@ template <typename S, typename FL> struct Partition {
                                  *bra_info->basis[m], ibra_prev,
                                  *ket_info->basis[m], iket_prev, ibra_cinfo,
                                  iket_cinfo, site_op_infos, prev_right_op_infos,
-                                 rop_notrunc, cg);
+                                 rop_notrunc, cg, plan_cache);
             rop_notrunc->cinfo = cinfo;
         }
         frame_<FP>()->activate(1);
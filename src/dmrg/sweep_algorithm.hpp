@@ -25,7 +25,9 @@
 #include "../core/sparse_matrix.hpp"
 #include "../core/spin_permutation.hpp"
 #include "effective_functions.hpp"
+#include "memory_planner.hpp"
 #include "moving_environment.hpp"
+#include "npdm_shard.hpp"
 #include "parallel_mps.hpp"
 #include "qc_ncorr.hpp"
 #include "qc_pdm1.hpp"
@@ -108,6 +110,15 @@ template <typename S, typename FL, typename FLS> struct DMRG {
     FPS quanta_cutoff = 1E-3;
     bool decomp_last_site = true;
     bool state_specific = false;
+    // number of states added by subspace expansion in one-site sweeps,
+    // relative to the bond dimension (zero means no expansion)
+    FPS subspace_expansion = 0.0;
+    // max number of target quanta in one batch of perturbed wavefunctions
+    // with NoiseTypes::Batched (zero means only limited by free memory)
+    int noise_batch_size = 0;
+    // if not nullptr, memory-saving switches are chosen before each sweep
+    // from a dry-run estimate of the peak memory
+    shared_ptr<MemoryPlanner<S, FL, FLS>> mem_planner = nullptr;
     vector<FPS> projection_weights;
     size_t sweep_cumulative_nflop = 0;
     size_t sweep_max_pket_size = 0;
@@ -181,6 +192,11 @@ template <typename S, typename FL, typename FLS> struct DMRG {
     // canonical form for wavefunction: K = left-fused, S = right-fused
     Iteration update_one_dot(int i, bool forward, ubond_t bond_dim, FPS noise,
                              FPS davidson_conv_thrd) {
+        if (subspace_expansion != 0 &&
+            (decomp_type != DecompositionTypes::DensityMatrix ||
+             me->bra != me->ket || context_ket != nullptr))
+            throw runtime_error("DMRG subspace expansion requires density "
+                                "matrix decomposition and a single ket!");
         frame_<FPS>()->activate(0);
         bool fuse_left = i <= me->fuse_center;
         vector<shared_ptr<MPS<S, FLS>>> mpss = {me->ket};
@@ -238,9 +254,13 @@ template <typename S, typename FL, typename FLS> struct DMRG {
             !decomp_last_site &&
             ((forward && i == sweep_end_site - 1 && !fuse_left) ||
              (!forward && i == sweep_start_site && fuse_left));
-        bool build_pdm = noise != 0 && (noise_type & NoiseTypes::Collected);
+        // subspace expansion needs the perturbed wavefunctions summed over
+        // all procs, so the noise is then added from them on the root proc
+        bool build_pdm = noise != 0 && (noise_type & NoiseTypes::Collected) &&
+                         subspace_expansion == 0;
         // effective hamiltonian
-        if (davidson_soft_max_iter != 0 || noise != 0)
+        if (davidson_soft_max_iter != 0 || noise != 0 ||
+            subspace_expansion != 0)
             pdi = one_dot_eigs_and_perturb(forward, fuse_left, i,
                                            davidson_conv_thrd, noise, pket);
         else if (me->para_rule != nullptr)
@@ -426,10 +446,20 @@ template <typename S, typename FL, typename FLS> struct DMRG {
                     if (me->bra != me->ket)
                         dm_b =
                             dm->deep_copy(make_shared<VectorAllocator<FPS>>());
-                    error = MovingEnvironment<S, FL, FLS>::split_density_matrix(
-                        dm, xket->tensors[i], (int)bond_dim, forward, true,
-                        left_k, right_k, cutoff, store_wfn_spectra, wfn_spectra,
-                        trunc_type);
+                    if (subspace_expansion != 0 && xpket != nullptr)
+                        error = MovingEnvironment<S, FL, FLS>::
+                            split_density_matrix_expanded(
+                                dm, xket->tensors[i], xpket, (int)bond_dim,
+                                (int)ceil(subspace_expansion * bond_dim),
+                                forward, true, left_k, right_k, cutoff,
+                                store_wfn_spectra, wfn_spectra, trunc_type);
+                    else
+                        error = MovingEnvironment<S, FL, FLS>::
+                            split_density_matrix(dm, xket->tensors[i],
+                                                 (int)bond_dim, forward, true,
+                                                 left_k, right_k, cutoff,
+                                                 store_wfn_spectra, wfn_spectra,
+                                                 trunc_type);
                     // TODO: this may have some problem if small numerical
                     // instability happens when truncating same dm twice
                     if (me->bra != me->ket) {
@@ -796,13 +826,31 @@ template <typename S, typename FL, typename FLS> struct DMRG {
         if ((noise_type & NoiseTypes::Perturbative) && noise != 0)
             pket = h_eff->perturbative_noise(
                 forward, i, i, fuse_left ? FuseTypes::FuseL : FuseTypes::FuseR,
-                me->ket->info, noise_type, me->para_rule);
+                me->ket->info,
+                subspace_expansion != 0
+                    ? NoiseTypes((uint16_t)noise_type &
+                                 ~(uint16_t)NoiseTypes::Collected)
+                    : noise_type,
+                me->para_rule);
+        else if (subspace_expansion != 0)
+            pket = h_eff->perturbative_noise(
+                forward, i, i, fuse_left ? FuseTypes::FuseL : FuseTypes::FuseR,
+                me->ket->info, NoiseTypes::ReducedPerturbative, me->para_rule);
         tprt += _t.get_time();
         h_eff->deallocate();
         if (m_eff != nullptr)
             m_eff->deallocate();
         return pdi;
     }
+    // whether the perturbative noise can be added to the density matrix
+    // in batches (NoiseTypes::Batched)
+    bool batched_noise_supported(NoiseTypes nt) const {
+        return (nt & NoiseTypes::Batched) && (nt & NoiseTypes::Perturbative) &&
+               (nt & NoiseTypes::Reduced) && me->dot == 2 &&
+               decomp_type == DecompositionTypes::DensityMatrix &&
+               context_ket == nullptr &&
+               !(me->ket->get_type() & MPSTypes::MultiWfn);
+    }
     // two-site single-state dmrg algorithm
     // canonical form for wavefunction: C = center
     Iteration update_two_dot(int i, bool forward, ubond_t bond_dim, FPS noise,
@@ -858,11 +906,14 @@ template <typename S, typename FL, typename FLS> struct DMRG {
         // effective hamiltonian
         if (davidson_soft_max_iter != 0 || noise != 0)
             pdi = two_dot_eigs_and_perturb(forward, i, davidson_conv_thrd,
-                                           noise, pket);
+                                           noise, pket, pdm);
         else if (me->para_rule != nullptr)
             me->para_rule->comm->barrier();
         if (pket != nullptr)
             sweep_max_pket_size = max(sweep_max_pket_size, pket->total_memory);
+        // with NoiseTypes::Batched the noise is already in pdm
+        if (pdm != nullptr)
+            build_pdm = true;
         shared_ptr<SparseMatrixGroup<S, FLS>> xpket = pket;
         shared_ptr<SparseMatrix<S, FLS>> xold_ket = old_ket;
         shared_ptr<MPS<S, FLS>> xket = me->ket;
@@ -912,11 +963,13 @@ template <typename S, typename FL, typename FLS> struct DMRG {
         if (build_pdm) {
             _t.get_time();
             assert(decomp_type == DecompositionTypes::DensityMatrix);
-            pdm = MovingEnvironment<S, FL, FLS>::density_matrix(
-                xket->info->vacuum, xold_ket, forward,
-                me->para_rule != nullptr ? noise / me->para_rule->comm->size
-                                         : noise,
-                noise_type, 0.0, xpket);
+            if (pdm == nullptr)
+                pdm = MovingEnvironment<S, FL, FLS>::density_matrix(
+                    xket->info->vacuum, xold_ket, forward,
+                    me->para_rule != nullptr
+                        ? noise / me->para_rule->comm->size
+                        : noise,
+                    noise_type, 0.0, xpket);
             if (me->para_rule != nullptr)
                 me->para_rule->comm->reduce_sum(pdm, me->para_rule->comm->root);
             tdm += _t.get_time();
@@ -1177,7 +1230,8 @@ template <typename S, typename FL, typename FLS> struct DMRG {
     virtual tuple<FPLS, int, size_t, double>
     two_dot_eigs_and_perturb(const bool forward, const int i,
                              const FPS davidson_conv_thrd, const FPS noise,
-                             shared_ptr<SparseMatrixGroup<S, FLS>> &pket) {
+                             shared_ptr<SparseMatrixGroup<S, FLS>> &pket,
+                             shared_ptr<SparseMatrix<S, FLS>> &pdm) {
         tuple<FPLS, int, size_t, double> pdi;
         vector<shared_ptr<SparseMatrix<S, FLS>>> ortho_bra;
         _t.get_time();
@@ -1243,10 +1297,33 @@ template <typename S, typename FL, typename FLS> struct DMRG {
         if (state_specific || projection_weights.size() != 0)
             for (auto &wfn : ortho_bra)
                 wfn->deallocate();
-        if ((noise_type & NoiseTypes::Perturbative) && noise != 0)
-            pket = h_eff->perturbative_noise(forward, i, i + 1,
-                                             FuseTypes::FuseLR, me->ket->info,
-                                             noise_type, me->para_rule);
+        // the noise density matrix is returned in pdm (with
+        // NoiseTypes::Batched), or the perturbed wavefunctions in pket
+        if ((noise_type & NoiseTypes::Perturbative) && noise != 0) {
+            if (batched_noise_supported(noise_type)) {
+                shared_ptr<SparseMatrixInfo<S>> dm_info =
+                    make_shared<SparseMatrixInfo<S>>(
+                        make_shared<VectorAllocator<uint32_t>>());
+                dm_info->initialize_dm(
+                    vector<shared_ptr<SparseMatrixInfo<S>>>{
+                        me->ket->tensors[i]->info},
+                    me->ket->info->vacuum, forward);
+                pdm = make_shared<SparseMatrix<S, FLS>>(
+                    make_shared<VectorAllocator<FPS>>());
+                pdm->allocate(dm_info);
+                h_eff->perturbative_noise_density_matrix(
+                    forward, i, i + 1, FuseTypes::FuseLR, me->ket->info,
+                    noise_type, pdm,
+                    me->para_rule != nullptr &&
+                            (noise_type & NoiseTypes::Collected)
+                        ? noise / me->para_rule->comm->size
+                        : noise,
+                    noise_batch_size, me->para_rule);
+            } else
+                pket = h_eff->perturbative_noise(
+                    forward, i, i + 1, FuseTypes::FuseLR, me->ket->info,
+                    noise_type, me->para_rule);
+        }
         tprt += _t.get_time();
         h_eff->deallocate();
         if (m_eff != nullptr)
@@ -3040,6 +3117,12 @@ template <typename S, typename FL, typename FLS> struct DMRG {
         if (me->bra != me->ket && para_mps != nullptr)
             throw runtime_error(
                 "Parallel MPS and different bra and ket is not yet supported!");
+        if ((noise_type & NoiseTypes::Batched) &&
+            !batched_noise_supported(noise_type))
+            throw runtime_error(
+                "NoiseTypes::Batched requires two-site single-state DMRG with "
+                "reduced perturbative noise and density matrix "
+                "decomposition!");
         if ((me->bra != me->ket &&
              !((davidson_type & DavidsonTypes::NonHermitian) &&
                (davidson_type & DavidsonTypes::LeftEigen))) ||
@@ -3070,12 +3153,29 @@ template <typename S, typename FL, typename FLS> struct DMRG {
                      << setw(9) << setprecision(2) << noises[iw]
                      << " | Dav threshold = " << scientific << setw(9)
                      << setprecision(2) << davidson_conv_thrds[iw] << endl;
-            auto sweep_results =
-                para_mps != nullptr
-                    ? unordered_sweep(forward, bond_dims[iw], noises[iw],
-                                      davidson_conv_thrds[iw])
-                    : sweep(forward, bond_dims[iw], noises[iw],
-                            davidson_conv_thrds[iw]);
+            tuple<vector<FPLS>, FPS, vector<vector<pair<S, FPS>>>>
+                sweep_results;
+            try {
+                if (mem_planner != nullptr)
+                    mem_planner->apply(
+                        mem_planner->plan_sweep(
+                            me, bond_dims[iw],
+                            noises[iw] == 0 ? NoiseTypes::None : noise_type,
+                            davidson_def_max_size),
+                        me, noise_type);
+                sweep_results =
+                    para_mps != nullptr
+                        ? unordered_sweep(forward, bond_dims[iw], noises[iw],
+                                          davidson_conv_thrds[iw])
+                        : sweep(forward, bond_dims[iw], noises[iw],
+                                davidson_conv_thrds[iw]);
+            } catch (...) {
+                if (mem_planner != nullptr)
+                    mem_planner->restore(me, noise_type);
+                throw;
+            }
+            if (mem_planner != nullptr)
+                mem_planner->finish_sweep();
             energies.push_back(get<0>(sweep_results));
             discarded_weights.push_back(get<1>(sweep_results));
             mps_quanta.push_back(get<2>(sweep_results));
@@ -3189,6 +3289,9 @@ template <typename S, typename FL, typename FLS> struct DMRG {
                             << Parsing::to_size_string(
                                    frame_<FPS>()->fp_codec->ncpsd * sizeof(FPS))
                             << endl;
+                    if (me->mpo->tf->opf->plan_cache != nullptr)
+                        sout << " | "
+                             << me->mpo->tf->opf->plan_cache->to_str() << endl;
                     sout << " | Trot = " << me->trot << " | Tctr = " << me->tctr
                          << " | Tint = " << me->tint << " | Tmid = " << me->tmid
                          << " | Tdctr = " << me->tdctr
@@ -3211,6 +3314,8 @@ template <typename S, typename FL, typename FLS> struct DMRG {
             if (converged || has_abort_file())
                 break;
         }
+        if (mem_planner != nullptr)
+            mem_planner->restore(me, noise_type);
         this->forward = forward;
         accumulated_elapsed_time += current.current - start.current;
         if (!converged && iprint > 0 && tol != 0)
@@ -6507,6 +6612,9 @@ struct Expect {
                          << Parsing::to_size_string(
                                 frame_<FPS>()->fp_codec->ncpsd * sizeof(FPS));
                 cout << " | Tasync = " << frame_<FPS>()->tasync << endl;
+                if (me != nullptr && me->mpo->tf->opf->plan_cache != nullptr)
+                    cout << " | " << me->mpo->tf->opf->plan_cache->to_str()
+                         << endl;
                 if (me != nullptr)
                     cout << " | Trot = " << me->trot << " | Tctr = " << me->tctr
                          << " | Tint = " << me->tint << " | Tmid = " << me->tmid
@@ -6576,11 +6684,30 @@ struct Expect {
         GTensorPtr(FLS *data) : data(make_shared<FLS *>(data)) {}
     };
     vector<shared_ptr<GTensor<FLX>>> get_npdm(uint16_t n_physical_sites = 0U) {
+        vector<shared_ptr<NPDMShard<S, FLX>>> shards =
+            get_npdm_shards(n_physical_sites, false);
+        vector<shared_ptr<GTensor<FLX>>> r(shards.size());
+        for (size_t i = 0; i < shards.size(); i++) {
+            r[i] = make_shared<GTensor<FLX>>();
+            r[i]->shape = shards[i]->shape;
+            r[i]->data = shards[i]->data->data;
+        }
+        return r;
+    }
+    // NPDM with each rank of para_rule owning a slice of every tensor.
+    // Fragments are summed over ranks one site at a time, so no rank ever
+    // holds a full tensor in the symbol-free algorithm. If distributed is
+    // false, every rank gets the full tensors.
+    vector<shared_ptr<NPDMShard<S, FLX>>>
+    get_npdm_shards(uint16_t n_physical_sites = 0U, bool distributed = true) {
         if (me->mpo->npdm_scheme == nullptr)
             throw runtime_error(
                 "Expect::get_npdm only works with general NPDM MPO.");
         shared_ptr<NPDMScheme> scheme = me->mpo->npdm_scheme;
-        vector<shared_ptr<GTensor<FLX>>> r(scheme->perms.size());
+        shared_ptr<ParallelCommunicator<S>> comm =
+            distributed && me->para_rule != nullptr ? me->para_rule->comm
+                                                    : nullptr;
+        vector<shared_ptr<NPDMShard<S, FLX>>> r(scheme->perms.size());
         if (n_physical_sites == 0U)
             n_physical_sites = me->n_sites;
         size_t total_mem = 0;
@@ -6597,15 +6724,33 @@ struct Expect {
                 }
             }
             vector<MKL_INT> shape(n_op, n_physical_sites);
-            r[i] = make_shared<GTensor<FLX>>(shape);
-            r[i]->clear();
+            r[i] = make_shared<NPDMShard<S, FLX>>(shape, comm);
             total_mem += r[i]->size();
         }
+        // flat index range owned by this rank, empty if the whole tensor
+        vector<pair<uint64_t, uint64_t>> ranges;
+        for (int i = 0; i < (int)r.size(); i++)
+            if (r[i]->is_partial())
+                ranges.resize(r.size());
+        for (int i = 0; i < (int)ranges.size(); i++)
+            ranges[i] = make_pair((uint64_t)r[i]->offset,
+                                  (uint64_t)(r[i]->offset + r[i]->size()));
+        vector<shared_ptr<GTensor<FLX>>> rd(r.size());
+        for (int i = 0; i < (int)r.size(); i++)
+            rd[i] = r[i]->data;
         bool symbol_free = false;
         // for zero-dot backward, expectations[0] may be empty
         for (auto &v : expectations)
             if (v.size() == 1 && v[0].first->get_type() == OpTypes::Counter)
                 symbol_free = true;
+        // expectation values are not sorted by site, so the full tensors
+        // are accumulated locally and then reduce-scattered
+        if (!symbol_free && ranges.size() != 0)
+            for (int i = 0; i < (int)r.size(); i++) {
+                rd[i] = make_shared<GTensor<FLX>>(r[i]->shape);
+                rd[i]->clear();
+                total_mem += rd[i]->size();
+            }
         if (iprint) {
             cout << "NPDM Sorting | Nsites = " << setw(5) << me->n_sites
                  << " | Nmaxops = " << setw(2) << scheme->n_max_ops
@@ -6652,30 +6797,34 @@ struct Expect {
                     !is_same<FLS, FLX>::value) {
                     vector<shared_ptr<GTensorPtr>> rx(r.size());
                     for (int i = 0; i < (int)r.size(); i++)
-                        rx[i] =
-                            make_shared<GTensorPtr>((FLS *)r[i]->data->data());
+                        rx[i] = make_shared<GTensorPtr>(
+                            (FLS *)r[i]->data->data->data());
+                    // real and imaginary parts are interleaved
+                    vector<pair<uint64_t, uint64_t>> rranges = ranges;
+                    for (auto &rg : rranges)
+                        rg.first *= 2, rg.second *= 2;
                     me->mpo->tf->template npdm_sort<FLS,
                                                     shared_ptr<GTensorPtr>>(
                         scheme, rx, me->get_npdm_fragment_filename(ix) + "-RE",
                         me->n_sites, ix,
                         (algo_type & ExpectationAlgorithmTypes::Compressed) ||
                             (algo_type & ExpectationAlgorithmTypes::Automatic),
-                        2, 0);
+                        2, 0, rranges);
                     me->mpo->tf->template npdm_sort<FLS,
                                                     shared_ptr<GTensorPtr>>(
                         scheme, rx, me->get_npdm_fragment_filename(ix) + "-IM",
                         me->n_sites, ix,
                         (algo_type & ExpectationAlgorithmTypes::Compressed) ||
                             (algo_type & ExpectationAlgorithmTypes::Automatic),
-                        2, 1);
+                        2, 1, rranges);
                 } else
                     me->mpo->tf->template npdm_sort<FLX,
                                                     shared_ptr<GTensor<FLX>>>(
-                        scheme, r, me->get_npdm_fragment_filename(ix),
+                        scheme, rd, me->get_npdm_fragment_filename(ix),
                         me->n_sites, ix,
                         (algo_type & ExpectationAlgorithmTypes::Compressed) ||
                             (algo_type & ExpectationAlgorithmTypes::Automatic),
-                        1, 0);
+                        1, 0, ranges);
             } else
                 for (size_t i = 0; i < (size_t)v.size(); i++) {
                     shared_ptr<OpElement<S, FL>> op =
@@ -6686,7 +6835,7 @@ struct Expect {
                                 ((size_t)op->site_index[1] << 24) |
                                 ((size_t)op->site_index[2] << 12) |
                                 ((size_t)op->site_index[3]);
-                    (*r[ii]->data)[kk] += v[i].second;
+                    (*rd[ii]->data)[kk] += v[i].second;
                 }
             if (iprint >= 2) {
                 tsite = current.get_time();
@@ -6698,8 +6847,11 @@ struct Expect {
         if (!symbol_free && me->para_rule != nullptr) {
             current.get_time();
             for (int i = 0; i < (int)scheme->perms.size(); i++)
-                me->para_rule->comm->allreduce_sum(r[i]->data->data(),
-                                                   r[i]->data->size());
+                if (ranges.size() != 0)
+                    r[i]->reduce_scatter(rd[i]);
+                else
+                    me->para_rule->comm->allreduce_sum(
+                        r[i]->data->data->data(), r[i]->size());
             tsite = current.get_time();
             cout << "Tcomm = " << fixed << setprecision(3) << tsite << " ";
         }
@@ -31,6 +31,7 @@
 #include <iomanip>
 #include <iostream>
 #include <memory>
+#include <set>
 #include <string>
 #include <tuple>
 #include <utility>
@@ -814,6 +815,9 @@ template <typename S, typename FL, typename FLS> struct TimeEvolution {
     vector<FPS> weights = {1.0 / 3.0, 1.0 / 6.0, 1.0 / 6.0, 1.0 / 3.0};
     uint8_t iprint = 2;
     FPS cutoff = 1E-14;
+    // number of states added by subspace expansion in one-site sweeps,
+    // relative to the bond dimension (zero means no expansion)
+    FPS subspace_expansion = 0.0;
     bool normalize_mps = true;
     bool hermitian = true; //!< Whether the Hamiltonian is Hermitian (symmetric)
     size_t sweep_cumulative_nflop = 0;
@@ -853,6 +857,12 @@ template <typename S, typename FL, typename FLS> struct TimeEvolution {
     // one-site algorithm - real MPS - imag time
     Iteration update_one_dot(int i, bool forward, bool advance, FLS beta,
                              ubond_t bond_dim, FPS noise) {
+        if (subspace_expansion != 0 &&
+            (decomp_type != DecompositionTypes::DensityMatrix ||
+             me->bra != me->ket))
+            throw runtime_error("TimeEvolution subspace expansion requires "
+                                "density matrix decomposition and a single "
+                                "ket!");
         frame_<FPS>()->activate(0);
         bool fuse_left = i <= me->fuse_center;
         vector<shared_ptr<MPS<S, FLS>>> mpss = {me->ket};
@@ -948,6 +958,12 @@ template <typename S, typename FL, typename FLS> struct TimeEvolution {
             pdpf = pdp.first;
             pdi = pdp.second;
         }
+        // perturbed wavefunctions for subspace expansion
+        shared_ptr<SparseMatrixGroup<S, FLS>> pket = nullptr;
+        if (subspace_expansion != 0)
+            pket = h_eff->perturbative_noise(
+                forward, i, i, fuse_left ? FuseTypes::FuseL : FuseTypes::FuseR,
+                me->ket->info, NoiseTypes::ReducedPerturbative, me->para_rule);
         h_eff->deallocate();
         int bdim = bond_dim, mmps = 0, expok = 0;
         FPS error = 0.0;
@@ -991,6 +1007,22 @@ template <typename S, typename FL, typename FLS> struct TimeEvolution {
                 }
                 prev_wfn->info->deallocate();
                 prev_wfn->deallocate();
+                if (pket != nullptr) {
+                    vector<shared_ptr<SparseMatrixGroup<S, FLS>>> prev_pkets = {
+                        pket};
+                    if (!fuse_left && forward)
+                        pket = MovingEnvironment<S, FL, FLS>::
+                            swap_multi_wfn_to_fused_left(
+                                i, me->ket->info, prev_pkets,
+                                me->mpo->tf->opf->cg)[0];
+                    else if (fuse_left && !forward)
+                        pket = MovingEnvironment<S, FL, FLS>::
+                            swap_multi_wfn_to_fused_right(
+                                i, me->ket->info, prev_pkets,
+                                me->mpo->tf->opf->cg)[0];
+                    prev_pkets[0]->deallocate_infos();
+                    prev_pkets[0]->deallocate();
+                }
             }
         }
         for (auto &mps : ext_mpss) {
@@ -1047,9 +1079,17 @@ template <typename S, typename FL, typename FLS> struct TimeEvolution {
                 (this->trunc_pattern == TruncPatternTypes::TruncAfterEven &&
                  i % 2 == 1))
                 bdim = -1;
-            error = MovingEnvironment<S, FL, FLS>::split_density_matrix(
-                dm, me->ket->tensors[i], bdim, forward, false, left, right,
-                cutoff, store_wfn_spectra, wfn_spectra, trunc_type);
+            if (pket != nullptr)
+                error = MovingEnvironment<S, FL, FLS>::
+                    split_density_matrix_expanded(
+                        dm, me->ket->tensors[i], pket, bdim,
+                        (int)ceil(subspace_expansion * bond_dim), forward,
+                        false, left, right, cutoff, store_wfn_spectra,
+                        wfn_spectra, trunc_type);
+            else
+                error = MovingEnvironment<S, FL, FLS>::split_density_matrix(
+                    dm, me->ket->tensors[i], bdim, forward, false, left, right,
+                    cutoff, store_wfn_spectra, wfn_spectra, trunc_type);
         } else {
             if (pdpf.size() != 0) {
                 frame_<FPS>()->activate(1);
@@ -1059,6 +1099,10 @@ template <typename S, typename FL, typename FLS> struct TimeEvolution {
             }
             old_wfn = me->ket->tensors[i];
         }
+        if (pket != nullptr) {
+            pket->deallocate();
+            pket->deallocate_infos();
+        }
         if (me->para_rule == nullptr || me->para_rule->is_root()) {
             shared_ptr<StateInfo<S>> info = nullptr;
             if (forward) {
@@ -2295,4 +2339,216 @@ template <typename S, typename FL, typename FLS> struct TimeEvolution {
     }
 };
 
+// Time evolution of several independent MPS (trajectories) under the same MPO.
+// All trajectories are swept in lockstep. When the MPO data is loaded on
+// demand (archive_filename or minimal_memory_usage), the MPO sites around the
+// sweep position are pinned, so that they are read once per sweep step rather
+// than once per trajectory. Nothing else is shared: each trajectory has its
+// own environments, effective Hamiltonian, Krylov subspace and truncation,
+// and the matvecs are not batched across trajectories (the renormalized bases
+// differ). Additional options (noise, decomposition, ext_mes, etc.)
+// can be set on the elements of trajs
+template <typename S, typename FL, typename FLS>
+struct MultiTrajectoryTimeEvolution {
+    typedef typename TimeEvolution<S, FL, FLS>::FPS FPS;
+    typedef typename TimeEvolution<S, FL, FLS>::FCS FCS;
+    typedef typename TimeEvolution<S, FL, FLS>::FLLS FLLS;
+    vector<shared_ptr<TimeEvolution<S, FL, FLS>>> trajs;
+    vector<ubond_t> bond_dims;
+    vector<FPS> noises;
+    // energies / norms / discarded weights of each trajectory at each sweep
+    vector<vector<FLLS>> energies;
+    vector<vector<FPS>> normsqs;
+    vector<vector<FPS>> discarded_weights;
+    bool forward;
+    TETypes mode;
+    int n_sub_sweeps;
+    uint8_t iprint = 2;
+    bool normalize_mps = true;
+    // pin the MPO sites used at the current sweep position
+    bool pin_mpo = true;
+    size_t sweep_cumulative_nflop = 0;
+    MultiTrajectoryTimeEvolution(
+        const vector<shared_ptr<MovingEnvironment<S, FL, FLS>>> &mes,
+        const vector<ubond_t> &bond_dims, TETypes mode = TETypes::TangentSpace,
+        int n_sub_sweeps = 1)
+        : bond_dims(bond_dims), noises(vector<FPS>{0.0}), forward(false),
+          mode(mode), n_sub_sweeps(n_sub_sweeps) {
+        if (mes.size() == 0)
+            throw runtime_error(
+                "MultiTrajectoryTimeEvolution: no trajectories given!");
+        set<string> tags, mps_tags;
+        for (auto &me : mes) {
+            if (me->mpo != mes[0]->mpo || me->dot != mes[0]->dot ||
+                me->center != mes[0]->center ||
+                me->n_sites != mes[0]->n_sites)
+                throw runtime_error(
+                    "MultiTrajectoryTimeEvolution: all trajectories must "
+                    "share the same MPO, dot and center!");
+            if (!tags.insert(me->tag).second ||
+                !mps_tags.insert(me->ket->info->tag).second)
+                throw runtime_error(
+                    "MultiTrajectoryTimeEvolution: trajectories must have "
+                    "distinct MovingEnvironment and MPS tags!");
+            trajs.push_back(make_shared<TimeEvolution<S, FL, FLS>>(
+                me, bond_dims, mode, n_sub_sweeps));
+            trajs.back()->iprint = 0;
+        }
+    }
+    // returns energy, norm^2 and largest discarded weight of each trajectory
+    vector<tuple<FLLS, FPS, FPS>> sweep(bool forward, bool advance, FCS beta,
+                                        ubond_t bond_dim, FPS noise) {
+        frame_<FPS>()->twrite = frame_<FPS>()->tread = frame_<FPS>()->tasync =
+            0;
+        frame_<FPS>()->fpwrite = frame_<FPS>()->fpread = 0;
+        if (frame_<FPS>()->fp_codec != nullptr)
+            frame_<FPS>()->fp_codec->ndata = frame_<FPS>()->fp_codec->ncpsd = 0;
+        for (auto &te : trajs) {
+            te->me->prepare();
+            for (auto &xme : te->ext_mes)
+                xme->prepare();
+        }
+        const shared_ptr<MovingEnvironment<S, FL, FLS>> &me = trajs[0]->me;
+        for (auto &te : trajs)
+            if (te->me->center != me->center || te->me->dot != me->dot)
+                throw runtime_error("MultiTrajectoryTimeEvolution: "
+                                    "trajectories are out of step!");
+        const shared_ptr<MPO<S, FL>> &mpo = me->mpo;
+        const int n_sites = me->n_sites, dot = me->dot;
+        vector<tuple<FLLS, FPS, FPS>> rs(trajs.size(),
+                                         make_tuple((FLLS)0.0, 0.0, 0.0));
+        sweep_cumulative_nflop = 0;
+        vector<int> sweep_range;
+        if (forward)
+            for (int it = me->center; it < n_sites - dot + 1; it++)
+                sweep_range.push_back(it);
+        else
+            for (int it = me->center; it >= 0; it--)
+                sweep_range.push_back(it);
+        // MPO sites used by the blocking at site i (including the environment
+        // contractions in MovingEnvironment::move_to) are [i - 1, i + dot]
+        int pin_l = 0, pin_r = -1;
+        Timer t;
+        for (auto i : sweep_range) {
+            check_signal_()();
+            if (pin_mpo) {
+                const int xl = max(i - 1, 0), xr = min(i + dot, n_sites - 1);
+                for (int j = pin_l; j <= pin_r; j++)
+                    if (j < xl || j > xr)
+                        mpo->unpin_site(j);
+                for (int j = xl; j <= xr; j++)
+                    mpo->pin_site(j);
+                pin_l = xl, pin_r = xr;
+            }
+            for (size_t k = 0; k < trajs.size(); k++) {
+                if (iprint >= 2) {
+                    if (dot == 2)
+                        cout << " " << (forward ? "-->" : "<--")
+                             << " Site = " << setw(4) << i << "-" << setw(4)
+                             << i + 1 << " Traj = " << setw(3) << k << " .. ";
+                    else
+                        cout << " " << (forward ? "-->" : "<--")
+                             << " Site = " << setw(4) << i
+                             << " Traj = " << setw(3) << k << " .. ";
+                    cout.flush();
+                }
+                t.get_time();
+                typename TimeEvolution<S, FL, FLS>::Iteration r =
+                    trajs[k]->blocking(i, forward, advance, beta, bond_dim,
+                                       noise);
+                sweep_cumulative_nflop += r.nflop;
+                if (iprint >= 2)
+                    cout << r << " T = " << setw(4) << fixed << setprecision(2)
+                         << t.get_time() << endl;
+                get<0>(rs[k]) = r.energy;
+                get<1>(rs[k]) = r.normsq;
+                get<2>(rs[k]) = max(get<2>(rs[k]), r.error);
+            }
+        }
+        for (int j = pin_l; j <= pin_r; j++)
+            mpo->unpin_site(j);
+        return rs;
+    }
+    // returns the final energy of each trajectory
+    vector<FLLS> solve(int n_sweeps, FCS beta, bool forward = true,
+                       FPS tol = 1E-6) {
+        if (bond_dims.size() < n_sweeps)
+            bond_dims.resize(n_sweeps, bond_dims.back());
+        if (noises.size() < n_sweeps)
+            noises.resize(n_sweeps, noises.back());
+        for (auto &te : trajs)
+            te->mode = mode, te->n_sub_sweeps = n_sub_sweeps;
+        Timer start, current;
+        start.get_time();
+        current.get_time();
+        energies.clear();
+        normsqs.clear();
+        discarded_weights.clear();
+        for (int iw = 0; iw < n_sweeps; iw++) {
+            for (int isw = 0; isw < n_sub_sweeps; isw++) {
+                if (iprint >= 1) {
+                    cout << "Sweep = " << setw(4) << iw;
+                    if (n_sub_sweeps != 1)
+                        cout << " (" << setw(2) << isw << "/" << setw(2)
+                             << (int)n_sub_sweeps << ")";
+                    cout << " | Direction = " << setw(8)
+                         << (forward ? "forward" : "backward")
+                         << " | Beta = " << fixed << setw(15) << setprecision(5)
+                         << beta << " | Bond dimension = " << setw(4)
+                         << (uint32_t)bond_dims[iw]
+                         << " | Noise = " << scientific << setw(9)
+                         << setprecision(2) << noises[iw]
+                         << " | Ntraj = " << trajs.size() << endl;
+                }
+                auto rs = sweep(forward, isw == n_sub_sweeps - 1, beta,
+                                bond_dims[iw], noises[iw]);
+                forward = !forward;
+                FPS tswp = current.get_time();
+                if (iprint >= 1) {
+                    cout << "Time elapsed = " << fixed << setw(10)
+                         << setprecision(3) << current.current - start.current
+                         << endl;
+                    for (size_t k = 0; k < rs.size(); k++) {
+                        cout << fixed << setprecision(10);
+                        cout << " Traj = " << setw(3) << k;
+                        cout << " | E = " << setw(18) << get<0>(rs[k]);
+                        cout << " | Norm^2 = " << setw(18) << get<1>(rs[k]);
+                        cout << " | DW = " << setw(9) << setprecision(5)
+                             << scientific << get<2>(rs[k]) << endl;
+                    }
+                }
+                if (iprint >= 2) {
+                    cout << fixed << setprecision(3);
+                    cout << "Time sweep = " << setw(12) << tswp;
+                    cout << " | "
+                         << Parsing::to_size_string(sweep_cumulative_nflop,
+                                                    "FLOP/SWP")
+                         << endl;
+                    cout << " | Tread = " << frame_<FPS>()->tread
+                         << " | Twrite = " << frame_<FPS>()->twrite
+                         << " | Tmpo-read = " << trajs[0]->me->mpo->tread
+                         << endl;
+                }
+                if (isw == n_sub_sweeps - 1) {
+                    energies.push_back(vector<FLLS>());
+                    normsqs.push_back(vector<FPS>());
+                    discarded_weights.push_back(vector<FPS>());
+                    for (size_t k = 0; k < rs.size(); k++) {
+                        energies.back().push_back(get<0>(rs[k]));
+                        normsqs.back().push_back(get<1>(rs[k]));
+                        discarded_weights.back().push_back(get<2>(rs[k]));
+                    }
+                }
+            }
+            if (normalize_mps)
+                for (auto &te : trajs)
+                    te->normalize();
+        }
+        this->forward = forward;
+        for (auto &te : trajs)
+            te->forward = forward;
+        return energies.back();
+    }
+};
+
 } // namespace block2
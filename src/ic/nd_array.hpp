@@ -27,6 +27,11 @@
 #ifdef _HAS_INTEL_MKL
 #include "mkl.h"
 #endif
+#if (defined(__GNUC__) || defined(__clang__)) &&                              \
+    (defined(__x86_64__) || defined(__i386__))
+#define _ND_ARRAY_X86_SIMD
+#include <immintrin.h>
+#endif
 #include <algorithm>
 #include <cassert>
 #include <cmath>
@@ -36,6 +41,7 @@
 #include <memory>
 #include <numeric>
 #include <set>
+#include <unordered_map>
 #include <vector>
 
 using namespace std;
@@ -114,6 +120,16 @@ struct NDArraySlice {
     }
 };
 
+// Plan of a tiled transpose: a sequence of 2D (m x n) transposes
+// b[k * ldb + i] = a[i * lda + k], one for each index of the outer dims
+struct NDArrayTransposePlan {
+    bool tiled = false;
+    MKL_INT m = 0, n = 0;
+    ssize_t lda = 0, ldb = 0;
+    vector<MKL_INT> outer_shape;
+    vector<ssize_t> outer_strides_a, outer_strides_b;
+};
+
 struct NDArray {
     shared_ptr<vector<double>> vdata;
     vector<MKL_INT> shape;
@@ -457,10 +473,198 @@ struct NDArray {
         r.vdata = vdata;
         return r;
     }
+    // b[k * ldb + i] = alpha * a[i * lda + k] + beta * b[k * ldb + i]
+    // for the rows and columns outside the 4 x 4 blocks
+    static void transpose_tile_edges(MKL_INT m, MKL_INT n, const double *a,
+                                     ssize_t lda, double *b, ssize_t ldb,
+                                     double alpha, double beta) {
+        const MKL_INT m4 = m & ~(MKL_INT)3, n4 = n & ~(MKL_INT)3;
+        for (MKL_INT j = 0; j < m4; j++)
+            for (MKL_INT i = n4; i < n; i++)
+                b[j * ldb + i] = beta == 0.0 ? alpha * a[i * lda + j]
+                                             : alpha * a[i * lda + j] +
+                                                   beta * b[j * ldb + i];
+        for (MKL_INT j = m4; j < m; j++)
+            for (MKL_INT i = 0; i < n; i++)
+                b[j * ldb + i] = beta == 0.0 ? alpha * a[i * lda + j]
+                                             : alpha * a[i * lda + j] +
+                                                   beta * b[j * ldb + i];
+    }
+#ifdef _MSC_VER
+    static void transpose_tile_scalar(MKL_INT m, MKL_INT n,
+                                      const double *__restrict a, ssize_t lda,
+                                      double *__restrict b, ssize_t ldb,
+                                      double alpha, double beta) {
+#else
+    static void transpose_tile_scalar(MKL_INT m, MKL_INT n,
+                                      const double *__restrict__ a,
+                                      ssize_t lda, double *__restrict__ b,
+                                      ssize_t ldb, double alpha, double beta) {
+#endif
+        const MKL_INT m4 = m & ~(MKL_INT)3, n4 = n & ~(MKL_INT)3;
+        for (MKL_INT k = 0; k < m4; k += 4)
+            for (MKL_INT i = 0; i < n4; i += 4) {
+                const double *ax = a + i * lda + k;
+                double *bx = b + k * ldb + i;
+                for (int j = 0; j < 4; j++)
+                    for (int l = 0; l < 4; l++)
+                        bx[j * ldb + l] = beta == 0.0
+                                              ? alpha * ax[l * lda + j]
+                                              : alpha * ax[l * lda + j] +
+                                                    beta * bx[j * ldb + l];
+            }
+        transpose_tile_edges(m, n, a, lda, b, ldb, alpha, beta);
+    }
+#ifdef _ND_ARRAY_X86_SIMD
+    __attribute__((target("avx"))) static void
+    transpose_tile_avx(MKL_INT m, MKL_INT n, const double *__restrict__ a,
+                       ssize_t lda, double *__restrict__ b, ssize_t ldb,
+                       double alpha, double beta) {
+        const MKL_INT m4 = m & ~(MKL_INT)3, n4 = n & ~(MKL_INT)3;
+        const __m256d va = _mm256_set1_pd(alpha), vb = _mm256_set1_pd(beta);
+        for (MKL_INT k = 0; k < m4; k += 4)
+            for (MKL_INT i = 0; i < n4; i += 4) {
+                const double *ax = a + i * lda + k;
+                double *bx = b + k * ldb + i;
+                __m256d r0 = _mm256_loadu_pd(ax);
+                __m256d r1 = _mm256_loadu_pd(ax + lda);
+                __m256d r2 = _mm256_loadu_pd(ax + 2 * lda);
+                __m256d r3 = _mm256_loadu_pd(ax + 3 * lda);
+                __m256d t0 = _mm256_unpacklo_pd(r0, r1);
+                __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+                __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+                __m256d t3 = _mm256_unpackhi_pd(r2, r3);
+                __m256d c[4] = {_mm256_permute2f128_pd(t0, t2, 0x20),
+                                _mm256_permute2f128_pd(t1, t3, 0x20),
+                                _mm256_permute2f128_pd(t0, t2, 0x31),
+                                _mm256_permute2f128_pd(t1, t3, 0x31)};
+                if (beta == 0.0)
+                    for (int j = 0; j < 4; j++)
+                        _mm256_storeu_pd(bx + j * ldb,
+                                         _mm256_mul_pd(va, c[j]));
+                else
+                    for (int j = 0; j < 4; j++)
+                        _mm256_storeu_pd(
+                            bx + j * ldb,
+                            _mm256_add_pd(
+                                _mm256_mul_pd(va, c[j]),
+                                _mm256_mul_pd(vb,
+                                              _mm256_loadu_pd(bx + j * ldb))));
+            }
+        transpose_tile_edges(m, n, a, lda, b, ldb, alpha, beta);
+    }
+#endif
+    // whether the running cpu supports the avx transpose tiles
+    static bool avx_transpose_supported() {
+#ifdef _ND_ARRAY_X86_SIMD
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx");
+#else
+        return false;
+#endif
+    }
+    // whether transpose tiles use avx, detected once at runtime
+    // (can be turned off, but not on when not supported)
+    static bool &avx_transpose() {
+        static bool use_avx = avx_transpose_supported();
+        return use_avx;
+    }
+    static void transpose_tile(MKL_INT m, MKL_INT n, const double *a,
+                               ssize_t lda, double *b, ssize_t ldb,
+                               double alpha, double beta) {
+#ifdef _ND_ARRAY_X86_SIMD
+        if (avx_transpose())
+            return transpose_tile_avx(m, n, a, lda, b, ldb, alpha, beta);
+#endif
+        transpose_tile_scalar(m, n, a, lda, b, ldb, alpha, beta);
+    }
+    // cache-oblivious recursive blocking down to tiles fitting in L1
+    static void transpose_block(MKL_INT m, MKL_INT n, const double *a,
+                                ssize_t lda, double *b, ssize_t ldb,
+                                double alpha, double beta) {
+        const MKL_INT blk = 32;
+        if (m <= blk && n <= blk)
+            transpose_tile(m, n, a, lda, b, ldb, alpha, beta);
+        else if (m >= n) {
+            const MKL_INT h = ((m >> 1) + 3) & ~(MKL_INT)3;
+            transpose_block(h, n, a, lda, b, ldb, alpha, beta);
+            transpose_block(m - h, n, a + h, lda, b + h * ldb, ldb, alpha,
+                            beta);
+        } else {
+            const MKL_INT h = ((n >> 1) + 3) & ~(MKL_INT)3;
+            transpose_block(m, h, a, lda, b, ldb, alpha, beta);
+            transpose_block(m, n - h, a + h * lda, lda, b + h, ldb, alpha,
+                            beta);
+        }
+    }
+    // transpose plans, keyed by shapes, strides and permutation
+    static unordered_map<string, NDArrayTransposePlan> &transpose_plan_cache() {
+        static unordered_map<string, NDArrayTransposePlan> plan_cache;
+        return plan_cache;
+    }
+    // the plan cache is cleared when it has this number of plans
+    // zero disables the cache
+    static size_t &max_transpose_plan_cache_size() {
+        static size_t max_size = 4096;
+        return max_size;
+    }
+    // plan (cached by shapes, strides and permutation) for transpose
+    // bx is C order and xperm[i] is the index in a of the i-th index in bx
+    static NDArrayTransposePlan transpose_plan(const NDArray &a,
+                                               const NDArray &bx,
+                                               const vector<int> &xperm) {
+        unordered_map<string, NDArrayTransposePlan> &plan_cache =
+            transpose_plan_cache();
+        const int dim = a.ndim();
+        // raw bytes of the shapes, strides and permutation as the key
+        vector<ssize_t> kx(dim * 4);
+        for (int i = 0; i < dim; i++) {
+            kx[i * 4] = a.shape[i], kx[i * 4 + 1] = a.strides[i];
+            kx[i * 4 + 2] = bx.strides[i], kx[i * 4 + 3] = xperm[i];
+        }
+        const string key((const char *)kx.data(), kx.size() * sizeof(ssize_t));
+        NDArrayTransposePlan plan;
+        bool found = false;
+#pragma omp critical(nd_array_transpose_plan)
+        {
+            auto it = plan_cache.find(key);
+            if (it != plan_cache.end())
+                plan = it->second, found = true;
+        }
+        if (found)
+            return plan;
+        // the index that is contiguous in a (should not be last in b)
+        int pk = -1;
+        for (int i = 0; i < dim - 1; i++)
+            if (a.strides[xperm[i]] == 1 && bx.shape[i] >= 8)
+                pk = i;
+        const MKL_INT n = dim == 0 ? 1 : bx.shape[dim - 1];
+        const ssize_t lda = dim == 0 ? 0 : a.strides[xperm[dim - 1]];
+        const ssize_t ldb = pk == -1 ? 0 : bx.strides[pk];
+        if (pk != -1 && n >= 8 && lda > 1 && ldb > 1 &&
+            bx.strides[dim - 1] == 1) {
+            plan.tiled = true;
+            plan.m = bx.shape[pk], plan.n = n, plan.lda = lda, plan.ldb = ldb;
+            for (int i = 0; i < dim - 1; i++)
+                if (i != pk) {
+                    plan.outer_shape.push_back(bx.shape[i]);
+                    plan.outer_strides_a.push_back(a.strides[xperm[i]]);
+                    plan.outer_strides_b.push_back(bx.strides[i]);
+                }
+        }
+#pragma omp critical(nd_array_transpose_plan)
+        {
+            if (plan_cache.size() >= max_transpose_plan_cache_size())
+                plan_cache.clear();
+            if (max_transpose_plan_cache_size() != 0)
+                plan_cache[key] = plan;
+        }
+        return plan;
+    }
     // b must be C order (modulo permutations) (always copy)
     static void transpose(const NDArray &a, const NDArray &b,
                           const vector<int> &perm = {}, double alpha = 1.0,
-                          double beta = 0.0) {
+                          double beta = 0.0, bool tiled = true) {
         const int dim = a.ndim();
         vector<int> idx, xperm(perm.size());
         NDArray bx = b.reorder_c(idx);
@@ -472,6 +676,42 @@ struct NDArray {
             for (int i = 0; i < dim; i++)
                 xperm.push_back(idx[i]);
         }
+        const NDArrayTransposePlan plan =
+            tiled ? transpose_plan(a, bx, xperm) : NDArrayTransposePlan();
+        if (plan.tiled) {
+            // work items: outer index x a chunk of rows of the 2D transpose
+            const MKL_INT chunk = 64, nchunk = (plan.m + chunk - 1) / chunk;
+            const int nouter = (int)plan.outer_shape.size();
+            size_t size_outer = 1;
+            for (auto &sh : plan.outer_shape)
+                size_outer *= sh;
+            const size_t nitems = size_outer * nchunk;
+            int ntg = threading->activate_global();
+            const size_t plen = (nitems + ntg - 1) / ntg;
+#pragma omp parallel num_threads(ntg)
+            {
+                int tid = threading->get_thread_id();
+                const size_t ixst = min(nitems, plen * tid);
+                const size_t ixed = min(nitems, plen * (tid + 1));
+                for (size_t it = ixst; it < ixed; it++) {
+                    size_t jx = it / nchunk;
+                    const MKL_INT k0 = (MKL_INT)(it % nchunk) * chunk;
+                    ssize_t offset_a = k0, offset_b = k0 * plan.ldb;
+                    for (int i = nouter - 1; i >= 0;
+                         jx /= plan.outer_shape[i--]) {
+                        offset_a += ((ssize_t)jx % plan.outer_shape[i]) *
+                                    plan.outer_strides_a[i];
+                        offset_b += ((ssize_t)jx % plan.outer_shape[i]) *
+                                    plan.outer_strides_b[i];
+                    }
+                    transpose_block(min(chunk, plan.m - k0), plan.n,
+                                    a.data + offset_a, plan.lda,
+                                    bx.data + offset_b, plan.ldb, alpha, beta);
+                }
+            }
+            threading->activate_normal();
+            return;
+        }
         size_t size_left = 1;
         for (int i = 0; i < dim; i++)
             if (i != xperm.back())
@@ -688,6 +928,134 @@ struct NDArray {
             c = c.transpose(perm_c);
         }
     }
+    // flop count of contracting two operands (product of all involved
+    // dimensions) and the script of the result (broadcast + free indices)
+    static double pair_contraction_cost(const string &sa, const string &sb,
+                                        const int *char_count,
+                                        const double *dims, string &out) {
+        int char_map[256];
+        memset(char_map, 0, sizeof(int) * 256);
+        for (auto &c : sa)
+            char_map[(uint8_t)c]++;
+        for (auto &c : sb)
+            char_map[(uint8_t)c]++;
+        string outr, outs;
+        double cost = 1.0;
+        for (auto &c : sa) {
+            cost *= dims[(uint8_t)c];
+            if (char_map[(uint8_t)c] == 1)
+                outs.push_back(c);
+            else if (char_map[(uint8_t)c] != char_count[(uint8_t)c])
+                outr.push_back(c);
+        }
+        for (auto &c : sb)
+            if (char_map[(uint8_t)c] == 1)
+                cost *= dims[(uint8_t)c], outs.push_back(c);
+        out = outr + outs;
+        return cost;
+    }
+    static void update_contraction_count(const string &sa, const string &sb,
+                                         int *char_count) {
+        for (auto &c : sa)
+            if (sb.find(c) != string::npos)
+                char_count[(uint8_t)c] -= char_count[(uint8_t)c] == 2 ? 2 : 1;
+    }
+    static void optimal_contraction_path(vector<string> &scripts,
+                                         vector<int> &char_count,
+                                         const double *dims, double cost,
+                                         vector<pair<int, int>> &path,
+                                         double &best_cost,
+                                         vector<pair<int, int>> &best_path) {
+        if (scripts.size() <= 1) {
+            if (cost < best_cost)
+                best_cost = cost, best_path = path;
+            return;
+        }
+        string out;
+        for (int i = 0; i < (int)scripts.size(); i++)
+            for (int j = i + 1; j < (int)scripts.size(); j++) {
+                double c = pair_contraction_cost(
+                    scripts[i], scripts[j], char_count.data(), dims, out);
+                if (cost + c >= best_cost)
+                    continue;
+                vector<int> count = char_count;
+                const string sa = scripts[i], sb = scripts[j];
+                update_contraction_count(sa, sb, char_count.data());
+                scripts[i] = out, scripts.erase(scripts.begin() + j);
+                path.push_back(make_pair(i, j));
+                optimal_contraction_path(scripts, char_count, dims, cost + c,
+                                         path, best_cost, best_path);
+                path.pop_back();
+                scripts.insert(scripts.begin() + j, sb), scripts[i] = sa;
+                char_count = count;
+            }
+    }
+    // contraction paths used by einsum, keyed by scripts and shapes
+    static unordered_map<string, vector<pair<int, int>>> &einsum_path_cache() {
+        static unordered_map<string, vector<pair<int, int>>> path_cache;
+        return path_cache;
+    }
+    // the path cache is cleared when it has this number of paths
+    // zero disables the cache
+    static size_t &max_einsum_path_cache_size() {
+        static size_t max_size = 4096;
+        return max_size;
+    }
+    /** Pairwise contraction order for einsum operands (with unique indices).
+     * Each step (i, j), i < j contracts operand j into operand i. The exact
+     * minimal-flop order is searched for at most max_optimal operands,
+     * otherwise the cheapest pair is greedily contracted at each step. */
+    static vector<pair<int, int>>
+    contraction_path(const vector<string> &scripts,
+                     const vector<vector<MKL_INT>> &shapes,
+                     const string &result, int max_optimal = 6) {
+        vector<int> char_count(256, 0);
+        double dims[256];
+        for (int i = 0; i < 256; i++)
+            dims[i] = 1.0;
+        for (int i = 0; i < (int)scripts.size(); i++)
+            for (int j = 0; j < (int)scripts[i].length(); j++)
+                char_count[(uint8_t)scripts[i][j]]++,
+                    dims[(uint8_t)scripts[i][j]] = (double)shapes[i][j];
+        for (auto &c : result)
+            char_count[(uint8_t)c]++;
+        // greedy path, also used as the initial bound of the exact search
+        vector<string> gscripts = scripts;
+        vector<int> gcount = char_count;
+        vector<pair<int, int>> path, best_path;
+        double cost = 0;
+        string out, best_out;
+        while (gscripts.size() > 1) {
+            double best_c = numeric_limits<double>::max(), best_sz = 0;
+            int bi = 0, bj = 1;
+            for (int i = 0; i < (int)gscripts.size(); i++)
+                for (int j = i + 1; j < (int)gscripts.size(); j++) {
+                    double c = pair_contraction_cost(
+                        gscripts[i], gscripts[j], gcount.data(), dims, out);
+                    double sz = 1.0;
+                    for (auto &x : out)
+                        sz *= dims[(uint8_t)x];
+                    if (c < best_c || (c == best_c && sz < best_sz))
+                        best_c = c, best_sz = sz, bi = i, bj = j,
+                        best_out = out;
+                }
+            update_contraction_count(gscripts[bi], gscripts[bj],
+                                     gcount.data());
+            gscripts[bi] = best_out, gscripts.erase(gscripts.begin() + bj);
+            path.push_back(make_pair(bi, bj));
+            cost += best_c;
+        }
+        if ((int)scripts.size() > 2 && (int)scripts.size() <= max_optimal) {
+            double best_cost = cost * (1.0 + 1E-12);
+            vector<pair<int, int>> cur_path;
+            gscripts = scripts;
+            optimal_contraction_path(gscripts, char_count, dims, 0.0, cur_path,
+                                     best_cost, best_path);
+            if (best_path.size() != 0)
+                path = best_path;
+        }
+        return path;
+    }
     static NDArray einsum(const string &script, const vector<NDArray> &arrs) {
         // explicit mode has '->'
         bool explicit_mode = false;
@@ -902,29 +1270,62 @@ struct NDArray {
                 gscripts[i] = newss.str();
             }
         }
+        // contraction order, cached by scripts and shapes
+        unordered_map<string, vector<pair<int, int>>> &path_cache =
+            einsum_path_cache();
+        stringstream pkey;
+        for (int i = 0; i < (int)gscripts.size(); i++) {
+            pkey << gscripts[i] << ":";
+            for (auto &sh : garrs[i].shape)
+                pkey << sh << ",";
+            pkey << ";";
+        }
+        pkey << "->" << result;
+        vector<pair<int, int>> path;
+        bool path_found = false;
+#pragma omp critical(nd_array_einsum_path)
+        {
+            auto it = path_cache.find(pkey.str());
+            if (it != path_cache.end())
+                path = it->second, path_found = true;
+        }
+        if (!path_found) {
+            vector<vector<MKL_INT>> gshapes(garrs.size());
+            for (int i = 0; i < (int)garrs.size(); i++)
+                gshapes[i] = garrs[i].shape;
+            path = contraction_path(gscripts, gshapes, result);
+#pragma omp critical(nd_array_einsum_path)
+            {
+                if (path_cache.size() >= max_einsum_path_cache_size())
+                    path_cache.clear();
+                if (max_einsum_path_cache_size() != 0)
+                    path_cache[pkey.str()] = path;
+            }
+        }
         // perform tensordot
         vector<int> idxa, idxb, br_idxa, br_idxb;
         vector<MKL_INT> new_sh, new_br;
-        for (int i = 1; i < (int)gscripts.size(); i++) {
+        for (auto &ip : path) {
+            const int i0 = ip.first, i = ip.second;
             idxa.clear(), idxb.clear();
             br_idxa.clear(), br_idxb.clear();
             new_sh.clear(), new_br.clear();
             memset(char_map, 0, sizeof(int) * _MAX_CHAR);
-            for (int j = 0; j < gscripts[0].length(); j++)
-                char_map[gscripts[0][j]]++;
+            for (int j = 0; j < gscripts[i0].length(); j++)
+                char_map[gscripts[i0][j]]++;
             for (int j = 0; j < gscripts[i].length(); j++)
                 char_map[gscripts[i][j]]++;
             stringstream newss, newsr;
-            for (int j = 0; j < gscripts[0].length(); j++)
-                if (char_map[gscripts[0][j]] > 1) {
-                    if (char_map[gscripts[0][j]] == char_count[gscripts[0][j]])
+            for (int j = 0; j < gscripts[i0].length(); j++)
+                if (char_map[gscripts[i0][j]] > 1) {
+                    if (char_map[gscripts[i0][j]] == char_count[gscripts[i0][j]])
                         idxa.push_back(j);
                     else
-                        br_idxa.push_back(j), newsr << gscripts[0][j],
-                            new_br.push_back(garrs[0].shape[j]);
+                        br_idxa.push_back(j), newsr << gscripts[i0][j],
+                            new_br.push_back(garrs[i0].shape[j]);
                 } else
-                    newss << gscripts[0][j],
-                        new_sh.push_back(garrs[0].shape[j]);
+                    newss << gscripts[i0][j],
+                        new_sh.push_back(garrs[i0].shape[j]);
             for (int j = 0; j < gscripts[i].length(); j++)
                 if (char_map[gscripts[i][j]] > 1) {
                     if (char_map[gscripts[i][j]] == char_count[gscripts[i][j]])
@@ -936,9 +1337,9 @@ struct NDArray {
                         new_sh.push_back(garrs[i].shape[j]);
             memset(char_map, -1, sizeof(int) * _MAX_CHAR);
             for (int j = 0; j < idxa.size(); j++)
-                char_map[gscripts[0][idxa[j]]] = j;
+                char_map[gscripts[i0][idxa[j]]] = j;
             for (int j = 0; j < br_idxa.size(); j++)
-                char_map[gscripts[0][br_idxa[j]]] = j;
+                char_map[gscripts[i0][br_idxa[j]]] = j;
             sort(idxb.begin(), idxb.end(),
                  [&char_map, &gscripts, i](int a, int b) {
                      return char_map[gscripts[i][a]] < char_map[gscripts[i][b]];
@@ -949,15 +1350,17 @@ struct NDArray {
                  });
             new_br.insert(new_br.end(), new_sh.begin(), new_sh.end());
             NDArray tmp(new_br);
-            NDArray::tensordot(garrs[0], garrs[i], tmp, idxa, idxb, br_idxa,
+            NDArray::tensordot(garrs[i0], garrs[i], tmp, idxa, idxb, br_idxa,
                                br_idxb);
             // remove contracted and broadcast index count
             for (auto &x : idxa)
-                char_count[gscripts[0][x]] -= 2;
+                char_count[gscripts[i0][x]] -= 2;
             for (auto &x : br_idxa)
-                char_count[gscripts[0][x]]--;
-            garrs[0] = tmp;
-            gscripts[0] = newsr.str() + newss.str();
+                char_count[gscripts[i0][x]]--;
+            garrs[i0] = tmp;
+            gscripts[i0] = newsr.str() + newss.str();
+            garrs.erase(garrs.begin() + i);
+            gscripts.erase(gscripts.begin() + i);
         }
         // final transpose (no copy)
         assert(gscripts[0].size() == result.size());
@@ -35,6 +35,7 @@
 #include <set>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -460,6 +461,14 @@ struct WickTensor {
         return type != other.type || name != other.name ||
                indices != other.indices;
     }
+    size_t hash() const noexcept {
+        size_t h = std::hash<string>{}(name);
+        h ^= (size_t)type + 0x9E3779B9 + (h << 6) + (h >> 2);
+        for (auto &wi : indices)
+            h ^= (wi.hash() ^ (size_t)wi.types) + 0x9E3779B9 + (h << 6) +
+                 (h >> 2);
+        return h;
+    }
     bool operator<(const WickTensor &other) const noexcept {
         int fc = fermi_type_compare(other);
         return fc != 0 ? (fc == -1)
@@ -818,6 +827,16 @@ struct WickString {
                ctr_indices.size() == other.ctr_indices.size() &&
                tensors == other.tensors && ctr_indices == other.ctr_indices;
     }
+    // hash consistent with abs_equal_to
+    size_t abs_hash() const noexcept {
+        size_t h = tensors.size();
+        for (auto &wt : tensors)
+            h ^= wt.hash() + 0x9E3779B9 + (h << 6) + (h >> 2);
+        for (auto &wi : ctr_indices)
+            h ^= (wi.hash() ^ (size_t)wi.types) + 0x9E3779B9 + (h << 6) +
+                 (h >> 2);
+        return h;
+    }
     bool operator==(const WickString &other) const noexcept {
         return factor == other.factor && tensors == other.tensors &&
                ctr_indices == other.ctr_indices;
@@ -2543,14 +2562,20 @@ struct WickExpr {
     }
     WickExpr simple_sort() const {
         WickExpr r = *this;
-        for (auto &rr : r.terms)
-            rr = rr.simple_sort();
+        int ntg = threading->activate_global();
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        for (int k = 0; k < (int)r.terms.size(); k++)
+            r.terms[k] = r.terms[k].simple_sort();
+        threading->activate_normal();
         return r;
     }
     WickExpr simplify_delta() const {
         WickExpr r = *this;
-        for (auto &rr : r.terms)
-            rr = rr.simplify_delta();
+        int ntg = threading->activate_global();
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        for (int k = 0; k < (int)r.terms.size(); k++)
+            r.terms[k] = r.terms[k].simplify_delta();
+        threading->activate_normal();
         return r;
     }
     WickExpr simplify_zero() const {
@@ -2620,25 +2645,73 @@ struct WickExpr {
         }
         return r;
     }
+    // terms are sharded by hash, each shard is merged by one thread
     WickExpr simplify_merge() const {
-        vector<WickString> sorted(terms.size());
-        vector<pair<int, double>> ridxs;
+        const int n = (int)terms.size();
         int ntg = threading->activate_global();
+        const int nshard = ntg * 4;
+        vector<size_t> hs(n);
 #pragma omp parallel for schedule(static) num_threads(ntg)
-        for (int k = 0; k < (int)terms.size(); k++)
-            sorted[k] = terms[k].abs().quick_sort();
-        threading->activate_normal();
-        for (int i = 0; i < (int)terms.size(); i++) {
-            bool found = false;
-            for (int j = 0; j < (int)ridxs.size() && !found; j++)
-                if (sorted[i].abs_equal_to(sorted[ridxs[j].first])) {
-                    found = true;
-                    ridxs[j].second += terms[i].factor * sorted[i].factor *
-                                       sorted[ridxs[j].first].factor;
+        for (int k = 0; k < n; k++)
+            hs[k] = terms[k].abs_hash();
+        // normal order each distinct term only once
+        // raw_rep[k] is the first term equal to term k (up to factor)
+        vector<WickString> sorted(n);
+        vector<int> raw_rep(n);
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        for (int is = 0; is < nshard; is++) {
+            unordered_map<size_t, vector<int>> memo;
+            for (int k = 0; k < n; k++) {
+                if (hs[k] % nshard != is)
+                    continue;
+                vector<int> &mk = memo[hs[k]];
+                raw_rep[k] = -1;
+                for (auto &j : mk)
+                    if (terms[j].abs_equal_to(terms[k])) {
+                        raw_rep[k] = j;
+                        break;
+                    }
+                if (raw_rep[k] == -1) {
+                    raw_rep[k] = k, mk.push_back(k);
+                    sorted[k] = terms[k].abs().quick_sort();
                 }
-            if (!found)
-                ridxs.push_back(make_pair(i, terms[i].factor));
+            }
         }
+#pragma omp parallel for schedule(static) num_threads(ntg)
+        for (int k = 0; k < n; k++)
+            hs[k] = sorted[raw_rep[k]].abs_hash();
+        // merge terms with the same canonical form
+        vector<vector<pair<int, double>>> sridxs(nshard);
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+        for (int is = 0; is < nshard; is++) {
+            unordered_map<size_t, vector<int>> groups;
+            vector<pair<int, double>> &ridxs = sridxs[is];
+            for (int i = 0; i < n; i++) {
+                if (hs[i] % nshard != is)
+                    continue;
+                const WickString &si = sorted[raw_rep[i]];
+                vector<int> &gi = groups[hs[i]];
+                bool found = false;
+                for (auto &j : gi) {
+                    const WickString &sj = sorted[raw_rep[ridxs[j].first]];
+                    if (si.abs_equal_to(sj)) {
+                        found = true;
+                        ridxs[j].second +=
+                            terms[i].factor * si.factor * sj.factor;
+                        break;
+                    }
+                }
+                if (!found) {
+                    gi.push_back((int)ridxs.size());
+                    ridxs.push_back(make_pair(i, terms[i].factor));
+                }
+            }
+        }
+        threading->activate_normal();
+        vector<pair<int, double>> ridxs;
+        for (auto &sr : sridxs)
+            ridxs.insert(ridxs.end(), sr.begin(), sr.end());
+        sort(ridxs.begin(), ridxs.end());
         WickExpr r;
         for (auto &m : ridxs) {
             r.terms.push_back(terms[m.first]);
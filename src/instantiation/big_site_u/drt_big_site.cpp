@@ -28,6 +28,7 @@ template struct block2::HDRTScheme<block2::SZ, double,
                                    block2::ElemOpTypes::SZ>;
 template struct block2::DRTBigSiteBase<block2::SZ, double>;
 template struct block2::DRTBigSite<block2::SZ, double>;
+template struct block2::DRTDirectCI<block2::SZ, double>;
 
 template struct block2::ElemMat<block2::SU2, double>;
 template struct block2::DRT<block2::SU2, block2::ElemOpTypes::SU2>;
@@ -37,3 +38,4 @@ template struct block2::HDRTScheme<block2::SU2, double,
                                    block2::ElemOpTypes::SU2>;
 template struct block2::DRTBigSiteBase<block2::SU2, double>;
 template struct block2::DRTBigSite<block2::SU2, double>;
+template struct block2::DRTDirectCI<block2::SU2, double>;
@@ -55,6 +55,7 @@ extern template struct block2::HDRTScheme<block2::SZ, double,
                                           block2::ElemOpTypes::SZ>;
 extern template struct block2::DRTBigSiteBase<block2::SZ, double>;
 extern template struct block2::DRTBigSite<block2::SZ, double>;
+extern template struct block2::DRTDirectCI<block2::SZ, double>;
 
 extern template struct block2::ElemMat<block2::SU2, double>;
 extern template struct block2::DRT<block2::SU2, block2::ElemOpTypes::SU2>;
@@ -64,6 +65,7 @@ extern template struct block2::HDRTScheme<block2::SU2, double,
                                           block2::ElemOpTypes::SU2>;
 extern template struct block2::DRTBigSiteBase<block2::SU2, double>;
 extern template struct block2::DRTBigSite<block2::SU2, double>;
+extern template struct block2::DRTDirectCI<block2::SU2, double>;
 
 // drt_mps.hpp
 extern template struct block2::DRTMPS<block2::SZ, double,
@@ -29,6 +29,7 @@
 #include "../dmrg/general_hamiltonian.hpp"
 #include "../dmrg/general_mpo.hpp"
 #include "../dmrg/general_npdm.hpp"
+#include "../dmrg/memory_planner.hpp"
 #include "../dmrg/moving_environment.hpp"
 #include "../dmrg/mpo.hpp"
 #include "../dmrg/mpo_fusing.hpp"
@@ -90,6 +91,7 @@ extern template struct block2::EffectiveHamiltonian<
 
 // general_hamiltonian.hpp
 extern template struct block2::GeneralHamiltonian<block2::SZ, double>;
+extern template struct block2::GeneralCustomHamiltonian<block2::SZ, double>;
 extern template struct block2::GeneralHamiltonian<block2::SU2, double>;
 
 // general_mpo.hpp
@@ -100,6 +102,10 @@ extern template struct block2::GeneralMPO<block2::SU2, double>;
 extern template struct block2::GeneralNPDMMPO<block2::SZ, double>;
 extern template struct block2::GeneralNPDMMPO<block2::SU2, double>;
 
+// memory_planner.hpp
+extern template struct block2::MemoryPlanner<block2::SZ, double, double>;
+extern template struct block2::MemoryPlanner<block2::SU2, double, double>;
+
 // moving_environment.hpp
 extern template struct block2::MovingEnvironment<block2::SZ, double, double>;
 extern template struct block2::MovingEnvironment<block2::SU2, double, double>;
@@ -256,9 +262,13 @@ extern template struct block2::Expect<block2::SU2, double, double,
 // sweep_algorithm_td.hpp
 extern template struct block2::TDDMRG<block2::SZ, double, double>;
 extern template struct block2::TimeEvolution<block2::SZ, double, double>;
+extern template struct block2::MultiTrajectoryTimeEvolution<block2::SZ, double,
+                                                            double>;
 
 extern template struct block2::TDDMRG<block2::SU2, double, double>;
 extern template struct block2::TimeEvolution<block2::SU2, double, double>;
+extern template struct block2::MultiTrajectoryTimeEvolution<block2::SU2, double,
+                                                            double>;
 
 #endif
 
@@ -310,6 +320,10 @@ extern template struct block2::GeneralMPO<block2::SU2K, double>;
 extern template struct block2::GeneralNPDMMPO<block2::SZK, double>;
 extern template struct block2::GeneralNPDMMPO<block2::SU2K, double>;
 
+// memory_planner.hpp
+extern template struct block2::MemoryPlanner<block2::SZK, double, double>;
+extern template struct block2::MemoryPlanner<block2::SU2K, double, double>;
+
 // moving_environment.hpp
 extern template struct block2::MovingEnvironment<block2::SZK, double, double>;
 extern template struct block2::MovingEnvironment<block2::SU2K, double, double>;
@@ -466,9 +480,13 @@ extern template struct block2::Expect<block2::SU2K, double, double,
 // sweep_algorithm_td.hpp
 extern template struct block2::TDDMRG<block2::SZK, double, double>;
 extern template struct block2::TimeEvolution<block2::SZK, double, double>;
+extern template struct block2::MultiTrajectoryTimeEvolution<block2::SZK, double,
+                                                            double>;
 
 extern template struct block2::TDDMRG<block2::SU2K, double, double>;
 extern template struct block2::TimeEvolution<block2::SU2K, double, double>;
+extern template struct block2::MultiTrajectoryTimeEvolution<block2::SU2K,
+                                                            double, double>;
 
 #endif
 
@@ -515,6 +533,10 @@ extern template struct block2::GeneralMPO<block2::SGB, double>;
 extern template struct block2::GeneralNPDMMPO<block2::SGF, double>;
 extern template struct block2::GeneralNPDMMPO<block2::SGB, double>;
 
+// memory_planner.hpp
+extern template struct block2::MemoryPlanner<block2::SGF, double, double>;
+extern template struct block2::MemoryPlanner<block2::SGB, double, double>;
+
 // moving_environment.hpp
 extern template struct block2::MovingEnvironment<block2::SGF, double, double>;
 extern template struct block2::MovingEnvironment<block2::SGB, double, double>;
@@ -665,9 +687,13 @@ extern template struct block2::Expect<block2::SGB, double, double,
 // sweep_algorithm_td.hpp
 extern template struct block2::TDDMRG<block2::SGF, double, double>;
 extern template struct block2::TimeEvolution<block2::SGF, double, double>;
+extern template struct block2::MultiTrajectoryTimeEvolution<block2::SGF, double,
+                                                            double>;
 
 extern template struct block2::TDDMRG<block2::SGB, double, double>;
 extern template struct block2::TimeEvolution<block2::SGB, double, double>;
+extern template struct block2::MultiTrajectoryTimeEvolution<block2::SGB, double,
+                                                            double>;
 
 #endif
 
@@ -696,6 +722,7 @@ extern template struct block2::EffectiveHamiltonian<
 
 // general_hamiltonian.hpp
 extern template struct block2::GeneralHamiltonian<block2::SAny, double>;
+extern template struct block2::GeneralCustomHamiltonian<block2::SAny, double>;
 
 // general_mpo.hpp
 extern template struct block2::GeneralMPO<block2::SAny, double>;
@@ -703,6 +730,9 @@ extern template struct block2::GeneralMPO<block2::SAny, double>;
 // general_npdm.hpp
 extern template struct block2::GeneralNPDMMPO<block2::SAny, double>;
 
+// memory_planner.hpp
+extern template struct block2::MemoryPlanner<block2::SAny, double, double>;
+
 // moving_environment.hpp
 extern template struct block2::MovingEnvironment<block2::SAny, double, double>;
 
@@ -798,6 +828,8 @@ extern template struct block2::Expect<block2::SAny, double, double,
 // sweep_algorithm_td.hpp
 extern template struct block2::TDDMRG<block2::SAny, double, double>;
 extern template struct block2::TimeEvolution<block2::SAny, double, double>;
+extern template struct block2::MultiTrajectoryTimeEvolution<block2::SAny,
+                                                            double, double>;
 
 #endif
 
@@ -844,6 +876,8 @@ extern template struct block2::EffectiveHamiltonian<
 
 // general_hamiltonian.hpp
 extern template struct block2::GeneralHamiltonian<block2::SZ, complex<double>>;
+extern template struct block2::GeneralCustomHamiltonian<block2::SZ,
+                                                        complex<double>>;
 extern template struct block2::GeneralHamiltonian<block2::SU2, complex<double>>;
 
 // general_mpo.hpp
@@ -854,6 +888,12 @@ extern template struct block2::GeneralMPO<block2::SU2, complex<double>>;
 extern template struct block2::GeneralNPDMMPO<block2::SZ, complex<double>>;
 extern template struct block2::GeneralNPDMMPO<block2::SU2, complex<double>>;
 
+// memory_planner.hpp
+extern template struct block2::MemoryPlanner<block2::SZ, complex<double>,
+                                             complex<double>>;
+extern template struct block2::MemoryPlanner<block2::SU2, complex<double>,
+                                             complex<double>>;
+
 // moving_environment.hpp
 extern template struct block2::MovingEnvironment<block2::SZ, complex<double>,
                                                  complex<double>>;
@@ -1009,11 +1049,17 @@ extern template struct block2::TDDMRG<block2::SZ, complex<double>,
                                       complex<double>>;
 extern template struct block2::TimeEvolution<block2::SZ, complex<double>,
                                              complex<double>>;
+extern template struct block2::MultiTrajectoryTimeEvolution<block2::SZ,
+                                                            complex<double>,
+                                                            complex<double>>;
 
 extern template struct block2::TDDMRG<block2::SU2, complex<double>,
                                       complex<double>>;
 extern template struct block2::TimeEvolution<block2::SU2, complex<double>,
                                              complex<double>>;
+extern template struct block2::MultiTrajectoryTimeEvolution<block2::SU2,
+                                                            complex<double>,
+                                                            complex<double>>;
 
 #endif
 
@@ -1072,6 +1118,12 @@ extern template struct block2::GeneralMPO<block2::SU2K, complex<double>>;
 extern template struct block2::GeneralNPDMMPO<block2::SZK, complex<double>>;
 extern template struct block2::GeneralNPDMMPO<block2::SU2K, complex<double>>;
 
+// memory_planner.hpp
+extern template struct block2::MemoryPlanner<block2::SZK, complex<double>,
+                                             complex<double>>;
+extern template struct block2::MemoryPlanner<block2::SU2K, complex<double>,
+                                             complex<double>>;
+
 // moving_environment.hpp
 extern template struct block2::MovingEnvironment<block2::SZK, complex<double>,
                                                  complex<double>>;
@@ -1229,11 +1281,17 @@ extern template struct block2::TDDMRG<block2::SZK, complex<double>,
                                       complex<double>>;
 extern template struct block2::TimeEvolution<block2::SZK, complex<double>,
                                              complex<double>>;
+extern template struct block2::MultiTrajectoryTimeEvolution<block2::SZK,
+                                                            complex<double>,
+                                                            complex<double>>;
 
 extern template struct block2::TDDMRG<block2::SU2K, complex<double>,
                                       complex<double>>;
 extern template struct block2::TimeEvolution<block2::SU2K, complex<double>,
                                              complex<double>>;
+extern template struct block2::MultiTrajectoryTimeEvolution<block2::SU2K,
+                                                            complex<double>,
+                                                            complex<double>>;
 
 #endif
 
@@ -1284,6 +1342,12 @@ extern template struct block2::GeneralMPO<block2::SGB, complex<double>>;
 extern template struct block2::GeneralNPDMMPO<block2::SGF, complex<double>>;
 extern template struct block2::GeneralNPDMMPO<block2::SGB, complex<double>>;
 
+// memory_planner.hpp
+extern template struct block2::MemoryPlanner<block2::SGF, complex<double>,
+                                             complex<double>>;
+extern template struct block2::MemoryPlanner<block2::SGB, complex<double>,
+                                             complex<double>>;
+
 // moving_environment.hpp
 extern template struct block2::MovingEnvironment<block2::SGF, complex<double>,
                                                  complex<double>>;
@@ -1437,11 +1501,17 @@ extern template struct block2::TDDMRG<block2::SGF, complex<double>,
                                       complex<double>>;
 extern template struct block2::TimeEvolution<block2::SGF, complex<double>,
                                              complex<double>>;
+extern template struct block2::MultiTrajectoryTimeEvolution<block2::SGF,
+                                                            complex<double>,
+                                                            complex<double>>;
 
 extern template struct block2::TDDMRG<block2::SGB, complex<double>,
                                       complex<double>>;
 extern template struct block2::TimeEvolution<block2::SGB, complex<double>,
                                              complex<double>>;
+extern template struct block2::MultiTrajectoryTimeEvolution<block2::SGB,
+                                                            complex<double>,
+                                                            complex<double>>;
 
 #endif
 
@@ -1475,6 +1545,8 @@ extern template struct block2::EffectiveHamiltonian<
 // general_hamiltonian.hpp
 extern template struct block2::GeneralHamiltonian<block2::SAny,
                                                   complex<double>>;
+extern template struct block2::GeneralCustomHamiltonian<block2::SAny,
+                                                        complex<double>>;
 
 // general_mpo.hpp
 extern template struct block2::GeneralMPO<block2::SAny, complex<double>>;
@@ -1482,6 +1554,10 @@ extern template struct block2::GeneralMPO<block2::SAny, complex<double>>;
 // general_npdm.hpp
 extern template struct block2::GeneralNPDMMPO<block2::SAny, complex<double>>;
 
+// memory_planner.hpp
+extern template struct block2::MemoryPlanner<block2::SAny, complex<double>,
+                                             complex<double>>;
+
 // moving_environment.hpp
 extern template struct block2::MovingEnvironment<block2::SAny, complex<double>,
                                                  complex<double>>;
@@ -1580,6 +1656,9 @@ extern template struct block2::TDDMRG<block2::SAny, complex<double>,
                                       complex<double>>;
 extern template struct block2::TimeEvolution<block2::SAny, complex<double>,
                                              complex<double>>;
+extern template struct block2::MultiTrajectoryTimeEvolution<block2::SAny,
+                                                            complex<double>,
+                                                            complex<double>>;
 
 #endif
 
@@ -1625,6 +1704,7 @@ extern template struct block2::EffectiveHamiltonian<
 
 // general_hamiltonian.hpp
 extern template struct block2::GeneralHamiltonian<block2::SZ, float>;
+extern template struct block2::GeneralCustomHamiltonian<block2::SZ, float>;
 extern template struct block2::GeneralHamiltonian<block2::SU2, float>;
 
 // general_mpo.hpp
@@ -1635,6 +1715,10 @@ extern template struct block2::GeneralMPO<block2::SU2, float>;
 extern template struct block2::GeneralNPDMMPO<block2::SZ, float>;
 extern template struct block2::GeneralNPDMMPO<block2::SU2, float>;
 
+// memory_planner.hpp
+extern template struct block2::MemoryPlanner<block2::SZ, float, float>;
+extern template struct block2::MemoryPlanner<block2::SU2, float, float>;
+
 // moving_environment.hpp
 extern template struct block2::MovingEnvironment<block2::SZ, float, float>;
 extern template struct block2::MovingEnvironment<block2::SU2, float, float>;
@@ -1774,9 +1858,13 @@ extern template struct block2::Expect<block2::SU2, float, float,
 // sweep_algorithm_td.hpp
 extern template struct block2::TDDMRG<block2::SZ, float, float>;
 extern template struct block2::TimeEvolution<block2::SZ, float, float>;
+extern template struct block2::MultiTrajectoryTimeEvolution<block2::SZ, float,
+                                                            float>;
 
 extern template struct block2::TDDMRG<block2::SU2, float, float>;
 extern template struct block2::TimeEvolution<block2::SU2, float, float>;
+extern template struct block2::MultiTrajectoryTimeEvolution<block2::SU2, float,
+                                                            float>;
 
 #endif
 
@@ -1823,6 +1911,10 @@ extern template struct block2::GeneralMPO<block2::SGB, float>;
 extern template struct block2::GeneralNPDMMPO<block2::SGF, float>;
 extern template struct block2::GeneralNPDMMPO<block2::SGB, float>;
 
+// memory_planner.hpp
+extern template struct block2::MemoryPlanner<block2::SGF, float, float>;
+extern template struct block2::MemoryPlanner<block2::SGB, float, float>;
+
 // moving_environment.hpp
 extern template struct block2::MovingEnvironment<block2::SGF, float, float>;
 extern template struct block2::MovingEnvironment<block2::SGB, float, float>;
@@ -1960,9 +2052,13 @@ extern template struct block2::Expect<block2::SGB, float, float,
 // sweep_algorithm_td.hpp
 extern template struct block2::TDDMRG<block2::SGF, float, float>;
 extern template struct block2::TimeEvolution<block2::SGF, float, float>;
+extern template struct block2::MultiTrajectoryTimeEvolution<block2::SGF, float,
+                                                            float>;
 
 extern template struct block2::TDDMRG<block2::SGB, float, float>;
 extern template struct block2::TimeEvolution<block2::SGB, float, float>;
+extern template struct block2::MultiTrajectoryTimeEvolution<block2::SGB, float,
+                                                            float>;
 
 #endif
 
@@ -2008,6 +2104,8 @@ extern template struct block2::EffectiveHamiltonian<
 
 // general_hamiltonian.hpp
 extern template struct block2::GeneralHamiltonian<block2::SZ, complex<float>>;
+extern template struct block2::GeneralCustomHamiltonian<block2::SZ,
+                                                        complex<float>>;
 extern template struct block2::GeneralHamiltonian<block2::SU2, complex<float>>;
 
 // general_mpo.hpp
@@ -2018,6 +2116,12 @@ extern template struct block2::GeneralMPO<block2::SU2, complex<float>>;
 extern template struct block2::GeneralNPDMMPO<block2::SZ, complex<float>>;
 extern template struct block2::GeneralNPDMMPO<block2::SU2, complex<float>>;
 
+// memory_planner.hpp
+extern template struct block2::MemoryPlanner<block2::SZ, complex<float>,
+                                             complex<float>>;
+extern template struct block2::MemoryPlanner<block2::SU2, complex<float>,
+                                             complex<float>>;
+
 // moving_environment.hpp
 extern template struct block2::MovingEnvironment<block2::SZ, complex<float>,
                                                  complex<float>>;
@@ -2179,11 +2283,17 @@ extern template struct block2::TDDMRG<block2::SZ, complex<float>,
                                       complex<float>>;
 extern template struct block2::TimeEvolution<block2::SZ, complex<float>,
                                              complex<float>>;
+extern template struct block2::MultiTrajectoryTimeEvolution<block2::SZ,
+                                                            complex<float>,
+                                                            complex<float>>;
 
 extern template struct block2::TDDMRG<block2::SU2, complex<float>,
                                       complex<float>>;
 extern template struct block2::TimeEvolution<block2::SU2, complex<float>,
                                              complex<float>>;
+extern template struct block2::MultiTrajectoryTimeEvolution<block2::SU2,
+                                                            complex<float>,
+                                                            complex<float>>;
 
 #endif
 
@@ -2232,6 +2342,12 @@ extern template struct block2::GeneralMPO<block2::SGB, complex<float>>;
 extern template struct block2::GeneralNPDMMPO<block2::SGF, complex<float>>;
 extern template struct block2::GeneralNPDMMPO<block2::SGB, complex<float>>;
 
+// memory_planner.hpp
+extern template struct block2::MemoryPlanner<block2::SGF, complex<float>,
+                                             complex<float>>;
+extern template struct block2::MemoryPlanner<block2::SGB, complex<float>,
+                                             complex<float>>;
+
 // moving_environment.hpp
 extern template struct block2::MovingEnvironment<block2::SGF, complex<float>,
                                                  complex<float>>;
@@ -2392,11 +2508,17 @@ extern template struct block2::TDDMRG<block2::SGF, complex<float>,
                                       complex<float>>;
 extern template struct block2::TimeEvolution<block2::SGF, complex<float>,
                                              complex<float>>;
+extern template struct block2::MultiTrajectoryTimeEvolution<block2::SGF,
+                                                            complex<float>,
+                                                            complex<float>>;
 
 extern template struct block2::TDDMRG<block2::SGB, complex<float>,
                                       complex<float>>;
 extern template struct block2::TimeEvolution<block2::SGB, complex<float>,
                                              complex<float>>;
+extern template struct block2::MultiTrajectoryTimeEvolution<block2::SGB,
+                                                            complex<float>,
+                                                            complex<float>>;
 
 #endif
 
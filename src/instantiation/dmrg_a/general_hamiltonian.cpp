@@ -21,3 +21,4 @@
 #include "../block2_dmrg.hpp"
 
 template struct block2::GeneralHamiltonian<block2::SAny, double>;
+template struct block2::GeneralCustomHamiltonian<block2::SAny, double>;
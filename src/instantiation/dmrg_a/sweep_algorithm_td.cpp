@@ -22,3 +22,5 @@
 
 template struct block2::TDDMRG<block2::SAny, double, double>;
 template struct block2::TimeEvolution<block2::SAny, double, double>;
+template struct block2::MultiTrajectoryTimeEvolution<block2::SAny, double,
+                                                     double>;
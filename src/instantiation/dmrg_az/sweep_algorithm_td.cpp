@@ -23,3 +23,6 @@
 template struct block2::TDDMRG<block2::SAny, complex<double>, complex<double>>;
 template struct block2::TimeEvolution<block2::SAny, complex<double>,
                                       complex<double>>;
+template struct block2::MultiTrajectoryTimeEvolution<block2::SAny,
+                                                     complex<double>,
+                                                     complex<double>>;
@@ -22,6 +22,10 @@
 
 template struct block2::TDDMRG<block2::SGF, double, double>;
 template struct block2::TimeEvolution<block2::SGF, double, double>;
+template struct block2::MultiTrajectoryTimeEvolution<block2::SGF, double,
+                                                     double>;
 
 template struct block2::TDDMRG<block2::SGB, double, double>;
 template struct block2::TimeEvolution<block2::SGB, double, double>;
+template struct block2::MultiTrajectoryTimeEvolution<block2::SGB, double,
+                                                     double>;
@@ -23,7 +23,13 @@
 template struct block2::TDDMRG<block2::SGF, complex<float>, complex<float>>;
 template struct block2::TimeEvolution<block2::SGF, complex<float>,
                                       complex<float>>;
+template struct block2::MultiTrajectoryTimeEvolution<block2::SGF,
+                                                     complex<float>,
+                                                     complex<float>>;
 
 template struct block2::TDDMRG<block2::SGB, complex<float>, complex<float>>;
 template struct block2::TimeEvolution<block2::SGB, complex<float>,
                                       complex<float>>;
+template struct block2::MultiTrajectoryTimeEvolution<block2::SGB,
+                                                     complex<float>,
+                                                     complex<float>>;
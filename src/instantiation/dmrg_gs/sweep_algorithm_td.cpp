@@ -22,6 +22,8 @@
 
 template struct block2::TDDMRG<block2::SGF, float, float>;
 template struct block2::TimeEvolution<block2::SGF, float, float>;
+template struct block2::MultiTrajectoryTimeEvolution<block2::SGF, float, float>;
 
 template struct block2::TDDMRG<block2::SGB, float, float>;
 template struct block2::TimeEvolution<block2::SGB, float, float>;
+template struct block2::MultiTrajectoryTimeEvolution<block2::SGB, float, float>;
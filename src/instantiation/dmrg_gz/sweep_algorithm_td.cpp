@@ -23,7 +23,13 @@
 template struct block2::TDDMRG<block2::SGF, complex<double>, complex<double>>;
 template struct block2::TimeEvolution<block2::SGF, complex<double>,
                                       complex<double>>;
+template struct block2::MultiTrajectoryTimeEvolution<block2::SGF,
+                                                     complex<double>,
+                                                     complex<double>>;
 
 template struct block2::TDDMRG<block2::SGB, complex<double>, complex<double>>;
 template struct block2::TimeEvolution<block2::SGB, complex<double>,
                                       complex<double>>;
+template struct block2::MultiTrajectoryTimeEvolution<block2::SGB,
+                                                     complex<double>,
+                                                     complex<double>>;
@@ -22,6 +22,10 @@
 
 template struct block2::TDDMRG<block2::SZK, double, double>;
 template struct block2::TimeEvolution<block2::SZK, double, double>;
+template struct block2::MultiTrajectoryTimeEvolution<block2::SZK, double,
+                                                     double>;
 
 template struct block2::TDDMRG<block2::SU2K, double, double>;
 template struct block2::TimeEvolution<block2::SU2K, double, double>;
+template struct block2::MultiTrajectoryTimeEvolution<block2::SU2K, double,
+                                                     double>;
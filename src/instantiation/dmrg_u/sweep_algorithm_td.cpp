@@ -22,6 +22,10 @@
 
 template struct block2::TDDMRG<block2::SZ, double, double>;
 template struct block2::TimeEvolution<block2::SZ, double, double>;
+template struct block2::MultiTrajectoryTimeEvolution<block2::SZ, double,
+                                                     double>;
 
 template struct block2::TDDMRG<block2::SU2, double, double>;
 template struct block2::TimeEvolution<block2::SU2, double, double>;
+template struct block2::MultiTrajectoryTimeEvolution<block2::SU2, double,
+                                                     double>;
@@ -22,3 +22,4 @@
 
 template struct block2::GeneralHamiltonian<block2::SZ, complex<float>>;
 template struct block2::GeneralHamiltonian<block2::SU2, complex<float>>;
+template struct block2::GeneralCustomHamiltonian<block2::SZ, complex<float>>;
@@ -23,7 +23,12 @@
 template struct block2::TDDMRG<block2::SZ, complex<float>, complex<float>>;
 template struct block2::TimeEvolution<block2::SZ, complex<float>,
                                       complex<float>>;
+template struct block2::MultiTrajectoryTimeEvolution<block2::SZ, complex<float>,
+                                                     complex<float>>;
 
 template struct block2::TDDMRG<block2::SU2, complex<float>, complex<float>>;
 template struct block2::TimeEvolution<block2::SU2, complex<float>,
                                       complex<float>>;
+template struct block2::MultiTrajectoryTimeEvolution<block2::SU2,
+                                                     complex<float>,
+                                                     complex<float>>;
@@ -22,6 +22,8 @@
 
 template struct block2::TDDMRG<block2::SZ, float, float>;
 template struct block2::TimeEvolution<block2::SZ, float, float>;
+template struct block2::MultiTrajectoryTimeEvolution<block2::SZ, float, float>;
 
 template struct block2::TDDMRG<block2::SU2, float, float>;
 template struct block2::TimeEvolution<block2::SU2, float, float>;
+template struct block2::MultiTrajectoryTimeEvolution<block2::SU2, float, float>;
@@ -22,3 +22,4 @@
 
 template struct block2::GeneralHamiltonian<block2::SZ, complex<double>>;
 template struct block2::GeneralHamiltonian<block2::SU2, complex<double>>;
+template struct block2::GeneralCustomHamiltonian<block2::SZ, complex<double>>;
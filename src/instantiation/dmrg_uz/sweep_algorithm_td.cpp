@@ -23,7 +23,13 @@
 template struct block2::TDDMRG<block2::SZ, complex<double>, complex<double>>;
 template struct block2::TimeEvolution<block2::SZ, complex<double>,
                                       complex<double>>;
+template struct block2::MultiTrajectoryTimeEvolution<block2::SZ,
+                                                     complex<double>,
+                                                     complex<double>>;
 
 template struct block2::TDDMRG<block2::SU2, complex<double>, complex<double>>;
 template struct block2::TimeEvolution<block2::SU2, complex<double>,
                                       complex<double>>;
+template struct block2::MultiTrajectoryTimeEvolution<block2::SU2,
+                                                     complex<double>,
+                                                     complex<double>>;
@@ -397,7 +397,14 @@ template <typename S, typename FL> void run(const map<string, string> &params) {
             double sparsity = 1.1;
 
             if (params.count("sparse_mpo") != 0) {
-                sparsity = Parsing::to_double(params.at("sparse_mpo"));
+                // "auto" uses the dense/sparse crossover density
+                if (params.at("sparse_mpo") == "auto") {
+                    sparsity = 1.0 - GCSRMatrixFunctions<
+                                         FL>::get_dense_crossover_density();
+                    cout << "sparse mpo sparsity threshold = " << sparsity
+                         << endl;
+                } else
+                    sparsity = Parsing::to_double(params.at("sparse_mpo"));
                 mpo->tf = make_shared<TensorFunctions<S, FL>>(
                     make_shared<CSROperatorFunctions<S, FL>>(hamil->opf->cg));
                 mpo->tf->opf->seq = hamil->opf->seq;
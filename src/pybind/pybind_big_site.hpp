@@ -152,6 +152,8 @@ template <typename S, typename FL> void bind_fl_csf_big_site(py::module &m) {
 
     py::class_<CSFSpace<S, FL>, shared_ptr<CSFSpace<S, FL>>>(m, "CSFSpace")
         .def(py::init<int, int, bool, const std::vector<uint8_t> &>())
+        .def(py::init<int, int, bool, const std::vector<uint8_t> &,
+                      const string &>())
         .def("get_config", &CSFSpace<S, FL>::get_config)
         .def("index_config", &CSFSpace<S, FL>::index_config)
         .def("to_string", &CSFSpace<S, FL>::to_string)
@@ -412,6 +414,45 @@ template <typename S, typename FL> void bind_fl_drt_big_site(py::module &m) {
         .def_readwrite("factors", &DRTBigSite<S, FL>::factors)
         .def_readwrite("factor_strides", &DRTBigSite<S, FL>::factor_strides)
         .def_readwrite("is_right", &DRTBigSite<S, FL>::is_right);
+
+    py::class_<DRTDirectCI<S, FL>, shared_ptr<DRTDirectCI<S, FL>>>(
+        m, "DRTDirectCI")
+        .def(py::init<const shared_ptr<FCIDUMP<FL>> &, S,
+                      const vector<typename S::pg_t> &>())
+        .def(py::init<const shared_ptr<FCIDUMP<FL>> &, S,
+                      const vector<typename S::pg_t> &, int>())
+        .def("size", &DRTDirectCI<S, FL>::size)
+        .def("sigma",
+             [](DRTDirectCI<S, FL> *self, py::array_t<FL> c) {
+                 assert((long long)c.size() == self->size());
+                 py::array_t<FL> s(c.size());
+                 memset(s.mutable_data(), 0, sizeof(FL) * c.size());
+                 self->sigma(c.data(), s.mutable_data());
+                 return s;
+             })
+        .def("diagonal",
+             [](DRTDirectCI<S, FL> *self) {
+                 vector<FL> diag = self->diagonal();
+                 return py::array_t<FL>(diag.size(), diag.data());
+             })
+        .def(
+            "solve",
+            [](DRTDirectCI<S, FL> *self, int nroots,
+               typename DRTDirectCI<S, FL>::FP conv_thrd, int max_iter) {
+                vector<vector<FL>> cis;
+                vector<typename DRTDirectCI<S, FL>::FP> eners =
+                    self->solve(nroots, cis, conv_thrd, max_iter);
+                py::list r;
+                for (auto &ci : cis)
+                    r.append(py::array_t<FL>(ci.size(), ci.data()));
+                return make_pair(eners, r);
+            },
+            py::arg("nroots") = 1, py::arg("conv_thrd") = 1E-10,
+            py::arg("max_iter") = 5000)
+        .def_readwrite("site", &DRTDirectCI<S, FL>::site)
+        .def_readwrite("hdrt", &DRTDirectCI<S, FL>::hdrt)
+        .def_readwrite("target", &DRTDirectCI<S, FL>::target)
+        .def_readwrite("iprint", &DRTDirectCI<S, FL>::iprint);
 }
 
 template <typename S, typename FL>
@@ -402,6 +402,23 @@ auto printable(const T &p) -> decltype(declval<ostream &>() << declval<T>(),
     return p;
 }
 
+// numpy array sharing the memory of data (no copy). Only allowed when the
+// data is owned by a VectorAllocator (heap), since stack allocated data is
+// reused by later allocations. The array keeps the owner alive, but it is
+// invalid after deallocate() or reallocate() of the owner
+template <typename FL, typename T>
+py::array_t<FL> heap_array_view(const shared_ptr<T> &owner) {
+    typedef typename GMatrix<FL>::FP FP;
+    if (owner->data == nullptr ||
+        dynamic_pointer_cast<VectorAllocator<FP>>(owner->alloc) == nullptr)
+        throw runtime_error("array_view: data is not owned by a "
+                            "VectorAllocator, use data for a copy.");
+    return py::array_t<FL>(
+        owner->total_memory, owner->data,
+        py::capsule(new shared_ptr<T>(owner),
+                    [](void *p) { delete (shared_ptr<T> *)p; }));
+}
+
 template <typename T>
 py::class_<Array<T>, shared_ptr<Array<T>>> bind_array(py::module &m,
                                                       const char *name) {
@@ -707,7 +724,8 @@ template <typename S> void bind_state_info(py::module &m, const string &name) {
         .def("deep_copy", &StateInfo<S>::deep_copy)
         .def("collect", &StateInfo<S>::collect,
              py::arg("target") = S(S::invalid))
-        .def("find_state", &StateInfo<S>::find_state)
+        .def("find_state",
+             (int(StateInfo<S>::*)(S) const) & StateInfo<S>::find_state)
         .def_static("tensor_product_ref",
                     (StateInfo<S>(*)(const StateInfo<S> &, const StateInfo<S> &,
                                      const StateInfo<S> &)) &
@@ -744,6 +762,20 @@ void bind_fl_state_info(py::module &m, const string &fname) {
 
 template <typename S> void bind_sparse(py::module &m) {
 
+    py::class_<ConnectionPlanCache<S>, shared_ptr<ConnectionPlanCache<S>>>(
+        m, "ConnectionPlanCache")
+        .def(py::init<>())
+        .def_readwrite("n_hits", &ConnectionPlanCache<S>::n_hits)
+        .def_readwrite("n_misses", &ConnectionPlanCache<S>::n_misses)
+        .def_readwrite("n_plans", &ConnectionPlanCache<S>::n_plans)
+        .def_readwrite("total_size", &ConnectionPlanCache<S>::total_size)
+        .def_readwrite("max_size", &ConnectionPlanCache<S>::max_size)
+        .def("hit_rate", &ConnectionPlanCache<S>::hit_rate)
+        .def("clear", &ConnectionPlanCache<S>::clear)
+        .def("save_data", &ConnectionPlanCache<S>::save_data)
+        .def("load_data", &ConnectionPlanCache<S>::load_data)
+        .def("__repr__", &ConnectionPlanCache<S>::to_str);
+
     py::class_<typename SparseMatrixInfo<S>::ConnectionInfo,
                shared_ptr<typename SparseMatrixInfo<S>::ConnectionInfo>>(
         m, "SpMatConnectionInfo")
@@ -755,7 +787,12 @@ template <typename S> void bind_sparse(py::module &m) {
             })
         .def_readwrite("nc", &SparseMatrixInfo<S>::ConnectionInfo::nc)
         .def("initialize_tp",
-             &SparseMatrixInfo<S>::ConnectionInfo::initialize_tp)
+             &SparseMatrixInfo<S>::ConnectionInfo::initialize_tp,
+             py::arg("cdq"), py::arg("subdq"), py::arg("bra"), py::arg("ket"),
+             py::arg("bra_a"), py::arg("bra_b"), py::arg("ket_a"),
+             py::arg("ket_b"), py::arg("bra_cinfo"), py::arg("ket_cinfo"),
+             py::arg("ainfos"), py::arg("binfos"), py::arg("cinfo"),
+             py::arg("cg"), py::arg("plans") = nullptr)
         .def("deallocate", &SparseMatrixInfo<S>::ConnectionInfo::deallocate)
         .def("__repr__",
              [](typename SparseMatrixInfo<S>::ConnectionInfo *self) {
@@ -799,8 +836,20 @@ template <typename S> void bind_sparse(py::module &m) {
              &SparseMatrixInfo<S>::initialize_trans_contract)
         .def("initialize_contract", &SparseMatrixInfo<S>::initialize_contract)
         .def("initialize_dm", &SparseMatrixInfo<S>::initialize_dm)
-        .def("find_state", &SparseMatrixInfo<S>::find_state, py::arg("q"),
-             py::arg("start") = 0)
+        .def("find_state",
+             (int(SparseMatrixInfo<S>::*)(S, int) const) &
+                 SparseMatrixInfo<S>::find_state,
+             py::arg("q"), py::arg("start") = 0)
+        .def("build_index", &SparseMatrixInfo<S>::build_index)
+        .def_property_readonly("has_index", &SparseMatrixInfo<S>::has_index)
+        .def_property_static(
+            "quanta_index_threshold",
+            [](py::object) {
+                return SparseMatrixInfo<S>::quanta_index_threshold();
+            },
+            [](py::object, int t) {
+                SparseMatrixInfo<S>::quanta_index_threshold() = t;
+            })
         .def_property_readonly("total_memory",
                                &SparseMatrixInfo<S>::get_total_memory)
         .def("allocate", &SparseMatrixInfo<S>::allocate, py::arg("length"),
@@ -845,6 +894,7 @@ template <typename S, typename FL> void bind_fl_sparse(py::module &m) {
                 assert(v.size() == self->total_memory);
                 memcpy(self->data, v.data(), sizeof(FL) * self->total_memory);
             })
+        .def("array_view", &heap_array_view<FL, SparseMatrix<S, FL>>)
         .def("clear", &SparseMatrix<S, FL>::clear)
         .def("load_data",
              (void(SparseMatrix<S, FL>::*)(
@@ -1049,6 +1099,7 @@ template <typename S, typename FL> void bind_fl_sparse(py::module &m) {
                 assert(v.size() == self->total_memory);
                 memcpy(self->data, v.data(), sizeof(FL) * self->total_memory);
             })
+        .def("array_view", &heap_array_view<FL, SparseMatrixGroup<S, FL>>)
         .def("load_data", &SparseMatrixGroup<S, FL>::load_data,
              py::arg("filename"), py::arg("load_info") = false,
              py::arg("i_alloc") = nullptr)
@@ -1100,6 +1151,7 @@ template <typename S, typename FL> void bind_fl_operator(py::module &m) {
         m, "OperatorFunctions")
         .def_readwrite("cg", &OperatorFunctions<S, FL>::cg)
         .def_readwrite("seq", &OperatorFunctions<S, FL>::seq)
+        .def_readwrite("plan_cache", &OperatorFunctions<S, FL>::plan_cache)
         .def(py::init<const shared_ptr<CG<S>> &>())
         .def("get_type", &OperatorFunctions<S, FL>::get_type)
         .def("iadd", &OperatorFunctions<S, FL>::iadd, py::arg("a"),
@@ -1699,6 +1751,7 @@ template <typename S = void> void bind_types(py::module &m) {
         .value("Unscaled", NoiseTypes::Unscaled)
         .value("LowMem", NoiseTypes::LowMem)
         .value("MidMem", NoiseTypes::MidMem)
+        .value("Batched", NoiseTypes::Batched)
         .value("ReducedPerturbative", NoiseTypes::ReducedPerturbative)
         .value("ReducedPerturbativeUnscaled",
                NoiseTypes::ReducedPerturbativeUnscaled)
@@ -1718,6 +1771,14 @@ template <typename S = void> void bind_types(py::module &m) {
                NoiseTypes::ReducedPerturbativeCollectedLowMem)
         .value("ReducedPerturbativeUnscaledCollectedLowMem",
                NoiseTypes::ReducedPerturbativeUnscaledCollectedLowMem)
+        .value("ReducedPerturbativeBatched",
+               NoiseTypes::ReducedPerturbativeBatched)
+        .value("ReducedPerturbativeUnscaledBatched",
+               NoiseTypes::ReducedPerturbativeUnscaledBatched)
+        .value("ReducedPerturbativeCollectedBatched",
+               NoiseTypes::ReducedPerturbativeCollectedBatched)
+        .value("ReducedPerturbativeUnscaledCollectedBatched",
+               NoiseTypes::ReducedPerturbativeUnscaledCollectedBatched)
         .def(py::self & py::self)
         .def(py::self | py::self);
 
@@ -2361,6 +2422,12 @@ template <typename S = void> void bind_io(py::module &m) {
                       const vector<uint16_t> &>())
         .def(py::init<string, bool, bool, bool, bool, const vector<uint16_t> &,
                       int>())
+        .def(py::init<string, bool, bool, bool, bool, const vector<uint16_t> &,
+                      int, const string &>(),
+             py::arg("spin_str"), py::arg("su2"), py::arg("is_fermion"),
+             py::arg("is_npdm"), py::arg("is_drt"), py::arg("mask"),
+             py::arg("max_n_sites"), py::arg("cache_dir"))
+        .def_static("cache_key", &SpinPermScheme::cache_key)
         .def_readwrite("index_patterns", &SpinPermScheme::index_patterns)
         .def_readwrite("data", &SpinPermScheme::data)
         .def_readwrite("is_su2", &SpinPermScheme::is_su2)
@@ -2409,6 +2476,9 @@ template <typename S = void> void bind_io(py::module &m) {
     py::class_<NPDMScheme, shared_ptr<NPDMScheme>>(m, "NPDMScheme")
         .def(py::init<shared_ptr<SpinPermScheme>>())
         .def(py::init<const vector<shared_ptr<SpinPermScheme>> &>())
+        .def(py::init<const vector<shared_ptr<SpinPermScheme>> &,
+                      const string &>(),
+             py::arg("perms"), py::arg("cache_dir"))
         .def_readwrite("left_terms", &NPDMScheme::left_terms)
         .def_readwrite("right_terms", &NPDMScheme::right_terms)
         .def_readwrite("middle_terms", &NPDMScheme::middle_terms)
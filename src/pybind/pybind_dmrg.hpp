@@ -32,6 +32,7 @@ namespace py = pybind11;
 using namespace block2;
 
 PYBIND11_MAKE_OPAQUE(vector<ActiveTypes>);
+PYBIND11_MAKE_OPAQUE(vector<MemoryPlan>);
 
 #ifdef _USE_SU2SZ
 // SZ
@@ -539,7 +540,7 @@ template <typename S, typename FL> void bind_fl_mps(py::module &m) {
              py::arg("info"), py::arg("para_rule") = nullptr)
         .def("evaluate", &DeterminantTRIE<S, FL>::evaluate, py::arg("mps"),
              py::arg("cutoff") = 0.0, py::arg("max_rank") = -1,
-             py::arg("ref") = vector<uint8_t>())
+             py::arg("ref") = vector<uint8_t>(), py::arg("batch") = 0)
         .def("convert_phase", &DeterminantTRIE<S, FL>::convert_phase,
              py::arg("reorder"));
 }
@@ -575,11 +576,20 @@ template <typename S, typename FL> void bind_fl_partition(py::module &m) {
         .def_static("copy_op_infos", &Partition<S, FL>::copy_op_infos)
         .def_static("init_left_op_infos", &Partition<S, FL>::init_left_op_infos)
         .def_static("init_left_op_infos_notrunc",
-                    &Partition<S, FL>::init_left_op_infos_notrunc)
+                    &Partition<S, FL>::init_left_op_infos_notrunc, py::arg("m"),
+                    py::arg("bra_info"), py::arg("ket_info"), py::arg("sl"),
+                    py::arg("subsl"), py::arg("prev_left_op_infos"),
+                    py::arg("site_op_infos"), py::arg("left_op_infos_notrunc"),
+                    py::arg("cg"), py::arg("plan_cache") = nullptr)
         .def_static("init_right_op_infos",
                     &Partition<S, FL>::init_right_op_infos)
         .def_static("init_right_op_infos_notrunc",
-                    &Partition<S, FL>::init_right_op_infos_notrunc);
+                    &Partition<S, FL>::init_right_op_infos_notrunc,
+                    py::arg("m"), py::arg("bra_info"), py::arg("ket_info"),
+                    py::arg("sl"), py::arg("subsl"),
+                    py::arg("prev_right_op_infos"), py::arg("site_op_infos"),
+                    py::arg("right_op_infos_notrunc"), py::arg("cg"),
+                    py::arg("plan_cache") = nullptr);
 
     py::bind_vector<vector<shared_ptr<Partition<S, FL>>>>(m, "VectorPartition");
 
@@ -812,6 +822,15 @@ void bind_fl_moving_environment(py::module &m, const string &name) {
             &MovingEnvironment<S, FL, FLS>::lowmem_numerical_transform)
         .def_readwrite("save_environments",
                        &MovingEnvironment<S, FL, FLS>::save_environments)
+        .def_readwrite("incremental_rotation",
+                       &MovingEnvironment<S, FL, FLS>::incremental_rotation)
+        .def_readwrite(
+            "incremental_rotation_tol",
+            &MovingEnvironment<S, FL, FLS>::incremental_rotation_tol)
+        .def_readwrite("incr_kept_states",
+                       &MovingEnvironment<S, FL, FLS>::incr_kept_states)
+        .def_readwrite("incr_total_states",
+                       &MovingEnvironment<S, FL, FLS>::incr_total_states)
         .def("left_contract_rotate",
              &MovingEnvironment<S, FL, FLS>::left_contract_rotate)
         .def("right_contract_rotate",
@@ -1261,7 +1280,10 @@ void bind_fl_expect(py::module &m, const string &name) {
         .def("get_1npc", &Expect<S, FL, FLS, FLX>::get_1npc, py::arg("s"),
              py::arg("n_physical_sites") = (uint16_t)0U)
         .def("get_npdm", &Expect<S, FL, FLS, FLX>::get_npdm,
-             py::arg("n_physical_sites") = (uint16_t)0U);
+             py::arg("n_physical_sites") = (uint16_t)0U)
+        .def("get_npdm_shards", &Expect<S, FL, FLS, FLX>::get_npdm_shards,
+             py::arg("n_physical_sites") = (uint16_t)0U,
+             py::arg("distributed") = true);
 }
 
 template <typename S, typename FL, typename FLS>
@@ -1287,6 +1309,22 @@ void bind_fl_dmrg(py::module &m) {
             return ss.str();
         });
 
+    py::class_<MemoryPlanner<S, FL, FLS>,
+               shared_ptr<MemoryPlanner<S, FL, FLS>>>(m, "MemoryPlanner")
+        .def(py::init<>())
+        .def(py::init<size_t>())
+        .def(py::init<size_t, size_t>())
+        .def_readwrite("max_memory", &MemoryPlanner<S, FL, FLS>::max_memory)
+        .def_readwrite("max_disk", &MemoryPlanner<S, FL, FLS>::max_disk)
+        .def_readwrite("safety", &MemoryPlanner<S, FL, FLS>::safety)
+        .def_readwrite("iprint", &MemoryPlanner<S, FL, FLS>::iprint)
+        .def_readwrite("plans", &MemoryPlanner<S, FL, FLS>::plans)
+        .def("estimate", &MemoryPlanner<S, FL, FLS>::estimate)
+        .def("fits", &MemoryPlanner<S, FL, FLS>::fits)
+        .def("plan_sweep", &MemoryPlanner<S, FL, FLS>::plan_sweep)
+        .def("restore", &MemoryPlanner<S, FL, FLS>::restore)
+        .def("finish_sweep", &MemoryPlanner<S, FL, FLS>::finish_sweep);
+
     py::class_<DMRG<S, FL, FLS>, shared_ptr<DMRG<S, FL, FLS>>>(m, "DMRG")
         .def(py::init<const shared_ptr<MovingEnvironment<S, FL, FLS>> &,
                       const vector<ubond_t> &,
@@ -1334,6 +1372,11 @@ void bind_fl_dmrg(py::module &m) {
         .def_readwrite("trunc_type", &DMRG<S, FL, FLS>::trunc_type)
         .def_readwrite("decomp_type", &DMRG<S, FL, FLS>::decomp_type)
         .def_readwrite("decomp_last_site", &DMRG<S, FL, FLS>::decomp_last_site)
+        .def_readwrite("subspace_expansion",
+                       &DMRG<S, FL, FLS>::subspace_expansion)
+        .def_readwrite("noise_batch_size",
+                       &DMRG<S, FL, FLS>::noise_batch_size)
+        .def_readwrite("mem_planner", &DMRG<S, FL, FLS>::mem_planner)
         .def_readwrite("sweep_cumulative_nflop",
                        &DMRG<S, FL, FLS>::sweep_cumulative_nflop)
         .def_readwrite("sweep_max_pket_size",
@@ -1475,6 +1518,8 @@ void bind_fl_td_dmrg(py::module &m) {
                       const vector<ubond_t> &, TETypes, int>())
         .def_readwrite("iprint", &TimeEvolution<S, FL, FLS>::iprint)
         .def_readwrite("cutoff", &TimeEvolution<S, FL, FLS>::cutoff)
+        .def_readwrite("subspace_expansion",
+                       &TimeEvolution<S, FL, FLS>::subspace_expansion)
         .def_readwrite("me", &TimeEvolution<S, FL, FLS>::me)
         .def_readwrite("ext_mes", &TimeEvolution<S, FL, FLS>::ext_mes)
         .def_readwrite("ext_mpss", &TimeEvolution<S, FL, FLS>::ext_mpss)
@@ -1521,6 +1566,50 @@ void bind_fl_td_dmrg(py::module &m) {
              py::arg("beta"), py::arg("forward") = true, py::arg("tol") = 1E-6,
              py::call_guard<checked_ostream_redirect,
                             checked_estream_redirect>());
+
+    py::class_<MultiTrajectoryTimeEvolution<S, FL, FLS>,
+               shared_ptr<MultiTrajectoryTimeEvolution<S, FL, FLS>>>(
+        m, "MultiTrajectoryTimeEvolution")
+        .def(py::init<
+             const vector<shared_ptr<MovingEnvironment<S, FL, FLS>>> &,
+             const vector<ubond_t> &, TETypes>())
+        .def(py::init<
+             const vector<shared_ptr<MovingEnvironment<S, FL, FLS>>> &,
+             const vector<ubond_t> &, TETypes, int>())
+        .def_readwrite("trajs",
+                       &MultiTrajectoryTimeEvolution<S, FL, FLS>::trajs)
+        .def_readwrite("iprint",
+                       &MultiTrajectoryTimeEvolution<S, FL, FLS>::iprint)
+        .def_readwrite("bond_dims",
+                       &MultiTrajectoryTimeEvolution<S, FL, FLS>::bond_dims)
+        .def_readwrite("noises",
+                       &MultiTrajectoryTimeEvolution<S, FL, FLS>::noises)
+        .def_readwrite("energies",
+                       &MultiTrajectoryTimeEvolution<S, FL, FLS>::energies)
+        .def_readwrite("normsqs",
+                       &MultiTrajectoryTimeEvolution<S, FL, FLS>::normsqs)
+        .def_readwrite(
+            "discarded_weights",
+            &MultiTrajectoryTimeEvolution<S, FL, FLS>::discarded_weights)
+        .def_readwrite("forward",
+                       &MultiTrajectoryTimeEvolution<S, FL, FLS>::forward)
+        .def_readwrite("mode", &MultiTrajectoryTimeEvolution<S, FL, FLS>::mode)
+        .def_readwrite("n_sub_sweeps",
+                       &MultiTrajectoryTimeEvolution<S, FL, FLS>::n_sub_sweeps)
+        .def_readwrite(
+            "normalize_mps",
+            &MultiTrajectoryTimeEvolution<S, FL, FLS>::normalize_mps)
+        .def_readwrite("pin_mpo",
+                       &MultiTrajectoryTimeEvolution<S, FL, FLS>::pin_mpo)
+        .def_readwrite(
+            "sweep_cumulative_nflop",
+            &MultiTrajectoryTimeEvolution<S, FL, FLS>::sweep_cumulative_nflop)
+        .def("sweep", &MultiTrajectoryTimeEvolution<S, FL, FLS>::sweep)
+        .def("solve", &MultiTrajectoryTimeEvolution<S, FL, FLS>::solve,
+             py::arg("n_sweeps"), py::arg("beta"), py::arg("forward") = true,
+             py::arg("tol") = 1E-6,
+             py::call_guard<checked_ostream_redirect,
+                            checked_estream_redirect>());
 }
 
 template <typename S, typename FL, typename FLS>
@@ -1720,6 +1809,25 @@ template <typename S, typename FL> void bind_fl_parallel_dmrg(py::module &m) {
         .def(py::init<const shared_ptr<ParallelCommunicator<S>> &,
                       ParallelCommTypes>());
 
+    py::class_<NPDMShard<S, FL>, shared_ptr<NPDMShard<S, FL>>>(m,
+                                                               "NPDMShard")
+        .def(py::init<const vector<MKL_INT> &>())
+        .def(py::init<const vector<MKL_INT> &,
+                      const shared_ptr<ParallelCommunicator<S>> &>())
+        .def_readwrite("shape", &NPDMShard<S, FL>::shape)
+        .def_readwrite("offset", &NPDMShard<S, FL>::offset)
+        .def_readwrite("data", &NPDMShard<S, FL>::data)
+        .def_readwrite("comm", &NPDMShard<S, FL>::comm)
+        .def_property_readonly("rank", &NPDMShard<S, FL>::rank)
+        .def_property_readonly("n_ranks", &NPDMShard<S, FL>::n_ranks)
+        .def("size", &NPDMShard<S, FL>::size)
+        .def("total_size", &NPDMShard<S, FL>::total_size)
+        .def("displs", &NPDMShard<S, FL>::displs)
+        .def("gather", &NPDMShard<S, FL>::gather)
+        .def("save", &NPDMShard<S, FL>::save, py::arg("filename"))
+        .def("save_local", &NPDMShard<S, FL>::save_local,
+             py::arg("filename"));
+
     py::class_<ParallelRuleNPDMQC<S, FL>, shared_ptr<ParallelRuleNPDMQC<S, FL>>,
                ParallelRule<S, FL>>(m, "ParallelRuleNPDMQC")
         .def(py::init<const shared_ptr<ParallelCommunicator<S>> &>())
@@ -1824,8 +1932,10 @@ template <typename S, typename FL> void bind_fl_mpo(py::module &m) {
         .def_readwrite("archive_schemer_mark",
                        &MPO<S, FL>::archive_schemer_mark)
         .def_readwrite("archive_filename", &MPO<S, FL>::archive_filename)
+        .def_readwrite("pinned_sites", &MPO<S, FL>::pinned_sites)
         .def_readwrite("tag", &MPO<S, FL>::tag)
         .def_readwrite("tread", &MPO<S, FL>::tread)
+        .def_readwrite("nread", &MPO<S, FL>::nread)
         .def_readwrite("twrite", &MPO<S, FL>::twrite)
         .def("get_summary", &MPO<S, FL>::get_summary)
         .def("get_bond_dims", &MPO<S, FL>::get_bond_dims)
@@ -1846,6 +1956,9 @@ template <typename S, typename FL> void bind_fl_mpo(py::module &m) {
         .def("load_schemer", &MPO<S, FL>::load_schemer)
         .def("save_schemer", &MPO<S, FL>::save_schemer)
         .def("unload_schemer", &MPO<S, FL>::unload_schemer)
+        .def("is_pinned", &MPO<S, FL>::is_pinned)
+        .def("pin_site", &MPO<S, FL>::pin_site)
+        .def("unpin_site", &MPO<S, FL>::unpin_site)
         .def("reduce_data", &MPO<S, FL>::reduce_data)
         .def("load_data",
              (void(MPO<S, FL>::*)(const string &, bool)) &
@@ -2042,12 +2155,96 @@ template <typename S, typename FL> void bind_fl_mpo(py::module &m) {
         .def(py::init<const shared_ptr<MPO<S, FL>> &, const string &>());
 }
 
+template <typename S, typename FL>
+void bind_fl_general_custom_hamiltonian(py::module &m) {
+
+    py::class_<GeneralCustomHamiltonian<S, FL>,
+               shared_ptr<GeneralCustomHamiltonian<S, FL>>,
+               GeneralHamiltonian<S, FL>>(m, "GeneralCustomHamiltonian")
+        .def(py::init([](S vacuum, int n_sites,
+                         const vector<typename S::pg_t> &orb_sym,
+                         const py::sequence &site_basis,
+                         const py::sequence &site_ops,
+                         const string &orb_dependent_ops,
+                         const string &spin_dependent_ops,
+                         const py::object &spin_sym) {
+                 typedef py::array_t<FL, py::array::c_style |
+                                             py::array::forcecast>
+                     arr_t;
+                 vector<vector<pair<S, int>>> basis(site_basis.size());
+                 for (size_t i = 0; i < site_basis.size(); i++)
+                     for (auto x : site_basis[i].cast<py::sequence>()) {
+                         py::tuple t = x.cast<py::tuple>();
+                         basis[i].push_back(
+                             make_pair(t[0].cast<S>(), t[1].cast<int>()));
+                     }
+                 vector<vector<pair<string, pair<S, vector<FL>>>>> ops(
+                     site_ops.size());
+                 for (size_t i = 0; i < site_ops.size(); i++)
+                     for (auto x : site_ops[i].cast<py::dict>()) {
+                         S dq(S::invalid);
+                         py::object op = py::reinterpret_borrow<py::object>(
+                             x.second);
+                         if (py::isinstance<py::tuple>(op) &&
+                             py::len(op) == 2 &&
+                             py::isinstance<py::array>(op[py::int_(1)])) {
+                             dq = op[py::int_(0)].cast<S>();
+                             op = op[py::int_(1)];
+                         }
+                         arr_t arr = op.cast<arr_t>();
+                         ops[i].push_back(make_pair(
+                             x.first.cast<string>(),
+                             make_pair(dq, vector<FL>(arr.data(),
+                                                      arr.data() +
+                                                          arr.size()))));
+                     }
+                 vector<map<string, int>> spins;
+                 if (!spin_sym.is_none())
+                     spins = spin_sym.cast<vector<map<string, int>>>();
+                 return make_shared<GeneralCustomHamiltonian<S, FL>>(
+                     vacuum, n_sites, orb_sym, basis, ops, orb_dependent_ops,
+                     spin_dependent_ops, spins);
+             }),
+             py::arg("vacuum"), py::arg("n_sites"), py::arg("orb_sym"),
+             py::arg("site_basis"), py::arg("site_ops"),
+             py::arg("orb_dependent_ops") = "cdCD",
+             py::arg("spin_dependent_ops") = "",
+             py::arg("spin_sym") = py::none())
+        .def_readwrite("orb_dependent_ops",
+                       &GeneralCustomHamiltonian<S, FL>::orb_dependent_ops)
+        .def_readwrite("spin_dependent_ops",
+                       &GeneralCustomHamiltonian<S, FL>::spin_dependent_ops)
+        .def_readwrite("prim_quanta",
+                       &GeneralCustomHamiltonian<S, FL>::prim_quanta);
+}
+
+template <typename S, typename FL>
+auto bind_fl_general_custom(py::module &m) -> decltype(typename S::is_sz_t()) {
+    bind_fl_general_custom_hamiltonian<S, FL>(m);
+}
+
+template <typename S, typename FL>
+auto bind_fl_general_custom(py::module &m)
+    -> decltype(typename S::is_sany_t()) {
+    bind_fl_general_custom_hamiltonian<S, FL>(m);
+}
+
+template <typename S, typename FL>
+auto bind_fl_general_custom(py::module &m) -> decltype(typename S::is_su2_t()) {
+}
+
+template <typename S, typename FL>
+auto bind_fl_general_custom(py::module &m) -> decltype(typename S::is_sg_t()) {
+}
+
 template <typename S, typename FL> void bind_fl_general(py::module &m) {
 
     struct PyGeneralHamiltonian : GeneralHamiltonian<S, FL> {
         typedef GeneralHamiltonian<S, FL> super_t;
         typedef unordered_map<string, shared_ptr<SparseMatrix<S, FL>>> mp_str_t;
         using GeneralHamiltonian<S, FL>::GeneralHamiltonian;
+        // callbacks may acquire the GIL, so they must be called serially
+        bool is_thread_safe() const override { return false; }
         shared_ptr<StateInfo<S>> get_site_basis(uint16_t m) const override {
             PYBIND11_OVERRIDE(shared_ptr<StateInfo<S>>, super_t, get_site_basis,
                               m);
@@ -2136,6 +2333,8 @@ template <typename S, typename FL> void bind_fl_general(py::module &m) {
         .def_static("get_sub_expr", &GeneralHamiltonian<S, FL>::get_sub_expr)
         .def("deallocate", &GeneralHamiltonian<S, FL>::deallocate);
 
+    bind_fl_general_custom<S, FL>(m);
+
     py::class_<GeneralMPO<S, FL>, shared_ptr<GeneralMPO<S, FL>>, MPO<S, FL>>(
         m, "GeneralMPO")
         .def_readwrite("algo_type", &GeneralMPO<S, FL>::algo_type)
@@ -2160,6 +2359,11 @@ template <typename S, typename FL> void bind_fl_general(py::module &m) {
         .def_readwrite("block_max_length", &GeneralMPO<S, FL>::block_max_length)
         .def_readwrite("fast_no_orb_dep_op",
                        &GeneralMPO<S, FL>::fast_no_orb_dep_op)
+        // site quanta of terms are computed in parallel, and Python
+        // overrides of GeneralHamiltonian acquire the GIL by themselves
+        .def("build", &GeneralMPO<S, FL>::build,
+             py::call_guard<checked_ostream_redirect, checked_estream_redirect,
+                            py::gil_scoped_release>())
         .def(py::init<const shared_ptr<GeneralHamiltonian<S, FL>> &,
                       const shared_ptr<GeneralFCIDUMP<FL>> &,
                       MPOAlgorithmTypes>(),
@@ -2491,6 +2695,31 @@ template <typename S = void> void bind_dmrg_types(py::module &m) {
         .value("FastBipartite", MPOAlgorithmTypes::FastBipartite)
         .def(py::self & py::self)
         .def(py::self | py::self);
+
+    py::class_<MemoryPlan, shared_ptr<MemoryPlan>>(m, "MemoryPlan")
+        .def(py::init<>())
+        .def_readwrite("bond_dim", &MemoryPlan::bond_dim)
+        .def_readwrite("peak_site", &MemoryPlan::peak_site)
+        .def_readwrite("main_peak", &MemoryPlan::main_peak)
+        .def_readwrite("second_peak", &MemoryPlan::second_peak)
+        .def_readwrite("heap_peak", &MemoryPlan::heap_peak)
+        .def_readwrite("disk_storage", &MemoryPlan::disk_storage)
+        .def_readwrite("actual_main_peak", &MemoryPlan::actual_main_peak)
+        .def_readwrite("actual_second_peak", &MemoryPlan::actual_second_peak)
+        .def_readwrite("dmain_ratio", &MemoryPlan::dmain_ratio)
+        .def_readwrite("use_main_stack", &MemoryPlan::use_main_stack)
+        .def_readwrite("batched_noise", &MemoryPlan::batched_noise)
+        .def_readwrite("fused_contraction_rotation",
+                       &MemoryPlan::fused_contraction_rotation)
+        .def_readwrite("fused_contraction_multiplication",
+                       &MemoryPlan::fused_contraction_multiplication)
+        .def_readwrite("lowmem_numerical_transform",
+                       &MemoryPlan::lowmem_numerical_transform)
+        .def_readwrite("minimal_disk_usage", &MemoryPlan::minimal_disk_usage)
+        .def_readwrite("feasible", &MemoryPlan::feasible)
+        .def("__repr__", &MemoryPlan::to_str);
+
+    py::bind_vector<vector<MemoryPlan>>(m, "VectorMemoryPlan");
 }
 
 template <typename S = void> void bind_dmrg_io(py::module &m) {
@@ -2508,7 +2737,23 @@ template <typename S = void> void bind_dmrg_io(py::module &m) {
         .def_static("ga_opt", &OrbitalOrdering::ga_opt, py::arg("n_sites"),
                     py::arg("kmat"), py::arg("n_generations") = 10000,
                     py::arg("n_configs") = 54, py::arg("n_elite") = 5,
-                    py::arg("clone_rate") = 0.1, py::arg("mutate_rate") = 0.1);
+                    py::arg("clone_rate") = 0.1, py::arg("mutate_rate") = 0.1,
+                    py::arg("target_cost") = 0.0, py::arg("iprint") = 0)
+        .def_static(
+            "swap_delta",
+            [](uint16_t n_sites, const vector<double> &kmat,
+               const vector<uint16_t> &ord, int a, int b) {
+                return OrbitalOrdering::swap_delta(n_sites, kmat, ord, a, b);
+            },
+            py::arg("n_sites"), py::arg("kmat"), py::arg("ord"), py::arg("a"),
+            py::arg("b"))
+        .def_static("reverse_delta", &OrbitalOrdering::reverse_delta,
+                    py::arg("n_sites"), py::arg("kmat"), py::arg("ord"),
+                    py::arg("a"), py::arg("b"))
+        .def_static("sa_opt", &OrbitalOrdering::sa_opt, py::arg("n_sites"),
+                    py::arg("kmat"), py::arg("init_ord") = vector<uint16_t>(),
+                    py::arg("n_steps") = 1000000, py::arg("seed") = 1234,
+                    py::arg("target_cost") = 0.0, py::arg("iprint") = 0);
 }
 
 #ifdef _EXPLICIT_TEMPLATE
@@ -173,6 +173,9 @@ template <typename S = void> void bind_nd_array(py::module &m) {
                             xarrs.push_back(x.cast<NDArray>());
                         return NDArray::einsum(script, xarrs);
                     })
+        .def_static("contraction_path", &NDArray::contraction_path,
+                    py::arg("scripts"), py::arg("shapes"), py::arg("result"),
+                    py::arg("max_optimal") = 6)
         .def("transpose",
              [](NDArray *self, const py::tuple &t) {
                  vector<int> perm(t.size());
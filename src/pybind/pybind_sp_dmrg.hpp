@@ -72,5 +72,10 @@ template <typename S, typename FL> void bind_fl_sp_dmrg(py::module &m) {
         .def("sampling", &StochasticPDMRG<S, FL>::sampling)
         .def("overlap", &StochasticPDMRG<S, FL>::overlap)
         .def("parallel_sampling",
-             &StochasticPDMRG<S, FL>::template parallel_sampling<double>);
+             &StochasticPDMRG<S, FL>::template parallel_sampling<double>)
+        .def("batched_sampling",
+             &StochasticPDMRG<S, FL>::template batched_sampling<double>,
+             py::arg("n_sample"), py::arg("ityp"), py::arg("fcidump"),
+             py::arg("seed") = 0, py::arg("sample_start") = 0,
+             py::arg("batch") = 256, py::arg("iprint") = 0);
 }
@@ -432,8 +432,8 @@ template <typename S> struct DMRGSCIAQCC : DMRGSCI<S> {
 
     tuple<double, int, size_t, double> two_dot_eigs_and_perturb(
         const bool forward, const int i, const double davidson_conv_thrd,
-        const double noise,
-        shared_ptr<SparseMatrixGroup<S, double>> &pket) override {
+        const double noise, shared_ptr<SparseMatrixGroup<S, double>> &pket,
+        shared_ptr<SparseMatrix<S, double>> &pdm) override {
         tuple<double, int, size_t, double> pdi;
         _t.get_time();
         shared_ptr<EffectiveHamiltonian<S, double>> d_eff1, d_eff2, d_eff3,
@@ -47,6 +47,283 @@ using namespace std;
 
 namespace block2 {
 
+// Batched determinant sampler for one unfused MPS
+// Walkers are advanced together site by site. At each site, walkers with
+// the same last digit share the shape of partial contractions, which are
+// stored as rows of one dense matrix, so that each MPS block is applied to
+// all walkers of the group by one GEMM.
+template <typename S, typename FL> struct StochasticPDMRGSampler {
+    typedef typename GMatrix<FL>::FP FP;
+    typedef vector<pair<pair<S, S>, shared_ptr<GTensor<FL>>>> blocks_t;
+    int n_sites;
+    // pinfos[i_site + 1][d] : shape of partial contraction ending with d
+    vector<vector<shared_ptr<SparseMatrixInfo<S>>>> pinfos;
+    // blocks[i_site][d] : MPS blocks connected to digit d at i_site
+    vector<vector<blocks_t>> blocks;
+    StochasticPDMRGSampler(
+        const vector<vector<shared_ptr<SparseMatrixInfo<S>>>> &pinfos,
+        const vector<vector<blocks_t>> &blocks)
+        : n_sites((int)blocks.size()), pinfos(pinfos), blocks(blocks) {}
+    // pc[nr, :] += pa[nr, :] x blocks[i_site][d]
+    void contract(int i_site, int g, const FL *pa, MKL_INT nr, int d,
+                  FL *pc) const {
+        const shared_ptr<SparseMatrixInfo<S>> &pinfo = pinfos[i_site][g];
+        const shared_ptr<SparseMatrixInfo<S>> &cinfo = pinfos[i_site + 1][d];
+        const MKL_INT tma = (MKL_INT)pinfo->get_total_memory();
+        const MKL_INT tmc = (MKL_INT)cinfo->get_total_memory();
+        const FL one = 1.0;
+        if (nr == 0 || tma == 0 || tmc == 0)
+            return;
+        for (auto &m : blocks[i_site][d]) {
+            int ib = pinfo->find_state(m.first.first);
+            int ik = cinfo->find_state(m.first.second);
+            if (ib == -1 || ik == -1)
+                continue;
+            MKL_INT kb = (MKL_INT)m.second->shape[0];
+            MKL_INT nk = (MKL_INT)m.second->shape[2];
+            xgemm<FL>("n", "n", &nk, &nr, &kb, &one, m.second->data->data(),
+                      &nk, pa + pinfo->n_states_total[ib], &tma, &one,
+                      pc + cinfo->n_states_total[ik], &tmc);
+        }
+    }
+    // draw nw determinants with probability |<D|MPS>|^2
+    // rands : nw x n_sites uniform random numbers
+    // dets : nw x n_sites digits; amps : <D|MPS>
+    void sample(int nw, const FP *rands, uint8_t *dets, FL *amps) const {
+        const int nd = (int)pinfos[1].size();
+        vector<vector<int>> gw(1), ngw(nd);
+        vector<vector<FL>> gmat(1), ngmat(nd), cmat(nd);
+        gw[0].resize(nw);
+        for (int iw = 0; iw < nw; iw++)
+            gw[0][iw] = iw;
+        gmat[0].assign((size_t)nw * pinfos[0][0]->get_total_memory(),
+                       (FL)1.0);
+        vector<FP> cp(nd);
+        for (int i_site = 0; i_site < n_sites; i_site++) {
+            for (int d = 0; d < nd; d++)
+                ngw[d].clear(), ngmat[d].clear();
+            for (int g = 0; g < (int)gw.size(); g++) {
+                const MKL_INT nr = (MKL_INT)gw[g].size();
+                if (nr == 0)
+                    continue;
+                for (int d = 0; d < nd; d++) {
+                    const size_t tm = pinfos[i_site + 1][d]->get_total_memory();
+                    cmat[d].assign(nr * tm, (FL)0.0);
+                    contract(i_site, g, gmat[g].data(), nr, d, cmat[d].data());
+                }
+                for (MKL_INT ir = 0; ir < nr; ir++) {
+                    const int iw = gw[g][ir];
+                    FP acc = 0;
+                    for (int d = 0; d < nd; d++) {
+                        const size_t tm =
+                            pinfos[i_site + 1][d]->get_total_memory();
+                        FP tmp = tm == 0 ? (FP)0.0
+                                         : (FP)GMatrixFunctions<FL>::norm(
+                                               GMatrix<FL>(cmat[d].data() +
+                                                               ir * tm,
+                                                           1, (MKL_INT)tm));
+                        acc += (cp[d] = tmp * tmp);
+                    }
+                    // last non-zero digit is used in case of rounding errors
+                    FP x = rands[(size_t)iw * n_sites + i_site] * acc;
+                    int dx = -1;
+                    for (int d = 0; d < nd; d++)
+                        if (cp[d] != 0) {
+                            dx = d;
+                            if (x < cp[d])
+                                break;
+                            x -= cp[d];
+                        }
+                    assert(dx != -1);
+                    const size_t tm =
+                        pinfos[i_site + 1][dx]->get_total_memory();
+                    dets[(size_t)iw * n_sites + i_site] = (uint8_t)dx;
+                    ngw[dx].push_back(iw);
+                    ngmat[dx].insert(ngmat[dx].end(),
+                                     cmat[dx].data() + ir * tm,
+                                     cmat[dx].data() + (ir + 1) * tm);
+                }
+            }
+            gw.swap(ngw), gmat.swap(ngmat);
+            gw.resize(nd), gmat.resize(nd), ngw.resize(nd), ngmat.resize(nd);
+        }
+        for (int g = 0; g < (int)gw.size(); g++)
+            for (size_t ir = 0; ir < gw[g].size(); ir++)
+                amps[gw[g][ir]] = gmat[g][ir];
+    }
+    // amps : <D|MPS> for nw determinants given in dets (nw x n_sites)
+    void overlap(int nw, const uint8_t *dets, FL *amps) const {
+        const int nd = (int)pinfos[1].size();
+        vector<vector<int>> gw(1), ngw(nd);
+        vector<vector<FL>> gmat(1), ngmat(nd);
+        vector<FL> amat;
+        gw[0].resize(nw);
+        for (int iw = 0; iw < nw; iw++)
+            gw[0][iw] = iw;
+        gmat[0].assign((size_t)nw * pinfos[0][0]->get_total_memory(),
+                       (FL)1.0);
+        vector<vector<MKL_INT>> sub(nd);
+        for (int i_site = 0; i_site < n_sites; i_site++) {
+            for (int d = 0; d < nd; d++)
+                ngw[d].clear(), ngmat[d].clear();
+            for (int g = 0; g < (int)gw.size(); g++) {
+                const size_t tma = pinfos[i_site][g]->get_total_memory();
+                for (int d = 0; d < nd; d++)
+                    sub[d].clear();
+                for (size_t ir = 0; ir < gw[g].size(); ir++)
+                    sub[dets[(size_t)gw[g][ir] * n_sites + i_site]].push_back(
+                        (MKL_INT)ir);
+                for (int d = 0; d < nd; d++) {
+                    const MKL_INT nr = (MKL_INT)sub[d].size();
+                    if (nr == 0)
+                        continue;
+                    const size_t tmc =
+                        pinfos[i_site + 1][d]->get_total_memory();
+                    amat.resize(nr * tma);
+                    for (MKL_INT k = 0; k < nr; k++) {
+                        memcpy(amat.data() + k * tma,
+                               gmat[g].data() + sub[d][k] * tma,
+                               sizeof(FL) * tma);
+                        ngw[d].push_back(gw[g][sub[d][k]]);
+                    }
+                    size_t ng = ngmat[d].size();
+                    ngmat[d].resize(ng + nr * tmc, (FL)0.0);
+                    contract(i_site, g, amat.data(), nr, d,
+                             ngmat[d].data() + ng);
+                }
+            }
+            gw.swap(ngw), gmat.swap(ngmat);
+            gw.resize(nd), gmat.resize(nd), ngw.resize(nd), ngmat.resize(nd);
+        }
+        for (int g = 0; g < (int)gw.size(); g++) {
+            const size_t tm = pinfos[n_sites][g]->get_total_memory();
+            for (size_t ir = 0; ir < gw[g].size(); ir++)
+                amps[gw[g][ir]] = tm == 0 ? (FL)0.0 : gmat[g][ir * tm];
+        }
+    }
+    // diagonal energy of determinant
+    template <typename FLI>
+    static FP det_energy(const uint8_t *det, int n_sites,
+                         const shared_ptr<FCIDUMP<FLI>> &fcidump) {
+        FP det_ener = 0;
+        for (uint16_t i = 0; i < n_sites; i++)
+            for (uint8_t si = 0; si < 2; si++)
+                if (det[i] & (si + 1)) {
+                    det_ener += (FP)xreal<FLI>(fcidump->t(si, i, i));
+                    for (uint16_t j = 0; j < n_sites; j++)
+                        for (uint8_t sj = 0; sj < 2; sj++)
+                            if (det[j] & (sj + 1)) {
+                                det_ener += 0.5 * (FP)xreal<FLI>(fcidump->v(
+                                                      si, sj, i, i, j, j));
+                                if (si == sj)
+                                    det_ener -= 0.5 * (FP)xreal<FLI>(
+                                                          fcidump->v(si, sj, i,
+                                                                     j, j, i));
+                            }
+                }
+        return det_ener + (FP)xreal<FLI>(fcidump->const_e);
+    }
+    // batched sampling with counter-based random streams
+    // the random numbers of sample i only depend on (seed, sample_start + i)
+    // and partial statistics are merged in a fixed order,
+    // so results are independent of the number of threads and batch size
+    // ityp == 0: sampling psi0 (this), return H00, H00sq, err(H00)
+    // ityp == 1: sampling qvpsi0 (this) and overlap psi0 (ovlp),
+    //      return H11, H11sq, H10, H10sq, err(H11), err(H10)
+    template <typename FLI>
+    vector<FP>
+    batched_sampling(const shared_ptr<StochasticPDMRGSampler> &ovlp,
+                     FP norm_qvpsi0, size_t n_sample, int ityp,
+                     const shared_ptr<FCIDUMP<FLI>> &fcidump, uint64_t seed,
+                     size_t sample_start, int batch, int iprint) const {
+        assert(batch > 0 && (ityp == 0 || ovlp != nullptr));
+        const int nq = ityp == 0 ? 1 : 2;
+        // online statistics (count, mean, sum of squared deviations)
+        struct Stat {
+            size_t n = 0;
+            FP mean = 0, m2 = 0;
+            void add(FP x) {
+                n++;
+                FP dx = x - mean;
+                mean += dx / (FP)n;
+                m2 += dx * (x - mean);
+            }
+            void merge(const Stat &o) {
+                if (o.n == 0)
+                    return;
+                size_t nn = n + o.n;
+                FP dx = o.mean - mean;
+                mean += dx * (FP)o.n / (FP)nn;
+                m2 += o.m2 + dx * dx * (FP)n * (FP)o.n / (FP)nn;
+                n = nn;
+            }
+            FP mean_sq() const { return n == 0 ? 0 : m2 / (FP)n + mean * mean; }
+            FP error() const {
+                return n <= 1 ? 0 : sqrt(m2 / (FP)(n - 1) / (FP)n);
+            }
+        };
+        const size_t nb = (n_sample + batch - 1) / batch;
+        int ntg = threading->activate_global();
+        const size_t nround = (size_t)ntg * 4;
+        vector<array<Stat, 2>> bstats(nround);
+        array<Stat, 2> stats;
+        Timer t;
+        t.get_time();
+        for (size_t ib0 = 0; ib0 < nb; ib0 += nround) {
+            const size_t ib1 = min(nb, ib0 + nround);
+#pragma omp parallel for schedule(dynamic) num_threads(ntg)
+            for (size_t ib = ib0; ib < ib1; ib++) {
+                const size_t is0 = ib * batch;
+                const int nw = (int)(min(n_sample, is0 + batch) - is0);
+                vector<FP> rands((size_t)nw * n_sites);
+                vector<uint8_t> dets((size_t)nw * n_sites);
+                vector<FL> ramps(nw), samps(nw);
+                for (int iw = 0; iw < nw; iw++) {
+                    RandomCB rng(seed, sample_start + is0 + iw);
+                    rng.fill<FP>(rands.data() + (size_t)iw * n_sites, n_sites);
+                }
+                sample(nw, rands.data(), dets.data(), ramps.data());
+                if (ityp == 1)
+                    ovlp->overlap(nw, dets.data(), samps.data());
+                array<Stat, 2> &st = bstats[ib - ib0];
+                st = array<Stat, 2>();
+                for (int iw = 0; iw < nw; iw++) {
+                    FP ener =
+                        det_energy(dets.data() + (size_t)iw * n_sites, n_sites,
+                                   fcidump);
+                    if (ityp == 0)
+                        st[0].add(1 / ener);
+                    else {
+                        st[0].add(norm_qvpsi0 / ener);
+                        st[1].add(xreal<FL>(norm_qvpsi0 * samps[iw] /
+                                            (ramps[iw] * ener)));
+                    }
+                }
+            }
+            for (size_t ib = ib0; ib < ib1; ib++)
+                for (int iq = 0; iq < nq; iq++)
+                    stats[iq].merge(bstats[ib - ib0][iq]);
+            if (iprint >= 2) {
+                cout << " Nsample = " << setw(10) << stats[0].n;
+                for (int iq = 0; iq < nq; iq++)
+                    cout << " H" << (ityp == 0 ? "00" : (iq == 0 ? "11" : "10"))
+                         << " = " << fixed << setprecision(10) << setw(18)
+                         << stats[iq].mean << " Error = " << scientific
+                         << setprecision(2) << stats[iq].error();
+                cout << fixed << setprecision(3) << " T = " << t.get_time()
+                     << endl;
+            }
+        }
+        threading->activate_normal();
+        vector<FP> r;
+        for (int iq = 0; iq < nq; iq++)
+            r.push_back(stats[iq].mean), r.push_back(stats[iq].mean_sq());
+        for (int iq = 0; iq < nq; iq++)
+            r.push_back(stats[iq].error());
+        return r;
+    }
+};
+
 template <typename, typename, typename = void> struct StochasticPDMRG;
 
 // stochastic perturbative DMRG
@@ -58,6 +335,7 @@ struct StochasticPDMRG<S, FL, typename S::is_sz_t> {
     vector<shared_ptr<SparseTensor<S, FL>>> tensors_psi0, tensors_qvpsi0;
     FP norm_qvpsi0;
     vector<vector<shared_ptr<SparseMatrixInfo<S>>>> pinfos_psi0, pinfos_qvpsi0;
+    shared_ptr<StochasticPDMRGSampler<S, FL>> sampler_psi0, sampler_qvpsi0;
     int n_sites;
     uint8_t phys_dim;
     StochasticPDMRG() {}
@@ -84,6 +362,8 @@ struct StochasticPDMRG<S, FL, typename S::is_sz_t> {
         pinfos_qvpsi0.resize(n_sites);
         gen_si_map(pinfos_psi0, mps_psi0);
         gen_si_map(pinfos_qvpsi0, mps_qvpsi0);
+        sampler_psi0 = gen_sampler(pinfos_psi0, mps_psi0);
+        sampler_qvpsi0 = gen_sampler(pinfos_qvpsi0, mps_qvpsi0);
 
         norm_qvpsi0 = norm;
     }
@@ -124,6 +404,19 @@ struct StochasticPDMRG<S, FL, typename S::is_sz_t> {
             }
         }
     }
+    // generate batched sampler
+    shared_ptr<StochasticPDMRGSampler<S, FL>>
+    gen_sampler(const vector<vector<shared_ptr<SparseMatrixInfo<S>>>> &pinfos,
+                const shared_ptr<UnfusedMPS<S, FL>> &mps) const {
+        vector<vector<typename StochasticPDMRGSampler<S, FL>::blocks_t>>
+            blocks(n_sites);
+        for (int d = 0; d < n_sites; d++) {
+            blocks[d].resize(pinfos[d + 1].size());
+            for (int j = 0; j < (int)blocks[d].size(); j++)
+                blocks[d][j] = mps->tensors[d]->data[j];
+        }
+        return make_shared<StochasticPDMRGSampler<S, FL>>(pinfos, blocks);
+    }
     // ityp == 0: sampling a determinant for C term
     // ityp == 1: sampling a determinant for A,B term
     FL sampling(int ityp, vector<uint8_t> &det_string) const {
@@ -367,6 +660,27 @@ struct StochasticPDMRG<S, FL, typename S::is_sz_t> {
         threading->activate_normal();
         return r;
     }
+    // batched sampling with reproducible random streams
+    // ityp == 0: sampling a determinant for C term
+    //      return H00, H00sq, err(H00)
+    // ityp == 1: sampling a determinant for A,B term
+    //      return H11, H11sq, H10, H10sq, err(H11), err(H10)
+    // samples are numbered from sample_start, so that independent calls
+    // (e.g. on different MPI procs) can use disjoint random streams
+    template <typename FLI>
+    vector<FP> batched_sampling(size_t n_sample, int ityp,
+                                const shared_ptr<FCIDUMP<FLI>> &fcidump,
+                                uint64_t seed = 0, size_t sample_start = 0,
+                                int batch = 256, int iprint = 0) const {
+        if (ityp == 0)
+            return sampler_psi0->batched_sampling(nullptr, norm_qvpsi0,
+                                                  n_sample, ityp, fcidump, seed,
+                                                  sample_start, batch, iprint);
+        else
+            return sampler_qvpsi0->batched_sampling(
+                sampler_psi0, norm_qvpsi0, n_sample, ityp, fcidump, seed,
+                sample_start, batch, iprint);
+    }
     template <typename FLI>
     FP energy_zeroth(const shared_ptr<FCIDUMP<FLI>> &fcidump,
                      GMatrix<FLI> e_pqqp, GMatrix<FLI> e_pqpq,
@@ -395,6 +709,7 @@ struct StochasticPDMRG<S, FL, typename S::is_su2_t> {
     vector<shared_ptr<SparseTensor<S, FL>>> tensors_psi0, tensors_qvpsi0;
     FP norm_qvpsi0;
     vector<vector<shared_ptr<SparseMatrixInfo<S>>>> pinfos_psi0, pinfos_qvpsi0;
+    shared_ptr<StochasticPDMRGSampler<S, FL>> sampler_psi0, sampler_qvpsi0;
     int n_sites;
     uint8_t phys_dim;
     StochasticPDMRG() {}
@@ -420,6 +735,8 @@ struct StochasticPDMRG<S, FL, typename S::is_su2_t> {
         pinfos_qvpsi0.resize(n_sites);
         gen_si_map(pinfos_psi0, mps_psi0);
         gen_si_map(pinfos_qvpsi0, mps_qvpsi0);
+        sampler_psi0 = gen_sampler(pinfos_psi0, mps_psi0);
+        sampler_qvpsi0 = gen_sampler(pinfos_qvpsi0, mps_qvpsi0);
 
         norm_qvpsi0 = norm;
     }
@@ -463,6 +780,26 @@ struct StochasticPDMRG<S, FL, typename S::is_su2_t> {
             }
         }
     }
+    shared_ptr<StochasticPDMRGSampler<S, FL>>
+    gen_sampler(const vector<vector<shared_ptr<SparseMatrixInfo<S>>>> &pinfos,
+                const shared_ptr<UnfusedMPS<S, FL>> &mps) const {
+        vector<vector<typename StochasticPDMRGSampler<S, FL>::blocks_t>>
+            blocks(n_sites);
+        for (int d = 0; d < n_sites; d++) {
+            blocks[d].resize(pinfos[d + 1].size());
+            for (int j = 0; j < (int)blocks[d].size(); j++) {
+                int jd = j >= 2 ? j - 1 : j;
+                for (auto &m : mps->tensors[d]->data[jd]) {
+                    S bra = m.first.first, ket = m.first.second;
+                    if (jd == 1 && !((j == 1 && ket.twos() > bra.twos()) ||
+                                     (j == 2 && ket.twos() < bra.twos())))
+                        continue;
+                    blocks[d][j].push_back(m);
+                }
+            }
+        }
+        return make_shared<StochasticPDMRGSampler<S, FL>>(pinfos, blocks);
+    }
     // ityp == 0: sampling a determinant for C term
     // ityp == 1: sampling a determinant for A,B term
     FL sampling(int ityp, vector<uint8_t> &det_string) const {
@@ -724,6 +1061,27 @@ struct StochasticPDMRG<S, FL, typename S::is_su2_t> {
         threading->activate_normal();
         return r;
     }
+    // batched sampling with reproducible random streams
+    // ityp == 0: sampling a determinant for C term
+    //      return H00, H00sq, err(H00)
+    // ityp == 1: sampling a determinant for A,B term
+    //      return H11, H11sq, H10, H10sq, err(H11), err(H10)
+    // samples are numbered from sample_start, so that independent calls
+    // (e.g. on different MPI procs) can use disjoint random streams
+    template <typename FLI>
+    vector<FP> batched_sampling(size_t n_sample, int ityp,
+                                const shared_ptr<FCIDUMP<FLI>> &fcidump,
+                                uint64_t seed = 0, size_t sample_start = 0,
+                                int batch = 256, int iprint = 0) const {
+        if (ityp == 0)
+            return sampler_psi0->batched_sampling(nullptr, norm_qvpsi0,
+                                                  n_sample, ityp, fcidump, seed,
+                                                  sample_start, batch, iprint);
+        else
+            return sampler_qvpsi0->batched_sampling(
+                sampler_psi0, norm_qvpsi0, n_sample, ityp, fcidump, seed,
+                sample_start, batch, iprint);
+    }
     template <typename FLI>
     FP energy_zeroth(const shared_ptr<FCIDUMP<FLI>> &fcidump,
                      GMatrix<FLI> e_pqqp, GMatrix<FLI> e_pqpq,
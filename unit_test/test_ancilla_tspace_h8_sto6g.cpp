@@ -126,6 +126,22 @@ void TestTSpaceAncillaH8STO6G<FL>::test_imag_te(
 
     EXPECT_LT(abs(norm - 1.0), 1E-7);
 
+    // initial states for multi-trajectory TE
+    // the second trajectory starts from a perturbed state
+    vector<shared_ptr<MPS<S, FL>>> mt_mpss = {imps->deep_copy("BRA-MT0"),
+                                              imps->deep_copy("BRA-MT1")};
+    const int mt_center = mt_mpss[1]->center;
+    mt_mpss[1]->load_tensor(mt_center);
+    shared_ptr<SparseMatrix<S, FL>> pmat = mt_mpss[1]->tensors[mt_center];
+    for (size_t j = 0; j < pmat->total_memory; j++)
+        pmat->data[j] += (FL)Random::rand_double(-0.1, 0.1);
+    pmat->iscale(1.0 / pmat->norm());
+    mt_mpss[1]->save_tensor(mt_center);
+    mt_mpss[1]->unload_tensor(mt_center);
+    // the same states for propagating each trajectory separately
+    vector<shared_ptr<MPS<S, FL>>> rf_mpss = {mt_mpss[0]->deep_copy("BRA-RF0"),
+                                              mt_mpss[1]->deep_copy("BRA-RF1")};
+
     // TE ME
     shared_ptr<MovingEnvironment<S, FL, FL>> me =
         make_shared<MovingEnvironment<S, FL, FL>>(mpo, imps, imps, "TE");
@@ -160,6 +176,74 @@ void TestTSpaceAncillaH8STO6G<FL>::test_imag_te(
     te_energies.insert(te_energies.end(), te->energies.begin(),
                        te->energies.end());
 
+    // Multi-trajectory imaginary TE with MPO loaded on demand
+    string mpo_filename = frame_<FP>()->save_dir + "/MPO-MT.bin";
+    mpo->save_data(mpo_filename);
+    shared_ptr<MPO<S, FL>> xmpo = make_shared<MPO<S, FL>>(0);
+    xmpo->load_data(mpo_filename, true);
+    vector<shared_ptr<MovingEnvironment<S, FL, FL>>> mt_mes, rf_mes;
+    for (size_t k = 0; k < mt_mpss.size(); k++) {
+        mt_mes.push_back(make_shared<MovingEnvironment<S, FL, FL>>(
+            xmpo, mt_mpss[k], mt_mpss[k], "TE-MT" + Parsing::to_string(k)));
+        mt_mes.back()->init_environments(false);
+        rf_mes.push_back(make_shared<MovingEnvironment<S, FL, FL>>(
+            xmpo, rf_mpss[k], rf_mpss[k], "TE-RF" + Parsing::to_string(k)));
+        rf_mes.back()->init_environments(false);
+    }
+
+    // reference: each trajectory propagated on its own
+    vector<vector<typename TimeEvolution<S, FL, FL>::FLLS>> rf_energies(
+        mt_mpss.size());
+    xmpo->nread = 0;
+    for (size_t k = 0; k < rf_mpss.size(); k++) {
+        shared_ptr<TimeEvolution<S, FL, FL>> rte =
+            make_shared<TimeEvolution<S, FL, FL>>(rf_mes[k], bdims,
+                                                  TETypes::RK4);
+        rte->iprint = 0;
+        rte->n_sub_sweeps = 6;
+        rte->solve(1, beta / 2.0, rf_mpss[k]->center == 0);
+        rf_energies[k] = rte->energies;
+        rte->n_sub_sweeps = 1;
+        rte->mode = TETypes::TangentSpace;
+        rte->solve(2, beta / 2.0, rf_mpss[k]->center == 0);
+        rf_energies[k].insert(rf_energies[k].end(), rte->energies.begin(),
+                              rte->energies.end());
+    }
+    const size_t rf_nread = xmpo->nread;
+
+    // the same propagation with all trajectories in lockstep
+    shared_ptr<MultiTrajectoryTimeEvolution<S, FL, FL>> mte =
+        make_shared<MultiTrajectoryTimeEvolution<S, FL, FL>>(
+            mt_mes, bdims, TETypes::RK4, 6);
+    mte->iprint = 1;
+    xmpo->nread = 0;
+    mte->solve(1, beta / 2.0, mt_mpss[0]->center == 0);
+    auto mt_energies = mte->energies;
+    mte->n_sub_sweeps = 1;
+    mte->mode = TETypes::TangentSpace;
+    mte->solve(2, beta / 2.0, mt_mpss[0]->center == 0);
+    mt_energies.insert(mt_energies.end(), mte->energies.begin(),
+                       mte->energies.end());
+    const size_t mt_nread = xmpo->nread;
+
+    cout << "MPO site reads: separate = " << rf_nread
+         << " lockstep = " << mt_nread << endl;
+    EXPECT_EQ(xmpo->pinned_sites, vector<bool>(n_sites, false));
+    ASSERT_EQ(mt_energies.size(), (size_t)3);
+    for (size_t i = 0; i < mt_energies.size(); i++) {
+        EXPECT_LT(abs(mt_energies[i][0] - te_energies[i + 1]), 1E-7);
+        EXPECT_GT(abs(mt_energies[i][1] - mt_energies[i][0]), 1E-3);
+        for (size_t k = 0; k < mt_mpss.size(); k++)
+            EXPECT_LT(abs(mt_energies[i][k] - rf_energies[k][i]), 1E-10);
+    }
+    // sites read once per sweep step instead of once per trajectory
+    EXPECT_LT(mt_nread * 3, rf_nread * 2);
+
+    for (int k = (int)rf_mpss.size() - 1; k >= 0; k--)
+        rf_mpss[k]->info->deallocate();
+    for (int k = (int)mt_mpss.size() - 1; k >= 0; k--)
+        mt_mpss[k]->info->deallocate();
+
     for (size_t i = 0; i < te_energies.size(); i++) {
         cout << "== " << name << " =="
              << " BETA = " << setw(10) << fixed << setprecision(4)
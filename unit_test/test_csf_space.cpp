@@ -307,3 +307,65 @@ TEST_F(TestCSFSpace, TestCSFSpace) {
     matg->initialize(info);
     csf_bs->build_site_op(c_ops, {2}, matg, 1);
 }
+
+TEST_F(TestCSFSpace, TestCSFSpaceCache) {
+    const string filename = frame_<FP>()->save_dir + "/csf-space.tmp";
+    for (bool is_right : {false, true}) {
+        for (int n_max_elec : {2, 5}) {
+            shared_ptr<CSFSpace<SU2, double>> ref =
+                make_shared<CSFSpace<SU2, double>>(6, n_max_elec, is_right);
+            // same basis as from tensor product of site bases
+            shared_ptr<StateInfo<SU2>> tp_basis =
+                ref->tensor_product_basis(vector<uint8_t>());
+            EXPECT_EQ(tp_basis->n, ref->basis->n);
+            for (int i = 0; i < ref->basis->n; i++) {
+                EXPECT_EQ(tp_basis->quanta[i], ref->basis->quanta[i]);
+                EXPECT_EQ(tp_basis->n_states[i], ref->basis->n_states[i]);
+            }
+            Parsing::remove_file(filename);
+            make_shared<CSFSpace<SU2, double>>(6, n_max_elec, is_right,
+                                               vector<uint8_t>(), filename);
+            shared_ptr<CSFSpace<SU2, double>> csf_space =
+                make_shared<CSFSpace<SU2, double>>(
+                    6, n_max_elec, is_right, vector<uint8_t>(), filename);
+            EXPECT_EQ(csf_space->n_csfs(), ref->n_csfs());
+            EXPECT_EQ(csf_space->n_configs(), ref->n_configs());
+            EXPECT_EQ(csf_space->csfs, ref->csfs);
+            EXPECT_EQ(csf_space->csf_offsets, ref->csf_offsets);
+            EXPECT_EQ(csf_space->n_unpaired_idxs, ref->n_unpaired_idxs);
+            for (int i = 0; i < ref->n_configs(); i++)
+                EXPECT_EQ(csf_space->get_config(i), ref->get_config(i));
+            // invalid caches are rebuilt
+            string data;
+            {
+                ifstream ifs(filename.c_str(), ios::binary);
+                data.assign(istreambuf_iterator<char>(ifs),
+                            istreambuf_iterator<char>());
+            }
+            vector<string> bad_data(3, data);
+            bad_data[0][0] = 'X';                 // magic
+            bad_data[1].resize(data.size() / 2); // truncated
+            // size of orb_sym after magic, version, n_orbs, n_max_elec
+            // and is_right
+            const size_t huge = (size_t)1 << 60;
+            bad_data[2].replace(17, sizeof(huge), (const char *)&huge,
+                                sizeof(huge));
+            for (const string &bad : bad_data) {
+                {
+                    ofstream ofs(filename.c_str(), ios::binary);
+                    ofs.write(bad.data(), bad.size());
+                }
+                csf_space = make_shared<CSFSpace<SU2, double>>(
+                    6, n_max_elec, is_right, vector<uint8_t>(), filename);
+                EXPECT_EQ(csf_space->n_csfs(), ref->n_csfs());
+                EXPECT_EQ(csf_space->csfs, ref->csfs);
+                EXPECT_EQ(csf_space->csf_offsets, ref->csf_offsets);
+            }
+            // mismatched orbital space is rebuilt
+            csf_space = make_shared<CSFSpace<SU2, double>>(
+                6, n_max_elec + 1, is_right, vector<uint8_t>(), filename);
+            EXPECT_NE(csf_space->n_csfs(), ref->n_csfs());
+        }
+    }
+    Parsing::remove_file(filename);
+}
@@ -354,3 +354,90 @@ TEST_F(TestCSRMatrix, TestTensorProduct) {
     }
     cout << "TP dense T = " << dst << " csr T = " << spt / 3 << endl;
 }
+
+TEST_F(TestCSRMatrix, TestComplexMultiplyDenseSparse) {
+    typedef complex<double> FL;
+    // op(x) for conj = 0 (n), 1 (t), 2 (x), 3 (c)
+    auto get_op = [](const ComplexMatrixRef &x, uint8_t cj) {
+        ComplexMatrixRef r(nullptr, (cj & 1) ? x.n : x.m,
+                           (cj & 1) ? x.m : x.n);
+        r.allocate();
+        for (int i = 0; i < x.m; i++)
+            for (int j = 0; j < x.n; j++) {
+                FL v = (cj & 2) ? conj(x(i, j)) : x(i, j);
+                if (cj & 1)
+                    r(j, i) = v;
+                else
+                    r(i, j) = v;
+            }
+        return r;
+    };
+    auto fill_sparse_complex = [this](FL *data, size_t n) {
+        fill_sparse_double((double *)data, n * 2);
+        if (Random::rand_double() > 0.5)
+            for (size_t i = 0; i < n; i++)
+                if (Random::rand_double() < sparsity)
+                    data[i] = 0;
+    };
+    // fixed default, no measurement unless requested
+    // MKL builds keep using MKL sparse routines for all sparse operands
+    const double default_crossover =
+        GCSRMatrixFunctions<FL>::dense_crossover_density();
+#ifdef _HAS_INTEL_MKL
+    EXPECT_EQ(default_crossover, 1.0);
+#else
+    EXPECT_EQ(default_crossover, 0.15);
+#endif
+    EXPECT_EQ(GCSRMatrixFunctions<FL>::get_dense_crossover_density(),
+              default_crossover);
+    // 1.0 = always sparse kernels; 0.0 = always dense GEMM
+    for (double crossover : {1.0, 0.0, -1.0}) {
+        GCSRMatrixFunctions<FL>::dense_crossover_density() = crossover;
+        for (int i = 0; i < n_tests; i++) {
+            int m = Random::rand_int(1, 150), k = Random::rand_int(1, 150);
+            int n = Random::rand_int(1, 150);
+            uint8_t conja = Random::rand_int(0, 4);
+            uint8_t conjb = Random::rand_int(0, 4);
+            ComplexMatrixRef a(nullptr, (conja & 1) ? k : m,
+                               (conja & 1) ? m : k);
+            ComplexMatrixRef b(nullptr, (conjb & 1) ? n : k,
+                               (conjb & 1) ? k : n);
+            ComplexMatrixRef c(nullptr, m, n), stdc(nullptr, m, n);
+            a.allocate(), b.allocate(), c.allocate(), stdc.allocate();
+            fill_sparse_complex(a.data, a.size());
+            fill_sparse_complex(b.data, b.size());
+            Random::fill<double>((double *)c.data, c.size() * 2);
+            FL alpha(Random::rand_double(), Random::rand_double());
+            FL cfactor(Random::rand_double(), Random::rand_double());
+            ComplexMatrixRef opa = get_op(a, conja), opb = get_op(b, conjb);
+            ComplexMatrixFunctions::copy(stdc, c);
+            ComplexMatrixFunctions::multiply(opa, 0, opb, 0, stdc, alpha,
+                                             cfactor);
+            opb.deallocate(), opa.deallocate();
+            ComplexMatrixRef xc(nullptr, m, n);
+            xc.allocate();
+            GCSRMatrix<FL> ca, cb;
+            ca.from_dense(a);
+            cb.from_dense(b);
+            // ds x sp
+            ComplexMatrixFunctions::copy(xc, c);
+            GCSRMatrixFunctions<FL>::multiply(a, conja, cb, conjb, xc, alpha,
+                                              cfactor);
+            ASSERT_TRUE(ComplexMatrixFunctions::all_close(xc, stdc, 1E-10, 0.0));
+            // sp x ds
+            ComplexMatrixFunctions::copy(xc, c);
+            GCSRMatrixFunctions<FL>::multiply(ca, conja, b, conjb, xc, alpha,
+                                              cfactor);
+            ASSERT_TRUE(ComplexMatrixFunctions::all_close(xc, stdc, 1E-10, 0.0));
+            cb.deallocate(), ca.deallocate();
+            xc.deallocate();
+            stdc.deallocate(), c.deallocate(), b.deallocate(), a.deallocate();
+        }
+    }
+    GCSRMatrixFunctions<FL>::dense_crossover_density() = -1.0;
+    double crossover =
+        GCSRMatrixFunctions<FL>::get_dense_crossover_density();
+    cout << "measured dense/sparse crossover density = " << crossover << endl;
+    EXPECT_TRUE(crossover > 0.0 && crossover <= 1.0);
+    GCSRMatrixFunctions<FL>::dense_crossover_density() = default_crossover;
+}
@@ -155,6 +155,19 @@ void TestDETN2STO3G<FL>::test_dmrg(
         EXPECT_LT(abs(abs(val) - abs(coeffs[i])), 1E-7);
     }
 
+    // breadth-first traverse
+    shared_ptr<DeterminantTRIE<S, FL>> dtrie_bfs =
+        make_shared<DeterminantTRIE<S, FL>>(mps->n_sites, true);
+    dtrie_bfs->evaluate(make_shared<UnfusedMPS<S, FL>>(mps), 1E-7, -1,
+                        vector<uint8_t>(), 16);
+    EXPECT_EQ(dtrie_bfs->size(), dtrie->size());
+    for (int i = 0; i < (int)dtrie_bfs->size(); i++) {
+        int ii = dtrie->find((*dtrie_bfs)[i]);
+        EXPECT_NE(ii, -1);
+        if (ii != -1)
+            EXPECT_LT(abs(dtrie_bfs->vals[i] - dtrie->vals[ii]), 1E-12);
+    }
+
     // deallocate persistent stack memory
     mps_info->deallocate();
     me->remove_partition_files();
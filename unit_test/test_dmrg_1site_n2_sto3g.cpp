@@ -20,7 +20,8 @@ template <typename FL> class TestOneSiteDMRGN2STO3G : public ::testing::Test {
     void test_dmrg(const vector<vector<S>> &targets,
                    const vector<vector<FLL>> &energies,
                    const shared_ptr<HamiltonianQC<S, FL>> &hamil,
-                   const string &name, DecompositionTypes dt, NoiseTypes nt);
+                   const string &name, DecompositionTypes dt, NoiseTypes nt,
+                   FP expansion = 0.0);
     void SetUp() override {
         cout << "BOND INTEGER SIZE = " << sizeof(ubond_t) << endl;
         Random::rand_seed(0);
@@ -44,7 +45,7 @@ template <typename S>
 void TestOneSiteDMRGN2STO3G<FL>::test_dmrg(
     const vector<vector<S>> &targets, const vector<vector<FLL>> &energies,
     const shared_ptr<HamiltonianQC<S, FL>> &hamil, const string &name,
-    DecompositionTypes dt, NoiseTypes nt) {
+    DecompositionTypes dt, NoiseTypes nt, FP expansion) {
     Timer t;
     t.get_time();
     // MPO construction
@@ -75,7 +76,8 @@ void TestOneSiteDMRGN2STO3G<FL>::test_dmrg(
 
             shared_ptr<MPSInfo<S>> mps_info = make_shared<MPSInfo<S>>(
                 hamil->n_sites, hamil->vacuum, target, hamil->basis);
-            mps_info->set_bond_dimension(bond_dim);
+            // with subspace expansion, start from a small bond dimension
+            mps_info->set_bond_dimension(expansion != 0 ? 20 : bond_dim);
 
             // MPS
             shared_ptr<MPS<S, FL>> mps =
@@ -103,6 +105,7 @@ void TestOneSiteDMRGN2STO3G<FL>::test_dmrg(
             dmrg->iprint = 0;
             dmrg->decomp_type = dt;
             dmrg->noise_type = nt;
+            dmrg->subspace_expansion = expansion;
             dmrg->davidson_soft_max_iter = 4000;
             FLL energy = dmrg->solve(10, mps->center == 0, 1E-8);
 
@@ -198,11 +201,196 @@ TYPED_TEST(TestOneSiteDMRGN2STO3G, TestSU2) {
     this->template test_dmrg<SU2>(targets, energies, hamil, "SU2 SVD RED PERT",
                                   DecompositionTypes::SVD,
                                   NoiseTypes::ReducedPerturbative);
+    this->template test_dmrg<SU2>(targets, energies, hamil, "SU2 EXPN",
+                                  DecompositionTypes::DensityMatrix,
+                                  NoiseTypes::DensityMatrix, 0.25);
 
     hamil->deallocate();
     fcidump->deallocate();
 }
 
+// with collected perturbative noise, subspace expansion still uses the
+// perturbed wavefunctions summed over all procs (checked with one proc)
+TYPED_TEST(TestOneSiteDMRGN2STO3G, TestExpansionCollectedNoise) {
+    using FL = TypeParam;
+    using FP = typename TestFixture::FP;
+    using FLL = typename GMatrix<FL>::FL;
+    using S = SU2;
+
+    shared_ptr<FCIDUMP<FL>> fcidump = make_shared<FCIDUMP<FL>>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->template orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              [pg](uint8_t x) { return (uint8_t)PointGroup::swap_pg(pg)(x); });
+
+    S vacuum(0), target(fcidump->n_elec(), fcidump->twos(), 0);
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<S, FL>> hamil =
+        make_shared<HamiltonianQC<S, FL>>(vacuum, norb, orbsym, fcidump);
+
+    shared_ptr<MPO<S, FL>> mpo =
+        make_shared<MPOQC<S, FL>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<S, FL>>(
+        mpo, make_shared<RuleQC<S, FL>>(), true, true,
+        OpNamesSet({OpNames::R, OpNames::RD}));
+    shared_ptr<ParallelRule<S, FL>> rule = make_shared<ParallelRuleQC<S, FL>>(
+        make_shared<ParallelCommunicator<S>>(1, 0, 0));
+    mpo = make_shared<ParallelMPO<S, FL>>(mpo, rule);
+
+    const vector<NoiseTypes> noise_types = {
+        NoiseTypes::ReducedPerturbativeCollected,
+        NoiseTypes::ReducedPerturbative,
+        NoiseTypes::ReducedPerturbativeCollected};
+    const vector<FP> expansions = {0.0, 0.5, 0.5};
+    vector<FLL> energies(expansions.size());
+    vector<ubond_t> max_bond_dims(expansions.size());
+    for (size_t ie = 0; ie < expansions.size(); ie++) {
+        shared_ptr<MPSInfo<S>> mps_info = make_shared<MPSInfo<S>>(
+            hamil->n_sites, hamil->vacuum, target, hamil->basis);
+        mps_info->set_bond_dimension(4);
+        mps_info->tag = "KET" + Parsing::to_string(ie);
+
+        Random::rand_seed(384666);
+        shared_ptr<MPS<S, FL>> mps =
+            make_shared<MPS<S, FL>>(hamil->n_sites, 0, 1);
+        mps->initialize(mps_info);
+        mps->random_canonicalize();
+        mps->save_mutable();
+        mps->deallocate();
+        mps_info->save_mutable();
+        mps_info->deallocate_mutable();
+
+        shared_ptr<MovingEnvironment<S, FL, FL>> me =
+            make_shared<MovingEnvironment<S, FL, FL>>(mpo, mps, mps, "DMRG");
+        me->init_environments(false);
+
+        shared_ptr<DMRG<S, FL, FL>> dmrg = make_shared<DMRG<S, FL, FL>>(
+            me, vector<ubond_t>{50}, vector<FP>{1E-6});
+        dmrg->iprint = 0;
+        dmrg->noise_type = noise_types[ie];
+        dmrg->subspace_expansion = expansions[ie];
+        energies[ie] = dmrg->solve(2, mps->center == 0, 0);
+
+        mps_info->load_mutable();
+        max_bond_dims[ie] = mps_info->get_max_bond_dimension();
+        mps_info->deallocate_mutable();
+
+        cout << "== SU2 EXPN = " << fixed << setprecision(2) << expansions[ie]
+             << " == E = " << setw(22) << setprecision(12) << energies[ie]
+             << " M = " << (uint32_t)max_bond_dims[ie] << endl;
+
+        mps_info->deallocate();
+        me->remove_partition_files();
+    }
+
+    // the expansion is not skipped with collected noise
+    EXPECT_GT(max_bond_dims[2], max_bond_dims[0]);
+    EXPECT_EQ(max_bond_dims[2], max_bond_dims[1]);
+    EXPECT_LT(abs(energies[2] - energies[1]), 1E-8);
+
+    mpo->deallocate();
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
+// one-site imaginary time evolution from a small bond dimension
+// subspace expansion lets the bond dimension grow beyond what the one-site
+// density matrix can reach, which gives a lower energy from this initial mps
+TYPED_TEST(TestOneSiteDMRGN2STO3G, TestImagTEExpansion) {
+    using FL = TypeParam;
+    using FP = typename TestFixture::FP;
+    using FLL = typename GMatrix<FL>::FL;
+    using S = SU2;
+
+    shared_ptr<FCIDUMP<FL>> fcidump = make_shared<FCIDUMP<FL>>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->template orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              [pg](uint8_t x) { return (uint8_t)PointGroup::swap_pg(pg)(x); });
+
+    S vacuum(0), target(fcidump->n_elec(), fcidump->twos(), 0);
+    int norb = fcidump->n_sites();
+    // shift the ground state energy to around zero to keep the norm finite
+    const FP e_shift = 107.654122447525;
+    fcidump->const_e += e_shift;
+    shared_ptr<HamiltonianQC<S, FL>> hamil =
+        make_shared<HamiltonianQC<S, FL>>(vacuum, norb, orbsym, fcidump);
+
+    shared_ptr<MPO<S, FL>> mpo =
+        make_shared<MPOQC<S, FL>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<S, FL>>(
+        mpo, make_shared<RuleQC<S, FL>>(), true, true,
+        OpNamesSet({OpNames::R, OpNames::RD}));
+
+    const ubond_t init_bond_dim = 4;
+    vector<FP> expansions = {0.0, 0.5};
+    vector<FLL> energies(expansions.size());
+    vector<ubond_t> max_bond_dims(expansions.size());
+    for (size_t ie = 0; ie < expansions.size(); ie++) {
+        shared_ptr<MPSInfo<S>> mps_info = make_shared<MPSInfo<S>>(
+            hamil->n_sites, hamil->vacuum, target, hamil->basis);
+        mps_info->set_bond_dimension(init_bond_dim);
+        mps_info->tag = "KET" + Parsing::to_string(ie);
+
+        Random::rand_seed(384666);
+        shared_ptr<MPS<S, FL>> mps =
+            make_shared<MPS<S, FL>>(hamil->n_sites, 0, 1);
+        mps->initialize(mps_info);
+        mps->random_canonicalize();
+        mps->save_mutable();
+        mps->deallocate();
+        mps_info->save_mutable();
+        mps_info->deallocate_mutable();
+
+        shared_ptr<MovingEnvironment<S, FL, FL>> me =
+            make_shared<MovingEnvironment<S, FL, FL>>(mpo, mps, mps, "TE");
+        me->init_environments(false);
+
+        shared_ptr<TimeEvolution<S, FL, FL>> te =
+            make_shared<TimeEvolution<S, FL, FL>>(
+                me, vector<ubond_t>{50}, TETypes::TangentSpace);
+        te->iprint = 0;
+        te->subspace_expansion = expansions[ie];
+        energies[ie] = te->solve(20, (FP)0.2, mps->center == 0);
+
+        mps_info->load_mutable();
+        max_bond_dims[ie] = mps_info->get_max_bond_dimension();
+        mps_info->deallocate_mutable();
+
+        // the expanded bond bases must give a consistent mps
+        shared_ptr<Expect<S, FL, FL, FL>> ex =
+            make_shared<Expect<S, FL, FL, FL>>(me, 100, 100);
+        FLL ex_energy = ex->solve(false, mps->center == 0);
+        EXPECT_LT(abs(ex_energy - energies[ie]), 1E-8);
+
+        cout << "== SU2 TE EXPN = " << fixed << setprecision(2)
+             << expansions[ie] << " == E = " << setw(22) << setprecision(12)
+             << energies[ie] << " M = " << (uint32_t)max_bond_dims[ie] << endl;
+
+        if (expansions[ie] != 0) {
+            // expansion is not defined for svd splitting
+            te->decomp_type = DecompositionTypes::SVD;
+            EXPECT_THROW(te->solve(1, (FP)0.2, mps->center == 0),
+                         runtime_error);
+            frame_<FP>()->activate(0);
+        }
+
+        mps_info->deallocate();
+        me->remove_partition_files();
+    }
+
+    EXPECT_GT(max_bond_dims[1], max_bond_dims[0]);
+    EXPECT_LT(xreal<FLL>(energies[1]), xreal<FLL>(energies[0]) - 0.1);
+
+    mpo->deallocate();
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
 TYPED_TEST(TestOneSiteDMRGN2STO3G, TestSZ) {
     using FL = TypeParam;
     using FLL = typename GMatrix<FL>::FL;
@@ -271,6 +459,9 @@ TYPED_TEST(TestOneSiteDMRGN2STO3G, TestSZ) {
     this->template test_dmrg<SZ>(targets, energies, hamil, "SZ SVD RED PERT",
                                  DecompositionTypes::SVD,
                                  NoiseTypes::ReducedPerturbative);
+    this->template test_dmrg<SZ>(targets, energies, hamil, "SZ EXPN",
+                                 DecompositionTypes::DensityMatrix,
+                                 NoiseTypes::DensityMatrix, 0.25);
 
     hamil->deallocate();
     fcidump->deallocate();
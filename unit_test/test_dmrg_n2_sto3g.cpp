@@ -21,7 +21,8 @@ template <typename FL> class TestDMRGN2STO3G : public ::testing::Test {
                    const vector<vector<FLL>> &energies,
                    const shared_ptr<HamiltonianQC<S, FL>> &hamil,
                    const string &name, DecompositionTypes dt, NoiseTypes nt,
-                   bool condense = false);
+                   bool condense = false, bool planned = false,
+                   bool incremental = false);
     void SetUp() override {
         cout << "BOND INTEGER SIZE = " << sizeof(ubond_t) << endl;
         Random::rand_seed(0);
@@ -48,7 +49,8 @@ template <typename S>
 void TestDMRGN2STO3G<FL>::test_dmrg(
     const vector<vector<S>> &targets, const vector<vector<FLL>> &energies,
     const shared_ptr<HamiltonianQC<S, FL>> &hamil, const string &name,
-    DecompositionTypes dt, NoiseTypes nt, bool condense) {
+    DecompositionTypes dt, NoiseTypes nt, bool condense, bool planned,
+    bool incremental) {
     Timer t;
     t.get_time();
     // MPO construction
@@ -73,6 +75,8 @@ void TestDMRGN2STO3G<FL>::test_dmrg(
     const FP conv = is_same<FP, double>::value ? 1E-7 : 1E-3;
     ubond_t bond_dim = 200;
     vector<ubond_t> bdims = {bond_dim};
+    if (incremental)
+        bdims = {(ubond_t)(bond_dim / 2), (ubond_t)(bond_dim / 2), bond_dim};
     vector<FP> noises = {noise_base, noise_base * (FP)0.1, 0.0};
 
     t.get_time();
@@ -104,6 +108,11 @@ void TestDMRGN2STO3G<FL>::test_dmrg(
             shared_ptr<MovingEnvironment<S, FL, FL>> me =
                 make_shared<MovingEnvironment<S, FL, FL>>(mpo, mps, mps,
                                                           "DMRG");
+            // old environments must be kept on disk
+            if (incremental) {
+                frame_<FP>()->minimal_disk_usage = false;
+                me->incremental_rotation = true;
+            }
             me->init_environments(false);
             if (!condense)
                 me->delayed_contraction = OpNamesSet::normal_ops();
@@ -115,9 +124,35 @@ void TestDMRGN2STO3G<FL>::test_dmrg(
             dmrg->iprint = 0;
             dmrg->decomp_type = dt;
             dmrg->noise_type = nt;
+            // one target quantum in each noise batch
+            if (nt & NoiseTypes::Batched)
+                dmrg->noise_batch_size = 1;
             dmrg->davidson_soft_max_iter = 200;
+            if (planned)
+                dmrg->mem_planner = make_shared<MemoryPlanner<S, FL, FL>>();
             FLL energy = dmrg->solve(10, mps->center == 0, conv * 0.1);
 
+            if (planned) {
+                EXPECT_EQ(dmrg->mem_planner->plans.size(),
+                          dmrg->energies.size());
+                for (auto &plan : dmrg->mem_planner->plans) {
+                    EXPECT_TRUE(plan.feasible);
+                    EXPECT_GT(plan.main_peak, 0);
+                    EXPECT_GT(plan.second_peak, 0);
+                    EXPECT_GT(plan.actual_main_peak, 0);
+                }
+                // frame settings are recovered after solve
+                EXPECT_FALSE(frame_<FP>()->use_main_stack);
+                EXPECT_TRUE(frame_<FP>()->minimal_disk_usage);
+            }
+
+            if (incremental) {
+                cout << "kept states = " << me->incr_kept_states << " / "
+                     << me->incr_total_states << endl;
+                EXPECT_GT(me->incr_kept_states, 0);
+                frame_<FP>()->minimal_disk_usage = true;
+            }
+
             // deallocate persistent stack memory
             mps_info->deallocate();
             me->remove_partition_files();
@@ -232,7 +267,634 @@ TYPED_TEST(TestDMRGN2STO3G, TestSU2) {
     this->template test_dmrg<SU2>(
         targets, energies, hamil, "SU2 SVD RED PERT LM",
         DecompositionTypes::SVD, NoiseTypes::ReducedPerturbativeLowMem);
+    this->template test_dmrg<SU2>(targets, energies, hamil, "SU2 RED PERT BT",
+                                  DecompositionTypes::DensityMatrix,
+                                  NoiseTypes::ReducedPerturbativeBatched);
+
+    // compiled contraction plans
+    hamil->opf->plan_cache = make_shared<ConnectionPlanCache<SU2>>();
+    this->template test_dmrg<SU2>(targets, energies, hamil, "SU2 PLAN",
+                                  DecompositionTypes::DensityMatrix,
+                                  NoiseTypes::DensityMatrix);
+    cout << hamil->opf->plan_cache->to_str() << endl;
+    EXPECT_GT(hamil->opf->plan_cache->n_hits, 0);
+    {
+        // saved plans are restored unchanged
+        shared_ptr<ConnectionPlanCache<SU2>> cache = hamil->opf->plan_cache;
+        const string plan_file =
+            frame_<typename TestFixture::FP>()->save_dir + "/plans.bin";
+        cache->save_data(plan_file);
+        shared_ptr<ConnectionPlanCache<SU2>> loaded =
+            make_shared<ConnectionPlanCache<SU2>>();
+        loaded->load_data(plan_file);
+        EXPECT_EQ(loaded->n_plans, cache->n_plans);
+        EXPECT_EQ(loaded->total_size, cache->total_size);
+        for (auto &r : cache->plans)
+            for (auto &p : r.second) {
+                bool found = false;
+                for (auto &q : loaded->plans.at(r.first))
+                    if (q.first == p.first) {
+                        found = true;
+                        EXPECT_EQ(q.second.nc, p.second.nc);
+                        EXPECT_EQ(q.second.data, p.second.data);
+                        for (int i = 0; i < 5; i++)
+                            EXPECT_EQ(q.second.n[i], p.second.n[i]);
+                    }
+                EXPECT_TRUE(found);
+            }
+        // invalid files are rejected without adding any plan
+        string data;
+        {
+            ifstream ifs(plan_file.c_str(), ios::binary);
+            data.assign(istreambuf_iterator<char>(ifs),
+                        istreambuf_iterator<char>());
+        }
+        vector<string> bad_data(3, data);
+        bad_data[0][0] = 'X';                 // magic
+        bad_data[1].resize(data.size() - 4); // truncated
+        // key length of the first plan after magic, version, sizeof(S)
+        // and the number of plans
+        const size_t huge = (size_t)1 << 60;
+        bad_data[2].replace(20, sizeof(huge), (const char *)&huge,
+                            sizeof(huge));
+        for (const string &bad : bad_data) {
+            {
+                ofstream ofs(plan_file.c_str(), ios::binary);
+                ofs.write(bad.data(), bad.size());
+            }
+            shared_ptr<ConnectionPlanCache<SU2>> xloaded =
+                make_shared<ConnectionPlanCache<SU2>>();
+            EXPECT_THROW(xloaded->load_data(plan_file), runtime_error);
+            EXPECT_EQ(xloaded->n_plans, 0);
+            EXPECT_EQ(xloaded->plans.size(), 0);
+        }
+        Parsing::remove_file(plan_file);
+    }
+    hamil->opf->plan_cache = nullptr;
+
+    // memory planner choosing the low-memory switches
+    this->template test_dmrg<SU2>(targets, energies, hamil, "SU2 MEM PLAN",
+                                  DecompositionTypes::DensityMatrix,
+                                  NoiseTypes::ReducedPerturbative, false, true);
+
+    // incremental environment update after bond dimension increase
+    this->template test_dmrg<SU2>(targets, energies, hamil, "SU2 INCR ROT",
+                                  DecompositionTypes::DensityMatrix,
+                                  NoiseTypes::DensityMatrix, false, false,
+                                  true);
+
+    // hashed find_state for all block-sparse infos
+    // (including op infos restored from the stack frame)
+    const int qidx_threshold = SparseMatrixInfo<SU2>::quanta_index_threshold();
+    SparseMatrixInfo<SU2>::quanta_index_threshold() = 0;
+    this->template test_dmrg<SU2>(targets, energies, hamil, "SU2 QUANTA IDX",
+                                  DecompositionTypes::DensityMatrix,
+                                  NoiseTypes::DensityMatrix);
+    SparseMatrixInfo<SU2>::quanta_index_threshold() = qidx_threshold;
+
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
+// batched reduced perturbative noise must give the same density matrix
+// as the perturbed wavefunctions stored all at once
+TYPED_TEST(TestDMRGN2STO3G, TestBatchedNoiseDM) {
+    using FL = TypeParam;
+    using FP = typename TestFixture::FP;
+    using S = SU2;
+
+    shared_ptr<FCIDUMP<FL>> fcidump = make_shared<FCIDUMP<FL>>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    fcidump->rescale();
+    vector<uint8_t> orbsym = fcidump->template orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              [pg](uint8_t x) { return (uint8_t)PointGroup::swap_pg(pg)(x); });
+
+    S vacuum(0), target(fcidump->n_elec(), fcidump->twos(), 0);
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<S, FL>> hamil =
+        make_shared<HamiltonianQC<S, FL>>(vacuum, norb, orbsym, fcidump);
+
+    shared_ptr<MPO<S, FL>> mpo =
+        make_shared<MPOQC<S, FL>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<S, FL>>(mpo, make_shared<RuleQC<S, FL>>(),
+                                            true, true,
+                                            OpNamesSet({OpNames::R, OpNames::RD}));
 
+    shared_ptr<MPSInfo<S>> mps_info =
+        make_shared<MPSInfo<S>>(mpo->n_sites, vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(100);
+    shared_ptr<MPS<S, FL>> mps = make_shared<MPS<S, FL>>(mpo->n_sites, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    shared_ptr<MovingEnvironment<S, FL, FL>> me =
+        make_shared<MovingEnvironment<S, FL, FL>>(mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+
+    const int i = 0;
+    const bool forward = true;
+    const FP noise = 1E-4;
+    me->move_to(i);
+    if (mps->tensors[i] != nullptr && mps->tensors[i + 1] != nullptr)
+        MovingEnvironment<S, FL, FL>::contract_two_dot(i, mps);
+    else {
+        mps->load_tensor(i);
+        mps->tensors[i + 1] = nullptr;
+    }
+    shared_ptr<SparseMatrix<S, FL>> ket = mps->tensors[i];
+    shared_ptr<EffectiveHamiltonian<S, FL>> h_eff =
+        me->eff_ham(FuseTypes::FuseLR, forward, true, ket, ket);
+    shared_ptr<SparseMatrixGroup<S, FL>> pket = h_eff->perturbative_noise(
+        forward, i, i + 1, FuseTypes::FuseLR, mps_info,
+        NoiseTypes::ReducedPerturbative);
+    shared_ptr<SparseMatrixInfo<S>> pdm_info = make_shared<SparseMatrixInfo<S>>(
+        make_shared<VectorAllocator<uint32_t>>());
+    pdm_info->initialize_dm(vector<shared_ptr<SparseMatrixInfo<S>>>{ket->info},
+                            vacuum, forward);
+    shared_ptr<SparseMatrix<S, FL>> pdm =
+        make_shared<SparseMatrix<S, FL>>(make_shared<VectorAllocator<FP>>());
+    pdm->allocate(pdm_info);
+    // one target quantum in each batch
+    int n_batches = h_eff->perturbative_noise_density_matrix(
+        forward, i, i + 1, FuseTypes::FuseLR, mps_info,
+        NoiseTypes::ReducedPerturbativeBatched, pdm, noise, 1);
+    h_eff->deallocate();
+    EXPECT_GT(pket->n, 1);
+    EXPECT_GT(n_batches, 1);
+
+    shared_ptr<SparseMatrix<S, FL>> dm_ref =
+        MovingEnvironment<S, FL, FL>::density_matrix(
+            vacuum, ket, forward, noise, NoiseTypes::ReducedPerturbative, 1.0,
+            pket);
+    shared_ptr<SparseMatrix<S, FL>> dm =
+        MovingEnvironment<S, FL, FL>::density_matrix(
+            vacuum, ket, forward, 0.0, NoiseTypes::ReducedPerturbative, 1.0);
+    GMatrixFunctions<FL>::iadd(
+        GMatrix<FL>(dm->data, (MKL_INT)dm->total_memory, 1),
+        GMatrix<FL>(pdm->data, (MKL_INT)pdm->total_memory, 1), 1.0);
+    ASSERT_EQ(dm->total_memory, dm_ref->total_memory);
+    FP max_diff = 0, max_noise = 0;
+    for (size_t k = 0; k < dm->total_memory; k++) {
+        max_diff = max(max_diff, (FP)abs(dm->data[k] - dm_ref->data[k]));
+        max_noise = max(max_noise, (FP)abs(pdm->data[k]));
+    }
+    cout << "batches = " << n_batches << " max noise = " << scientific
+         << max_noise << " max diff = " << max_diff << endl;
+    EXPECT_GT(max_noise, noise * 1E-3);
+    EXPECT_LT(max_diff, (is_same<FP, double>::value ? 1E-12 : 1E-6));
+
+    dm->info->deallocate();
+    dm->deallocate();
+    dm_ref->info->deallocate();
+    dm_ref->deallocate();
+    pdm->deallocate();
+    pket->deallocate();
+    pket->deallocate_infos();
+    mps->unload_tensor(i);
+    mps_info->deallocate();
+    me->remove_partition_files();
+    mpo->deallocate();
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
+TYPED_TEST(TestDMRGN2STO3G, TestMemoryPlannerTight) {
+    using FL = TypeParam;
+    using FP = typename TestFixture::FP;
+    using S = SU2;
+
+    // fused multiplication is not available with SeqTypes::Tasked
+    const SeqTypes seq_type = threading_()->seq_type;
+    threading_()->seq_type = SeqTypes::None;
+
+    shared_ptr<FCIDUMP<FL>> fcidump = make_shared<FCIDUMP<FL>>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->template orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              [pg](uint8_t x) { return (uint8_t)PointGroup::swap_pg(pg)(x); });
+
+    S vacuum(0), target(fcidump->n_elec(), fcidump->twos(), 0);
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<S, FL>> hamil =
+        make_shared<HamiltonianQC<S, FL>>(vacuum, norb, orbsym, fcidump);
+
+    shared_ptr<MPO<S, FL>> mpo =
+        make_shared<MPOQC<S, FL>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<S, FL>>(mpo, make_shared<RuleQC<S, FL>>(),
+                                            true, true,
+                                            OpNamesSet({OpNames::R, OpNames::RD}));
+
+    shared_ptr<MPSInfo<S>> mps_info =
+        make_shared<MPSInfo<S>>(mpo->n_sites, vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(200);
+    Random::rand_seed(384666);
+    shared_ptr<MPS<S, FL>> mps = make_shared<MPS<S, FL>>(mpo->n_sites, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    // settings that the planner has to change and then recover
+    frame_<FP>()->use_main_stack = true;
+    frame_<FP>()->minimal_disk_usage = false;
+
+    shared_ptr<MovingEnvironment<S, FL, FL>> me =
+        make_shared<MovingEnvironment<S, FL, FL>>(mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+    shared_ptr<DMRG<S, FL, FL>> dmrg = make_shared<DMRG<S, FL, FL>>(
+        me, vector<ubond_t>{200}, vector<FP>{1E-6, 0});
+    dmrg->iprint = 0;
+    dmrg->noise_type = NoiseTypes::DensityMatrix;
+    // nothing fits in this budget, so all switches are needed
+    dmrg->mem_planner = make_shared<MemoryPlanner<S, FL, FL>>(0, 1);
+    dmrg->mem_planner->safety = 1E-9;
+    // stale peak from earlier work must not leak into the sweeps
+    const size_t stale_peak = (size_t)1 << 60;
+    frame_<FP>()->peak_used_memory[0] = stale_peak;
+    FP energy = (FP)xreal(dmrg->solve(10, true, 1E-8));
+
+    EXPECT_EQ(dmrg->mem_planner->plans.size(), dmrg->energies.size());
+    for (auto &plan : dmrg->mem_planner->plans) {
+        EXPECT_FALSE(plan.feasible);
+        EXPECT_TRUE(plan.minimal_disk_usage);
+        EXPECT_TRUE(plan.fused_contraction_rotation);
+        EXPECT_TRUE(plan.fused_contraction_multiplication);
+        EXPECT_FALSE(plan.use_main_stack);
+        EXPECT_GT(plan.actual_main_peak, 0);
+        EXPECT_LT(plan.actual_main_peak, stale_peak);
+    }
+    // all switches are recovered after the sweeps
+    EXPECT_FALSE(me->fused_contraction_rotation);
+    EXPECT_FALSE(me->fused_contraction_multiplication);
+    EXPECT_FALSE(me->lowmem_numerical_transform);
+    EXPECT_TRUE(frame_<FP>()->use_main_stack);
+    EXPECT_FALSE(frame_<FP>()->minimal_disk_usage);
+    EXPECT_LT(abs(energy - (FP)-107.654122447525),
+              (is_same<FP, double>::value ? 1E-6 : 1E-3));
+
+    threading_()->seq_type = seq_type;
+    frame_<FP>()->use_main_stack = false;
+    frame_<FP>()->minimal_disk_usage = true;
+    mps_info->deallocate();
+    me->remove_partition_files();
+    mpo->deallocate();
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
+// DMRG with a failing sweep
+template <typename S, typename FL> struct FailingDMRG : DMRG<S, FL, FL> {
+    typedef typename DMRG<S, FL, FL>::FPS FPS;
+    typedef typename DMRG<S, FL, FL>::FPLS FPLS;
+    // number of sweeps before the failing one
+    int n_good_sweeps = 1;
+    FailingDMRG(const shared_ptr<MovingEnvironment<S, FL, FL>> &me,
+                const vector<ubond_t> &bond_dims, const vector<FPS> &noises)
+        : DMRG<S, FL, FL>(me, bond_dims, noises) {}
+    tuple<vector<FPLS>, FPS, vector<vector<pair<S, FPS>>>>
+    sweep(bool forward, ubond_t bond_dim, FPS noise,
+          FPS davidson_conv_thrd) override {
+        if (n_good_sweeps-- == 0)
+            throw runtime_error("sweep failed");
+        return DMRG<S, FL, FL>::sweep(forward, bond_dim, noise,
+                                      davidson_conv_thrd);
+    }
+};
+
+TYPED_TEST(TestDMRGN2STO3G, TestMemoryPlannerRestore) {
+    using FL = TypeParam;
+    using FP = typename TestFixture::FP;
+    using S = SU2;
+
+    // fused multiplication is not available with SeqTypes::Tasked
+    const SeqTypes seq_type = threading_()->seq_type;
+    threading_()->seq_type = SeqTypes::None;
+
+    shared_ptr<FCIDUMP<FL>> fcidump = make_shared<FCIDUMP<FL>>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->template orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              [pg](uint8_t x) { return (uint8_t)PointGroup::swap_pg(pg)(x); });
+
+    S vacuum(0), target(fcidump->n_elec(), fcidump->twos(), 0);
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<S, FL>> hamil =
+        make_shared<HamiltonianQC<S, FL>>(vacuum, norb, orbsym, fcidump);
+
+    shared_ptr<MPO<S, FL>> mpo =
+        make_shared<MPOQC<S, FL>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<S, FL>>(mpo, make_shared<RuleQC<S, FL>>(),
+                                            true, true,
+                                            OpNamesSet({OpNames::R, OpNames::RD}));
+
+    shared_ptr<MPSInfo<S>> mps_info =
+        make_shared<MPSInfo<S>>(mpo->n_sites, vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(50);
+    Random::rand_seed(384666);
+    shared_ptr<MPS<S, FL>> mps = make_shared<MPS<S, FL>>(mpo->n_sites, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    frame_<FP>()->use_main_stack = true;
+    frame_<FP>()->minimal_disk_usage = false;
+
+    shared_ptr<MovingEnvironment<S, FL, FL>> me =
+        make_shared<MovingEnvironment<S, FL, FL>>(mpo, mps, mps, "DMRG");
+    me->cached_contraction = true;
+    me->init_environments(false);
+    shared_ptr<FailingDMRG<S, FL>> dmrg = make_shared<FailingDMRG<S, FL>>(
+        me, vector<ubond_t>{50}, vector<FP>{1E-6});
+    dmrg->iprint = 0;
+    dmrg->noise_type = NoiseTypes::ReducedPerturbative;
+    // nothing fits in this budget, so all switches are needed
+    dmrg->mem_planner = make_shared<MemoryPlanner<S, FL, FL>>(0, 1);
+    dmrg->mem_planner->safety = 1E-9;
+    dmrg->mem_planner->iprint = 0;
+    EXPECT_THROW(dmrg->solve(4, true, 0.0), runtime_error);
+
+    // the planner changed the switches for the sweeps
+    ASSERT_EQ(dmrg->mem_planner->plans.size(), 2);
+    EXPECT_EQ(dmrg->energies.size(), 1);
+    for (auto &plan : dmrg->mem_planner->plans) {
+        EXPECT_TRUE(plan.batched_noise);
+        EXPECT_TRUE(plan.fused_contraction_rotation);
+        EXPECT_TRUE(plan.minimal_disk_usage);
+        // perturbative noise needs the blocked operators
+        EXPECT_FALSE(plan.fused_contraction_multiplication);
+    }
+    // and recovered all of them when the second sweep failed
+    EXPECT_EQ(dmrg->noise_type, NoiseTypes::ReducedPerturbative);
+    EXPECT_TRUE(me->cached_contraction);
+    EXPECT_FALSE(me->fused_contraction_rotation);
+    EXPECT_FALSE(me->fused_contraction_multiplication);
+    EXPECT_FALSE(me->lowmem_numerical_transform);
+    EXPECT_TRUE(frame_<FP>()->use_main_stack);
+    EXPECT_FALSE(frame_<FP>()->minimal_disk_usage);
+
+    frame_<FP>()->use_main_stack = false;
+    frame_<FP>()->minimal_disk_usage = true;
+    threading_()->seq_type = seq_type;
+    mps_info->deallocate();
+    me->remove_partition_files();
+    mpo->deallocate();
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
+TYPED_TEST(TestDMRGN2STO3G, TestFusedRotation) {
+    using FL = TypeParam;
+    using FP = typename TestFixture::FP;
+    using S = SU2;
+
+    // blocking and rotation are only fused in the kernel
+    // OperatorFunctions::tensor_product_rotate without batched gemm
+    const SeqTypes seq_type = threading_()->seq_type;
+    threading_()->seq_type = SeqTypes::None;
+
+    shared_ptr<FCIDUMP<FL>> fcidump = make_shared<FCIDUMP<FL>>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    fcidump->rescale();
+    vector<uint8_t> orbsym = fcidump->template orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              [pg](uint8_t x) { return (uint8_t)PointGroup::swap_pg(pg)(x); });
+
+    S vacuum(0), target(fcidump->n_elec(), fcidump->twos(), 0);
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<S, FL>> hamil =
+        make_shared<HamiltonianQC<S, FL>>(vacuum, norb, orbsym, fcidump);
+
+    shared_ptr<MPO<S, FL>> mpo =
+        make_shared<MPOQC<S, FL>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<S, FL>>(mpo, make_shared<RuleQC<S, FL>>(),
+                                            true, true,
+                                            OpNamesSet({OpNames::R, OpNames::RD}));
+
+    shared_ptr<MPSInfo<S>> mps_info =
+        make_shared<MPSInfo<S>>(mpo->n_sites, vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(50);
+    shared_ptr<MPS<S, FL>> mps = make_shared<MPS<S, FL>>(mpo->n_sites, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    auto make_env = [&mps](const shared_ptr<MPO<S, FL>> &xmpo,
+                           const string &tag, bool fused) {
+        shared_ptr<MovingEnvironment<S, FL, FL>> me =
+            make_shared<MovingEnvironment<S, FL, FL>>(xmpo, mps, mps, tag);
+        me->save_partition_info = true;
+        me->cached_contraction = false;
+        me->fused_contraction_rotation = fused;
+        me->init_environments(false);
+        return me;
+    };
+    // the parallel version is checked with a single rank
+    // (some operators are only formed in later sweep steps in this case,
+    // so it is compared with the unfused parallel version)
+    shared_ptr<ParallelRule<S, FL>> rule = make_shared<ParallelRuleQC<S, FL>>(
+        make_shared<ParallelCommunicator<S>>(1, 0, 0));
+    shared_ptr<MPO<S, FL>> pmpo = make_shared<ParallelMPO<S, FL>>(mpo, rule);
+    vector<pair<shared_ptr<MovingEnvironment<S, FL, FL>>,
+                shared_ptr<MovingEnvironment<S, FL, FL>>>>
+        mes = {make_pair(make_env(mpo, "PLAIN", false),
+                         make_env(mpo, "FUSED", true)),
+               make_pair(make_env(pmpo, "PPLAIN", false),
+                         make_env(pmpo, "PFUSED", true))};
+
+    int n_envs = 0;
+    size_t n_ops = 0;
+    FP max_diff = 0, max_abs = 0;
+    for (auto &me : mes)
+        for (int i = 0; i < norb; i++) {
+            shared_ptr<OperatorTensor<S, FL>> r =
+                me.first->load_old_environment(i, false);
+            shared_ptr<OperatorTensor<S, FL>> fr =
+                me.second->load_old_environment(i, false);
+            ASSERT_EQ(r == nullptr, fr == nullptr);
+            if (r == nullptr)
+                continue;
+            n_envs++;
+            ASSERT_EQ(r->ops.size(), fr->ops.size());
+            for (auto &p : r->ops) {
+                ASSERT_EQ(fr->ops.count(p.first), 1);
+                const shared_ptr<SparseMatrix<S, FL>> &a = p.second;
+                const shared_ptr<SparseMatrix<S, FL>> &b =
+                    fr->ops.at(p.first);
+                ASSERT_EQ(a->total_memory, b->total_memory);
+                for (size_t k = 0; k < a->total_memory; k++) {
+                    max_diff = max(max_diff, (FP)abs(a->data[k] - b->data[k]));
+                    max_abs = max(max_abs, (FP)abs(a->data[k]));
+                }
+                n_ops++;
+            }
+            for (auto &p : fr->ops)
+                p.second->deallocate(), p.second->info->deallocate();
+            for (auto &p : r->ops)
+                p.second->deallocate(), p.second->info->deallocate();
+        }
+    cout << "envs = " << n_envs << " ops = " << n_ops << " max abs = "
+         << scientific << max_abs << " max diff = " << max_diff << endl;
+    EXPECT_GT(n_envs, 2);
+    EXPECT_GT(max_abs, (FP)1E-3);
+    EXPECT_LT(max_diff, (is_same<FP, double>::value ? 1E-10 : 1E-4));
+
+    threading_()->seq_type = seq_type;
+    mps_info->deallocate();
+    for (auto &me : mes)
+        me.second->remove_partition_files(),
+            me.first->remove_partition_files();
+    mpo->deallocate();
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
+// incremental rotation of the right environments against full rotation,
+// after two states of one sector at one bond are mixed
+TYPED_TEST(TestDMRGN2STO3G, TestIncrementalRotation) {
+    using FL = TypeParam;
+    using FP = typename TestFixture::FP;
+    using S = SU2;
+
+    shared_ptr<FCIDUMP<FL>> fcidump = make_shared<FCIDUMP<FL>>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->template orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              [pg](uint8_t x) { return (uint8_t)PointGroup::swap_pg(pg)(x); });
+
+    S vacuum(0), target(fcidump->n_elec(), fcidump->twos(), 0);
+    int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<S, FL>> hamil =
+        make_shared<HamiltonianQC<S, FL>>(vacuum, norb, orbsym, fcidump);
+
+    shared_ptr<MPO<S, FL>> mpo =
+        make_shared<MPOQC<S, FL>>(hamil, QCTypes::Conventional);
+    mpo = make_shared<SimplifiedMPO<S, FL>>(mpo, make_shared<RuleQC<S, FL>>(),
+                                            true, true,
+                                            OpNamesSet({OpNames::R, OpNames::RD}));
+
+    shared_ptr<MPSInfo<S>> mps_info =
+        make_shared<MPSInfo<S>>(mpo->n_sites, vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(50);
+    Random::rand_seed(384666);
+    shared_ptr<MPS<S, FL>> mps = make_shared<MPS<S, FL>>(mpo->n_sites, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+
+    // old environments must be kept on disk
+    frame_<FP>()->minimal_disk_usage = false;
+    shared_ptr<MovingEnvironment<S, FL, FL>> me =
+        make_shared<MovingEnvironment<S, FL, FL>>(mpo, mps, mps, "INCR");
+    me->incremental_rotation = true;
+    me->init_environments(false);
+
+    // mix two states of the left bond of the right-canonical site j
+    // the states of the other sectors at this bond are kept
+    const int j = norb / 2;
+    mps->load_tensor(j);
+    bool mixed = false;
+    for (int k = 0; k < mps->tensors[j]->info->n && !mixed; k++) {
+        GMatrix<FL> m = (*mps->tensors[j])[k];
+        if (m.m < 2)
+            continue;
+        const FP c = (FP)0.6, s = (FP)0.8;
+        for (MKL_INT l = 0; l < m.n; l++) {
+            const FL x = m(0, l), y = m(1, l);
+            m(0, l) = c * x - s * y, m(1, l) = s * x + c * y;
+        }
+        mixed = true;
+    }
+    ASSERT_TRUE(mixed);
+    mps->save_tensor(j);
+    mps->unload_tensor(j);
+
+    // rebuild the right environments as in a backward sweep
+    const size_t kept = me->incr_kept_states, total = me->incr_total_states;
+    for (int i = norb - 3; i >= 0; i--) {
+        me->envs[i]->right_op_infos.clear();
+        me->envs[i]->right = nullptr;
+    }
+    frame_<FP>()->reset(1);
+    for (int i = norb - 3; i >= 0; i--)
+        me->right_contract_rotate(i);
+    const size_t incr_kept = me->incr_kept_states - kept;
+    const size_t incr_total = me->incr_total_states - total;
+    cout << "kept states = " << incr_kept << " / " << incr_total << endl;
+    // some, but not all states are reused
+    EXPECT_GT(incr_kept, 0);
+    EXPECT_LT(incr_kept, incr_total);
+
+    shared_ptr<MovingEnvironment<S, FL, FL>> fme =
+        make_shared<MovingEnvironment<S, FL, FL>>(mpo, mps, mps, "FULL");
+    fme->save_partition_info = true;
+    fme->init_environments(false);
+
+    int n_envs = 0;
+    size_t n_ops = 0;
+    FP max_diff = 0, max_abs = 0;
+    for (int i = 0; i < norb; i++) {
+        shared_ptr<OperatorTensor<S, FL>> r =
+            fme->load_old_environment(i, false);
+        shared_ptr<OperatorTensor<S, FL>> ir =
+            me->load_old_environment(i, false);
+        ASSERT_EQ(r == nullptr, ir == nullptr);
+        if (r == nullptr)
+            continue;
+        n_envs++;
+        ASSERT_EQ(r->ops.size(), ir->ops.size());
+        for (auto &p : r->ops) {
+            ASSERT_EQ(ir->ops.count(p.first), 1);
+            const shared_ptr<SparseMatrix<S, FL>> &a = p.second;
+            const shared_ptr<SparseMatrix<S, FL>> &b = ir->ops.at(p.first);
+            ASSERT_EQ(a->total_memory, b->total_memory);
+            for (size_t k = 0; k < a->total_memory; k++) {
+                max_diff = max(max_diff, (FP)abs(a->data[k] - b->data[k]));
+                max_abs = max(max_abs, (FP)abs(a->data[k]));
+            }
+            n_ops++;
+        }
+        for (auto &p : ir->ops)
+            p.second->deallocate(), p.second->info->deallocate();
+        for (auto &p : r->ops)
+            p.second->deallocate(), p.second->info->deallocate();
+    }
+    cout << "envs = " << n_envs << " ops = " << n_ops << " max abs = "
+         << scientific << max_abs << " max diff = " << max_diff << endl;
+    EXPECT_GT(n_envs, 2);
+    EXPECT_GT(max_abs, (FP)1E-3);
+    EXPECT_LT(max_diff, (is_same<FP, double>::value ? 1E-10 : 1E-4));
+
+    frame_<FP>()->minimal_disk_usage = true;
+    mps_info->deallocate();
+    me->remove_partition_files();
+    fme->remove_partition_files();
+    mpo->deallocate();
     hamil->deallocate();
     fcidump->deallocate();
 }
@@ -314,6 +976,9 @@ TYPED_TEST(TestDMRGN2STO3G, TestSZ) {
     this->template test_dmrg<SZ>(targets, energies, hamil, "SZ SVD RED PERT LM",
                                  DecompositionTypes::SVD,
                                  NoiseTypes::ReducedPerturbativeLowMem);
+    this->template test_dmrg<SZ>(targets, energies, hamil, "SZ RED PERT BT",
+                                 DecompositionTypes::DensityMatrix,
+                                 NoiseTypes::ReducedPerturbativeBatched);
     this->template test_dmrg<SZ>(targets, energies, hamil, "SZ RED PERT CDS",
                                  DecompositionTypes::DensityMatrix,
                                  NoiseTypes::ReducedPerturbative, true);
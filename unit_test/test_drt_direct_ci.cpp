@@ -0,0 +1,86 @@
+#include "block2_big_site.hpp"
+#include "block2_core.hpp"
+#include "block2_dmrg.hpp"
+#include <gtest/gtest.h>
+
+using namespace block2;
+
+class TestDRTDirectCI : public ::testing::Test {
+  protected:
+    size_t isize = 1LL << 24;
+    size_t dsize = 1LL << 28;
+    template <typename S>
+    void test_direct_ci(const shared_ptr<FCIDUMP<double>> &fcidump,
+                        PGTypes pg, double energy) {
+        vector<uint8_t> orbsym = fcidump->template orb_sym<uint8_t>();
+        transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+                  PointGroup::swap_pg(pg));
+        S target(fcidump->n_elec(), fcidump->twos(),
+                 PointGroup::swap_pg(pg)(fcidump->isym()));
+        Timer t;
+        t.get_time();
+        shared_ptr<DRTDirectCI<S, double>> ci =
+            make_shared<DRTDirectCI<S, double>>(fcidump, target, orbsym);
+        const long long n = ci->size();
+        // sigma must reproduce a symmetric matrix with the same diagonal
+        vector<double> diag = ci->diagonal();
+        const int ncols = (int)min(n, 40LL);
+        vector<vector<double>> cols(ncols, vector<double>(n, 0.0));
+        for (int i = 0; i < ncols; i++) {
+            vector<double> c(n, 0.0);
+            c[i] = 1.0;
+            ci->sigma(c.data(), cols[i].data());
+            EXPECT_LT(abs(cols[i][i] - diag[i]), 1E-10);
+        }
+        for (int i = 0; i < ncols; i++)
+            for (int j = 0; j < i; j++)
+                EXPECT_LT(abs(cols[i][j] - cols[j][i]), 1E-10);
+        // and the same matrix elements as the CSR hamiltonian of the big site
+        shared_ptr<OpExpr<S>> hop = make_shared<OpElement<S, double>>(
+            OpNames::H, SiteIndex(), S(0, 0, 0));
+        unordered_map<shared_ptr<OpExpr<S>>, shared_ptr<SparseMatrix<S, double>>>
+            ops;
+        ops[hop] = nullptr;
+        ci->site->get_site_ops(0, ops);
+        shared_ptr<CSRSparseMatrix<S, double>> hmat =
+            dynamic_pointer_cast<CSRSparseMatrix<S, double>>(ops.at(hop));
+        ASSERT_NE(hmat, nullptr);
+        int ih = 0;
+        while (ih < hmat->info->n && hmat->info->quanta[ih].get_ket() != target)
+            ih++;
+        ASSERT_LT(ih, hmat->info->n);
+        ASSERT_EQ((long long)hmat->csr_data[ih]->m, n);
+        vector<double> hdense((size_t)n * n);
+        hmat->csr_data[ih]->to_dense(
+            GMatrix<double>(hdense.data(), (MKL_INT)n, (MKL_INT)n));
+        for (int i = 0; i < ncols; i++)
+            for (long long j = 0; j < n; j++)
+                EXPECT_LT(abs(cols[i][j] - hdense[j * n + i]), 1E-10);
+        vector<vector<double>> cis;
+        vector<double> eners = ci->solve(1, cis);
+        cout << "NCSF = " << n << " E = " << fixed << setprecision(10)
+             << eners[0] << " T = " << t.get_time() << endl;
+        EXPECT_LT(abs(eners[0] - energy), 1E-7);
+    }
+    void SetUp() override {
+        Random::rand_seed(0);
+        frame_<double>() = make_shared<DataFrame<double>>(isize, dsize, "nodex");
+        threading_() = make_shared<Threading>(
+            ThreadingTypes::OperatorBatchedGEMM | ThreadingTypes::Global, 4, 4,
+            1);
+        threading_()->seq_type = SeqTypes::Tasked;
+    }
+    void TearDown() override {
+        frame_<double>()->activate(0);
+        assert(ialloc_()->used == 0 && dalloc_<double>()->used == 0);
+        frame_<double>() = nullptr;
+    }
+};
+
+TEST_F(TestDRTDirectCI, TestN2STO3G) {
+    shared_ptr<FCIDUMP<double>> fcidump = make_shared<FCIDUMP<double>>();
+    fcidump->read("data/N2.STO3G.FCIDUMP");
+    fcidump->symmetrize(fcidump->orb_sym<uint8_t>());
+    test_direct_ci<SU2>(fcidump, PGTypes::D2H, -107.654122447525);
+    test_direct_ci<SZ>(fcidump, PGTypes::D2H, -107.654122447525);
+}
@@ -132,3 +132,61 @@ TEST_F(TestFCIDUMP, TestCompressedComplexRead) {
     EXPECT_EQ(fcidump.cps_vs[0](0, 2, 1, 1), fcidump.cps_vs[0](1, 1, 2, 0));
     fcidump.deallocate();
 }
+
+TEST_F(TestFCIDUMP, TestRotate) {
+    const uint16_t n = 9;
+    const size_t n2 = (size_t)n * n;
+    vector<double> rot_mat(n2);
+    Random::fill<double>(rot_mat.data(), rot_mat.size(), -1, 1);
+    V1Int<double> v1(n), r1(n);
+    V4Int<double> v4(n), r4(n);
+    V8Int<double> v8(n), r8(n);
+    vector<double> d1(v1.size()), d4(v4.size()), d8(v8.size());
+    Random::fill<double>(d8.data(), d8.size(), -1, 1);
+    v8.data = d8.data();
+    for (uint16_t i = 0; i < n; i++)
+        for (uint16_t j = 0; j < n; j++)
+            for (uint16_t k = 0; k < n; k++)
+                for (uint16_t l = 0; l < n; l++)
+                    d1[((i * n + j) * n + k) * n + l] =
+                        d4[v4.find_index(i, j, k, l)] = v8(i, j, k, l);
+    v1.data = d1.data(), v4.data = d4.data();
+    // reference: one index at a time on the full array
+    vector<double> ref(d1), tmp(ref.size());
+    for (int p = 0; p < 4; p++) {
+        const size_t st = p == 0 ? n2 * n : (p == 1 ? n2 : (p == 2 ? n : 1));
+        for (size_t x = 0; x < ref.size(); x++) {
+            const size_t y = x - (x / st % n) * st;
+            double v = 0;
+            for (uint16_t q = 0; q < n; q++)
+                v += rot_mat[q * n + x / st % n] * ref[y + q * st];
+            tmp[x] = v;
+        }
+        ref.swap(tmp);
+    }
+    // small max_memory gives blocks of one slab and one k row
+    for (size_t max_memory : {(size_t)1, (size_t)1 << 30}) {
+        vector<double> e1(v1.size()), e4(v4.size()), e8(v8.size());
+        r1.data = e1.data(), r4.data = e4.data(), r8.data = e8.data();
+        r1.rotate(v1, rot_mat, max_memory);
+        r4.rotate(v4, rot_mat, max_memory);
+        r8.rotate(v8, rot_mat, max_memory);
+        for (uint16_t i = 0; i < n; i++)
+            for (uint16_t j = 0; j < n; j++)
+                for (uint16_t k = 0; k < n; k++)
+                    for (uint16_t l = 0; l < n; l++) {
+                        const double x = ref[((i * n + j) * n + k) * n + l];
+                        EXPECT_LT(abs(r1(i, j, k, l) - x), 1E-12);
+                        EXPECT_LT(abs(r4(i, j, k, l) - x), 1E-12);
+                        EXPECT_LT(abs(r8(i, j, k, l) - x), 1E-12);
+                    }
+        // in place, compared with each other
+        r1.rotate(r1, rot_mat, max_memory);
+        r4.rotate(r4, rot_mat, max_memory);
+        for (uint16_t i = 0; i < n; i++)
+            for (uint16_t j = 0; j < n; j++)
+                for (uint16_t k = 0; k < n; k++)
+                    for (uint16_t l = 0; l < n; l++)
+                        EXPECT_LT(abs(r1(i, j, k, l) - r4(i, j, k, l)), 1E-10);
+    }
+}
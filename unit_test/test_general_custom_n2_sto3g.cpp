@@ -0,0 +1,330 @@
+#include "block2_core.hpp"
+#include "block2_dmrg.hpp"
+#include <gtest/gtest.h>
+
+using namespace block2;
+
+// custom hamiltonian with callbacks that must not be called concurrently
+template <typename S, typename FL>
+struct SerialCustomHamiltonian : GeneralCustomHamiltonian<S, FL> {
+    using GeneralCustomHamiltonian<S, FL>::GeneralCustomHamiltonian;
+    bool is_thread_safe() const override { return false; }
+};
+
+template <typename FL>
+class TestGeneralCustomN2STO3G : public ::testing::Test {
+  protected:
+    size_t isize = 1LL << 24;
+    size_t dsize = 1LL << 30;
+    typedef typename GMatrix<FL>::FP FP;
+
+    template <typename S> static S make_q(int n, int twos, int pg);
+    template <typename S>
+    shared_ptr<GeneralHamiltonian<S, FL>>
+    make_custom_hamil(S vacuum, int n_sites,
+                      const vector<typename S::pg_t> &orb_sym, bool serial);
+    template <typename S> void test_custom();
+    template <typename S>
+    static double
+    dmrg_energy(const shared_ptr<GeneralHamiltonian<S, FL>> &hamil,
+                const shared_ptr<GeneralFCIDUMP<FL>> &gfd, S vacuum, S target);
+    void test_custom_lz();
+    void SetUp() override {
+        Random::rand_seed(0);
+        frame_<FP>() = make_shared<DataFrame<FP>>(isize, dsize, "nodex");
+        frame_<FP>()->use_main_stack = false;
+        frame_<FP>()->minimal_disk_usage = true;
+        threading_() = make_shared<Threading>(
+            ThreadingTypes::OperatorBatchedGEMM | ThreadingTypes::Global, 4, 4,
+            1);
+        threading_()->seq_type = SeqTypes::Tasked;
+        cout << *threading_() << endl;
+    }
+    void TearDown() override {
+        frame_<FP>()->activate(0);
+        assert(ialloc_()->used == 0 && dalloc_<FP>()->used == 0);
+        frame_<FP>() = nullptr;
+    }
+};
+
+template <typename FL>
+template <typename S>
+S TestGeneralCustomN2STO3G<FL>::make_q(int n, int twos, int pg) {
+    return S(n, twos, pg);
+}
+
+#ifdef _USE_SANY
+template <>
+template <>
+SAny TestGeneralCustomN2STO3G<double>::make_q<SAny>(int n, int twos, int pg) {
+    return SAny::init_sz(n, twos, pg);
+}
+#endif
+
+// spin orbital c/d/C/D matrices in the basis |0>, |a>, |b>, |ab>
+template <typename FL>
+template <typename S>
+shared_ptr<GeneralHamiltonian<S, FL>>
+TestGeneralCustomN2STO3G<FL>::make_custom_hamil(
+    S vacuum, int n_sites, const vector<typename S::pg_t> &orb_sym,
+    bool serial) {
+    vector<vector<pair<S, int>>> site_basis(n_sites);
+    vector<vector<pair<string, pair<S, vector<FL>>>>> site_ops(n_sites);
+    for (int m = 0; m < n_sites; m++) {
+        const int ipg = orb_sym[m];
+        site_basis[m] = vector<pair<S, int>>{{make_q<S>(0, 0, 0), 1},
+                                             {make_q<S>(1, 1, ipg), 1},
+                                             {make_q<S>(1, -1, ipg), 1},
+                                             {make_q<S>(2, 0, 0), 1}};
+        vector<FL> id(16), c(16), d(16), xc(16), xd(16);
+        for (int i = 0; i < 4; i++)
+            id[i * 5] = 1;
+        c[1 * 4 + 0] = 1, c[3 * 4 + 2] = 1;
+        xc[2 * 4 + 0] = 1, xc[3 * 4 + 1] = -1;
+        for (int i = 0; i < 4; i++)
+            for (int j = 0; j < 4; j++)
+                d[i * 4 + j] = c[j * 4 + i], xd[i * 4 + j] = xc[j * 4 + i];
+        const S inv(S::invalid);
+        site_ops[m] = vector<pair<string, pair<S, vector<FL>>>>{
+            {"", {inv, id}},
+            {"c", {inv, c}},
+            {"d", {inv, d}},
+            {"C", {inv, xc}},
+            {"D", {inv, xd}}};
+    }
+    if (serial)
+        return make_shared<SerialCustomHamiltonian<S, FL>>(
+            vacuum, n_sites, orb_sym, site_basis, site_ops);
+    else
+        return make_shared<GeneralCustomHamiltonian<S, FL>>(
+            vacuum, n_sites, orb_sym, site_basis, site_ops);
+}
+
+template <typename FL>
+template <typename S>
+void TestGeneralCustomN2STO3G<FL>::test_custom() {
+    shared_ptr<FCIDUMP<FL>> fcidump = make_shared<FCIDUMP<FL>>();
+    PGTypes pg = PGTypes::D2H;
+    string filename = "data/N2.STO3G.FCIDUMP";
+    fcidump->read(filename);
+    vector<uint8_t> orbsym = fcidump->template orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+    vector<typename S::pg_t> porbsym(orbsym.begin(), orbsym.end());
+    int norb = fcidump->n_sites();
+    S vacuum = make_q<S>(0, 0, 0);
+    S target = make_q<S>(fcidump->n_elec(), fcidump->twos(),
+                         PointGroup::swap_pg(pg)(fcidump->isym()));
+    fcidump->symmetrize(orbsym);
+    shared_ptr<GeneralFCIDUMP<FL>> gfd =
+        GeneralFCIDUMP<FL>::initialize_from_qc(fcidump, ElemOpTypes::SZ)
+            ->adjust_order();
+
+    vector<shared_ptr<GeneralHamiltonian<S, FL>>> hamils = {
+        make_shared<GeneralHamiltonian<S, FL>>(vacuum, norb, porbsym),
+        make_custom_hamil<S>(vacuum, norb, porbsym, false),
+        make_custom_hamil<S>(vacuum, norb, porbsym, true)};
+    vector<string> names = {"STD", "CUSTOM", "CUSTOM SERIAL"};
+    EXPECT_TRUE(hamils[1]->is_thread_safe());
+    EXPECT_FALSE(hamils[2]->is_thread_safe());
+
+    vector<vector<int>> bond_dims(hamils.size());
+    vector<double> energies(hamils.size());
+    for (size_t ih = 0; ih < hamils.size(); ih++) {
+        shared_ptr<MPO<S, FL>> mpo = make_shared<GeneralMPO<S, FL>>(
+            hamils[ih], gfd, MPOAlgorithmTypes::FastBipartite, 1E-14, -1, 0);
+        mpo->build();
+        for (int i = 0; i < norb - 1; i++)
+            bond_dims[ih].push_back(
+                (int)mpo->right_operator_names[i]->data.size());
+        mpo = make_shared<SimplifiedMPO<S, FL>>(
+            mpo, make_shared<Rule<S, FL>>(), false, false);
+
+        shared_ptr<MPSInfo<S>> mps_info =
+            make_shared<MPSInfo<S>>(norb, vacuum, target, mpo->basis);
+        mps_info->set_bond_dimension(200);
+        Random::rand_seed(384666);
+        shared_ptr<MPS<S, FL>> mps = make_shared<MPS<S, FL>>(norb, 0, 2);
+        mps->initialize(mps_info);
+        mps->random_canonicalize();
+        mps->save_mutable();
+        mps->deallocate();
+        mps_info->save_mutable();
+        mps_info->deallocate_mutable();
+
+        shared_ptr<MovingEnvironment<S, FL, FL>> me =
+            make_shared<MovingEnvironment<S, FL, FL>>(mpo, mps, mps, "DMRG");
+        me->init_environments(false);
+        shared_ptr<DMRG<S, FL, FL>> dmrg = make_shared<DMRG<S, FL, FL>>(
+            me, vector<ubond_t>{200}, vector<FP>{1E-8, 0});
+        dmrg->iprint = 0;
+        energies[ih] = (double)xreal(dmrg->solve(10, true, 1E-12));
+        cout << setw(15) << names[ih] << " E = " << fixed << setw(22)
+             << setprecision(12) << energies[ih] << endl;
+
+        mps_info->deallocate();
+        mpo->deallocate();
+    }
+
+    for (size_t ih = 1; ih < hamils.size(); ih++) {
+        EXPECT_EQ(bond_dims[ih], bond_dims[0]);
+        EXPECT_LT(abs(energies[ih] - energies[0]), 1E-8);
+    }
+    EXPECT_LT(abs(energies[0] - (-107.654122447525)), 1E-7);
+
+    for (int ih = (int)hamils.size() - 1; ih >= 0; ih--)
+        hamils[ih]->deallocate();
+    fcidump->deallocate();
+}
+
+template <typename FL>
+template <typename S>
+double TestGeneralCustomN2STO3G<FL>::dmrg_energy(
+    const shared_ptr<GeneralHamiltonian<S, FL>> &hamil,
+    const shared_ptr<GeneralFCIDUMP<FL>> &gfd, S vacuum, S target) {
+    const int norb = hamil->n_sites;
+    shared_ptr<MPO<S, FL>> mpo = make_shared<GeneralMPO<S, FL>>(
+        hamil, gfd, MPOAlgorithmTypes::FastBipartite, 1E-14, -1, 0);
+    mpo->build();
+    mpo = make_shared<SimplifiedMPO<S, FL>>(mpo, make_shared<Rule<S, FL>>(),
+                                            false, false);
+    shared_ptr<MPSInfo<S>> mps_info =
+        make_shared<MPSInfo<S>>(norb, vacuum, target, mpo->basis);
+    mps_info->set_bond_dimension(200);
+    Random::rand_seed(384666);
+    shared_ptr<MPS<S, FL>> mps = make_shared<MPS<S, FL>>(norb, 0, 2);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+    shared_ptr<MovingEnvironment<S, FL, FL>> me =
+        make_shared<MovingEnvironment<S, FL, FL>>(mpo, mps, mps, "DMRG");
+    me->init_environments(false);
+    shared_ptr<DMRG<S, FL, FL>> dmrg = make_shared<DMRG<S, FL, FL>>(
+        me, vector<ubond_t>{200}, vector<FP>{1E-8, 0});
+    dmrg->iprint = 0;
+    double energy = (double)xreal(dmrg->solve(10, true, 1E-12));
+    mps_info->deallocate();
+    mpo->deallocate();
+    return energy;
+}
+
+#ifdef _USE_SANY
+static SAny make_q_lz(int n, int twos, int lz) {
+    SAny r;
+    r.types[0] = SAnySymmTypes::U1Fermi;
+    r.types[1] = SAnySymmTypes::U1Fermi;
+    r.types[2] = SAnySymmTypes::LZ;
+    r.values[0] = n, r.values[1] = twos, r.values[2] = lz;
+    return r;
+}
+
+// N2 integrals keeping only the terms that conserve an Lz label of
+// +1 (B2 irreps), -1 (B3 irreps) or 0 (others) for each orbital
+template <typename FL> void TestGeneralCustomN2STO3G<FL>::test_custom_lz() {
+    typedef SAny S;
+    shared_ptr<FCIDUMP<FL>> fcidump = make_shared<FCIDUMP<FL>>();
+    PGTypes pg = PGTypes::D2H;
+    fcidump->read("data/N2.STO3G.FCIDUMP");
+    vector<uint8_t> orbsym = fcidump->template orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+    const int norb = fcidump->n_sites(), n_elec = fcidump->n_elec();
+    vector<int> lz(norb);
+    for (int i = 0; i < norb; i++)
+        lz[i] = (orbsym[i] & 3) == 2 ? 1 : ((orbsym[i] & 3) == 3 ? -1 : 0);
+    vector<FL> t((size_t)norb * norb), v((size_t)norb * norb * norb * norb);
+    for (int i = 0; i < norb; i++)
+        for (int j = 0; j < norb; j++) {
+            if (lz[i] == lz[j])
+                t[(size_t)i * norb + j] = fcidump->t(i, j);
+            for (int k = 0; k < norb; k++)
+                for (int l = 0; l < norb; l++)
+                    if (lz[i] == lz[j] && lz[k] == lz[l])
+                        v[(((size_t)i * norb + j) * norb + k) * norb + l] =
+                            fcidump->v(i, j, k, l);
+        }
+    shared_ptr<FCIDUMP<FL>> lzfd = make_shared<FCIDUMP<FL>>();
+    lzfd->initialize_su2(norb, n_elec, 0, 0, fcidump->e(), t.data(), t.size(),
+                         v.data(), v.size());
+    shared_ptr<GeneralFCIDUMP<FL>> gfd =
+        GeneralFCIDUMP<FL>::initialize_from_qc(lzfd, ElemOpTypes::SZ)
+            ->adjust_order();
+
+    // reference without Lz symmetry
+    S vacuum = S::init_sz(0, 0, 0);
+    shared_ptr<GeneralHamiltonian<S, FL>> std_hamil =
+        make_shared<GeneralHamiltonian<S, FL>>(vacuum, norb,
+                                               vector<int>(norb, 0));
+    const double std_energy =
+        dmrg_energy<S>(std_hamil, gfd, vacuum, S::init_sz(n_elec, 0, 0));
+    std_hamil->deallocate();
+
+    // custom hamiltonian with Lz: c/C add lz, d/D subtract lz
+    vector<vector<pair<S, int>>> site_basis(norb);
+    vector<vector<pair<string, pair<S, vector<FL>>>>> site_ops(norb);
+    for (int m = 0; m < norb; m++) {
+        site_basis[m] = vector<pair<S, int>>{{make_q_lz(0, 0, 0), 1},
+                                             {make_q_lz(1, 1, lz[m]), 1},
+                                             {make_q_lz(1, -1, lz[m]), 1},
+                                             {make_q_lz(2, 0, 2 * lz[m]), 1}};
+        vector<FL> id(16), c(16), d(16), xc(16), xd(16);
+        for (int i = 0; i < 4; i++)
+            id[i * 5] = 1;
+        c[1 * 4 + 0] = 1, c[3 * 4 + 2] = 1;
+        xc[2 * 4 + 0] = 1, xc[3 * 4 + 1] = -1;
+        for (int i = 0; i < 4; i++)
+            for (int j = 0; j < 4; j++)
+                d[i * 4 + j] = c[j * 4 + i], xd[i * 4 + j] = xc[j * 4 + i];
+        const S inv(S::invalid);
+        site_ops[m] = vector<pair<string, pair<S, vector<FL>>>>{
+            {"", {inv, id}},
+            {"c", {inv, c}},
+            {"d", {inv, d}},
+            {"C", {inv, xc}},
+            {"D", {inv, xd}}};
+    }
+    S lz_vacuum = make_q_lz(0, 0, 0);
+    shared_ptr<GeneralCustomHamiltonian<S, FL>> hamil =
+        make_shared<GeneralCustomHamiltonian<S, FL>>(
+            lz_vacuum, norb, lz, site_basis, site_ops);
+    // the orbital independent quanta do not carry lz
+    EXPECT_EQ(hamil->prim_quanta.at("d"), make_q_lz(-1, -1, 0));
+    map<int, double> energies;
+    double min_energy = 0;
+    for (int k = -2; k <= 2; k++) {
+        energies[k] =
+            dmrg_energy<S>(hamil, gfd, lz_vacuum, make_q_lz(n_elec, 0, k));
+        cout << " LZ = " << setw(3) << k << " E = " << fixed << setw(22)
+             << setprecision(12) << energies[k] << endl;
+        min_energy = k == -2 ? energies[k] : min(min_energy, energies[k]);
+    }
+    hamil->deallocate();
+    lzfd->deallocate();
+    fcidump->deallocate();
+
+    cout << " NO LZ E = " << fixed << setw(22) << setprecision(12)
+         << std_energy << endl;
+    EXPECT_LT(abs(min_energy - std_energy), 1E-8);
+    EXPECT_LT(abs(energies[1] - energies[-1]), 1E-8);
+    EXPECT_GT(abs(energies[1] - energies[0]), 1E-4);
+}
+#endif
+
+typedef ::testing::Types<double> TestFL;
+
+TYPED_TEST_CASE(TestGeneralCustomN2STO3G, TestFL);
+
+TYPED_TEST(TestGeneralCustomN2STO3G, TestSZ) {
+    this->template test_custom<SZ>();
+}
+
+#ifdef _USE_SANY
+TYPED_TEST(TestGeneralCustomN2STO3G, TestSAny) {
+    this->template test_custom<SAny>();
+}
+
+TYPED_TEST(TestGeneralCustomN2STO3G, TestSAnyLZ) { this->test_custom_lz(); }
+#endif
@@ -187,6 +187,60 @@ TEST_F(TestNDArray, TestTranspose) {
     check_perm({12, 15, 5, 10, 4, 9}, {2, 0, 4, 1, 5, 3});
 }
 
+TEST_F(TestNDArray, TestTransposeTiled) {
+    Random::rand_seed(1234);
+    const vector<pair<vector<MKL_INT>, vector<int>>> cases = {
+        {{512, 384}, {1, 0}},
+        {{36, 40, 44, 48}, {3, 2, 1, 0}},
+        {{36, 40, 44, 48}, {1, 3, 0, 2}},
+        {{12, 14, 16, 18, 20}, {4, 0, 3, 1, 2}},
+        {{8, 9, 10, 11, 12, 13}, {5, 1, 3, 0, 4, 2}}};
+    Timer t;
+    const bool use_avx = NDArray::avx_transpose();
+    EXPECT_EQ(use_avx, NDArray::avx_transpose_supported());
+    for (auto &c : cases) {
+        NDArray x = NDArray::random(c.first);
+        NDArray y = x.transpose(c.second);
+        NDArray z0 = NDArray::random(y.shape), z1(y.shape), z2(y.shape);
+        NDArray::transpose(z0, z1);
+        // reference: generic strided loop
+        t.get_time();
+        NDArray::transpose(y, z1, {}, 0.5, 2.0, false);
+        double tref = t.get_time();
+        // tiles with every instruction set available on this cpu
+        for (int avx = 0; avx <= (int)use_avx; avx++) {
+            NDArray::avx_transpose() = avx;
+            NDArray::transpose(z0, z2);
+            t.get_time();
+            NDArray::transpose(y, z2, {}, 0.5, 2.0, true);
+            double ttiled = t.get_time();
+            EXPECT_LT((z1 - z2).norm(), 1E-12);
+            cout << "transpose size = " << x.size() << " T(strided) = "
+                 << fixed << setprecision(4) << tref << " T(tiled"
+                 << (avx ? ",avx" : "") << ") = " << ttiled << endl;
+        }
+    }
+    NDArray::avx_transpose() = use_avx;
+    // the plan cache is bounded
+    const size_t max_size = NDArray::max_transpose_plan_cache_size();
+    NDArray::max_transpose_plan_cache_size() = 2;
+    NDArray::transpose_plan_cache().clear();
+    for (auto &c : cases) {
+        NDArray y = NDArray::random(c.first).transpose(c.second);
+        NDArray z1(y.shape), z2(y.shape);
+        NDArray::transpose(y, z1, {}, 1.0, 0.0, false);
+        NDArray::transpose(y, z2);
+        EXPECT_LT((z1 - z2).norm(), 1E-12);
+        EXPECT_LE(NDArray::transpose_plan_cache().size(), 2);
+        EXPECT_GT(NDArray::transpose_plan_cache().size(), 0);
+    }
+    NDArray::max_transpose_plan_cache_size() = 0;
+    NDArray::transpose(NDArray::random({64, 64}).transpose({1, 0}),
+                       NDArray(vector<MKL_INT>{64, 64}));
+    EXPECT_EQ(NDArray::transpose_plan_cache().size(), 0);
+    NDArray::max_transpose_plan_cache_size() = max_size;
+}
+
 TEST_F(TestNDArray, TestSum) {
     Random::rand_seed(1234);
 
@@ -1599,4 +1653,43 @@ TEST_F(TestNDArray, TestEinsum) {
 
     diff = (NDArray::einsum("ijkl,xiky,lyp,px->jl", {a, b, c, d}) - ref).norm();
     EXPECT_LT(diff, 1E-12);
-}
\ No newline at end of file
+}
+TEST_F(TestNDArray, TestEinsumPath) {
+    // the small vector should be contracted first
+    vector<pair<int, int>> path = NDArray::contraction_path(
+        {"ab", "bc", "c"}, {{20, 30}, {30, 40}, {40}}, "a");
+    EXPECT_EQ(path.size(), 2);
+    EXPECT_EQ(path[0], make_pair(1, 2));
+    // greedy path for many operands
+    path = NDArray::contraction_path(
+        {"ab", "bc", "cd", "de", "ef", "fg", "gh", "h"},
+        {{4, 5}, {5, 6}, {6, 7}, {7, 8}, {8, 9}, {9, 10}, {10, 11}, {11}}, "a");
+    EXPECT_EQ(path.size(), 7);
+    EXPECT_EQ(path[0], make_pair(6, 7));
+    NDArray a = NDArray::random({3, 4}), b = NDArray::random({4, 5});
+    NDArray c = NDArray::random({5, 6}), d = NDArray::random({6});
+    NDArray e = NDArray::random({6, 3});
+    NDArray ab = NDArray::einsum("ij,jk->ik", {a, b});
+    NDArray abc = NDArray::einsum("ik,kl->il", {ab, c});
+    NDArray ref = NDArray::einsum("il,l->i", {abc, d});
+    double diff = (NDArray::einsum("ij,jk,kl,l->i", {a, b, c, d}) - ref).norm();
+    EXPECT_LT(diff, 1E-12);
+    // repeated call uses the cached path
+    diff = (NDArray::einsum("ij,jk,kl,l->i", {a, b, c, d}) - ref).norm();
+    EXPECT_LT(diff, 1E-12);
+    EXPECT_GT(NDArray::einsum_path_cache().size(), 0);
+    // the path cache is bounded
+    const size_t max_size = NDArray::max_einsum_path_cache_size();
+    NDArray::max_einsum_path_cache_size() = 1;
+    diff = (NDArray::einsum("ij,jk,kl,l->i", {a, b, c, d}) - ref).norm();
+    EXPECT_LT(diff, 1E-12);
+    NDArray ref2 = NDArray::einsum("il,li->", {abc, e});
+    diff = (NDArray::einsum("pq,qr,rs,sp->", {a, b, c, e}) - ref2).norm();
+    EXPECT_LT(diff, 1E-12);
+    EXPECT_EQ(NDArray::einsum_path_cache().size(), 1);
+    NDArray::max_einsum_path_cache_size() = 0;
+    diff = (NDArray::einsum("ij,jk,kl,l->i", {a, b, c, d}) - ref).norm();
+    EXPECT_LT(diff, 1E-12);
+    EXPECT_EQ(NDArray::einsum_path_cache().size(), 0);
+    NDArray::max_einsum_path_cache_size() = max_size;
+}
@@ -0,0 +1,146 @@
+#include "block2_core.hpp"
+#include "block2_dmrg.hpp"
+#include <gtest/gtest.h>
+
+using namespace block2;
+
+// one rank of a communicator without communication, for checking the
+// slices of each rank in serial
+// the collectives leave the local data unchanged
+template <typename S>
+struct SerialRankCommunicator : ParallelCommunicator<S> {
+    SerialRankCommunicator(int size, int rank)
+        : ParallelCommunicator<S>(size, rank, 0) {}
+    void barrier() override {}
+    void reduce_sum(double *data, size_t len, int owner) override {}
+    void allreduce_sum(double *data, size_t len) override {}
+    void allreduce_logical_or(bool &v) override {}
+};
+
+class TestNPDMShard : public ::testing::Test {
+  protected:
+    typedef double FL;
+    typedef SZ S;
+    size_t stack_mem = 1LL << 30;
+    void SetUp() override { Random::rand_seed(384666); }
+    static shared_ptr<GTensor<FL>> read_npy(const string &filename) {
+        shared_ptr<GTensor<FL>> r = make_shared<GTensor<FL>>();
+        ifstream ifs(filename.c_str(), ios::binary);
+        EXPECT_TRUE(ifs.good());
+        r->read_array(ifs);
+        EXPECT_TRUE(ifs.good());
+        ifs.close();
+        return r;
+    }
+    static void expect_equal(const shared_ptr<GTensor<FL>> &a,
+                             const shared_ptr<GTensor<FL>> &b) {
+        EXPECT_EQ(a->shape, b->shape);
+        ASSERT_EQ(a->size(), b->size());
+        for (size_t i = 0; i < a->size(); i++)
+            EXPECT_EQ((*a->data)[i], (*b->data)[i]);
+    }
+};
+
+TEST_F(TestNPDMShard, TestHubbard) {
+    const int n_sites = 6, n_elec = 6;
+    const FL t = 1.0, u = 2.0;
+    shared_ptr<DMRGDriver<S, FL>> driver =
+        make_shared<DMRGDriver<S, FL>>(stack_mem, "nodex");
+    driver->initialize_system(n_sites, n_elec, 0);
+    const string save_dir = frame_<double>()->save_dir;
+
+    // 1D hubbard model
+    shared_ptr<GeneralFCIDUMP<FL>> b = driver->expr_builder();
+    b->exprs = vector<string>{"cd", "CD", "cdCD"};
+    b->indices.resize(3);
+    b->data.resize(3);
+    for (uint16_t i = 0; i + 1 < (uint16_t)n_sites; i++)
+        for (int k = 0; k < 2; k++) {
+            for (uint16_t j : {i, (uint16_t)(i + 1)})
+                b->indices[k].push_back(j);
+            for (uint16_t j : {(uint16_t)(i + 1), i})
+                b->indices[k].push_back(j);
+            b->data[k].insert(b->data[k].end(), {-t, -t});
+        }
+    for (uint16_t i = 0; i < (uint16_t)n_sites; i++) {
+        b->indices[2].insert(b->indices[2].end(), {i, i, i, i});
+        b->data[2].push_back(u);
+    }
+    shared_ptr<MPO<S, FL>> mpo = driver->get_mpo(b->adjust_order(), 0);
+    shared_ptr<MPS<S, FL>> ket = driver->get_random_mps("KET", 50, 0, 2);
+    driver->dmrg(mpo, ket, 10, 1E-10, vector<ubond_t>{50},
+                 vector<double>{1E-5, 1E-5, 0.0});
+
+    const vector<string> exprs = {"cd", "CD", "ccdd", "cCDd", "CCDD"};
+    vector<shared_ptr<GTensor<FL>>> npdms = driver->get_npdm(exprs, ket, ket);
+    vector<shared_ptr<NPDMShard<S, FL>>> shards =
+        driver->get_npdm_shards(exprs, ket, ket);
+    ASSERT_EQ(shards.size(), npdms.size());
+
+    // without a communicator every shard owns the whole tensor
+    FL n_tot = 0;
+    for (size_t i = 0; i < shards.size(); i++) {
+        EXPECT_FALSE(shards[i]->is_partial());
+        expect_equal(shards[i]->gather(), npdms[i]);
+        const string fn = save_dir + "/NPDM-SHARD-" + exprs[i] + ".npy";
+        shards[i]->save(fn);
+        expect_equal(read_npy(fn), npdms[i]);
+    }
+    for (int k = 0; k < 2; k++)
+        for (int i = 0; i < n_sites; i++)
+            n_tot += (*npdms[k])({i, i});
+    EXPECT_LT(abs(n_tot - (FL)n_elec), 1E-8);
+
+    // slices of three ranks
+    const int n_ranks = 3;
+    const shared_ptr<GTensor<FL>> &full = npdms[2];
+    FL full_norm = 0;
+    for (size_t i = 0; i < full->size(); i++)
+        full_norm += (*full->data)[i] * (*full->data)[i];
+    EXPECT_GT(full_norm, 1.0);
+    vector<shared_ptr<NPDMShard<S, FL>>> rshards(n_ranks);
+    const string fn = save_dir + "/NPDM-SHARD-RANKS.npy";
+    size_t n_owned = 0;
+    shared_ptr<GTensor<FL>> gathered = make_shared<GTensor<FL>>(full->shape);
+    gathered->clear();
+    for (int r = 0; r < n_ranks; r++) {
+        shared_ptr<SerialRankCommunicator<S>> comm =
+            make_shared<SerialRankCommunicator<S>>(n_ranks, r);
+        rshards[r] = make_shared<NPDMShard<S, FL>>(full->shape, comm);
+        EXPECT_TRUE(rshards[r]->is_partial());
+        EXPECT_EQ(rshards[r]->offset, n_owned);
+        n_owned += rshards[r]->size();
+        shared_ptr<GTensor<FL>> xfull = make_shared<GTensor<FL>>(*full);
+        xfull->data = make_shared<vector<FL>>(*full->data);
+        rshards[r]->reduce_scatter(xfull);
+        // without the sum over ranks, gather only gives the owned slice
+        shared_ptr<GTensor<FL>> g = rshards[r]->gather();
+        for (size_t i = 0; i < g->size(); i++)
+            (*gathered->data)[i] += (*g->data)[i];
+        // rank 0 writes the header before the other ranks write the slices
+        rshards[r]->save(fn);
+        rshards[r]->save_local(fn);
+    }
+    EXPECT_EQ(n_owned, full->size());
+    expect_equal(gathered, full);
+    expect_equal(read_npy(fn), full);
+    shared_ptr<GTensor<FL>> locals =
+        make_shared<GTensor<FL>>(vector<MKL_INT>{0});
+    locals->data->clear();
+    for (int r = 0; r < n_ranks; r++) {
+        shared_ptr<GTensor<FL>> x =
+            read_npy(fn + "." + Parsing::to_string(r) + ".npy");
+        EXPECT_EQ(x->shape, vector<MKL_INT>{(MKL_INT)rshards[r]->size()});
+        locals->data->insert(locals->data->end(), x->data->begin(),
+                             x->data->end());
+    }
+    locals->shape = full->shape;
+    expect_equal(locals, full);
+
+    // failed writes are reported
+    EXPECT_THROW(shards[0]->save(save_dir + "/NO-SUCH-DIR/NPDM.npy"),
+                 runtime_error);
+
+    mpo->deallocate();
+    driver = nullptr;
+}
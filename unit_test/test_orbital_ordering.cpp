@@ -0,0 +1,126 @@
+#include "block2_core.hpp"
+#include "block2_dmrg.hpp"
+#include <gtest/gtest.h>
+
+using namespace block2;
+
+class TestOrbitalOrdering : public ::testing::Test {
+  protected:
+    static const int n_tests = 20;
+    void SetUp() override {
+        Random::rand_seed(384666);
+        threading_() = make_shared<Threading>(
+            ThreadingTypes::OperatorBatchedGEMM | ThreadingTypes::Global, 4, 4,
+            1);
+    }
+    void TearDown() override {}
+    static vector<double> random_kmat(uint16_t n_sites) {
+        vector<double> kmat(n_sites * n_sites, 0.0);
+        for (uint16_t i = 0; i < n_sites; i++)
+            for (uint16_t j = i + 1; j < n_sites; j++)
+                kmat[i * n_sites + j] = kmat[j * n_sites + i] =
+                    Random::rand_double();
+        return kmat;
+    }
+    static vector<uint16_t> random_ord(uint16_t n_sites) {
+        vector<uint16_t> ord(n_sites);
+        for (uint16_t i = 0; i < n_sites; i++)
+            ord[i] = i;
+        for (uint16_t i = 0; i < n_sites; i++)
+            swap(ord[i], ord[Random::rand_int(i, n_sites)]);
+        return ord;
+    }
+    static double rsum(uint16_t n_sites, const vector<double> &kmat) {
+        double r = 0;
+        for (uint16_t i = 0; i < n_sites; i++)
+            for (uint16_t j = i + 1; j < n_sites; j++)
+                r += kmat[i * n_sites + j];
+        return r;
+    }
+};
+
+TEST_F(TestOrbitalOrdering, TestDeltas) {
+    for (int it = 0; it < n_tests; it++) {
+        const uint16_t n_sites = (uint16_t)Random::rand_int(3, 15);
+        const vector<double> kmat = random_kmat(n_sites);
+        const vector<uint16_t> ord = random_ord(n_sites);
+        const double rs = rsum(n_sites, kmat);
+        const double cost = OrbitalOrdering::evaluate(n_sites, kmat, ord) * rs;
+        for (int a = 0; a < n_sites; a++)
+            for (int b = a; b < n_sites; b++) {
+                vector<uint16_t> xord = ord;
+                swap(xord[a], xord[b]);
+                double ref =
+                    OrbitalOrdering::evaluate(n_sites, kmat, xord) * rs - cost;
+                EXPECT_LT(abs(OrbitalOrdering::swap_delta(n_sites, kmat, ord,
+                                                          a, b) -
+                              ref),
+                          1E-10 * max(1.0, abs(cost)));
+                xord = ord;
+                reverse(xord.begin() + a, xord.begin() + b + 1);
+                ref =
+                    OrbitalOrdering::evaluate(n_sites, kmat, xord) * rs - cost;
+                EXPECT_LT(abs(OrbitalOrdering::reverse_delta(n_sites, kmat, ord,
+                                                             a, b) -
+                              ref),
+                          1E-10 * max(1.0, abs(cost)));
+            }
+    }
+}
+
+TEST_F(TestOrbitalOrdering, TestGAIncrementalCosts) {
+    const uint16_t n_sites = 16;
+    const vector<double> kmat = random_kmat(n_sites);
+    const double rs = rsum(n_sites, kmat);
+    auto eval_op = [&kmat](uint16_t *ord) {
+        return OrbitalOrdering::evaluate(
+            n_sites, kmat, vector<uint16_t>(ord, ord + n_sites));
+    };
+    const vector<uint16_t> ford = OrbitalOrdering::fiedler(n_sites, kmat);
+    // costs updated by swap deltas must match the full evaluation
+    for (bool incremental : {false, true}) {
+        GAOptimization<decltype(eval_op)> ga(n_sites, ford, eval_op, 20);
+        ga.n_elite = 3;
+        ga.clone_rate = 0.5;
+        ga.mutate_rate = 0.5;
+        if (incremental)
+            ga.swap_delta_op = [&kmat, rs](const uint16_t *ord, int a, int b) {
+                return OrbitalOrdering::swap_delta(n_sites, kmat.data(), ord,
+                                                   a, b) /
+                       rs;
+            };
+        vector<uint16_t> best = ga.solve(200);
+        for (int i = 0; i < ga.n_configs; i++)
+            EXPECT_LT(abs(ga.costs[i] - eval_op(ga.ords.data() + i * n_sites)),
+                      1E-10);
+        EXPECT_LE(OrbitalOrdering::evaluate(n_sites, kmat, best),
+                  OrbitalOrdering::evaluate(n_sites, kmat, ford) + 1E-12);
+    }
+}
+
+TEST_F(TestOrbitalOrdering, TestSA) {
+    const uint16_t n_sites = 16;
+    const vector<double> kmat = random_kmat(n_sites);
+    const vector<uint16_t> ford = OrbitalOrdering::fiedler(n_sites, kmat);
+    const vector<uint16_t> ord =
+        OrbitalOrdering::sa_opt(n_sites, kmat, ford, 20000, 1234);
+    // a permutation, deterministic for a given seed
+    vector<uint16_t> xord = ord;
+    sort(xord.begin(), xord.end());
+    for (uint16_t i = 0; i < n_sites; i++)
+        EXPECT_EQ(xord[i], i);
+    EXPECT_EQ(OrbitalOrdering::sa_opt(n_sites, kmat, ford, 20000, 1234), ord);
+    const double cost = OrbitalOrdering::evaluate(n_sites, kmat, ord);
+    EXPECT_LE(cost, OrbitalOrdering::evaluate(n_sites, kmat, ford) + 1E-12);
+    // no single swap improves the final ordering
+    const double rs = rsum(n_sites, kmat);
+    for (int a = 0; a < n_sites; a++)
+        for (int b = a + 1; b < n_sites; b++)
+            EXPECT_GT(OrbitalOrdering::swap_delta(n_sites, kmat, ord, a, b),
+                      -1E-10 * cost * rs);
+    // the GA (with incremental costs) also improves the fiedler ordering
+    const vector<uint16_t> gord =
+        OrbitalOrdering::ga_opt(n_sites, kmat, 200, 20, 3);
+    EXPECT_LE(OrbitalOrdering::evaluate(n_sites, kmat, gord),
+              OrbitalOrdering::evaluate(n_sites, kmat, ford) + 1E-12);
+}
@@ -730,3 +730,89 @@ TEST_F(TestQ, TestSAnySU2) {
         }
     }
 }
+
+TEST_F(TestQ, TestStateInfoHashedProduct) {
+    typedef SU2KLong S;
+    threading_() = make_shared<Threading>(
+        ThreadingTypes::OperatorBatchedGEMM | ThreadingTypes::Global, 4, 2, 1);
+    auto rand_info = [](int n) {
+        StateInfo<S> si;
+        si.allocate(n);
+        for (int i = 0; i < n; i++) {
+            int nn = Random::rand_int(0, 40), twos = Random::rand_int(0, 9);
+            twos = (twos & (~1)) | (nn & 1);
+            si.quanta[i] = S(nn, twos, twos, 0, Random::rand_int(0, 16),
+                             Random::rand_int(0, 8));
+            si.n_states[i] = (ubond_t)Random::rand_int(0, 300);
+        }
+        si.sort_states();
+        si.collect();
+        return si;
+    };
+    StateInfo<S> a = rand_info(300), b = rand_info(400);
+    S target(60, 4, 4, 0, 0, 0);
+    ASSERT_GT((size_t)a.n * b.n, StateInfo<S>::hashed_product_threshold + 0);
+    StateInfo<S> c = StateInfo<S>::tensor_product(a, b, target);
+    // serial reference using sorted merge
+    vector<pair<S, ubond_t>> qs;
+    for (int i = 0; i < a.n; i++)
+        for (int j = 0; j < b.n; j++) {
+            S qc = a.quanta[i] + b.quanta[j];
+            for (int k = 0; k < qc.count(); k++)
+                qs.push_back(make_pair(
+                    qc[k], (ubond_t)min((uint64_t)a.n_states[i] *
+                                            (uint64_t)b.n_states[j],
+                                        (uint64_t)numeric_limits<ubond_t>::max())));
+        }
+    StateInfo<S> cx;
+    cx.allocate((int)qs.size());
+    for (size_t i = 0; i < qs.size(); i++)
+        cx.quanta[i] = qs[i].first, cx.n_states[i] = qs[i].second;
+    cx.sort_states();
+    cx.collect(target);
+    ASSERT_EQ(c.n, cx.n);
+    EXPECT_EQ(c.n_states_total, cx.n_states_total);
+    for (int i = 0; i < c.n; i++) {
+        EXPECT_EQ(c.quanta[i], cx.quanta[i]);
+        EXPECT_EQ(c.n_states[i], cx.n_states[i]);
+    }
+    // hashed lookup agrees with binary search
+    QuantaIndex<S> idx = c.build_quanta_index();
+    for (int i = 0; i < a.n; i++) {
+        EXPECT_EQ(c.find_state(a.quanta[i], idx), c.find_state(a.quanta[i]));
+        EXPECT_EQ(c.find_state(c.quanta[i % c.n], idx), i % c.n);
+    }
+    StateInfo<S> cr = StateInfo<S>::tensor_product(a, b, c);
+    ASSERT_EQ(cr.n, c.n);
+    for (int i = 0; i < c.n; i++) {
+        EXPECT_EQ(cr.quanta[i], c.quanta[i]);
+        EXPECT_EQ(cr.n_states[i], c.n_states[i]);
+    }
+    // called from a parallel region: same result, thread settings kept
+    vector<int> n_bad(threading_()->n_threads_global, 0);
+    int ntg = threading_()->activate_global();
+#pragma omp parallel num_threads(ntg)
+    {
+        int tid = threading_()->get_thread_id();
+#ifdef _OPENMP
+        int nt = omp_get_max_threads();
+#else
+        int nt = 1;
+#endif
+        StateInfo<S> cp = StateInfo<S>::tensor_product(a, b, target);
+        StateInfo<S> crp = StateInfo<S>::tensor_product(a, b, c);
+#ifdef _OPENMP
+        n_bad[tid] += nt != omp_get_max_threads();
+#endif
+        n_bad[tid] += cp.n != c.n || crp.n != c.n;
+        for (int i = 0; i < c.n && cp.n == c.n && crp.n == c.n; i++)
+            n_bad[tid] += cp.quanta[i] != c.quanta[i] ||
+                          cp.n_states[i] != c.n_states[i] ||
+                          crp.n_states[i] != c.n_states[i];
+        crp.deallocate();
+        cp.deallocate();
+    }
+    threading_()->activate_normal();
+    EXPECT_EQ(n_bad, vector<int>(n_bad.size(), 0));
+    threading_() = make_shared<Threading>();
+}
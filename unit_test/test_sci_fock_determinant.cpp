@@ -0,0 +1,57 @@
+#include "block2_big_site.hpp"
+#include "block2_core.hpp"
+#include "block2_dmrg.hpp"
+#include <gtest/gtest.h>
+
+using namespace block2;
+
+class TestSCIFockDeterminant : public ::testing::Test {
+  protected:
+    static const int n_tests = 200;
+    sci_detail::SIMDLevel level;
+    void SetUp() override {
+        Random::rand_seed(384666);
+        level = sci_detail::bitDistancesLevel();
+    }
+    void TearDown() override { sci_detail::bitDistancesLevel() = level; }
+};
+
+TEST_F(TestSCIFockDeterminant, TestBitDistances) {
+    const sci_detail::SIMDLevel max_level = sci_detail::supportedSIMDLevel();
+    EXPECT_EQ(sci_detail::bitDistancesLevel(), max_level);
+    for (int it = 0; it < n_tests; it++) {
+        const int n_words = Random::rand_int(1, 4);
+        const int n_kets = Random::rand_int(0, 40);
+        const int k0 = Random::rand_int(0, 5);
+        const size_t stride = k0 + n_kets + Random::rand_int(0, 3);
+        vector<long long> bra(n_words), kets(n_words * stride);
+        for (auto &x : bra)
+            x = ((long long)Random::rand_int(0, 1 << 30) << 34) ^
+                Random::rand_int(0, 1 << 30);
+        for (auto &x : kets)
+            x = ((long long)Random::rand_int(0, 1 << 30) << 34) ^
+                Random::rand_int(0, 1 << 30);
+        // make some kets close to bra
+        for (int k = 0; k < n_kets; k += 3)
+            for (int w = 0; w < n_words; w++)
+                kets[w * stride + k0 + k] =
+                    bra[w] ^ (1LL << Random::rand_int(0, 64));
+        vector<uint16_t> ref(n_kets);
+        for (int k = 0; k < n_kets; k++) {
+            ref[k] = 0;
+            for (int w = 0; w < n_words; w++)
+                for (int i = 0; i < 64; i++)
+                    ref[k] += ((bra[w] ^ kets[w * stride + k0 + k]) >> i) & 1;
+        }
+        // every instruction set available on this CPU gives the same result
+        for (int il = 0; il <= (int)max_level; il++) {
+            sci_detail::bitDistancesLevel() = (sci_detail::SIMDLevel)il;
+            vector<uint16_t> dist(n_kets + 1, 9999);
+            sci_detail::bitDistances(bra.data(), n_words, kets.data() + k0,
+                                     stride, n_kets, dist.data());
+            for (int k = 0; k < n_kets; k++)
+                EXPECT_EQ(dist[k], ref[k]);
+            EXPECT_EQ(dist[n_kets], 9999);
+        }
+    }
+}
@@ -0,0 +1,118 @@
+#include "block2_core.hpp"
+#include "block2_dmrg.hpp"
+#include "block2_sp_dmrg.hpp"
+#include <gtest/gtest.h>
+
+using namespace block2;
+
+class TestSPDMRGSampler : public ::testing::Test {
+  protected:
+    size_t isize = 1LL << 24;
+    size_t dsize = 1LL << 28;
+    typedef double FL;
+    template <typename S> void test_sampler();
+    void SetUp() override {
+        Random::rand_seed(0);
+        frame_<FL>() = make_shared<DataFrame<FL>>(isize, dsize, "nodex");
+        frame_<FL>()->use_main_stack = false;
+        threading_() = make_shared<Threading>(
+            ThreadingTypes::OperatorBatchedGEMM | ThreadingTypes::Global, 4, 4,
+            1);
+        threading_()->seq_type = SeqTypes::Tasked;
+    }
+    void TearDown() override {
+        frame_<FL>()->activate(0);
+        assert(ialloc_()->used == 0 && dalloc_<FL>()->used == 0);
+        frame_<FL>() = nullptr;
+    }
+};
+
+template <typename S> void TestSPDMRGSampler::test_sampler() {
+    shared_ptr<FCIDUMP<FL>> fcidump = make_shared<FCIDUMP<FL>>();
+    PGTypes pg = PGTypes::D2H;
+    fcidump->read("data/N2.STO3G.FCIDUMP");
+    vector<uint8_t> orbsym = fcidump->template orb_sym<uint8_t>();
+    transform(orbsym.begin(), orbsym.end(), orbsym.begin(),
+              PointGroup::swap_pg(pg));
+    S vacuum(0), target(fcidump->n_elec(), fcidump->twos(),
+                        PointGroup::swap_pg(pg)(fcidump->isym()));
+    const int norb = fcidump->n_sites();
+    shared_ptr<HamiltonianQC<S, FL>> hamil =
+        make_shared<HamiltonianQC<S, FL>>(vacuum, norb, orbsym, fcidump);
+
+    // random right-canonical MPS with center at the first site
+    shared_ptr<MPSInfo<S>> mps_info =
+        make_shared<MPSInfo<S>>(norb, vacuum, target, hamil->basis);
+    mps_info->set_bond_dimension(20);
+    mps_info->tag = "KET";
+    Random::rand_seed(384666);
+    shared_ptr<MPS<S, FL>> mps = make_shared<MPS<S, FL>>(norb, 0, 1);
+    mps->initialize(mps_info);
+    mps->random_canonicalize();
+    mps->save_mutable();
+    mps->save_data();
+    mps->deallocate();
+    mps_info->save_mutable();
+    mps_info->deallocate_mutable();
+    shared_ptr<UnfusedMPS<S, FL>> umps = make_shared<UnfusedMPS<S, FL>>(mps);
+    shared_ptr<StochasticPDMRG<S, FL>> spd =
+        make_shared<StochasticPDMRG<S, FL>>(umps, umps, 1.0);
+
+    // the batched sampler draws the same determinants with the same
+    // amplitudes as the single determinant sampler
+    const int nw = 50;
+    vector<double> rands((size_t)nw * norb);
+    vector<uint8_t> dets((size_t)nw * norb);
+    vector<FL> amps(nw), ovlps(nw);
+    vector<vector<uint8_t>> det_strings(nw);
+    vector<FL> ref_amps(nw);
+    for (int iw = 0; iw < nw; iw++) {
+        Random::rand_seed(1000 + iw);
+        ref_amps[iw] = spd->sampling(0, det_strings[iw]);
+        Random::rand_seed(1000 + iw);
+        Random::fill<double>(rands.data() + (size_t)iw * norb, norb);
+    }
+    spd->sampler_psi0->sample(nw, rands.data(), dets.data(), amps.data());
+    spd->sampler_psi0->overlap(nw, dets.data(), ovlps.data());
+    for (int iw = 0; iw < nw; iw++) {
+        for (int i = 0; i < norb; i++)
+            EXPECT_EQ(dets[(size_t)iw * norb + i],
+                      det_strings[iw][2 * i] +
+                          (det_strings[iw][2 * i + 1] << 1));
+        EXPECT_LT(abs(amps[iw] - ref_amps[iw]), 1E-12);
+        EXPECT_LT(abs(ovlps[iw] - spd->overlap(1, det_strings[iw])), 1E-12);
+    }
+
+    // batched statistics do not depend on batch size or number of threads
+    const size_t n_sample = 4000;
+    vector<double> r0 = spd->batched_sampling(n_sample, 0, fcidump, 7, 0, 256);
+    vector<double> r1 = spd->batched_sampling(n_sample, 0, fcidump, 7, 0, 13);
+    threading_()->n_threads_global = 1;
+    vector<double> r2 = spd->batched_sampling(n_sample, 0, fcidump, 7, 0, 256);
+    threading_()->n_threads_global = 4;
+    ASSERT_EQ(r0.size(), 3);
+    EXPECT_EQ(r0, r2);
+    for (size_t i = 0; i < r0.size(); i++)
+        EXPECT_LT(abs(r0[i] - r1[i]), 1E-12 * max(1.0, abs(r0[i])));
+    // with qvpsi0 = psi0 the B term equals the A term sample by sample
+    vector<double> r3 = spd->batched_sampling(n_sample, 1, fcidump, 7, 0, 64);
+    ASSERT_EQ(r3.size(), 6);
+    for (int i = 0; i < 2; i++)
+        EXPECT_LT(abs(r3[i] - r0[i]), 1E-12 * max(1.0, abs(r0[i])));
+    EXPECT_LT(abs(r3[2] - r3[0]), 1E-12 * abs(r3[0]));
+    EXPECT_LT(abs(r3[3] - r3[1]), 1E-12 * abs(r3[1]));
+    // and agree with the unbatched sampler within the statistical error
+    vector<double> rp = spd->parallel_sampling((int)n_sample, 0, fcidump);
+    const double err =
+        sqrt(abs(rp[1] - rp[0] * rp[0]) / n_sample + r0[2] * r0[2]);
+    EXPECT_GT(r0[2], 0.0);
+    EXPECT_LT(abs(rp[0] - r0[0]), 6 * err);
+
+    mps_info->deallocate();
+    hamil->deallocate();
+    fcidump->deallocate();
+}
+
+TEST_F(TestSPDMRGSampler, TestSZ) { test_sampler<SZ>(); }
+
+TEST_F(TestSPDMRGSampler, TestSU2) { test_sampler<SU2>(); }
@@ -273,3 +273,86 @@ TYPED_TEST(TestSparseMatrix, TestComplexSplit) {
         }
     }
 }
+
+TYPED_TEST(TestSparseMatrix, TestFindStateIndex) {
+    using S = TypeParam;
+    int iter = 12, nst = 50, nq = 400, n_lookups = 1000000;
+    double tx_hash = 0, tx_bisect = 0;
+    size_t n_found = 0, n_blocks = 0;
+    for (int i = 0; i < 10; i++) {
+        shared_ptr<StateInfo<S>> bsi =
+            this->random_state_info(iter, nq, Random::rand_int(4, nst));
+        shared_ptr<StateInfo<S>> ksi =
+            this->random_state_info(iter, nq, Random::rand_int(4, nst));
+        S target = bsi->quanta[Random::rand_int(0, bsi->n)] +
+                   ksi->quanta[Random::rand_int(0, ksi->n)];
+        target = target[Random::rand_int(0, target.count())];
+        shared_ptr<SparseMatrixInfo<S>> minfo =
+            make_shared<SparseMatrixInfo<S>>();
+        minfo->initialize(*bsi, *ksi, target, false, true);
+        n_blocks += minfo->n;
+        EXPECT_EQ(minfo->has_index(),
+                  minfo->n > SparseMatrixInfo<S>::quanta_index_threshold());
+        // probes contain both present and absent quanta
+        vector<S> probes(n_lookups);
+        for (int j = 0; j < n_lookups; j++) {
+            S q = bsi->quanta[Random::rand_int(0, bsi->n)];
+            S k = ksi->quanta[Random::rand_int(0, ksi->n)];
+            probes[j] = (j & 3) == 3 ? q : target.combine(q, -k);
+            if (probes[j] == S(S::invalid))
+                probes[j] = minfo->quanta[Random::rand_int(0, minfo->n)];
+        }
+        vector<int> idx_hash(n_lookups), idx_bisect(n_lookups);
+        Timer t;
+        t.get_time();
+        for (int j = 0; j < n_lookups; j++)
+            idx_hash[j] = minfo->find_state(probes[j]);
+        tx_hash += t.get_time();
+        for (int j = 0; j < n_lookups; j++) {
+            auto p = lower_bound(minfo->quanta, minfo->quanta + minfo->n,
+                                 probes[j]);
+            idx_bisect[j] = p == minfo->quanta + minfo->n || *p != probes[j]
+                                ? -1
+                                : (int)(p - minfo->quanta);
+        }
+        tx_bisect += t.get_time();
+        for (int j = 0; j < n_lookups; j++) {
+            EXPECT_EQ(idx_hash[j], idx_bisect[j]);
+            n_found += idx_hash[j] != -1;
+        }
+        // the index is rebuilt by load_data
+        stringstream ss;
+        minfo->save_data(ss);
+        shared_ptr<SparseMatrixInfo<S>> minfo2 =
+            make_shared<SparseMatrixInfo<S>>();
+        minfo2->load_data(ss);
+        EXPECT_EQ(minfo2->has_index(), minfo->has_index());
+        for (int j = 0; j < n_lookups; j += 97)
+            EXPECT_EQ(minfo2->find_state(probes[j]), idx_bisect[j]);
+        // pointer_only load must not trust any index saved before the
+        // stack data is changed
+        stringstream sp;
+        minfo2->save_data(sp, true);
+        reverse(minfo2->quanta, minfo2->quanta + minfo2->n);
+        shared_ptr<SparseMatrixInfo<S>> minfo3 =
+            make_shared<SparseMatrixInfo<S>>();
+        minfo3->load_data(sp, true);
+        EXPECT_EQ(minfo3->has_index(), minfo->has_index());
+        // (quanta are no longer sorted, so only hashed lookup can work)
+        for (int j = 0; j < (minfo3->has_index() ? minfo3->n : 0); j++)
+            EXPECT_EQ(minfo3->find_state(minfo3->quanta[j]), j);
+        minfo2->deallocate();
+        minfo->deallocate();
+    }
+    // a corrupted table (no empty slot) falls back to binary search
+    vector<S> qs(8);
+    for (int i = 0; i < 8; i++)
+        qs[i] = S(i, i & 1, 0);
+    vector<int> table(QuantaIndex<S>::capacity(8), 0);
+    EXPECT_EQ(QuantaIndex<S>::find(table.data(), table.size(), qs.data(),
+                                   qs[3]),
+              -2);
+    cout << "find_state: hashed = " << fixed << setprecision(3) << tx_hash
+         << " s bisect = " << tx_bisect << " s found = " << n_found
+         << " avg n = " << n_blocks / 10 << endl;
+}
@@ -0,0 +1,116 @@
+#include "block2_core.hpp"
+#include <gtest/gtest.h>
+
+using namespace block2;
+
+class TestSpinPermCache : public ::testing::Test {
+  protected:
+    const string cache_dir = "nodex/scheme-cache";
+    void SetUp() override {
+        threading_() = make_shared<Threading>(
+            ThreadingTypes::OperatorBatchedGEMM | ThreadingTypes::Global, 4, 4,
+            1);
+        if (!Parsing::path_exists("nodex"))
+            Parsing::mkdir("nodex");
+    }
+    void TearDown() override {}
+    template <typename T> static string serialize(const T &x) {
+        stringstream ss;
+        x.save_data(ss);
+        return ss.str();
+    }
+    static string read_file(const string &filename) {
+        ifstream ifs(filename.c_str(), ios::binary);
+        stringstream ss;
+        ss << ifs.rdbuf();
+        return ss.str();
+    }
+    static void write_file(const string &filename, const string &data) {
+        ofstream ofs(filename.c_str(), ios::binary);
+        ofs.write(data.data(), data.length());
+    }
+};
+
+TEST_F(TestSpinPermCache, TestSpinPermScheme) {
+    struct Case {
+        string spin_str;
+        bool su2, is_npdm;
+        vector<uint16_t> mask;
+        int max_n_sites;
+    };
+    const vector<Case> cases = {
+        {"((C+(C+D)0)1+D)0", true, true, vector<uint16_t>(), 6},
+        {"((C+(C+D)0)1+D)0", true, true, vector<uint16_t>{0, 0, 1, 1}, 6},
+        {"((C+(C+D)0)1+D)0", true, true, vector<uint16_t>(), 8},
+        {"(((C+D)0+(C+D)0)0+(C+D)0)0", true, false, vector<uint16_t>(), 0},
+        {"cdCD", false, false, vector<uint16_t>(), 0},
+        {"ccdd", false, false, vector<uint16_t>{0, 1, 1, 2}, 0}};
+    vector<string> filenames;
+    for (auto &c : cases) {
+        const string key = SpinPermScheme::cache_key(
+            c.spin_str, c.su2, true, c.is_npdm, false, c.mask, c.max_n_sites);
+        const string filename =
+            SpinPermIO::cache_filename(cache_dir, "spin-perm", key);
+        Parsing::remove_file(filename);
+        // each key has its own file
+        EXPECT_EQ(find(filenames.begin(), filenames.end(), filename),
+                  filenames.end());
+        filenames.push_back(filename);
+        const int nn = SpinPermRecoupling::count_cds(c.spin_str);
+        SpinPermScheme ref =
+            c.su2 ? SpinPermScheme::initialize_su2(
+                        nn, c.spin_str, c.is_npdm, false, c.mask, c.max_n_sites)
+                  : SpinPermScheme::initialize_sz(nn, c.spin_str, true, c.mask,
+                                                  c.max_n_sites);
+        const string sref = serialize(ref);
+        // the first construction builds and saves, the second one loads
+        for (int it = 0; it < 2; it++) {
+            SpinPermScheme x(c.spin_str, c.su2, true, c.is_npdm, false, c.mask,
+                             c.max_n_sites, cache_dir);
+            EXPECT_TRUE(Parsing::file_exists(filename));
+            EXPECT_EQ(serialize(x), sref);
+            EXPECT_EQ(x.to_str(), ref.to_str());
+        }
+        // a stale version or a truncated file is rebuilt and rewritten
+        const string data = read_file(filename);
+        string bad = data;
+        bad[0] ^= 0x7f;
+        const string bads[2] = {bad, data.substr(0, data.length() - 3)};
+        for (auto &b : bads) {
+            write_file(filename, b);
+            SpinPermScheme x(c.spin_str, c.su2, true, c.is_npdm, false, c.mask,
+                             c.max_n_sites, cache_dir);
+            EXPECT_EQ(serialize(x), sref);
+            EXPECT_EQ(read_file(filename), data);
+        }
+    }
+}
+
+TEST_F(TestSpinPermCache, TestNPDMScheme) {
+    const vector<string> spin_strs = {"(C+D)0", "((C+(C+D)0)1+D)0"};
+    for (auto &spin_str : spin_strs) {
+        const int nn = SpinPermRecoupling::count_cds(spin_str);
+        vector<shared_ptr<SpinPermScheme>> perms = {
+            make_shared<SpinPermScheme>(SpinPermScheme::initialize_su2(
+                nn, spin_str, true, false, vector<uint16_t>(), 8))};
+        stringstream kss;
+        perms[0]->save_data(kss);
+        const string filename =
+            SpinPermIO::cache_filename(cache_dir, "npdm-scheme", kss.str());
+        Parsing::remove_file(filename);
+        NPDMScheme ref(perms);
+        const string sref = serialize(ref);
+        for (int it = 0; it < 2; it++) {
+            NPDMScheme x(perms, cache_dir);
+            EXPECT_TRUE(Parsing::file_exists(filename));
+            EXPECT_EQ(x.n_max_ops, ref.n_max_ops);
+            EXPECT_EQ(serialize(x), sref);
+            EXPECT_EQ(x.to_str(), ref.to_str());
+        }
+        const string data = read_file(filename);
+        write_file(filename, data.substr(0, data.length() / 2));
+        NPDMScheme x(perms, cache_dir);
+        EXPECT_EQ(serialize(x), sref);
+        EXPECT_EQ(read_file(filename), data);
+    }
+}
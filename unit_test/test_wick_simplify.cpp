@@ -0,0 +1,91 @@
+#include "ic/wick.hpp"
+#include <gtest/gtest.h>
+
+using namespace block2;
+
+class TestWickSimplify : public ::testing::Test {
+  protected:
+    map<WickIndexTypes, set<WickIndex>> idx_map;
+    map<pair<string, int>, vector<WickPermutation>> perm_map;
+    void SetUp() override {
+        threading_() = make_shared<Threading>(
+            ThreadingTypes::OperatorBatchedGEMM | ThreadingTypes::Global, 4, 4,
+            1);
+        idx_map[WickIndexTypes::Inactive] = WickIndex::parse_set("pqrsijklmno");
+        idx_map[WickIndexTypes::External] = WickIndex::parse_set("pqrsabcdefg");
+        perm_map[make_pair("v", 4)] = WickPermutation::four_anti();
+        perm_map[make_pair("t", 2)] = WickPermutation::non_symmetric();
+        perm_map[make_pair("t", 4)] = WickPermutation::four_anti();
+    }
+    void TearDown() override {}
+    // serial reference, comparing each term with all unique terms
+    static WickExpr serial_simplify_merge(const WickExpr &x) {
+        vector<WickString> sorted(x.terms.size());
+        vector<pair<int, double>> ridxs;
+        for (int k = 0; k < (int)x.terms.size(); k++)
+            sorted[k] = x.terms[k].abs().quick_sort();
+        for (int i = 0; i < (int)x.terms.size(); i++) {
+            bool found = false;
+            for (int j = 0; j < (int)ridxs.size() && !found; j++)
+                if (sorted[i].abs_equal_to(sorted[ridxs[j].first])) {
+                    found = true;
+                    ridxs[j].second += x.terms[i].factor * sorted[i].factor *
+                                       sorted[ridxs[j].first].factor;
+                }
+            if (!found)
+                ridxs.push_back(make_pair(i, x.terms[i].factor));
+        }
+        WickExpr r;
+        for (auto &m : ridxs) {
+            r.terms.push_back(x.terms[m.first]);
+            r.terms.back().factor = m.second;
+        }
+        r = r.simplify_zero();
+        sort(r.terms.begin(), r.terms.end());
+        return r;
+    }
+    static void expect_equal(const WickExpr &a, const WickExpr &b) {
+        ASSERT_EQ(a.terms.size(), b.terms.size());
+        for (size_t i = 0; i < a.terms.size(); i++)
+            EXPECT_TRUE(a.terms[i] == b.terms[i]) << i << " : " << a.terms[i]
+                                                  << " vs " << b.terms[i];
+    }
+};
+
+TEST_F(TestWickSimplify, TestMerge) {
+    WickExpr h1 =
+        WickExpr::parse("SUM <pq> h[pq] C[p] D[q]", idx_map, perm_map);
+    WickExpr h2 =
+        0.25 * WickExpr::parse("SUM <pqrs> v[pqrs] C[p] C[q] D[s] D[r]",
+                               idx_map, perm_map);
+    WickExpr t1 =
+        WickExpr::parse("SUM <ai> t[ai] C[a] D[i]", idx_map, perm_map);
+    WickExpr t2 =
+        0.25 * WickExpr::parse("SUM <abij> t[abij] C[a] C[b] D[j] D[i]",
+                               idx_map, perm_map);
+    WickExpr ex2 = WickExpr::parse("C[i] C[j] D[b] D[a]", idx_map, perm_map);
+    WickExpr h = (h1 + h2).expand(-1, true).simplify();
+    WickExpr t = (t1 + t2).expand(-1, true).simplify();
+    // many equivalent terms and, with the negative copy, exact cancellations
+    WickExpr hx = (ex2 * (h ^ t)).expand(0);
+    vector<WickExpr> xs = {hx, hx + hx,
+                           hx + (h ^ t).expand(-1) + (-1.0) * hx};
+    for (auto &x : xs) {
+        WickExpr sx = x.simplify_delta().simplify_zero();
+        WickExpr ref = serial_simplify_merge(sx);
+        EXPECT_GT(sx.terms.size(), ref.terms.size());
+        // the result does not depend on the number of shards (threads)
+        for (int ntg : {1, 2, 4}) {
+            threading_()->n_threads_global = ntg;
+            expect_equal(sx.simplify_merge(), ref);
+            // per-term operations
+            WickExpr ss = x.simple_sort(), sd = x.simplify_delta();
+            ASSERT_EQ(ss.terms.size(), x.terms.size());
+            ASSERT_EQ(sd.terms.size(), x.terms.size());
+            for (size_t k = 0; k < x.terms.size(); k++) {
+                EXPECT_TRUE(ss.terms[k] == x.terms[k].simple_sort());
+                EXPECT_TRUE(sd.terms[k] == x.terms[k].simplify_delta());
+            }
+        }
+    }
+}